@@ -0,0 +1,100 @@
+/*
+ *  VS_CullBenchmark.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+// vsCullBenchmark measures how many boxes and spheres per millisecond
+// vsFrustum can classify, one at a time through ClassifyBox3D() and
+// ClassifySphere(), and in batches through ClassifyBoxes() and
+// ClassifySpheres().
+//
+//   vsCullBenchmark [--count N] [--iterations N]
+//
+// The boxes and spheres are scattered randomly around a camera at the origin,
+// so that some are inside its frustum, some outside, and some crossing it.
+
+#include "VS_VectorStorm.h"
+
+static float
+Rate( int items, int iterations, uint64_t microseconds )
+{
+	return (items * (float)iterations) / vsMax( 1.f, microseconds / 1000.f );
+}
+
+int main(int argc, char* argv[])
+{
+	int count = 100000;
+	int iterations = 100;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		vsString arg(argv[i]);
+		if ( arg == "--count" && i+1 < argc )
+			count = atoi(argv[++i]);
+		else if ( arg == "--iterations" && i+1 < argc )
+			iterations = atoi(argv[++i]);
+	}
+	count = vsMax( 1, count );
+	iterations = vsMax( 1, iterations );
+
+	vsSystem system( "VectorStorm", "vsCullBenchmark", argc, argv );
+	system.Init();
+
+	{
+		vsCamera3D camera;
+		camera.SetFarPlane( 500.f );
+		camera.SetPosition( vsVector3D::Zero );
+		const vsFrustum &frustum = camera.GetFrustum();
+
+		vsRandom::InitWithSeed( 1 );
+		vsArray<vsBox3D> box;
+		vsArray<vsVector4D> sphere;
+		for ( int i = 0; i < count; i++ )
+		{
+			vsVector3D center = vsRandom::GetVector3D( 600.f );
+			vsVector3D size( vsRandom::GetFloat(1.f, 20.f), vsRandom::GetFloat(1.f, 20.f), vsRandom::GetFloat(1.f, 20.f) );
+			box.AddItem( vsBox3D( center - size * 0.5f, center + size * 0.5f ) );
+			sphere.AddItem( vsVector4D( center, vsRandom::GetFloat(1.f, 20.f) ) );
+		}
+		vsArray<vsFrustum::Classification> result;
+		result.SetArraySize( count );
+
+		vsTimerSystem *timer = vsTimerSystem::Instance();
+		int visible = 0;
+
+		uint64_t start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+			for ( int i = 0; i < count; i++ )
+				visible += ( frustum.ClassifyBox3D( box[i] ) != vsFrustum::Outside );
+		uint64_t boxSingle = timer->GetMicroseconds() - start;
+
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+			visible += frustum.ClassifyBoxes( &box[0], count, &result[0] );
+		uint64_t boxBatch = timer->GetMicroseconds() - start;
+
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+			for ( int i = 0; i < count; i++ )
+				visible += ( frustum.ClassifySphere( sphere[i], sphere[i].w ) != vsFrustum::Outside );
+		uint64_t sphereSingle = timer->GetMicroseconds() - start;
+
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+			visible += frustum.ClassifySpheres( &sphere[0], count, &result[0] );
+		uint64_t sphereBatch = timer->GetMicroseconds() - start;
+
+		vsLog( "%d items, %d iterations (%d visible)", count, iterations, visible );
+		vsLog( "Boxes, one at a time:    %10.0f per ms", Rate(count, iterations, boxSingle) );
+		vsLog( "Boxes, batched:          %10.0f per ms", Rate(count, iterations, boxBatch) );
+		vsLog( "Spheres, one at a time:  %10.0f per ms", Rate(count, iterations, sphereSingle) );
+		vsLog( "Spheres, batched:        %10.0f per ms", Rate(count, iterations, sphereBatch) );
+	}
+
+	system.Deinit();
+	return 0;
+}
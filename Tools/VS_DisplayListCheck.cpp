@@ -0,0 +1,173 @@
+/*
+ *  VS_DisplayListCheck.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+// vsDisplayListCheck builds small display lists and runs them through the
+// passes which rewrite display lists (Compile() and Optimize()), checking
+// that the rewritten lists still describe the same geometry.  It logs each
+// check, and exits with a non-zero status if any of them failed.
+//
+//   vsDisplayListCheck [--headless]
+//
+// Compiling needs vsRenderBuffers, so we start up the renderer;  pass
+// '--headless' to use the null renderer.
+
+#include "VS_VectorStorm.h"
+
+static int s_failures = 0;
+
+static void
+Check( bool passed, const char *name )
+{
+	vsLog( "%s:  %s", passed ? "PASS" : "FAIL", name );
+	if ( !passed )
+		s_failures++;
+}
+
+static bool
+SameBox( const vsBox3D &a, const vsBox3D &b )
+{
+	return a.GetMin() == b.GetMin() && a.GetMax() == b.GetMax();
+}
+
+// A line model like vsModel::LoadFrom() would read from disk:  a couple of
+// transformed groups of line lists and strips.
+static vsDisplayList *
+MakeLineModel()
+{
+	vsDisplayList *list = new vsDisplayList(4096);
+
+	vsVector3D square[4] =
+	{
+		vsVector3D(-1.f, -1.f, 0.f),
+		vsVector3D(1.f, -1.f, 0.f),
+		vsVector3D(1.f, 1.f, 0.f),
+		vsVector3D(-1.f, 1.f, 0.f)
+	};
+	int lines[8] = { 0, 1, 1, 2, 2, 3, 3, 0 };
+	vsTransform3D transform;
+	transform.SetTranslation( vsVector3D(10.f, 0.f, 0.f) );
+	transform.SetRotation( vsQuaternion( vsVector3D::ZAxis, DEGREES(30.f) ) );
+	list->PushMatrix4x4( transform.GetMatrix() );
+	list->VertexArray( square, 4 );
+	list->LineListArray( lines, 8 );
+	list->ClearArrays();
+	list->PopTransform();
+
+	vsVector3D zigzag[5] =
+	{
+		vsVector3D(0.f, 0.f, -3.f),
+		vsVector3D(1.f, 2.f, -3.f),
+		vsVector3D(2.f, 0.f, -3.f),
+		vsVector3D(3.f, 2.f, -3.f),
+		vsVector3D(4.f, 0.f, -3.f)
+	};
+	int strip[5] = { 0, 1, 2, 3, 4 };
+	transform.SetTranslation( vsVector3D(0.f, -5.f, 2.f) );
+	transform.SetRotation( vsQuaternion::Identity );
+	list->PushMatrix4x4( transform.GetMatrix() );
+	list->VertexArray( zigzag, 5 );
+	list->LineStripArray( strip, 5 );
+	list->ClearArrays();
+	list->PopTransform();
+
+	return list;
+}
+
+static void
+CheckCompiledLineBounds()
+{
+	vsDisplayList *list = MakeLineModel();
+	vsBox3D before;
+	list->GetBoundingBox( before );
+
+	bool compiled = list->Compile();
+	Check( compiled && list->IsCompiled(), "Compile() compiles a line model" );
+
+	vsBox3D after;
+	list->GetBoundingBox( after );
+	Check( SameBox( before, after ), "compiled line model has the same bounds" );
+
+	// vsModel::LoadFrom() compiles, then hands the list to SetDisplayList(),
+	// which computes the model's bounds.
+	vsModel model;
+	model.SetDisplayList( list );
+	Check( SameBox( before, model.GetBoundingBox() ), "vsModel bounds for a compiled line model" );
+}
+
+static const vsVector3D s_quad[4] =
+{
+	vsVector3D(0.f, 0.f, 0.f),
+	vsVector3D(1.f, 0.f, 0.f),
+	vsVector3D(0.f, 1.f, 0.f),
+	vsVector3D(1.f, 1.f, 0.f)
+};
+static int s_quadTriangles[6] = { 0, 1, 2, 1, 3, 2 };
+
+// Some inline geometry with state changes which Optimize() should strip out:
+// an empty push/pop, a repeated ClearArrays, and consecutive list draws it
+// can merge.
+static vsDisplayList *
+MakeRedundantList()
+{
+	vsDisplayList *list = new vsDisplayList(4096);
+
+	vsMatrix4x4 offset;
+	offset.SetTranslation( vsVector3D(2.f, 0.f, 0.f) );
+
+	list->PushTranslation( vsVector3D(5.f, 0.f, 0.f) );
+	list->PopTransform();
+	list->VertexArray( s_quad, 4 );
+	list->TriangleListArray( s_quadTriangles, 3 );
+	list->TriangleListArray( s_quadTriangles+3, 3 );
+	list->PushMatrix4x4( offset );
+	list->TriangleListArray( s_quadTriangles, 6 );
+	list->PopTransform();
+	list->ClearArrays();
+	list->ClearArrays();
+
+	return list;
+}
+
+static void
+CheckOptimize()
+{
+	vsDisplayList *list = MakeRedundantList();
+	vsDisplayList original( list->GetSize() + 1 );
+	original.Append( *list );
+
+	// debug builds also verify this inside Optimize() itself.
+	vsDisplayList::OptimizeStats stats = list->Optimize();
+	Check( stats.opsRemoved > 0, "Optimize() removes redundant ops" );
+	Check( list->DrawsIdentically( original ), "optimized list draws identically" );
+
+	// and make sure the comparison can actually fail.
+	vsDisplayList *changed = MakeRedundantList();
+	changed->VertexArray( s_quad, 4 );
+	changed->TriangleListArray( s_quadTriangles+3, 3 );
+	changed->ClearArrays();
+	Check( !changed->DrawsIdentically( original ), "DrawsIdentically() notices an extra draw" );
+
+	vsDelete( changed );
+	vsDelete( list );
+}
+
+int main(int argc, char* argv[])
+{
+	vsSystem system( "VectorStorm", "vsDisplayListCheck", argc, argv );
+	system.Init();
+
+	CheckCompiledLineBounds();
+	CheckOptimize();
+
+	if ( s_failures )
+		vsLog( "%d checks failed", s_failures );
+
+	system.Deinit();
+	return s_failures ? 1 : 0;
+}
@@ -0,0 +1,206 @@
+/*
+ *  VS_FontBenchmark.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+// vsFontBenchmark measures text layout throughput:  decoding a UTF-8 string
+// and finding each character's glyph and its kerning against the next
+// character, the way vsFontRenderer lays out every string it builds.  It
+// compares vsGlyphMap and vsKerningMap, which vsFontSize uses to find glyphs
+// and kerning, against the linear searches vsFontSize used to make through
+// its glyph and kerning arrays (kept below).
+//
+//   vsFontBenchmark [--glyphs N] [--kernings N] [--characters N] [--iterations N]
+//
+// The font is laid out like a large CJK font:  ASCII and Latin-1 first, then
+// N CJK ideographs from U+4E00 onward, with kerning between random pairs of
+// Latin letters.  The text is mostly ideographs, with runs of Latin text
+// mixed in.
+
+#include "VS_VectorStorm.h"
+#include "Utils/utfcpp/utf8.h"
+
+// The linear searches vsFontSize used, for comparison.
+struct vsLinearFontLookup
+{
+	const vsGlyph *glyph;
+	int glyphCount;
+	const vsKerning *kerning;
+	int kerningCount;
+
+	const vsGlyph * FindGlyph( uint32_t letter ) const
+	{
+		for ( int i = 0; i < glyphCount; i++ )
+		{
+			if ( glyph[i].glyph == letter )
+				return &glyph[i];
+		}
+		return NULL;
+	}
+
+	float FindKerning( uint32_t pChar, uint32_t nChar ) const
+	{
+		for ( int i = 0; i < kerningCount; i++ )
+		{
+			if ( kerning[i].glyphA == pChar && kerning[i].glyphB == nChar )
+				return kerning[i].xAdvance;
+		}
+		return 0.f;
+	}
+};
+
+struct vsHashedFontLookup
+{
+	const vsGlyph *glyph;
+	const vsKerning *kerning;
+	vsGlyphMap glyphMap;
+	vsKerningMap kerningMap;
+
+	const vsGlyph * FindGlyph( uint32_t letter ) const
+	{
+		int i = glyphMap.Find(letter);
+		return ( i >= 0 ) ? &glyph[i] : NULL;
+	}
+
+	float FindKerning( uint32_t pChar, uint32_t nChar ) const
+	{
+		int i = kerningMap.Find(pChar, nChar);
+		return ( i >= 0 ) ? kerning[i].xAdvance : 0.f;
+	}
+};
+
+// Lays out 'text' on one line, returning how far the cursor moved.
+template<typename Lookup>
+static float
+LayOut( const Lookup &lookup, const vsString &text )
+{
+	const char *w = text.c_str();
+	const char *end = w + text.size();
+	float x = 0.f;
+	while ( w < end )
+	{
+		uint32_t cp = utf8::next(w, end);
+		const vsGlyph *g = lookup.FindGlyph(cp);
+		if ( !g )
+			g = lookup.FindGlyph('?');
+		if ( g )
+		{
+			x += g->xAdvance;
+			if ( w < end )
+				x += lookup.FindKerning( cp, utf8::peek_next(w, end) );
+		}
+	}
+	return x;
+}
+
+int main(int argc, char* argv[])
+{
+	int glyphs = 7000;
+	int kernings = 2000;
+	int characters = 100000;
+	int iterations = 3;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		vsString arg(argv[i]);
+		if ( arg == "--glyphs" && i+1 < argc )
+			glyphs = atoi(argv[++i]);
+		else if ( arg == "--kernings" && i+1 < argc )
+			kernings = atoi(argv[++i]);
+		else if ( arg == "--characters" && i+1 < argc )
+			characters = atoi(argv[++i]);
+		else if ( arg == "--iterations" && i+1 < argc )
+			iterations = atoi(argv[++i]);
+	}
+	glyphs = vsMax( 1, glyphs );
+	kernings = vsMax( 0, kernings );
+	characters = vsMax( 1, characters );
+	iterations = vsMax( 1, iterations );
+
+	vsSystem system( "VectorStorm", "vsFontBenchmark", argc, argv );
+	system.Init();
+
+	{
+		vsRandom::InitWithSeed( 1 );
+
+		vsArray<uint32_t> codepoint;
+		for ( uint32_t c = 32; c < 127; c++ )
+			codepoint.AddItem(c);
+		for ( uint32_t c = 160; c < 256; c++ )
+			codepoint.AddItem(c);
+		int latinCount = codepoint.ItemCount();
+		for ( int i = 0; i < glyphs; i++ )
+			codepoint.AddItem( 0x4e00 + i );
+
+		int glyphCount = codepoint.ItemCount();
+		vsGlyph *glyph = new vsGlyph[glyphCount];
+		for ( int i = 0; i < glyphCount; i++ )
+		{
+			glyph[i].glyph = codepoint[i];
+			glyph[i].xAdvance = vsRandom::GetFloat(0.3f, 1.f);
+		}
+
+		vsKerning *kerning = new vsKerning[ vsMax(1, kernings) ];
+		for ( int i = 0; i < kernings; i++ )
+		{
+			kerning[i].glyphA = vsRandom::GetInt('A', 'z');
+			kerning[i].glyphB = vsRandom::GetInt('A', 'z');
+			kerning[i].xAdvance = vsRandom::GetFloat(-0.1f, 0.f);
+		}
+
+		// mostly ideographs, with a run of Latin text every so often
+		vsString text;
+		for ( int i = 0; i < characters; )
+		{
+			int run = vsRandom::GetInt(2, 12);
+			bool latin = ( vsRandom::GetInt(4) == 0 );
+			for ( int n = 0; n < run && i < characters; n++, i++ )
+			{
+				uint32_t c = latin ? codepoint[ vsRandom::GetInt(latinCount) ] : 0x4e00 + vsRandom::GetInt(glyphs);
+				utf8::append( c, back_inserter(text) );
+			}
+		}
+		vsLog( "%d glyphs, %d kernings, %d characters", glyphCount, kernings, characters );
+
+		vsLinearFontLookup linear;
+		linear.glyph = glyph;
+		linear.glyphCount = glyphCount;
+		linear.kerning = kerning;
+		linear.kerningCount = kernings;
+
+		vsTimerSystem *timer = vsTimerSystem::Instance();
+
+		uint64_t start = timer->GetMicroseconds();
+		vsHashedFontLookup hashed;
+		hashed.glyph = glyph;
+		hashed.kerning = kerning;
+		hashed.glyphMap.Build( glyph, glyphCount );
+		hashed.kerningMap.Build( kerning, kernings );
+		vsLog( "Building maps:     %8.3f ms", (timer->GetMicroseconds() - start) / 1000.f );
+
+		float width = 0.f;
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+			width = LayOut( linear, text );
+		uint64_t linearTime = timer->GetMicroseconds() - start;
+		vsLog( "Linear search:     %8.1f ms (%.0f characters per ms, width %.1f)", linearTime / (1000.f * iterations),
+				(characters * (float)iterations) / vsMax( 1.f, linearTime / 1000.f ), width );
+
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+			width = LayOut( hashed, text );
+		uint64_t hashedTime = timer->GetMicroseconds() - start;
+		vsLog( "Glyph/kerning map: %8.1f ms (%.0f characters per ms, width %.1f)", hashedTime / (1000.f * iterations),
+				(characters * (float)iterations) / vsMax( 1.f, hashedTime / 1000.f ), width );
+
+		vsDeleteArray( kerning );
+		vsDeleteArray( glyph );
+	}
+
+	system.Deinit();
+	return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ *  VS_FutexBenchmark.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+// vsFutexBenchmark measures how quickly two threads can hand control back
+// and forth through our synchronisation primitives.  The main thread and a
+// partner thread "ping-pong":  each posts the other's semaphore and then
+// waits on its own, so every round trip is two wakeups.  It compares the
+// futex-backed vsSemaphore and auto-reset vsEvent against the mutex and
+// condition variable semaphore vsSemaphore used to be (kept below as
+// vsCondVarSemaphore).
+//
+//   vsFutexBenchmark [--roundtrips N] [--iterations N]
+
+#include "VS_VectorStorm.h"
+
+#include <SDL2/SDL.h>
+
+// The vsSemaphore which took a mutex for every Post() and Wait(), for
+// comparison.
+class vsCondVarSemaphore
+{
+	SDL_mutex *		m_mutex;
+	SDL_cond *		m_cond;
+	unsigned int	m_value;
+	bool			m_released;
+
+public:
+	vsCondVarSemaphore( unsigned int initialValue ):
+		m_mutex( SDL_CreateMutex() ),
+		m_cond( SDL_CreateCond() ),
+		m_value( initialValue ),
+		m_released( false )
+	{
+	}
+
+	~vsCondVarSemaphore()
+	{
+		SDL_DestroyCond( m_cond );
+		SDL_DestroyMutex( m_mutex );
+	}
+
+	bool Wait()
+	{
+		SDL_LockMutex( m_mutex );
+		while ( m_value == 0 && !m_released )
+			SDL_CondWait( m_cond, m_mutex );
+		if ( !m_released )
+			m_value--;
+		bool result = !m_released;
+		SDL_UnlockMutex( m_mutex );
+		return result;
+	}
+
+	void Post()
+	{
+		SDL_LockMutex( m_mutex );
+		m_value++;
+		SDL_CondSignal( m_cond );
+		SDL_UnlockMutex( m_mutex );
+	}
+
+	void Release()
+	{
+		SDL_LockMutex( m_mutex );
+		m_released = true;
+		SDL_CondBroadcast( m_cond );
+		SDL_UnlockMutex( m_mutex );
+	}
+};
+
+// Waits on 'ping' and posts 'pong', 'roundtrips' times.
+template<typename T>
+class vsPingPongTask : public vsTask
+{
+	T *		m_ping;
+	T *		m_pong;
+	int		m_roundtrips;
+
+protected:
+	virtual int Run()
+	{
+		for ( int i = 0; i < m_roundtrips; i++ )
+		{
+			if ( !m_ping->Wait() )
+				break;
+			m_pong->Post();
+		}
+		return 0;
+	}
+
+public:
+	vsPingPongTask( T *ping, T *pong, int roundtrips ):
+		vsTask("vsPingPong"),
+		m_ping(ping),
+		m_pong(pong),
+		m_roundtrips(roundtrips)
+	{
+	}
+};
+
+// vsEvent has Set() rather than Post();  adapt it so the same code can drive
+// it.  (An auto-reset event doesn't count, so the initial value is ignored)
+class vsPingPongEvent : public vsEvent
+{
+public:
+	vsPingPongEvent( unsigned int ): vsEvent(true) {}
+	void Post() { Set(); }
+};
+
+template<typename T>
+static float PingPong( int roundtrips )
+{
+	T ping(0), pong(0);
+	vsPingPongTask<T> partner( &ping, &pong, roundtrips );
+	partner.Start();
+
+	vsTimerSystem *timer = vsTimerSystem::Instance();
+	uint64_t start = timer->GetMicroseconds();
+	for ( int i = 0; i < roundtrips; i++ )
+	{
+		ping.Post();
+		pong.Wait();
+	}
+	uint64_t elapsed = timer->GetMicroseconds() - start;
+
+	partner.Join();
+	ping.Release();
+	pong.Release();
+	return (1000.f * elapsed) / roundtrips;
+}
+
+int main(int argc, char* argv[])
+{
+	int roundtrips = 200000;
+	int iterations = 3;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		vsString arg(argv[i]);
+		if ( arg == "--roundtrips" && i+1 < argc )
+			roundtrips = atoi(argv[++i]);
+		else if ( arg == "--iterations" && i+1 < argc )
+			iterations = atoi(argv[++i]);
+	}
+	roundtrips = vsMax( 1, roundtrips );
+	iterations = vsMax( 1, iterations );
+
+	vsSystem system( "VectorStorm", "vsFutexBenchmark", argc, argv );
+	system.Init();
+
+	vsLog( "%d round trips, best of %d", roundtrips, iterations );
+
+	float condVar = 0.f, semaphore = 0.f, event = 0.f;
+	for ( int n = 0; n < iterations; n++ )
+	{
+		float c = PingPong<vsCondVarSemaphore>( roundtrips );
+		float s = PingPong<vsSemaphore>( roundtrips );
+		float e = PingPong<vsPingPongEvent>( roundtrips );
+		condVar = (n == 0) ? c : vsMin( condVar, c );
+		semaphore = (n == 0) ? s : vsMin( semaphore, s );
+		event = (n == 0) ? e : vsMin( event, e );
+	}
+	vsLog( "Mutex and condvar semaphore:  %8.1f ns per round trip", condVar );
+	vsLog( "Futex semaphore:              %8.1f ns per round trip", semaphore );
+	vsLog( "Futex auto-reset event:       %8.1f ns per round trip", event );
+
+	system.Deinit();
+	return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ *  VS_LineBuilderBenchmark.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+// vsLineBuilderBenchmark measures vsLineBuilder2D joining the segments of a
+// vector map into strips and loops, adding them one at a time through
+// AddLineSegment() and all at once through AddLineSegments().  It compares
+// those against the builder vsLineBuilder2D used to be (kept below as
+// vsScanningLineBuilder2D), which looked for the strips each segment touched
+// by checking the ends of every strip.
+//
+//   vsLineBuilderBenchmark [--segments N] [--iterations N]
+//
+// The map is made of closed outlines (like buildings) and open polylines
+// (like roads), with between 4 and 40 segments each.  Each feature's
+// segments arrive in a random order, each pointing in a random direction,
+// so strips grow from both ends and often have to be merged together.
+
+#include "VS_VectorStorm.h"
+
+// The vsLineBuilder2D which scanned every strip for each new segment, for
+// comparison.
+class vsScanningLineBuilder2D
+{
+	enum End
+	{
+		End_Start,
+		End_End
+	};
+	struct strip
+	{
+		vsArray<vsVector2D> vert;
+		bool loop;
+		strip(): loop(false) {}
+	};
+	vsArray<strip> m_strip;
+
+	struct touches
+	{
+		int stripId;
+		End end;
+	};
+
+	touches touchesStripId( const vsVector2D& v )
+	{
+		touches result;
+		result.stripId = -1;
+		result.end = End_Start;
+
+		for ( int i = 0; i < m_strip.ItemCount(); i++ )
+		{
+			if ( m_strip[i].loop )
+				continue;
+
+			if ( *m_strip[i].vert.Front() == v )
+			{
+				result.stripId = i;
+				result.end = End_Start;
+				break;
+			}
+			if ( *m_strip[i].vert.Back() == v )
+			{
+				result.stripId = i;
+				result.end = End_End;
+				break;
+			}
+		}
+		return result;
+	}
+
+	void AddVertToStrip( const vsVector2D& v, int stripId, End whichEnd )
+	{
+		if ( whichEnd == End_Start )
+		{
+			m_strip[stripId].vert.SetArraySize( m_strip[stripId].vert.ItemCount()+1 );
+			for ( int i = m_strip[stripId].vert.ItemCount()-1; i > 0; i-- )
+				m_strip[stripId].vert[i] = m_strip[stripId].vert[i-1];
+
+			m_strip[stripId].vert[0] = v;
+		}
+		else
+		{
+			m_strip[stripId].vert.AddItem(v);
+		}
+	}
+
+public:
+	void AddLineSegment( const vsVector2D& from, const vsVector2D& to )
+	{
+		if ( from == to )
+			return;
+
+		touches fromTouch = touchesStripId(from);
+		touches toTouch = touchesStripId(to);
+
+		if ( fromTouch.stripId < 0 && toTouch.stripId < 0 )
+		{
+			strip s;
+			s.vert.AddItem(from);
+			s.vert.AddItem(to);
+			m_strip.AddItem(s);
+		}
+		else if ( fromTouch.stripId == toTouch.stripId )
+		{
+			m_strip[fromTouch.stripId].loop = true;
+		}
+		else if ( fromTouch.stripId >= 0 && toTouch.stripId >= 0 )
+		{
+			int laterStripId = fromTouch.stripId;
+			bool addBackward = (fromTouch.end == End_End);
+			if ( fromTouch.stripId < toTouch.stripId )
+			{
+				laterStripId = toTouch.stripId;
+				addBackward = (toTouch.end == End_End);
+			}
+			strip held = m_strip[laterStripId];
+			vsArrayIterator<strip> it = m_strip.Begin();
+			for( int i = 0; i < laterStripId; i++ )
+				it++;
+			m_strip.RemoveItem( it );
+
+			AddLineSegment( from, to );
+
+			if ( addBackward )
+			{
+				for ( int i = held.vert.ItemCount()-2; i >= 0; i-- )
+					AddLineSegment( held.vert[i], held.vert[i+1] );
+			}
+			else
+			{
+				for ( int i = 0; i < held.vert.ItemCount()-1; i++ )
+					AddLineSegment( held.vert[i], held.vert[i+1] );
+			}
+		}
+		else if ( fromTouch.stripId >= 0 )
+		{
+			AddVertToStrip( to, fromTouch.stripId, fromTouch.end );
+		}
+		else
+		{
+			AddVertToStrip( from, toTouch.stripId, toTouch.end );
+		}
+	}
+
+	int GetStripCount() const { return m_strip.ItemCount(); }
+};
+
+// Appends one feature's segments to 'segment', as pairs of points, shuffled
+// and pointing in random directions.
+static void
+AddFeature( vsArray<vsVector2D> &segment, const vsArray<vsVector2D> &point, bool closed )
+{
+	int count = closed ? point.ItemCount() : point.ItemCount() - 1;
+	vsArray<int> order;
+	for ( int i = 0; i < count; i++ )
+		order.AddItem(i);
+	for ( int i = count-1; i > 0; i-- )
+	{
+		int j = vsRandom::GetInt(i+1);
+		int swap = order[i];
+		order[i] = order[j];
+		order[j] = swap;
+	}
+	for ( int i = 0; i < count; i++ )
+	{
+		const vsVector2D &a = point[ order[i] ];
+		const vsVector2D &b = point[ (order[i] + 1) % point.ItemCount() ];
+		bool flip = vsRandom::GetBool();
+		segment.AddItem( flip ? b : a );
+		segment.AddItem( flip ? a : b );
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int segments = 100000;
+	int iterations = 3;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		vsString arg(argv[i]);
+		if ( arg == "--segments" && i+1 < argc )
+			segments = atoi(argv[++i]);
+		else if ( arg == "--iterations" && i+1 < argc )
+			iterations = atoi(argv[++i]);
+	}
+	segments = vsMax( 1, segments );
+	iterations = vsMax( 1, iterations );
+
+	vsSystem system( "VectorStorm", "vsLineBuilderBenchmark", argc, argv );
+	system.Init();
+
+	{
+		vsRandom::InitWithSeed( 1 );
+		vsArray<vsVector2D> segment;
+		vsArray<vsVector2D> point;
+		int features = 0;
+		while ( segment.ItemCount() / 2 < segments )
+		{
+			bool closed = vsRandom::GetBool();
+			int length = vsRandom::GetInt(4, 40);
+			vsVector2D corner( vsRandom::GetFloat(-10000.f, 10000.f), vsRandom::GetFloat(-10000.f, 10000.f) );
+			point.Clear();
+			if ( closed )
+			{
+				// an outline around a rough circle
+				float radius = vsRandom::GetFloat(5.f, 50.f);
+				for ( int i = 0; i < length; i++ )
+				{
+					float angle = (2.f * PI * i) / length;
+					float r = radius * vsRandom::GetFloat(0.8f, 1.2f);
+					point.AddItem( corner + vsVector2D( r * vsCos(angle), r * vsSin(angle) ) );
+				}
+			}
+			else
+			{
+				// a wandering road
+				vsVector2D position = corner;
+				for ( int i = 0; i <= length; i++ )
+				{
+					point.AddItem( position );
+					position += vsRandom::GetVector2D( 20.f );
+				}
+			}
+			AddFeature( segment, point, closed );
+			features++;
+		}
+		int pointCount = segment.ItemCount();
+		vsLog( "%d features, %d segments", features, pointCount / 2 );
+
+		vsTimerSystem *timer = vsTimerSystem::Instance();
+		int strips = 0;
+
+		uint64_t start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+		{
+			vsScanningLineBuilder2D builder;
+			for ( int i = 0; i+1 < pointCount; i += 2 )
+				builder.AddLineSegment( segment[i], segment[i+1] );
+			strips = builder.GetStripCount();
+		}
+		vsLog( "Scanning, one at a time:  %8.1f ms (%d strips)", (timer->GetMicroseconds() - start) / (1000.f * iterations), strips );
+
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+		{
+			vsLineBuilder2D builder;
+			for ( int i = 0; i+1 < pointCount; i += 2 )
+				builder.AddLineSegment( segment[i], segment[i+1] );
+			strips = builder.GetStripCount();
+		}
+		vsLog( "Hashed, one at a time:    %8.1f ms (%d strips)", (timer->GetMicroseconds() - start) / (1000.f * iterations), strips );
+
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+		{
+			vsLineBuilder2D builder;
+			builder.AddLineSegments( &segment[0], pointCount );
+			strips = builder.GetStripCount();
+		}
+		vsLog( "Hashed, all at once:      %8.1f ms (%d strips)", (timer->GetMicroseconds() - start) / (1000.f * iterations), strips );
+	}
+
+	system.Deinit();
+	return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ *  VS_RayBenchmark.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+// vsRayBenchmark measures how many rays per second vsTriangleBVH can cast
+// against a soup of random triangles:  one at a time through ClosestHit(),
+// and in batches through ClosestHits() and AnyHits(), using from one thread
+// up to the main thread plus every worker sharing its L3 cache.
+//
+//   vsRayBenchmark [--triangles N] [--rays N] [--iterations N]
+//
+// Two sets of rays are cast.  "Coherent" rays fan out across a grid from a
+// single point, like picking or sight lines from one camera;  "scattered"
+// rays start and point anywhere.
+
+#include "VS_VectorStorm.h"
+
+static float
+Rate( int rays, int iterations, uint64_t microseconds )
+{
+	return (rays * (float)iterations) / vsMax( 1.f, (float)microseconds ) * 1000000.f;
+}
+
+static void
+Benchmark( const char *name, const vsTriangleBVH &bvh, const vsArray<vsTriangleBVH::Ray> &ray, int iterations )
+{
+	vsTimerSystem *timer = vsTimerSystem::Instance();
+	int count = ray.ItemCount();
+	vsArray<vsTriangleBVH::Hit> hit;
+	hit.SetArraySize( count );
+	bool *anyHit = new bool[count];
+	int hits = 0;
+
+	uint64_t start = timer->GetMicroseconds();
+	for ( int n = 0; n < iterations; n++ )
+		for ( int i = 0; i < count; i++ )
+			hits += bvh.ClosestHit( ray[i].pos, ray[i].dir, ray[i].maxT, &hit[i] );
+	uint64_t single = timer->GetMicroseconds() - start;
+	vsLog( "%s rays (%d hit), one at a time:  %12.0f rays/s", name, hits / iterations, Rate(count, iterations, single) );
+
+	int maxThreads = vsThreadPool::Instance()->GetWorkerCount( vsThreadPool::Affinity_MainThreadL3 ) + 1;
+	for ( int threads = 1; threads <= maxThreads; threads++ )
+	{
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+			bvh.ClosestHits( &ray[0], count, &hit[0], threads );
+		uint64_t closest = timer->GetMicroseconds() - start;
+
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+			bvh.AnyHits( &ray[0], count, anyHit, threads );
+		uint64_t any = timer->GetMicroseconds() - start;
+
+		vsLog( "%s rays, %2d threads:  closest %12.0f rays/s,  any %12.0f rays/s", name, threads,
+				Rate(count, iterations, closest), Rate(count, iterations, any) );
+	}
+	delete [] anyHit;
+}
+
+int main(int argc, char* argv[])
+{
+	int triangles = 100000;
+	int rays = 100000;
+	int iterations = 10;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		vsString arg(argv[i]);
+		if ( arg == "--triangles" && i+1 < argc )
+			triangles = atoi(argv[++i]);
+		else if ( arg == "--rays" && i+1 < argc )
+			rays = atoi(argv[++i]);
+		else if ( arg == "--iterations" && i+1 < argc )
+			iterations = atoi(argv[++i]);
+	}
+	triangles = vsMax( 1, triangles );
+	rays = vsMax( 1, rays );
+	iterations = vsMax( 1, iterations );
+
+	vsSystem system( "VectorStorm", "vsRayBenchmark", argc, argv );
+	system.Init();
+
+	{
+		vsRandom::InitWithSeed( 1 );
+		vsArray<vsVector3D> vertex;
+		for ( int i = 0; i < triangles; i++ )
+		{
+			vsVector3D center = vsRandom::GetVector3D( 100.f );
+			float size = vsRandom::GetFloat( 0.5f, 4.f );
+			for ( int v = 0; v < 3; v++ )
+				vertex.AddItem( center + vsRandom::GetVector3D( size ) );
+		}
+
+		vsTimerSystem *timer = vsTimerSystem::Instance();
+		uint64_t start = timer->GetMicroseconds();
+		vsTriangleBVH bvh;
+		bvh.Build( &vertex[0], triangles );
+		vsLog( "%d triangles, %d nodes, built in %0.1f ms", triangles, bvh.GetNodeCount(), (timer->GetMicroseconds() - start) / 1000.f );
+
+		int side = vsMax( 1, (int)vsSqrt( (float)rays ) );
+		vsArray<vsTriangleBVH::Ray> coherent, scattered;
+		for ( int i = 0; i < rays; i++ )
+		{
+			vsTriangleBVH::Ray r;
+			r.pos.Set( 0.f, 0.f, -150.f );
+			r.dir.Set( (i % side) / (float)side - 0.5f, (i / side) / (float)side - 0.5f, 1.f );
+			r.maxT = 1000.f;
+			coherent.AddItem( r );
+
+			r.pos = vsRandom::GetVector3D( 120.f );
+			r.dir = vsRandom::GetVector3D( 1.f );
+			scattered.AddItem( r );
+		}
+
+		Benchmark( "Coherent", bvh, coherent, iterations );
+		Benchmark( "Scattered", bvh, scattered, iterations );
+	}
+
+	system.Deinit();
+	return 0;
+}
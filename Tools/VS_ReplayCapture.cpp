@@ -0,0 +1,66 @@
+/*
+ *  VS_ReplayCapture.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+// vsReplayCapture loads a display list saved by vsScreen::CaptureNextFrame()
+// and renders it over and over, then reports how long each opcode took.
+//
+//   vsReplayCapture <capture file> [--iterations N] [--headless]
+//
+// The capture file and any materials and textures it names are loaded
+// through the usual game data directories.  '--headless' replays against
+// the null renderer, which measures display list processing on its own;
+// otherwise we replay against the real OpenGL renderer.
+
+#include "VS_VectorStorm.h"
+#include "VS/Graphics/VS_DisplayListCapture.h"
+
+int main(int argc, char* argv[])
+{
+	vsString filename;
+	int iterations = 100;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		vsString arg(argv[i]);
+		if ( arg == "--iterations" && i+1 < argc )
+			iterations = atoi(argv[++i]);
+		else if ( arg.compare(0, 2, "--") != 0 )
+			filename = arg;
+	}
+	iterations = vsMax( 1, iterations );
+
+	if ( filename.empty() )
+	{
+		fprintf(stderr, "Usage:  %s <capture file> [--iterations N] [--headless]\n", argv[0]);
+		return 1;
+	}
+
+	vsSystem system( "VectorStorm", "vsReplayCapture", argc, argv );
+	system.Init();
+	system.InitGameData();
+
+	int result = 1;
+	{
+		vsDisplayListCapture capture( filename );
+		if ( capture.IsOK() )
+		{
+			vsDisplayList::OpTiming timing;
+			// one untimed pass first, so buffers are uploaded and shaders are
+			// compiled before we start measuring.
+			capture.Replay( vsRenderer::Instance(), 1 );
+			capture.Replay( vsRenderer::Instance(), iterations, &timing );
+			vsDisplayListCapture::LogTiming( timing, iterations );
+			result = 0;
+		}
+	}
+
+	system.DeinitGameData();
+	system.Deinit();
+	return result;
+}
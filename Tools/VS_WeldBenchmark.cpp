@@ -0,0 +1,310 @@
+/*
+ *  VS_WeldBenchmark.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+// vsWeldBenchmark measures vsPointOctree on the job vsMeshMaker gives it:
+// welding a triangle soup's duplicated vertices, by searching for an
+// existing vertex near each new one before adding it.  It compares the
+// current Morton-ordered vsPointOctree against the node-based octree it
+// replaced (kept below as vsNodePointOctree), then compares building each
+// tree from the welded vertices in one go, using Build() from one thread up
+// to the main thread plus every worker sharing its L3 cache, and finding
+// each vertex's neighbours in the finished trees.  Finally it times
+// FindNearest(), which the node-based octree didn't have.
+//
+//   vsWeldBenchmark [--grid N] [--iterations N]
+//
+// The mesh is an N x N grid of quads, two triangles each, on a gently
+// rolling surface;  each triangle brings its own three vertices, so almost
+// every vertex is shared by six triangles.
+
+#include "VS_VectorStorm.h"
+
+struct vsWeldVertex : public vsPointOctreeElement
+{
+	int index;
+};
+
+// The node-based point octree vsPointOctree used before it became a linear
+// octree, for comparison.
+template<typename T>
+class vsNodePointOctree
+{
+	struct Node
+	{
+		vsBox3D		bounds;
+		vsVector3D	middle;
+		Node*		child[8];
+		vsArray<T*> contents;
+		bool		leaf;
+
+		Node( const vsBox3D &bounds ):
+			bounds(bounds),
+			middle(bounds.Middle()),
+			contents(),
+			leaf(true)
+		{
+			for ( int i = 0; i < 8; i++ )
+				child[i] = NULL;
+		}
+
+		~Node()
+		{
+			for ( int i = 0; i < 8; i++ )
+				vsDelete(child[i]);
+		}
+	};
+
+	Node 		m_node;
+	int			m_maxRecursion;
+	int			m_maxItemsPerNode;
+
+	void RecursiveAddPoint( int recursionLevel, T* point, Node* node )
+	{
+		if ( node->leaf )
+		{
+			if ( recursionLevel >= m_maxRecursion || node->contents.ItemCount() < m_maxItemsPerNode )
+			{
+				node->contents.AddItem( point );
+				return;
+			}
+			Subdivide( node );
+		}
+		RecursiveAddPoint( recursionLevel + 1, point, node->child[ PickOctant( point->position, node ) ] );
+	}
+
+	void RecursiveFindPointsWithin( Node *node, vsArray<T*> *result, const vsVector3D &position, float distance )
+	{
+		if ( node->leaf )
+		{
+			float sqDistance = distance * distance;
+			for (int i = 0; i < node->contents.ItemCount(); ++i)
+			{
+				if ( ( node->contents[i]->position - position ).SqLength() < sqDistance )
+					result->AddItem( node->contents[i] );
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < 8; ++i)
+			{
+				if ( node->child[i]->bounds.IntersectsSphere(position, distance) )
+					RecursiveFindPointsWithin( node->child[i], result, position, distance );
+			}
+		}
+	}
+
+	void Subdivide( Node* node )
+	{
+		node->leaf = false;
+		for ( int i = 0; i < 8; i++ )
+		{
+			vsVector3D corner = node->bounds.Corner(i);
+			vsBox3D box;
+			box.ExpandToInclude(corner);
+			box.ExpandToInclude(node->middle);
+			node->child[ PickOctant( corner, node ) ] = new Node( box );
+		}
+
+		for( int i = 0; i < node->contents.ItemCount(); i++ )
+			RecursiveAddPoint( 0, node->contents.GetItem(i), node );
+		node->contents.Clear();
+	}
+
+	int PickOctant( const vsVector3D &position, Node* node )
+	{
+		vsVector3D delta = node->middle - position;
+		int octant = 0;
+		if (delta.x < 0.f)
+			octant |= 0x1;
+		if (delta.y < 0.f)
+			octant |= 0x2;
+		if (delta.z < 0.f)
+			octant |= 0x4;
+		return octant;
+	}
+
+public:
+	vsNodePointOctree( const vsBox3D &bounds, int maxItemsPerNode ):
+		m_node( bounds ),
+		m_maxRecursion(10),
+		m_maxItemsPerNode( maxItemsPerNode )
+	{
+	}
+
+	void AddPoint( T *point )
+	{
+		RecursiveAddPoint( 0, point, &m_node );
+	}
+
+	void FindPointsWithin( vsArray<T*> *result, const vsVector3D &position, float distance )
+	{
+		RecursiveFindPointsWithin( &m_node, result, position, distance );
+	}
+};
+
+// Welds 'soup' the way vsMeshMaker does, returning how many distinct
+// vertices were left:  it gathers every vertex within its search distance,
+// then looks among them for one close enough to merge with.
+template<typename Tree>
+static int
+Weld( Tree &tree, const vsArray<vsVector3D> &soup, vsArray<vsWeldVertex> &vertex )
+{
+	const float c_searchDistance = 1.1f;
+	const float c_weldDistance = 0.01f;
+	int vertexCount = 0;
+	vsArray<vsWeldVertex*> nearby;
+	for ( int i = 0; i < soup.ItemCount(); i++ )
+	{
+		nearby.Clear();
+		tree.FindPointsWithin( &nearby, soup[i], c_searchDistance );
+		bool found = false;
+		for ( int n = 0; n < nearby.ItemCount() && !found; n++ )
+			found = ( nearby[n]->position - soup[i] ).SqLength() < c_weldDistance * c_weldDistance;
+		if ( !found )
+		{
+			vsWeldVertex *v = &vertex[vertexCount];
+			v->position = soup[i];
+			v->index = vertexCount++;
+			tree.AddPoint( v );
+		}
+	}
+	return vertexCount;
+}
+
+// Finds the neighbours of every vertex, returning how many were found.
+template<typename Tree>
+static int
+FindNeighbours( Tree &tree, const vsArray<vsWeldVertex> &vertex, int vertexCount, float distance )
+{
+	int found = 0;
+	vsArray<vsWeldVertex*> nearby;
+	for ( int i = 0; i < vertexCount; i++ )
+	{
+		nearby.Clear();
+		tree.FindPointsWithin( &nearby, vertex[i].position, distance );
+		found += nearby.ItemCount();
+	}
+	return found;
+}
+
+int main(int argc, char* argv[])
+{
+	int grid = 300;
+	int iterations = 3;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		vsString arg(argv[i]);
+		if ( arg == "--grid" && i+1 < argc )
+			grid = atoi(argv[++i]);
+		else if ( arg == "--iterations" && i+1 < argc )
+			iterations = atoi(argv[++i]);
+	}
+	grid = vsMax( 1, grid );
+	iterations = vsMax( 1, iterations );
+
+	vsSystem system( "VectorStorm", "vsWeldBenchmark", argc, argv );
+	system.Init();
+
+	{
+		vsArray<vsVector3D> soup;
+		for ( int y = 0; y < grid; y++ )
+		{
+			for ( int x = 0; x < grid; x++ )
+			{
+				vsVector3D corner[4];
+				for ( int c = 0; c < 4; c++ )
+				{
+					float px = (float)(x + (c & 0x1));
+					float pz = (float)(y + ((c & 0x2) ? 1 : 0));
+					corner[c].Set( px, 4.f * vsSin( px * 0.05f ) * vsCos( pz * 0.07f ), pz );
+				}
+				const int c_index[6] = { 0, 1, 2, 2, 1, 3 };
+				for ( int v = 0; v < 6; v++ )
+					soup.AddItem( corner[ c_index[v] ] );
+			}
+		}
+		vsBox3D bounds( vsVector3D(-1.f, -5.f, -1.f), vsVector3D(grid + 1.f, 5.f, grid + 1.f) );
+		vsArray<vsWeldVertex> vertex;
+		vertex.SetArraySize( soup.ItemCount() );
+		vsLog( "%d triangles, %d soup vertices", grid * grid * 2, soup.ItemCount() );
+
+		vsTimerSystem *timer = vsTimerSystem::Instance();
+		int welded = 0;
+
+		uint64_t start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+		{
+			vsNodePointOctree<vsWeldVertex> tree( bounds, 16 );
+			welded = Weld( tree, soup, vertex );
+		}
+		vsLog( "Weld, node octree:    %8.1f ms (%d vertices)", (timer->GetMicroseconds() - start) / (1000.f * iterations), welded );
+
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+		{
+			vsPointOctree<vsWeldVertex> tree( bounds, 16 );
+			welded = Weld( tree, soup, vertex );
+		}
+		vsLog( "Weld, linear octree:  %8.1f ms (%d vertices)", (timer->GetMicroseconds() - start) / (1000.f * iterations), welded );
+
+		// bulk build over every welded vertex, against adding them one at a
+		// time to the node octree
+		vsArray<vsWeldVertex*> point;
+		for ( int i = 0; i < welded; i++ )
+			point.AddItem( &vertex[i] );
+		vsNodePointOctree<vsWeldVertex> *nodeTree = NULL;
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+		{
+			vsDelete( nodeTree );
+			nodeTree = new vsNodePointOctree<vsWeldVertex>( bounds, 16 );
+			for ( int i = 0; i < welded; i++ )
+				nodeTree->AddPoint( point[i] );
+		}
+		vsLog( "Build, node octree:   %8.1f ms", (timer->GetMicroseconds() - start) / (1000.f * iterations) );
+
+		vsPointOctree<vsWeldVertex> tree( bounds, 16 );
+		int maxThreads = vsThreadPool::Instance()->GetWorkerCount( vsThreadPool::Affinity_MainThreadL3 ) + 1;
+		for ( int threads = 1; threads <= maxThreads; threads++ )
+		{
+			start = timer->GetMicroseconds();
+			for ( int n = 0; n < iterations; n++ )
+				tree.Build( &point[0], point.ItemCount(), threads );
+			vsLog( "Build, %2d threads:    %8.1f ms", threads, (timer->GetMicroseconds() - start) / (1000.f * iterations) );
+		}
+
+		// neighbours of each vertex, in both finished trees
+		const float c_neighbourDistance = 1.5f;
+		int found = 0;
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+			found = FindNeighbours( *nodeTree, vertex, welded, c_neighbourDistance );
+		vsLog( "Neighbours, node octree:    %8.1f ms (%d found)", (timer->GetMicroseconds() - start) / (1000.f * iterations), found );
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+			found = FindNeighbours( tree, vertex, welded, c_neighbourDistance );
+		vsLog( "Neighbours, linear octree:  %8.1f ms (%d found)", (timer->GetMicroseconds() - start) / (1000.f * iterations), found );
+		vsDelete( nodeTree );
+
+		// eight nearest neighbours of each vertex
+		const int c_k = 8;
+		vsWeldVertex *nearest[c_k];
+		float sqDistance[c_k];
+		found = 0;
+		start = timer->GetMicroseconds();
+		for ( int n = 0; n < iterations; n++ )
+			for ( int i = 0; i < welded; i++ )
+				found += tree.FindNearest( vertex[i].position, c_k, nearest, sqDistance );
+		vsLog( "Nearest %d, %d queries:  %8.1f ms (%d found)", c_k, welded, (timer->GetMicroseconds() - start) / (1000.f * iterations), found / iterations );
+	}
+
+	system.Deinit();
+	return 0;
+}
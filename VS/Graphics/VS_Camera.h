@@ -118,6 +118,8 @@ public:
 	};
 	VisibilityType		ClassifyBox3D( const vsBox3D &box ) const;
 	bool				IsBox3DVisible( const vsBox3D &box ) const;
+
+	const vsFrustum &	GetFrustum() const { return m_frustum; }
 };
 
 
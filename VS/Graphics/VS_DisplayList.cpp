@@ -25,6 +25,7 @@
 #if !TARGET_OS_IPHONE
 #include "SDL2/SDL_opengl.h"
 #endif
+#include <SDL2/SDL.h>
 
 static vsString g_opCodeName[vsDisplayList::OpCode_MAX] =
 {
@@ -105,7 +106,9 @@ static vsString g_opCodeName[vsDisplayList::OpCode_MAX] =
 
 	"SetShaderValues",
 
-	"Debug"
+	"Debug",
+
+	"Padding"
 };
 
 const vsString&
@@ -453,7 +456,11 @@ vsDisplayList::vsDisplayList():
 	m_instanceParent(NULL),
 	m_instanceCount(0),
 	m_materialCount(0),
-	m_colorSet(false)
+	m_colorSet(false),
+	m_containsArrays(false),
+	m_opTiming(NULL),
+	m_opTimingStart(0),
+	m_opTimingType(OpCode_MAX)
 {
 	Clear();
 }
@@ -462,7 +469,11 @@ vsDisplayList::vsDisplayList( size_t memSize ):
 	m_instanceParent(NULL),
 	m_instanceCount(0),
 	m_materialCount(0),
-	m_colorSet(false)
+	m_colorSet(false),
+	m_containsArrays(false),
+	m_opTiming(NULL),
+	m_opTimingStart(0),
+	m_opTimingType(OpCode_MAX)
 {
 	if ( memSize )
 	{
@@ -484,6 +495,7 @@ vsDisplayList::~vsDisplayList()
 	{
 		vsDelete( m_material[i] );
 	}
+	DeleteCompiledBuffers();
 
 	if ( m_fifo )
 	{
@@ -527,6 +539,18 @@ vsDisplayList::Clear()
 		m_fifo->Clear();
 	}
 	m_colorSet = false;
+	m_containsArrays = false;
+	DeleteCompiledBuffers();
+}
+
+void
+vsDisplayList::DeleteCompiledBuffers()
+{
+	for ( int i = 0; i < m_compiledBuffer.ItemCount(); i++ )
+	{
+		vsDelete( m_compiledBuffer[i] );
+	}
+	m_compiledBuffer.Clear();
 }
 
 void
@@ -607,10 +631,57 @@ vsDisplayList::Append( const vsDisplayList &list )
 	}
 	else
 	{
+		// 'list' was recorded with its arrays aligned relative to the start
+		// of its buffer;  line ourselves up the same way so they stay aligned.
+		if ( list.m_containsArrays )
+		{
+			PadToArrayAlignment();
+			m_containsArrays = true;
+		}
 		m_fifo->Append( list.m_fifo );
 	}
 }
 
+bool
+vsDisplayList::IsInstanceable()
+{
+	if ( m_instanceParent )
+		return m_instanceParent->IsInstanceable();
+
+	bool result = true;
+	Rewind();
+	for ( op *o = PopOp(); o && result; o = PopOp() )
+	{
+		switch ( o->type )
+		{
+			case OpCode_SetColors:
+			case OpCode_SetColorsBuffer:
+			case OpCode_PushTransform:
+			case OpCode_PushTranslation:
+			case OpCode_PushMatrix4x4:
+			case OpCode_SetMatrix4x4:
+			case OpCode_SetMatrices4x4:
+			case OpCode_SetMatrices4x4Buffer:
+			case OpCode_SetWorldToViewMatrix4x4:
+			case OpCode_PopTransform:
+			case OpCode_SetCameraTransform:
+			case OpCode_Set3DProjection:
+			case OpCode_SetProjectionMatrix4x4:
+			case OpCode_SnapMatrix:
+			case OpCode_SetRenderTarget:
+			case OpCode_ClearRenderTarget:
+			case OpCode_ResolveRenderTarget:
+			case OpCode_BlitRenderTarget:
+				result = false;
+				break;
+			default:
+				break;
+		}
+	}
+	Rewind();
+	return result;
+}
+
 void
 vsDisplayList::DrawLine( const vsVector3D &from, const vsVector3D &to )
 {
@@ -742,23 +813,17 @@ vsDisplayList::PopTransform()
 void
 vsDisplayList::VertexArray( const vsVector2D *array, int arrayCount )
 {
-	m_fifo->WriteUint8( OpCode_VertexArray );
-	m_fifo->WriteUint32( arrayCount );
+	vsVector3D *shuttle = (vsVector3D*)WriteArrayHeader( OpCode_VertexArray, arrayCount, sizeof(vsVector3D) );
 	for ( int i = 0; i < arrayCount; i++ )
 	{
-		m_fifo->WriteVector3D( array[i] );
+		shuttle[i].Set( array[i].x, array[i].y, 0.f );
 	}
 }
 
 void
 vsDisplayList::VertexArray( const vsVector3D *array, int arrayCount )
 {
-	m_fifo->WriteUint8( OpCode_VertexArray );
-	m_fifo->WriteUint32( arrayCount );
-	for ( int i = 0; i < arrayCount; i++ )
-	{
-		m_fifo->WriteVector3D( array[i] );
-	}
+	WriteArray( OpCode_VertexArray, array, arrayCount, sizeof(vsVector3D) );
 }
 
 void
@@ -774,12 +839,7 @@ vsDisplayList::VertexBuffer( vsRenderBuffer *buffer )
 void
 vsDisplayList::NormalArray( const vsVector3D *array, int arrayCount )
 {
-	m_fifo->WriteUint8( OpCode_NormalArray );
-	m_fifo->WriteUint32( arrayCount );
-	for ( int i = 0; i < arrayCount; i++ )
-	{
-		m_fifo->WriteVector3D( array[i] );
-	}
+	WriteArray( OpCode_NormalArray, array, arrayCount, sizeof(vsVector3D) );
 }
 
 void
@@ -856,78 +916,59 @@ vsDisplayList::ClearArrays()
 void
 vsDisplayList::TexelArray( const vsVector2D *array, int arrayCount )
 {
-	m_fifo->WriteUint8( OpCode_TexelArray );
-	m_fifo->WriteUint32( arrayCount );
-	for ( int i = 0; i < arrayCount; i++ )
-	{
-		m_fifo->WriteVector2D( array[i] );
-	}
+	WriteArray( OpCode_TexelArray, array, arrayCount, sizeof(vsVector2D) );
 }
 
 void
 vsDisplayList::ColorArray( const vsColor *array, int arrayCount )
 {
-	m_fifo->WriteUint8( OpCode_ColorArray );
-	m_fifo->WriteUint32( arrayCount );
 	m_colorSet = true;
-	for ( int i = 0; i < arrayCount; i++ )
-	{
-		m_fifo->WriteColor( array[i] );
-	}
+	WriteArray( OpCode_ColorArray, array, arrayCount, sizeof(vsColor) );
 }
 
 void
 vsDisplayList::LineListArray( int *idArray, int vertexCount )
 {
-	m_fifo->WriteUint8( OpCode_LineListArray );
-	m_fifo->WriteUint32( vertexCount );
+	uint16_t *shuttle = (uint16_t*)WriteArrayHeader( OpCode_LineListArray, vertexCount, sizeof(uint16_t) );
 	for ( int i = 0; i < vertexCount; i++ )
 	{
-		m_fifo->WriteUint16Native( idArray[i] );
+		shuttle[i] = idArray[i];
 	}
 }
 
 void
 vsDisplayList::LineStripArray( uint16_t *idArray, int vertexCount )
 {
-	m_fifo->WriteUint8( OpCode_LineStripArray );
-	m_fifo->WriteUint32( vertexCount );
-	for ( int i = 0; i < vertexCount; i++ )
-	{
-		m_fifo->WriteUint16Native( idArray[i] );
-	}
+	WriteArray( OpCode_LineStripArray, idArray, vertexCount, sizeof(uint16_t) );
 }
 
 void
 vsDisplayList::LineStripArray( int *idArray, int vertexCount )
 {
-	m_fifo->WriteUint8( OpCode_LineStripArray );
-	m_fifo->WriteUint32( vertexCount );
+	uint16_t *shuttle = (uint16_t*)WriteArrayHeader( OpCode_LineStripArray, vertexCount, sizeof(uint16_t) );
 	for ( int i = 0; i < vertexCount; i++ )
 	{
-		m_fifo->WriteUint16Native( idArray[i] );
+		shuttle[i] = idArray[i];
 	}
 }
 
 void
 vsDisplayList::TriangleListArray( int *idArray, int vertexCount )
 {
-	m_fifo->WriteUint8( OpCode_TriangleListArray );
-	m_fifo->WriteUint32( vertexCount );
+	uint16_t *shuttle = (uint16_t*)WriteArrayHeader( OpCode_TriangleListArray, vertexCount, sizeof(uint16_t) );
 	for ( int i = 0; i < vertexCount; i++ )
 	{
-		m_fifo->WriteUint16Native( idArray[i] );
+		shuttle[i] = idArray[i];
 	}
 }
 
 void
 vsDisplayList::TriangleStripArray( int *idArray, int vertexCount )
 {
-	m_fifo->WriteUint8( OpCode_TriangleStripArray );
-	m_fifo->WriteUint32( vertexCount );
+	uint16_t *shuttle = (uint16_t*)WriteArrayHeader( OpCode_TriangleStripArray, vertexCount, sizeof(uint16_t) );
 	for ( int i = 0; i < vertexCount; i++ )
 	{
-		m_fifo->WriteUint16Native( idArray[i] );
+		shuttle[i] = idArray[i];
 	}
 }
 
@@ -969,22 +1010,20 @@ vsDisplayList::LineStripBuffer( vsRenderBuffer *buffer )
 void
 vsDisplayList::PointsArray( int *idArray, int vertexCount )
 {
-	m_fifo->WriteUint8( OpCode_PointsArray );
-	m_fifo->WriteUint32( vertexCount );
+	uint16_t *shuttle = (uint16_t*)WriteArrayHeader( OpCode_PointsArray, vertexCount, sizeof(uint16_t) );
 	for ( int i = 0; i < vertexCount; i++ )
 	{
-		m_fifo->WriteUint16Native( idArray[i] );
+		shuttle[i] = idArray[i];
 	}
 }
 
 void
 vsDisplayList::TriangleFanArray( int *idArray, int vertexCount )
 {
-	m_fifo->WriteUint8( OpCode_TriangleFanArray );
-	m_fifo->WriteUint32( vertexCount );
+	uint16_t *shuttle = (uint16_t*)WriteArrayHeader( OpCode_TriangleFanArray, vertexCount, sizeof(uint16_t) );
 	for ( int i = 0; i < vertexCount; i++ )
 	{
-		m_fifo->WriteUint16Native( idArray[i] );
+		shuttle[i] = idArray[i];
 	}
 }
 
@@ -1117,6 +1156,7 @@ vsDisplayList::OpCode
 vsDisplayList::PeekOpType()
 {
 	OpCode result = OpCode_MAX;
+	SkipPadding();
 	if ( !m_fifo->AtEnd() )
 	{
 		result = (OpCode)m_fifo->PeekUint8();
@@ -1125,17 +1165,115 @@ vsDisplayList::PeekOpType()
 	return result;
 }
 
-static vsColor		s_color;
-static vsVector2D	s_vector;
-static vsVector3D	s_vector3d;
-static vsTransform2D	s_transform;
+void
+vsDisplayList::SkipPadding()
+{
+	while ( !m_fifo->AtEnd() && (OpCode)m_fifo->PeekUint8() == OpCode_Padding )
+	{
+		m_fifo->AdvanceReadHead(1);
+	}
+}
+
+void
+vsDisplayList::PadToArrayAlignment()
+{
+	size_t misalignment = m_fifo->Length() % DISPLAYLIST_ARRAY_ALIGNMENT;
+	if ( misalignment )
+	{
+		for ( size_t i = misalignment; i < DISPLAYLIST_ARRAY_ALIGNMENT; i++ )
+			m_fifo->WriteUint8( OpCode_Padding );
+	}
+}
+
+char *
+vsDisplayList::WriteArrayHeader( OpCode code, int count, size_t elementSize )
+{
+	m_fifo->WriteUint8( code );
+	m_fifo->WriteUint32( count );
+
+	// Alignment is relative to the start of our buffer, so that copying a
+	// list's contents somewhere else keeps them aligned.  +1 for the padding
+	// byte itself.
+	size_t misalignment = (m_fifo->Length() + 1) % DISPLAYLIST_ARRAY_ALIGNMENT;
+	uint8_t padding = misalignment ? (uint8_t)(DISPLAYLIST_ARRAY_ALIGNMENT - misalignment) : 0;
+	size_t bytes = count * elementSize;
+	vsAssert( m_fifo->BytesLeftForWriting() >= 1 + padding + bytes, "Tried to write past the end of a display list!" );
+
+	m_fifo->WriteUint8( padding );
+	m_fifo->AdvanceWriteHead( padding );
+
+	char *result = m_fifo->GetWriteHead();
+	m_fifo->AdvanceWriteHead( bytes );
+	m_containsArrays = true;
+	return result;
+}
+
+void
+vsDisplayList::WriteArray( OpCode code, const void *array, int count, size_t elementSize )
+{
+	char *block = WriteArrayHeader( code, count, elementSize );
+	memcpy( block, array, count * elementSize );
+}
+
+void
+vsDisplayList::ReadArray( size_t elementSize )
+{
+	uint32_t count = m_fifo->ReadUint32();
+	uint8_t padding = m_fifo->ReadUint8();
+	m_fifo->AdvanceReadHead( padding );
+
+	m_currentOp.data.Set( count );
+	m_currentOp.data.SetPointer( m_fifo->GetReadHead() );
+	m_fifo->AdvanceReadHead( count * elementSize );
+}
+
+vsDisplayList::OpTiming::OpTiming()
+{
+	Clear();
+}
+
+void
+vsDisplayList::OpTiming::Clear()
+{
+	for ( int i = 0; i < OpCode_MAX; i++ )
+	{
+		count[i] = 0;
+		ticks[i] = 0;
+	}
+}
+
+void
+vsDisplayList::SetOpTiming( OpTiming *timing )
+{
+	m_opTiming = timing;
+	m_opTimingType = OpCode_MAX;
+}
+
+void
+vsDisplayList::ChargeOpTime()
+{
+	uint64_t now = SDL_GetPerformanceCounter();
+	if ( m_opTimingType != OpCode_MAX )
+		m_opTiming->ticks[m_opTimingType] += now - m_opTimingStart;
+	m_opTimingStart = now;
+	m_opTimingType = OpCode_MAX;
+}
 
 vsDisplayList::op *
 vsDisplayList::PopOp()
 {
+	if ( m_opTiming )
+		ChargeOpTime();
+
+	SkipPadding();
 	if ( !m_fifo->AtEnd() )
 	{
 		m_currentOp.type = (OpCode)m_fifo->ReadUint8();
+		if ( m_opTiming )
+		{
+			m_opTiming->count[m_currentOp.type]++;
+			m_opTimingType = m_currentOp.type;
+		}
 
 		switch( m_currentOp.type )
 		{
@@ -1153,29 +1291,9 @@ vsDisplayList::PopOp()
 				m_fifo->ReadVector3D(&m_currentOp.data.vector);
 				break;
 			case OpCode_VertexArray:
-			{
-				int count = m_fifo->ReadUint32();
-				m_currentOp.data.Set( count );
-				m_currentOp.data.SetPointer( m_fifo->GetReadHead() );
-
-				m_fifo->AdvanceReadHead( sizeof(s_vector3d) * count );
-				//for ( int i = 0; i < count; i++ )
-				//	m_fifo->ReadVector3D(&s_vector3d);
-
-				break;
-			}
 			case OpCode_NormalArray:
-			{
-				int count = m_fifo->ReadUint32();
-				m_currentOp.data.Set( count );
-				m_currentOp.data.SetPointer( m_fifo->GetReadHead() );
-
-				m_fifo->AdvanceReadHead( sizeof(s_vector3d) * count );
-//				for ( int i = 0; i < count; i++ )
-//					m_fifo->ReadVector3D(&s_vector3d);
-
+				ReadArray( sizeof(vsVector3D) );
 				break;
-			}
 			case OpCode_SetShaderValues:
 			case OpCode_SetColorsBuffer:
 			case OpCode_VertexBuffer:
@@ -1189,47 +1307,19 @@ vsDisplayList::PopOp()
 				break;
 			}
 			case OpCode_TexelArray:
-			{
-				int count = m_fifo->ReadUint32();
-				m_currentOp.data.Set( count );
-				m_currentOp.data.SetPointer( m_fifo->GetReadHead() );
-
-				m_fifo->AdvanceReadHead( sizeof(s_vector) * count );
-//				for ( int i = 0; i < count; i++ )
-//					m_fifo->ReadVector2D(&s_vector);
-
+				ReadArray( sizeof(vsVector2D) );
 				break;
-			}
 			case OpCode_ColorArray:
-			{
-				int count = m_fifo->ReadUint32();
-				m_currentOp.data.Set( count );
-				m_currentOp.data.SetPointer( m_fifo->GetReadHead() );
-
-				m_fifo->AdvanceReadHead( sizeof(s_color) * count );
-//				for ( int i = 0; i < count; i++ )
-//				{
-//					m_fifo->ReadColor(&s_color);
-//				}
+				ReadArray( sizeof(vsColor) );
 				break;
-			}
 			case OpCode_LineListArray:
 			case OpCode_LineStripArray:
 			case OpCode_TriangleListArray:
 			case OpCode_TriangleStripArray:
 			case OpCode_TriangleFanArray:
 			case OpCode_PointsArray:
-			{
-				int count = m_fifo->ReadUint32();
-				m_currentOp.data.Set( count );
-				m_currentOp.data.SetPointer( m_fifo->GetReadHead() );
-
-				m_fifo->AdvanceReadHead( sizeof(uint16_t) * count );
-//				for ( int i = 0; i < count; i++ )
-//					m_fifo->Readuint16_t();
-
+				ReadArray( sizeof(uint16_t) );
 				break;
-			}
 			case OpCode_LineListBuffer:
 			case OpCode_LineStripBuffer:
 			case OpCode_TriangleStripBuffer:
@@ -1586,11 +1676,10 @@ vsDisplayList::GetBoundingBox( vsVector2D &topLeft, vsVector2D &bottomRight )
 				case OpCode_TriangleFanBuffer:
 					{
 						vsRenderBuffer *buffer = (vsRenderBuffer *)o->data.p;
-						uint16_t *shuttle = buffer->GetIntArray();
 
 						for ( int i = 0; i < buffer->GetIntArraySize(); i++ )
 						{
-							uint16_t index = shuttle[i];
+							uint32_t index = buffer->GetIndex(i);
 							vsVector3D pos;
 							if ( currentVertexArray )
 								pos = currentVertexArray[index];
@@ -1648,6 +1737,7 @@ vsDisplayList::GetBoundingBox( vsBox3D &box )
 		transformStack[0] = vsMatrix4x4::Identity;
 		int				transformStackLevel = 0;
 		vsVector3D		*currentVertexArray = NULL;
+		vsRenderBuffer	*currentVertexBuffer = NULL;
 		//int			currentVertexArraySize = 0;
 
 		Rewind();
@@ -1679,6 +1769,7 @@ vsDisplayList::GetBoundingBox( vsBox3D &box )
 				int count = o->data.GetUInt();
 				float *shuttle = (float *) o->data.p;
 				currentVertexArray = (vsVector3D *)shuttle;
+				currentVertexBuffer = NULL;
 				//currentVertexArraySize = count*3;
 
 				for ( int i = 0; i < count; i++ )
@@ -1696,6 +1787,7 @@ vsDisplayList::GetBoundingBox( vsBox3D &box )
 				vsVector3D pos;
 				vsRenderBuffer *buffer = (vsRenderBuffer *)o->data.p;
 				currentVertexArray = buffer->GetVector3DArray();
+				currentVertexBuffer = NULL;
 				//currentVertexArraySize = buffer->GetVector3DArraySize();
 
 				for ( int i = 0; i < buffer->GetVector3DArraySize(); i++ )
@@ -1711,6 +1803,8 @@ vsDisplayList::GetBoundingBox( vsBox3D &box )
 				vsVector3D pos;
 				vsRenderBuffer *buffer = (vsRenderBuffer *)o->data.p;
 				int positionCount = buffer->GetPositionCount();
+				currentVertexArray = NULL;
+				currentVertexBuffer = buffer;
 
 				for ( int i = 0; i < positionCount; i++ )
 				{
@@ -1723,12 +1817,14 @@ vsDisplayList::GetBoundingBox( vsBox3D &box )
 			else if ( o->type == OpCode_LineListBuffer || o->type == OpCode_LineStripBuffer )
 			{
 				vsRenderBuffer *buffer = (vsRenderBuffer *)o->data.p;
-				uint16_t *shuttle = buffer->GetIntArray();
 
 				for ( int i = 0; i < buffer->GetIntArraySize(); i++ )
 				{
-					uint16_t index = shuttle[i];
-					box.ExpandToInclude( transformStack[transformStackLevel].ApplyTo( currentVertexArray[index] ) );
+					uint32_t index = buffer->GetIndex(i);
+					if ( currentVertexArray )
+						box.ExpandToInclude( transformStack[transformStackLevel].ApplyTo( currentVertexArray[index] ) );
+					else if ( currentVertexBuffer )
+						box.ExpandToInclude( transformStack[transformStackLevel].ApplyTo( currentVertexBuffer->GetPosition(index) ) );
 				}
 			}
 			else if ( o->type == OpCode_LineStripArray )
@@ -1739,7 +1835,10 @@ vsDisplayList::GetBoundingBox( vsBox3D &box )
 				for ( int i = 0; i < count; i++ )
 				{
 					uint16_t index = shuttle[i];
-					box.ExpandToInclude( transformStack[transformStackLevel].ApplyTo( currentVertexArray[index] ) );
+					if ( currentVertexArray )
+						box.ExpandToInclude( transformStack[transformStackLevel].ApplyTo( currentVertexArray[index] ) );
+					else if ( currentVertexBuffer )
+						box.ExpandToInclude( transformStack[transformStackLevel].ApplyTo( currentVertexBuffer->GetPosition(index) ) );
 				}
 			}
 
@@ -1812,13 +1911,12 @@ vsDisplayList::GetTriangles(vsArray<struct Triangle>& result)
 			else if ( o->type == OpCode_TriangleListBuffer )
 			{
 				vsRenderBuffer *buffer = (vsRenderBuffer *)o->data.p;
-				uint16_t *shuttle = buffer->GetIntArray();
 
 				for ( int i = 0; i < buffer->GetIntArraySize(); i+=3 )
 				{
-					uint16_t index0 = shuttle[i];
-					uint16_t index1 = shuttle[i+1];
-					uint16_t index2 = shuttle[i+2];
+					uint32_t index0 = buffer->GetIndex(i);
+					uint32_t index1 = buffer->GetIndex(i+1);
+					uint32_t index2 = buffer->GetIndex(i+2);
 
 					Triangle t;
 					if ( currentVertexArray )
@@ -1842,13 +1940,12 @@ vsDisplayList::GetTriangles(vsArray<struct Triangle>& result)
 			else if ( o->type == OpCode_TriangleStripBuffer )
 			{
 				vsRenderBuffer *buffer = (vsRenderBuffer *)o->data.p;
-				uint16_t *shuttle = buffer->GetIntArray();
 
 				for ( int i = 2; i < buffer->GetIntArraySize(); i++ )
 				{
-					uint16_t index0 = shuttle[i-2];
-					uint16_t index1 = shuttle[i-1];
-					uint16_t index2 = shuttle[i];
+					uint32_t index0 = buffer->GetIndex(i-2);
+					uint32_t index1 = buffer->GetIndex(i-1);
+					uint32_t index2 = buffer->GetIndex(i);
 
 					Triangle t;
 					if ( currentVertexArray )
@@ -1928,6 +2025,7 @@ void
 vsDisplayList::ApplyOffset(const vsVector2D &offset)
 {
 	vsAssert( !m_instanceParent, "Tried to apply an offset to an instanced display list!" );
+	vsAssert( !IsCompiled(), "Tried to apply an offset to a compiled display list!" );
 
 	vsTransform2D currentTransform;
 
@@ -1955,3 +2053,1232 @@ vsDisplayList::ApplyOffset(const vsVector2D &offset)
 	}
 }
 
+
+static size_t ArrayElementSize( vsDisplayList::OpCode code )
+{
+	switch ( code )
+	{
+		case vsDisplayList::OpCode_VertexArray:
+		case vsDisplayList::OpCode_NormalArray:
+			return sizeof(vsVector3D);
+		case vsDisplayList::OpCode_TexelArray:
+			return sizeof(vsVector2D);
+		case vsDisplayList::OpCode_ColorArray:
+			return sizeof(vsColor);
+		case vsDisplayList::OpCode_LineListArray:
+		case vsDisplayList::OpCode_LineStripArray:
+		case vsDisplayList::OpCode_TriangleListArray:
+		case vsDisplayList::OpCode_TriangleStripArray:
+		case vsDisplayList::OpCode_TriangleFanArray:
+		case vsDisplayList::OpCode_PointsArray:
+			return sizeof(uint16_t);
+		default:
+			return 0;
+	}
+}
+
+// Optimize() works in place.  It only ever removes or merges ops, so its
+// write position can never overtake its read position;  each op we keep is
+// simply moved down over the gap left by whatever we've removed so far.
+#define OPTIMIZE_STACK_DEPTH (32)
+
+class vsDisplayListOptimizer
+{
+	struct Transform
+	{
+		bool		known;		// set directly by SetMatrix4x4, so we know its value
+		bool		instanced;	// set by SetMatrices4x4 or SetMatrices4x4Buffer
+		vsMatrix4x4	matrix;
+	};
+
+	char *		m_base;
+	size_t		m_out;
+
+	// transforms pushed since we started.  Anything below those is unknown
+	// to us, as are transforms deeper than OPTIMIZE_STACK_DEPTH.
+	Transform	m_stack[OPTIMIZE_STACK_DEPTH];
+	int			m_depth;
+
+	char *		m_material;
+	bool		m_materialKnown;
+	char *		m_shaderValues;
+	bool		m_shaderValuesKnown;
+	bool		m_instanceColors;	// SetMaterial clears these, so it isn't redundant while they're set
+	bool		m_arraysClear;
+
+	// Recently written ops which we might still take back.  Any op which
+	// could observe the transform stack cancels m_push and m_pop, and any
+	// op at all cancels m_draw.
+	bool		m_push;
+	size_t		m_pushOffset;
+	size_t		m_pushLength;
+
+	bool		m_pop;
+	size_t		m_popOffset;
+	Transform	m_popped;
+
+	bool		m_draw;
+	size_t		m_drawOffset;
+	vsDisplayList::OpCode m_drawType;
+	uint32_t	m_drawCount;
+
+	Transform	Unknown() const
+	{
+		Transform t;
+		t.known = false;
+		t.instanced = false;
+		return t;
+	}
+
+	bool TopIsTracked() const { return m_depth > 0 && m_depth <= OPTIMIZE_STACK_DEPTH; }
+
+	void Push( const Transform& t )
+	{
+		if ( m_depth < OPTIMIZE_STACK_DEPTH )
+			m_stack[m_depth] = t;
+		m_depth++;
+	}
+
+	Transform Pop()
+	{
+		if ( m_depth == 0 )
+			return Unknown();
+		m_depth--;
+		if ( m_depth < OPTIMIZE_STACK_DEPTH )
+			return m_stack[m_depth];
+		return Unknown();
+	}
+
+	void Emit( vsDisplayList::op *o, size_t from, size_t length )
+	{
+		m_draw = false;
+		size_t elementSize = ArrayElementSize( o->type );
+		if ( elementSize == 0 )
+		{
+			memmove( m_base + m_out, m_base + from, length );
+			m_out += length;
+			return;
+		}
+
+		// Arrays need their padding worked out again for their new
+		// position.  If the original wasn't aligned (and so we'd need to
+		// move it later in the buffer to align it), leave it unaligned.
+		const size_t header = sizeof(uint8_t) + sizeof(uint32_t);
+		memmove( m_base + m_out, m_base + from, header );
+		size_t paddingAt = m_out + header;
+		size_t dataFrom = o->data.p - m_base;
+		size_t misalignment = (paddingAt + 1) % DISPLAYLIST_ARRAY_ALIGNMENT;
+		size_t padding = misalignment ? DISPLAYLIST_ARRAY_ALIGNMENT - misalignment : 0;
+		if ( paddingAt + 1 + padding > dataFrom )
+			padding = dataFrom - (paddingAt + 1);
+
+		m_base[paddingAt] = (char)padding;
+		size_t dataTo = paddingAt + 1 + padding;
+		size_t bytes = o->data.GetUInt() * elementSize;
+		memmove( m_base + dataTo, m_base + dataFrom, bytes );
+		m_out = dataTo + bytes;
+	}
+
+	// Removes bytes which were already written.  We only close up the gap
+	// by a multiple of DISPLAYLIST_ARRAY_ALIGNMENT, so as not to misalign
+	// any arrays written since;  the remainder becomes padding.
+	void TakeBack( size_t offset, size_t length )
+	{
+		size_t padding = length % DISPLAYLIST_ARRAY_ALIGNMENT;
+		size_t removed = length - padding;
+		memset( m_base + offset, vsDisplayList::OpCode_Padding, padding );
+		memmove( m_base + offset + padding, m_base + offset + length, m_out - (offset + length) );
+		m_out -= removed;
+	}
+
+	void Cancel()
+	{
+		m_push = false;
+		m_pop = false;
+	}
+
+public:
+
+	int			m_opsRemoved;
+
+	vsDisplayListOptimizer( char *base, size_t start ):
+		m_base(base),
+		m_out(start),
+		m_depth(0),
+		m_material(NULL),
+		m_materialKnown(false),
+		m_shaderValues(NULL),
+		m_shaderValuesKnown(false),
+		m_instanceColors(false),
+		m_arraysClear(false),
+		m_push(false),
+		m_pop(false),
+		m_draw(false),
+		m_opsRemoved(0)
+	{
+	}
+
+	size_t GetOutputLength() const { return m_out; }
+
+	void Process( vsDisplayList::op *o, size_t from, size_t length )
+	{
+		switch ( o->type )
+		{
+			case vsDisplayList::OpCode_SetMaterial:
+				if ( m_materialKnown && m_material == o->data.p && !m_instanceColors )
+				{
+					m_opsRemoved++;
+					return;
+				}
+				m_material = o->data.p;
+				m_materialKnown = true;
+				m_instanceColors = false;
+				Emit( o, from, length );
+				return;
+			case vsDisplayList::OpCode_SetShaderValues:
+				if ( m_shaderValuesKnown && m_shaderValues == o->data.p )
+				{
+					m_opsRemoved++;
+					return;
+				}
+				m_shaderValues = o->data.p;
+				m_shaderValuesKnown = true;
+				Emit( o, from, length );
+				return;
+			case vsDisplayList::OpCode_SetColor:
+				m_instanceColors = false;
+				Emit( o, from, length );
+				return;
+			case vsDisplayList::OpCode_SetColors:
+			case vsDisplayList::OpCode_SetColorsBuffer:
+				m_instanceColors = true;
+				Emit( o, from, length );
+				return;
+			case vsDisplayList::OpCode_ClearArrays:
+				if ( m_arraysClear )
+				{
+					m_opsRemoved++;
+					return;
+				}
+				m_arraysClear = true;
+				Emit( o, from, length );
+				return;
+			case vsDisplayList::OpCode_VertexArray:
+			case vsDisplayList::OpCode_NormalArray:
+			case vsDisplayList::OpCode_TexelArray:
+			case vsDisplayList::OpCode_ColorArray:
+			case vsDisplayList::OpCode_VertexBuffer:
+			case vsDisplayList::OpCode_NormalBuffer:
+			case vsDisplayList::OpCode_TexelBuffer:
+			case vsDisplayList::OpCode_ColorBuffer:
+			case vsDisplayList::OpCode_BindBuffer:
+			case vsDisplayList::OpCode_UnbindBuffer:
+			case vsDisplayList::OpCode_ClearVertexArray:
+			case vsDisplayList::OpCode_ClearNormalArray:
+			case vsDisplayList::OpCode_ClearTexelArray:
+			case vsDisplayList::OpCode_ClearColorArray:
+				m_arraysClear = false;
+				Emit( o, from, length );
+				return;
+			case vsDisplayList::OpCode_Debug:
+				Emit( o, from, length );
+				return;
+
+			case vsDisplayList::OpCode_PushTransform:
+			case vsDisplayList::OpCode_PushTranslation:
+			case vsDisplayList::OpCode_PushMatrix4x4:
+			case vsDisplayList::OpCode_SnapMatrix:
+			case vsDisplayList::OpCode_SetMatrices4x4:
+			case vsDisplayList::OpCode_SetMatrices4x4Buffer:
+			{
+				Transform t = Unknown();
+				t.instanced = ( o->type == vsDisplayList::OpCode_SetMatrices4x4 ||
+						o->type == vsDisplayList::OpCode_SetMatrices4x4Buffer );
+				Cancel();
+				m_push = true;
+				m_pushOffset = m_out;
+				m_pushLength = length;
+				Emit( o, from, length );
+				Push( t );
+				return;
+			}
+			case vsDisplayList::OpCode_SetMatrix4x4:
+			{
+				if ( m_pop && m_popped.known &&
+						memcmp( &m_popped.matrix, &o->data.matrix4x4, sizeof(vsMatrix4x4) ) == 0 )
+				{
+					// we're setting back exactly the matrix that was just popped.
+					TakeBack( m_popOffset, 1 );
+					Push( m_popped );
+					Cancel();
+					m_opsRemoved += 2;
+					return;
+				}
+				Transform t;
+				t.known = true;
+				t.instanced = false;
+				t.matrix = o->data.matrix4x4;
+				Cancel();
+				m_push = true;
+				m_pushOffset = m_out;
+				m_pushLength = length;
+				Emit( o, from, length );
+				Push( t );
+				return;
+			}
+			case vsDisplayList::OpCode_PopTransform:
+			{
+				// a pop always leaves a single matrix set, so the push can
+				// only go if that's also what was set before it.
+				if ( m_push && m_depth >= 2 && m_depth <= OPTIMIZE_STACK_DEPTH && !m_stack[m_depth-2].instanced )
+				{
+					TakeBack( m_pushOffset, m_pushLength );
+					Pop();
+					Cancel();
+					m_opsRemoved += 2;
+					return;
+				}
+				Cancel();
+				m_pop = true;
+				m_popOffset = m_out;
+				m_popped = Pop();
+				Emit( o, from, length );
+				return;
+			}
+
+			case vsDisplayList::OpCode_LineListArray:
+			case vsDisplayList::OpCode_TriangleListArray:
+			case vsDisplayList::OpCode_PointsArray:
+			{
+				Cancel();
+				uint32_t count = o->data.GetUInt();
+				bool mergeable = TopIsTracked() && !m_stack[m_depth-1].instanced;
+				if ( mergeable && m_draw && m_drawType == o->type )
+				{
+					memmove( m_base + m_out, o->data.p, count * sizeof(uint16_t) );
+					m_out += count * sizeof(uint16_t);
+					m_drawCount += count;
+
+					vsStore countStore( m_base + m_drawOffset + 1, sizeof(uint32_t) );
+					countStore.RewindWriteHeadTo(0);
+					countStore.WriteUint32( m_drawCount );
+					m_opsRemoved++;
+					return;
+				}
+				size_t offset = m_out;
+				Emit( o, from, length );
+				if ( mergeable )
+				{
+					m_draw = true;
+					m_drawOffset = offset;
+					m_drawType = o->type;
+					m_drawCount = count;
+				}
+				return;
+			}
+
+			case vsDisplayList::OpCode_LineStripArray:
+			case vsDisplayList::OpCode_TriangleStripArray:
+			case vsDisplayList::OpCode_TriangleFanArray:
+			case vsDisplayList::OpCode_LineListBuffer:
+			case vsDisplayList::OpCode_LineStripBuffer:
+			case vsDisplayList::OpCode_TriangleStripBuffer:
+			case vsDisplayList::OpCode_TriangleListBuffer:
+			case vsDisplayList::OpCode_TriangleFanBuffer:
+				Cancel();
+				Emit( o, from, length );
+				return;
+
+			default:
+				// render targets, lights, stencils, etc.  We don't know what
+				// these do to the renderer's state, so forget everything we
+				// knew about it.
+				Cancel();
+				m_materialKnown = false;
+				m_arraysClear = false;
+				Emit( o, from, length );
+				return;
+		}
+	}
+};
+
+// In debug builds, check every optimised list against a copy of the original.
+#if defined(_DEBUG)
+#define VERIFY_OPTIMIZE
+#endif
+
+vsDisplayList::OptimizeStats
+vsDisplayList::Optimize( size_t startOffset )
+{
+	vsAssert( !m_instanceParent, "Tried to optimize an instanced display list!" );
+
+	OptimizeStats stats;
+	stats.opsBefore = 0;
+	stats.opsRemoved = 0;
+	stats.bytesBefore = GetSize();
+	stats.bytesRemoved = 0;
+
+#ifdef VERIFY_OPTIMIZE
+	vsDisplayList original( GetSize() + 1 );
+	original.Append( *this );
+#endif
+
+	Rewind();
+	vsDisplayListOptimizer optimizer( m_fifo->GetReadHead(), startOffset );
+	m_fifo->SeekReadHeadTo( startOffset );
+
+	// padding between ops is dropped;  the optimizer adds back whatever
+	// its arrays need.
+	SkipPadding();
+	size_t from = m_fifo->GetReadHeadPosition();
+	op *o = PopOp();
+	while ( o )
+	{
+		size_t to = m_fifo->GetReadHeadPosition();
+		optimizer.Process( o, from, to - from );
+		stats.opsBefore++;
+
+		SkipPadding();
+		from = m_fifo->GetReadHeadPosition();
+		o = PopOp();
+	}
+
+	m_fifo->RewindWriteHeadTo( optimizer.GetOutputLength() );
+	Rewind();
+
+	stats.opsRemoved = optimizer.m_opsRemoved;
+	stats.bytesRemoved = stats.bytesBefore - GetSize();
+
+#ifdef VERIFY_OPTIMIZE
+	vsAssert( DrawsIdentically( original ), "Display list optimisation changed what was drawn!" );
+#endif
+
+	return stats;
+}
+
+// For DrawsIdentically():  everything which could affect a single draw call.
+struct vsDisplayListDraw
+{
+	struct Array
+	{
+		char *	data;
+		size_t	bytes;		// zero for buffers;  we compare inline arrays by content
+	};
+
+	vsDisplayList::OpCode type;
+	int			indexStart;		// into the index pool, for inline draws
+	int			indexCount;
+	char *		indexBuffer;
+
+	char *		material;
+	char *		shaderValues;
+	vsColor		color;
+	char *		colors;
+	char *		colorsBuffer;
+
+	vsMatrix4x4	localToWorld;
+	char *		matrices;
+	int			matrixCount;
+	char *		matrixBuffer;
+
+	Array		array[4];	// vertex, normal, texel, color
+	char *		boundBuffer;
+
+	int			otherOps;	// how many ops we don't model have come before this draw
+};
+
+class vsDisplayListSimulator
+{
+	vsArray<vsMatrix4x4>	m_stack;
+	int						m_depth;
+	vsDisplayListDraw		m_state;
+
+	static bool SameArray( const vsDisplayListDraw::Array& a, const vsDisplayListDraw::Array& b )
+	{
+		if ( a.bytes != b.bytes )
+			return false;
+		if ( a.bytes == 0 )
+			return a.data == b.data;
+		return memcmp( a.data, b.data, a.bytes ) == 0;
+	}
+
+	void SetTop( const vsMatrix4x4& m )
+	{
+		while ( m_stack.ItemCount() <= m_depth )
+			m_stack.AddItem( vsMatrix4x4::Identity );
+		m_stack[m_depth] = m;
+		m_state.localToWorld = m;
+		m_state.matrices = NULL;
+		m_state.matrixCount = 1;
+		m_state.matrixBuffer = NULL;
+	}
+
+	void ClearArray( int i )
+	{
+		m_state.array[i].data = NULL;
+		m_state.array[i].bytes = 0;
+	}
+
+	void SetArray( int i, vsDisplayList::op *o, size_t elementSize )
+	{
+		m_state.array[i].data = o->data.p;
+		m_state.array[i].bytes = o->data.GetUInt() * elementSize;
+	}
+
+	void SetBuffer( int i, vsDisplayList::op *o )
+	{
+		m_state.array[i].data = o->data.p;
+		m_state.array[i].bytes = 0;
+	}
+
+	void Draw( vsDisplayList::op *o, bool isInline )
+	{
+		vsDisplayListDraw d = m_state;
+		d.type = o->type;
+		d.indexStart = m_index.ItemCount();
+		d.indexCount = 0;
+		d.indexBuffer = NULL;
+		if ( isInline )
+		{
+			uint16_t *index = (uint16_t*)o->data.p;
+			for ( uint32_t i = 0; i < o->data.GetUInt(); i++ )
+				m_index.AddItem( index[i] );
+			d.indexCount = o->data.GetUInt();
+		}
+		else
+			d.indexBuffer = o->data.p;
+
+		bool mergeable = ( d.type == vsDisplayList::OpCode_LineListArray ||
+				d.type == vsDisplayList::OpCode_TriangleListArray ||
+				d.type == vsDisplayList::OpCode_PointsArray ) &&
+			d.matrixCount == 1 && !d.matrixBuffer;
+		if ( mergeable && !m_draw.IsEmpty() )
+		{
+			vsDisplayListDraw &last = m_draw[ m_draw.ItemCount()-1 ];
+			if ( last.type == d.type && SameState( last, d ) )
+			{
+				last.indexCount += d.indexCount;
+				return;
+			}
+		}
+		m_draw.AddItem( d );
+	}
+
+public:
+	vsArray<vsDisplayListDraw>	m_draw;
+	vsArray<uint16_t>			m_index;
+
+	static bool SameState( const vsDisplayListDraw& a, const vsDisplayListDraw& b )
+	{
+		if ( a.material != b.material || a.shaderValues != b.shaderValues ||
+				a.colors != b.colors || a.colorsBuffer != b.colorsBuffer ||
+				a.matrices != b.matrices || a.matrixCount != b.matrixCount ||
+				a.matrixBuffer != b.matrixBuffer || a.boundBuffer != b.boundBuffer ||
+				a.otherOps != b.otherOps )
+			return false;
+		if ( memcmp( &a.color, &b.color, sizeof(vsColor) ) != 0 ||
+				memcmp( &a.localToWorld, &b.localToWorld, sizeof(vsMatrix4x4) ) != 0 )
+			return false;
+		for ( int i = 0; i < 4; i++ )
+			if ( !SameArray( a.array[i], b.array[i] ) )
+				return false;
+		return true;
+	}
+
+	void Run( vsDisplayList *list )
+	{
+		m_state.type = vsDisplayList::OpCode_MAX;
+		m_state.indexStart = m_state.indexCount = 0;
+		m_state.indexBuffer = NULL;
+		m_state.material = m_state.shaderValues = NULL;
+		m_state.color = vsColor(0,0,0,0);
+		m_state.colors = m_state.colorsBuffer = NULL;
+		m_state.localToWorld = vsMatrix4x4::Identity;
+		m_state.matrices = m_state.matrixBuffer = NULL;
+		m_state.matrixCount = 0;	// the renderer's count, before anything has been set
+		for ( int i = 0; i < 4; i++ )
+			ClearArray( i );
+		m_state.boundBuffer = NULL;
+		m_state.otherOps = 0;
+		m_depth = 0;
+		m_stack.AddItem( vsMatrix4x4::Identity );
+
+		list->Rewind();
+		vsDisplayList::op *o = list->PopOp();
+		while ( o )
+		{
+			switch ( o->type )
+			{
+				case vsDisplayList::OpCode_SetColor:
+					m_state.color = o->data.GetColor();
+					m_state.colors = m_state.colorsBuffer = NULL;
+					break;
+				case vsDisplayList::OpCode_SetColors:
+					m_state.colors = o->data.p;
+					m_state.colorsBuffer = NULL;
+					break;
+				case vsDisplayList::OpCode_SetColorsBuffer:
+					m_state.colors = NULL;
+					m_state.colorsBuffer = o->data.p;
+					break;
+				case vsDisplayList::OpCode_SetMaterial:
+					m_state.material = o->data.p;
+					m_state.colors = m_state.colorsBuffer = NULL;
+					break;
+				case vsDisplayList::OpCode_SetShaderValues:
+					m_state.shaderValues = o->data.p;
+					break;
+				case vsDisplayList::OpCode_PushTransform:
+				{
+					vsMatrix4x4 m = m_stack[m_depth] * o->data.GetTransform().GetMatrix();
+					m_depth++;
+					SetTop( m );
+					break;
+				}
+				case vsDisplayList::OpCode_PushTranslation:
+				{
+					vsMatrix4x4 t;
+					t.SetTranslation( o->data.vector );
+					vsMatrix4x4 m = m_stack[m_depth] * t;
+					m_depth++;
+					SetTop( m );
+					break;
+				}
+				case vsDisplayList::OpCode_PushMatrix4x4:
+				{
+					vsMatrix4x4 m = m_stack[m_depth] * o->data.GetMatrix4x4();
+					m_depth++;
+					SetTop( m );
+					break;
+				}
+				case vsDisplayList::OpCode_SetMatrix4x4:
+					m_depth++;
+					SetTop( o->data.GetMatrix4x4() );
+					break;
+				case vsDisplayList::OpCode_SetMatrices4x4:
+					m_depth++;
+					SetTop( ((vsMatrix4x4*)o->data.p)[0] );
+					m_state.matrices = o->data.p;
+					m_state.matrixCount = o->data.GetUInt();
+					break;
+				case vsDisplayList::OpCode_SetMatrices4x4Buffer:
+					m_depth++;
+					SetTop( vsMatrix4x4::Identity );
+					m_state.matrixBuffer = o->data.p;
+					break;
+				case vsDisplayList::OpCode_SnapMatrix:
+				{
+					vsMatrix4x4 m = m_stack[m_depth];
+					m.w.x = (float)vsFloor(m.w.x + 0.5f);
+					m.w.y = (float)vsFloor(m.w.y + 0.5f);
+					m.w.z = (float)vsFloor(m.w.z + 0.5f);
+					m_depth++;
+					SetTop( m );
+					break;
+				}
+				case vsDisplayList::OpCode_PopTransform:
+					m_depth = vsMax( 0, m_depth-1 );
+					SetTop( m_stack[m_depth] );
+					break;
+				case vsDisplayList::OpCode_VertexArray:
+					SetArray( 0, o, sizeof(vsVector3D) );
+					break;
+				case vsDisplayList::OpCode_NormalArray:
+					SetArray( 1, o, sizeof(vsVector3D) );
+					break;
+				case vsDisplayList::OpCode_TexelArray:
+					SetArray( 2, o, sizeof(vsVector2D) );
+					break;
+				case vsDisplayList::OpCode_ColorArray:
+					SetArray( 3, o, sizeof(vsColor) );
+					break;
+				case vsDisplayList::OpCode_VertexBuffer:
+					SetBuffer( 0, o );
+					break;
+				case vsDisplayList::OpCode_NormalBuffer:
+					SetBuffer( 1, o );
+					break;
+				case vsDisplayList::OpCode_TexelBuffer:
+					SetBuffer( 2, o );
+					break;
+				case vsDisplayList::OpCode_ColorBuffer:
+					SetBuffer( 3, o );
+					break;
+				case vsDisplayList::OpCode_ClearVertexArray:
+					ClearArray( 0 );
+					break;
+				case vsDisplayList::OpCode_ClearNormalArray:
+					ClearArray( 1 );
+					break;
+				case vsDisplayList::OpCode_ClearTexelArray:
+					ClearArray( 2 );
+					break;
+				case vsDisplayList::OpCode_ClearColorArray:
+					ClearArray( 3 );
+					break;
+				case vsDisplayList::OpCode_BindBuffer:
+					for ( int i = 0; i < 4; i++ )
+						ClearArray( i );
+					m_state.boundBuffer = o->data.p;
+					break;
+				case vsDisplayList::OpCode_UnbindBuffer:
+					m_state.boundBuffer = NULL;
+					break;
+				case vsDisplayList::OpCode_ClearArrays:
+					for ( int i = 0; i < 4; i++ )
+						ClearArray( i );
+					m_state.boundBuffer = NULL;
+					break;
+				case vsDisplayList::OpCode_LineListArray:
+				case vsDisplayList::OpCode_LineStripArray:
+				case vsDisplayList::OpCode_TriangleListArray:
+				case vsDisplayList::OpCode_TriangleStripArray:
+				case vsDisplayList::OpCode_TriangleFanArray:
+				case vsDisplayList::OpCode_PointsArray:
+					Draw( o, true );
+					break;
+				case vsDisplayList::OpCode_LineListBuffer:
+				case vsDisplayList::OpCode_LineStripBuffer:
+				case vsDisplayList::OpCode_TriangleStripBuffer:
+				case vsDisplayList::OpCode_TriangleListBuffer:
+				case vsDisplayList::OpCode_TriangleFanBuffer:
+					Draw( o, false );
+					break;
+				default:
+					m_state.otherOps++;
+					break;
+			}
+			o = list->PopOp();
+		}
+		list->Rewind();
+	}
+};
+
+bool
+vsDisplayList::DrawsIdentically( vsDisplayList &other )
+{
+	vsDisplayListSimulator a, b;
+	a.Run( m_instanceParent ? m_instanceParent : this );
+	b.Run( other.m_instanceParent ? other.m_instanceParent : &other );
+
+	if ( a.m_draw.ItemCount() != b.m_draw.ItemCount() )
+		return false;
+
+	for ( int i = 0; i < a.m_draw.ItemCount(); i++ )
+	{
+		const vsDisplayListDraw &da = a.m_draw[i];
+		const vsDisplayListDraw &db = b.m_draw[i];
+		if ( da.type != db.type || da.indexBuffer != db.indexBuffer ||
+				da.indexCount != db.indexCount ||
+				!vsDisplayListSimulator::SameState( da, db ) )
+			return false;
+		for ( int j = 0; j < da.indexCount; j++ )
+		{
+			if ( a.m_index[da.indexStart + j] != b.m_index[db.indexStart + j] )
+				return false;
+		}
+	}
+	return true;
+}
+
+// For Compile():  everything we're going to put into one buffer draw.
+struct vsDisplayListCompileGroup
+{
+	vsMaterial *	material;	// NULL if we inherit whatever was set before the list
+	bool			colorSet;
+	vsColor			color;
+	bool			hasNormals;
+	bool			hasTexels;
+	bool			hasColors;
+	bool			lines;
+
+	vsArray<vsVector3D>	position;
+	vsArray<vsVector3D>	normal;
+	vsArray<vsVector2D>	texel;
+	vsArray<vsColor>	vertexColor;
+	vsArray<uint16_t>	index;
+
+	// the source arrays we copied vertices from most recently, and where we
+	// put them;  consecutive draws from the same arrays share vertices.
+	char *			source[4];
+	int				sourceBase;
+};
+
+static void FillVertex( vsRenderBuffer::P& v, const vsDisplayListCompileGroup& g, int i )
+{
+	v.position = g.position[i];
+}
+
+static void FillVertex( vsRenderBuffer::PC& v, const vsDisplayListCompileGroup& g, int i )
+{
+	v.position = g.position[i];
+	v.color = g.vertexColor[i];
+}
+
+static void FillVertex( vsRenderBuffer::PT& v, const vsDisplayListCompileGroup& g, int i )
+{
+	v.position = g.position[i];
+	v.texel = g.texel[i];
+}
+
+static void FillVertex( vsRenderBuffer::PN& v, const vsDisplayListCompileGroup& g, int i )
+{
+	v.position = g.position[i];
+	v.normal = g.normal[i];
+}
+
+static void FillVertex( vsRenderBuffer::PCN& v, const vsDisplayListCompileGroup& g, int i )
+{
+	v.position = g.position[i];
+	v.normal = g.normal[i];
+	v.color = g.vertexColor[i];
+}
+
+static void FillVertex( vsRenderBuffer::PCT& v, const vsDisplayListCompileGroup& g, int i )
+{
+	v.position = g.position[i];
+	v.color = g.vertexColor[i];
+	v.texel = g.texel[i];
+}
+
+static void FillVertex( vsRenderBuffer::PNT& v, const vsDisplayListCompileGroup& g, int i )
+{
+	v.position = g.position[i];
+	v.normal = g.normal[i];
+	v.texel = g.texel[i];
+}
+
+static void FillVertex( vsRenderBuffer::PCNT& v, const vsDisplayListCompileGroup& g, int i )
+{
+	v.position = g.position[i];
+	v.normal = g.normal[i];
+	v.color = g.vertexColor[i];
+	v.texel = g.texel[i];
+}
+
+template<typename T>
+static size_t UploadVertices( vsRenderBuffer *buffer, const vsDisplayListCompileGroup& g )
+{
+	int count = g.position.ItemCount();
+	T *array = new T[count];
+	for ( int i = 0; i < count; i++ )
+		FillVertex( array[i], g, i );
+	buffer->SetArray( array, count );
+	vsDeleteArray( array );
+	return count * sizeof(T);
+}
+
+// Only draws with these materials may be moved past each other;  whatever
+// order they're drawn in, the depth buffer gives the same result.
+static bool IsOrderIndependent( vsMaterial *material )
+{
+	if ( !material )
+		return false;
+	vsMaterialInternal *m = material->GetResource();
+	return m->m_zRead && m->m_zWrite && !m->m_blend &&
+		!m->m_stencilWrite && m->m_stencilOp == StencilOp_None &&
+		( m->m_drawMode == DrawMode_Absolute || m->m_drawMode == DrawMode_Normal || m->m_drawMode == DrawMode_Lit );
+}
+
+#define COMPILE_MAX_VERTICES (0x10000)	// we use 16-bit indices
+
+class vsDisplayListCompiler
+{
+	enum
+	{
+		Array_Vertex,
+		Array_Normal,
+		Array_Texel,
+		Array_Color,
+		Array_MAX
+	};
+	struct Array
+	{
+		char *	data;
+		int		count;
+	};
+
+	vsArray<vsDisplayListCompileGroup*>	m_group;
+	vsDisplayList *	m_output;
+
+	vsMaterial *	m_material;
+	bool			m_colorSet;
+	vsColor			m_color;
+	Array			m_array[Array_MAX];
+
+	void ClearArray( int i )
+	{
+		m_array[i].data = NULL;
+		m_array[i].count = 0;
+	}
+
+	bool Matches( const vsDisplayListCompileGroup *g, bool lines ) const
+	{
+		return g->material == m_material &&
+			g->colorSet == m_colorSet && ( !m_colorSet || g->color == m_color ) &&
+			g->hasNormals == (m_array[Array_Normal].data != NULL) &&
+			g->hasTexels == (m_array[Array_Texel].data != NULL) &&
+			g->hasColors == (m_array[Array_Color].data != NULL) &&
+			g->lines == lines;
+	}
+
+	// Find (or make) the group this draw should go into.
+	vsDisplayListCompileGroup * FindGroup( bool lines, int vertexCount )
+	{
+		bool independent = IsOrderIndependent( m_material );
+		for ( int i = m_group.ItemCount()-1; i >= 0; i-- )
+		{
+			vsDisplayListCompileGroup *g = m_group[i];
+			if ( Matches( g, lines ) && g->position.ItemCount() + vertexCount <= COMPILE_MAX_VERTICES )
+				return g;
+
+			// to join an earlier group, we'd be drawn before this one.
+			if ( !independent || !IsOrderIndependent( g->material ) )
+				break;
+		}
+
+		vsDisplayListCompileGroup *g = new vsDisplayListCompileGroup;
+		g->material = m_material;
+		g->colorSet = m_colorSet;
+		g->color = m_color;
+		g->hasNormals = (m_array[Array_Normal].data != NULL);
+		g->hasTexels = (m_array[Array_Texel].data != NULL);
+		g->hasColors = (m_array[Array_Color].data != NULL);
+		g->lines = lines;
+		for ( int i = 0; i < Array_MAX; i++ )
+			g->source[i] = NULL;
+		g->sourceBase = 0;
+		m_group.AddItem( g );
+		return g;
+	}
+
+	// Returns the index in 'g' of the current arrays' first vertex.
+	int CopyVertices( vsDisplayListCompileGroup *g )
+	{
+		bool same = true;
+		for ( int i = 0; i < Array_MAX; i++ )
+			same = same && ( g->source[i] == m_array[i].data );
+		if ( same )
+			return g->sourceBase;
+
+		int count = m_array[Array_Vertex].count;
+		g->sourceBase = g->position.ItemCount();
+		for ( int i = 0; i < Array_MAX; i++ )
+			g->source[i] = m_array[i].data;
+
+		const vsVector3D *position = (const vsVector3D*)m_array[Array_Vertex].data;
+		const vsVector3D *normal = (const vsVector3D*)m_array[Array_Normal].data;
+		const vsVector2D *texel = (const vsVector2D*)m_array[Array_Texel].data;
+		const vsColor *color = (const vsColor*)m_array[Array_Color].data;
+		for ( int i = 0; i < count; i++ )
+		{
+			g->position.AddItem( position[i] );
+			if ( normal )
+				g->normal.AddItem( normal[i] );
+			if ( texel )
+				g->texel.AddItem( texel[i] );
+			if ( color )
+				g->vertexColor.AddItem( color[i] );
+		}
+		return g->sourceBase;
+	}
+
+public:
+
+	vsArray<vsRenderBuffer*>	m_buffer;
+	vsDisplayList::CompileStats	m_stats;
+
+	vsDisplayListCompiler( vsDisplayList *output ):
+		m_output(output),
+		m_material(NULL),
+		m_colorSet(false)
+	{
+		for ( int i = 0; i < Array_MAX; i++ )
+			ClearArray(i);
+		m_stats.drawsBefore = 0;
+		m_stats.drawsAfter = 0;
+		m_stats.bytesUploaded = 0;
+	}
+
+	~vsDisplayListCompiler()
+	{
+		for ( int i = 0; i < m_group.ItemCount(); i++ )
+			vsDelete( m_group[i] );
+	}
+
+	void DeleteBuffers()
+	{
+		for ( int i = 0; i < m_buffer.ItemCount(); i++ )
+			vsDelete( m_buffer[i] );
+		m_buffer.Clear();
+	}
+
+	// Returns false for ops we can't compile.
+	bool Process( vsDisplayList::op *o )
+	{
+		switch ( o->type )
+		{
+			case vsDisplayList::OpCode_SetColor:
+				m_colorSet = true;
+				m_color = o->data.GetColor();
+				return true;
+			case vsDisplayList::OpCode_SetMaterial:
+				m_material = (vsMaterial*)o->data.p;
+				m_colorSet = false;	// the renderer resets to the material's color
+				return true;
+			case vsDisplayList::OpCode_VertexArray:
+			case vsDisplayList::OpCode_NormalArray:
+			case vsDisplayList::OpCode_TexelArray:
+			case vsDisplayList::OpCode_ColorArray:
+			{
+				int i = o->type - vsDisplayList::OpCode_VertexArray;
+				m_array[i].data = o->data.p;
+				m_array[i].count = o->data.GetUInt();
+				return true;
+			}
+			case vsDisplayList::OpCode_ClearVertexArray:
+			case vsDisplayList::OpCode_ClearNormalArray:
+			case vsDisplayList::OpCode_ClearTexelArray:
+			case vsDisplayList::OpCode_ClearColorArray:
+				ClearArray( o->type - vsDisplayList::OpCode_ClearVertexArray );
+				return true;
+			case vsDisplayList::OpCode_ClearArrays:
+				for ( int i = 0; i < Array_MAX; i++ )
+					ClearArray(i);
+				return true;
+			case vsDisplayList::OpCode_LineListArray:
+			case vsDisplayList::OpCode_LineStripArray:
+			case vsDisplayList::OpCode_TriangleListArray:
+			case vsDisplayList::OpCode_TriangleStripArray:
+			case vsDisplayList::OpCode_TriangleFanArray:
+				return Draw( o->type, (const uint16_t*)o->data.p, o->data.GetUInt() );
+			default:
+				return false;
+		}
+	}
+
+	bool Draw( vsDisplayList::OpCode type, const uint16_t *index, int count )
+	{
+		int vertexCount = m_array[Array_Vertex].count;
+		if ( !m_array[Array_Vertex].data || vertexCount > COMPILE_MAX_VERTICES )
+			return false;
+		for ( int i = Array_Normal; i < Array_MAX; i++ )
+		{
+			if ( m_array[i].data && m_array[i].count < vertexCount )
+				return false;
+		}
+		for ( int i = 0; i < count; i++ )
+		{
+			if ( index[i] >= vertexCount )
+				return false;
+		}
+
+		m_stats.drawsBefore++;
+
+		bool lines = ( type == vsDisplayList::OpCode_LineListArray || type == vsDisplayList::OpCode_LineStripArray );
+		vsDisplayListCompileGroup *g = FindGroup( lines, vertexCount );
+		int base = CopyVertices( g );
+
+		switch ( type )
+		{
+			case vsDisplayList::OpCode_LineListArray:
+				for ( int i = 0; i+1 < count; i += 2 )
+				{
+					g->index.AddItem( base + index[i] );
+					g->index.AddItem( base + index[i+1] );
+				}
+				break;
+			case vsDisplayList::OpCode_LineStripArray:
+				for ( int i = 1; i < count; i++ )
+				{
+					g->index.AddItem( base + index[i-1] );
+					g->index.AddItem( base + index[i] );
+				}
+				break;
+			case vsDisplayList::OpCode_TriangleListArray:
+				for ( int i = 0; i+2 < count; i += 3 )
+				{
+					g->index.AddItem( base + index[i] );
+					g->index.AddItem( base + index[i+1] );
+					g->index.AddItem( base + index[i+2] );
+				}
+				break;
+			case vsDisplayList::OpCode_TriangleStripArray:
+			case vsDisplayList::OpCode_TriangleFanArray:
+				for ( int i = 2; i < count; i++ )
+				{
+					int a, b, c = index[i];
+					if ( type == vsDisplayList::OpCode_TriangleFanArray )
+					{
+						a = index[0];
+						b = index[i-1];
+					}
+					else if ( i % 2 == 0 )
+					{
+						a = index[i-2];
+						b = index[i-1];
+					}
+					else
+					{
+						// odd strip triangles are wound the other way.
+						a = index[i-1];
+						b = index[i-2];
+					}
+					// strips use degenerate triangles to join up;  we don't need them.
+					if ( a == b || b == c || a == c )
+						continue;
+					g->index.AddItem( base + a );
+					g->index.AddItem( base + b );
+					g->index.AddItem( base + c );
+				}
+				break;
+			default:
+				break;
+		}
+		return true;
+	}
+
+	// Write out buffer draws for everything gathered so far.
+	void Flush()
+	{
+		for ( int i = 0; i < m_group.ItemCount(); i++ )
+		{
+			vsDisplayListCompileGroup *g = m_group[i];
+			if ( !g->index.IsEmpty() )
+			{
+				vsRenderBuffer *vbo = new vsRenderBuffer( vsRenderBuffer::Type_Static );
+				if ( g->hasColors )
+				{
+					if ( g->hasNormals && g->hasTexels )
+						m_stats.bytesUploaded += UploadVertices<vsRenderBuffer::PCNT>( vbo, *g );
+					else if ( g->hasNormals )
+						m_stats.bytesUploaded += UploadVertices<vsRenderBuffer::PCN>( vbo, *g );
+					else if ( g->hasTexels )
+						m_stats.bytesUploaded += UploadVertices<vsRenderBuffer::PCT>( vbo, *g );
+					else
+						m_stats.bytesUploaded += UploadVertices<vsRenderBuffer::PC>( vbo, *g );
+				}
+				else
+				{
+					if ( g->hasNormals && g->hasTexels )
+						m_stats.bytesUploaded += UploadVertices<vsRenderBuffer::PNT>( vbo, *g );
+					else if ( g->hasNormals )
+						m_stats.bytesUploaded += UploadVertices<vsRenderBuffer::PN>( vbo, *g );
+					else if ( g->hasTexels )
+						m_stats.bytesUploaded += UploadVertices<vsRenderBuffer::PT>( vbo, *g );
+					else
+						m_stats.bytesUploaded += UploadVertices<vsRenderBuffer::P>( vbo, *g );
+				}
+
+				int indexCount = g->index.ItemCount();
+				uint16_t *indices = new uint16_t[indexCount];
+				for ( int j = 0; j < indexCount; j++ )
+					indices[j] = g->index[j];
+				vsRenderBuffer *ibo = new vsRenderBuffer( vsRenderBuffer::Type_Static );
+				ibo->SetArray( indices, indexCount );
+				vsDeleteArray( indices );
+				m_stats.bytesUploaded += indexCount * sizeof(uint16_t);
+
+				m_buffer.AddItem( vbo );
+				m_buffer.AddItem( ibo );
+
+				if ( g->material )
+					m_output->SetMaterial( g->material );
+				if ( g->colorSet )
+					m_output->SetColor( g->color );
+				m_output->BindBuffer( vbo );
+				if ( g->lines )
+					m_output->LineListBuffer( ibo );
+				else
+					m_output->TriangleListBuffer( ibo );
+				m_output->ClearArrays();
+				m_stats.drawsAfter++;
+			}
+			vsDelete( g );
+		}
+		m_group.Clear();
+	}
+};
+
+bool
+vsDisplayList::Compile( CompileStats *stats )
+{
+	vsAssert( !m_instanceParent, "Tried to compile an instanced display list!" );
+
+	// Compiled groups cost up to ~50 bytes each;  the smallest draw they
+	// could replace costs around eight.
+	vsDisplayList output( GetSize() * 8 + 64 );
+	vsDisplayListCompiler compiler( &output );
+
+	Rewind();
+	char *base = m_fifo->GetReadHead();
+	bool success = true;
+
+	SkipPadding();
+	size_t from = m_fifo->GetReadHeadPosition();
+	op *o = PopOp();
+	while ( o && success )
+	{
+		size_t to = m_fifo->GetReadHeadPosition();
+		switch ( o->type )
+		{
+			// these ops don't touch anything we're gathering up, but draws
+			// mustn't move across them.  Copy them straight over.
+			case OpCode_PushTransform:
+			case OpCode_PushTranslation:
+			case OpCode_PushMatrix4x4:
+			case OpCode_SetMatrix4x4:
+			case OpCode_PopTransform:
+			case OpCode_SnapMatrix:
+			case OpCode_SetShaderValues:
+			case OpCode_Light:
+			case OpCode_ClearLights:
+			case OpCode_Fog:
+			case OpCode_ClearFog:
+			case OpCode_FlatShading:
+			case OpCode_SmoothShading:
+			case OpCode_Debug:
+				compiler.Flush();
+				output.m_fifo->WriteBuffer( base + from, to - from );
+				break;
+			default:
+				success = compiler.Process( o );
+				break;
+		}
+
+		SkipPadding();
+		from = m_fifo->GetReadHeadPosition();
+		o = PopOp();
+	}
+
+	if ( success )
+	{
+		compiler.Flush();
+	}
+	if ( !success || compiler.m_stats.drawsBefore == 0 )
+	{
+		compiler.DeleteBuffers();
+		Rewind();
+		return false;
+	}
+
+	if ( output.GetSize() > GetMaxSize() )
+	{
+		vsDelete( m_fifo );
+		m_fifo = new vsStore( output.GetSize() );
+	}
+	m_fifo->Clear();
+	m_fifo->Append( output.m_fifo );
+	m_containsArrays = false;
+	for ( int i = 0; i < compiler.m_buffer.ItemCount(); i++ )
+	{
+		m_compiledBuffer.AddItem( compiler.m_buffer[i] );
+	}
+	Rewind();
+
+	if ( stats )
+	{
+		*stats = compiler.m_stats;
+	}
+	return true;
+}
@@ -33,6 +33,18 @@ class vsShaderValues;
 
 #define MAX_OWNED_MATERIALS (10)
 
+// Arrays embedded in a display list are stored as raw native-endian blocks
+// starting on this alignment (relative to the start of the list's buffer),
+// so that the renderer can use them in place.
+#define DISPLAYLIST_ARRAY_ALIGNMENT (16)
+
+// The layout of the bytes in a display list's fifo.  Version 1 wrote arrays
+// element by element, in vsStore's byte order.  Version 2 writes each array
+// as a padded, aligned, native-endian block, and may contain OpCode_Padding
+// bytes between ops.  Anything which saves a fifo's raw bytes must save this
+// alongside them, and mustn't read back bytes saved under another version.
+#define DISPLAYLIST_FORMAT_VERSION (2)
+
 class vsDisplayList
 {
 public:
@@ -117,6 +129,8 @@ public:
 
 		OpCode_Debug,
 
+		OpCode_Padding, // a single byte, used to align arrays.  Skipped by PopOp();  nobody else should ever see one.
+
 		OpCode_MAX
 	};
 
@@ -162,6 +176,15 @@ public:
 		Data	data;
 	};
 
+	struct OpTiming
+	{
+		int			count[OpCode_MAX];
+		uint64_t	ticks[OpCode_MAX];	// in SDL performance counter ticks
+
+		OpTiming();
+		void Clear();
+	};
+
 private:
 
 	vsStore *	m_fifo;
@@ -175,6 +198,15 @@ private:
 	int				m_materialCount;
 
 	bool			m_colorSet;
+	bool			m_containsArrays;	// if so, we pad before appending this list elsewhere, to keep them aligned
+
+	vsArray<vsRenderBuffer*>	m_compiledBuffer;	// created by Compile();  we own these.
+	void			DeleteCompiledBuffers();
+
+	OpTiming *		m_opTiming;
+	uint64_t		m_opTimingStart;
+	OpCode			m_opTimingType;	// the op we're timing right now, or OpCode_MAX
+	void			ChargeOpTime();
 
 	vsColor			m_cursorColor;
 	vsColor			m_nextLineColor;
@@ -186,6 +218,14 @@ private:
 	static vsDisplayList *	Load_Obj(const vsString &);
 	void					Write_CVec( const vsString &filename );
 
+	// Array ops are written as:  opcode, uint32 element count, uint8 padding
+	// size, that many bytes of padding, then the array itself.
+	char *	WriteArrayHeader( OpCode code, int count, size_t elementSize );	// returns where to put the array
+	void	WriteArray( OpCode code, const void *array, int count, size_t elementSize );
+	void	ReadArray( size_t elementSize );
+	void	SkipPadding();
+	void	PadToArrayAlignment();
+
 public:
 
 	// for use by vsFragment.
@@ -198,7 +238,7 @@ public:
 			vsDisplayList(size_t memSize);
 	virtual	~vsDisplayList();
 
-	vsStore *		GetFifo() { return m_fifo; }
+	vsStore *		GetFifo() { return m_fifo; }	// raw contents are in DISPLAYLIST_FORMAT_VERSION layout
 
 	vsDisplayList *	CreateInstance();
 
@@ -312,6 +352,62 @@ public:
 
 	void	ApplyOffset(const vsVector2D &offset);
 
+	struct OptimizeStats
+	{
+		int opsBefore;
+		int opsRemoved;
+		size_t bytesBefore;
+		size_t bytesRemoved;
+	};
+
+	// Rewrites this display list in place, without changing what it draws:
+	// removes SetMaterial, SetShaderValues and ClearArrays ops which don't
+	// change anything, push/pop pairs with nothing drawn between them, and
+	// 'PopTransform ... SetMatrix4x4' pairs which set back the same matrix
+	// that was just popped.  Adjacent list draws (LineListArray,
+	// TriangleListArray, PointsArray) using the same state are merged into one.
+	//
+	// Ops before 'startOffset' are left alone, and we make no assumptions
+	// about the state they leave behind.
+	OptimizeStats	Optimize( size_t startOffset = 0 );
+
+	// Returns true if both lists make the same sequence of draw calls, with
+	// the same state set for each.  Consecutive list draws which could have
+	// been merged are treated as already merged.  For validating Optimize().
+	bool	DrawsIdentically( vsDisplayList &other );
+
+	struct CompileStats
+	{
+		int drawsBefore;
+		int drawsAfter;
+		size_t bytesUploaded;
+
+		CompileStats& operator+=(const CompileStats& o)
+		{
+			drawsBefore += o.drawsBefore;
+			drawsAfter += o.drawsAfter;
+			bytesUploaded += o.bytesUploaded;
+			return *this;
+		}
+	};
+
+	// For display lists which will never change:  moves the contents of all
+	// inline vertex/normal/texel/color arrays into static vsRenderBuffers
+	// (owned by this list from now on), and replaces the array draws with
+	// one indexed buffer draw per material, color, vertex format and
+	// primitive type.  Strips and fans become lists.  Draws are only moved
+	// past other draws when both use opaque, depth-tested materials.
+	//
+	// Lists containing ops we don't know how to compile (points, existing
+	// buffers, render targets, etc) are left untouched, and we return false.
+	bool	Compile( CompileStats *stats = NULL );
+	bool	IsCompiled() const { return !m_compiledBuffer.IsEmpty(); }
+
+	// Returns true if this list draws only in whatever local space it's
+	// given;  it never pushes, pops or sets matrices or instance colors of
+	// its own.  Such a list can be drawn instanced.
+	bool	IsInstanceable();
+
 	void	Append( const vsDisplayList &list );	// appends the passed display list onto us.
 
 	void	EnableStencil();   // turns on stencil testing, cull future rendering to INSIDE stencil
@@ -335,6 +431,12 @@ public:
 	op *	PopOp();
 	void	AppendOp(op *);
 
+	// While set, each PopOp() charges the time since the previous PopOp() to
+	// the type of the op it returned, so whoever is consuming this list (a
+	// renderer, usually) gets its time broken down by opcode.  The time
+	// includes decoding the op.  Pass NULL to stop.
+	void	SetOpTiming( OpTiming *timing );
+
 	static const vsString& GetOpCodeString( OpCode code );
 
 	void operator= ( const vsDisplayList &list ) { Clear(); Append(list); }
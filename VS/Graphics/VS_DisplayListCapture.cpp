@@ -0,0 +1,600 @@
+/*
+ *  VS_DisplayListCapture.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+#include "VS_DisplayListCapture.h"
+
+#include "VS_DynamicMaterial.h"
+#include "VS_MaterialInternal.h"
+#include "VS_RenderBuffer.h"
+#include "VS_Renderer.h"
+#include "VS_TextureInternal.h"
+
+#include "VS/Files/VS_File.h"
+#include "VS/Memory/VS_Store.h"
+
+#include <SDL2/SDL.h>
+
+#define CAPTURE_MAGIC "vsDisplayListCapture"
+#define CAPTURE_VERSION (1)
+
+// bits in a captured material's flags
+#define CAPTURE_MATERIAL_ZREAD (BIT(0))
+#define CAPTURE_MATERIAL_ZWRITE (BIT(1))
+#define CAPTURE_MATERIAL_BLEND (BIT(2))
+#define CAPTURE_MATERIAL_HASCOLOR (BIT(3))
+
+// how big is each element of the array carried by this op?  0 if it isn't an
+// array op.
+static size_t ArrayElementSize( vsDisplayList::OpCode type )
+{
+	switch ( type )
+	{
+		case vsDisplayList::OpCode_VertexArray:
+		case vsDisplayList::OpCode_NormalArray:
+			return sizeof(vsVector3D);
+		case vsDisplayList::OpCode_TexelArray:
+			return sizeof(vsVector2D);
+		case vsDisplayList::OpCode_ColorArray:
+		case vsDisplayList::OpCode_SetColors:
+			return sizeof(vsColor);
+		case vsDisplayList::OpCode_SetMatrices4x4:
+			return sizeof(vsMatrix4x4);
+		case vsDisplayList::OpCode_LineListArray:
+		case vsDisplayList::OpCode_LineStripArray:
+		case vsDisplayList::OpCode_TriangleListArray:
+		case vsDisplayList::OpCode_TriangleStripArray:
+		case vsDisplayList::OpCode_TriangleFanArray:
+		case vsDisplayList::OpCode_PointsArray:
+			return sizeof(uint16_t);
+		default:
+			return 0;
+	}
+}
+
+static bool IsBufferOp( vsDisplayList::OpCode type )
+{
+	switch ( type )
+	{
+		case vsDisplayList::OpCode_SetColorsBuffer:
+		case vsDisplayList::OpCode_SetMatrices4x4Buffer:
+		case vsDisplayList::OpCode_VertexBuffer:
+		case vsDisplayList::OpCode_NormalBuffer:
+		case vsDisplayList::OpCode_TexelBuffer:
+		case vsDisplayList::OpCode_ColorBuffer:
+		case vsDisplayList::OpCode_BindBuffer:
+		case vsDisplayList::OpCode_UnbindBuffer:
+		case vsDisplayList::OpCode_LineListBuffer:
+		case vsDisplayList::OpCode_LineStripBuffer:
+		case vsDisplayList::OpCode_TriangleStripBuffer:
+		case vsDisplayList::OpCode_TriangleListBuffer:
+		case vsDisplayList::OpCode_TriangleFanBuffer:
+			return true;
+		default:
+			return false;
+	}
+}
+
+static void WriteMaterial( vsStore *store, vsMaterial *material )
+{
+	vsMaterialInternal *m = material->GetResource();
+	uint8_t flags = 0;
+	if ( m->m_zRead )
+		flags |= CAPTURE_MATERIAL_ZREAD;
+	if ( m->m_zWrite )
+		flags |= CAPTURE_MATERIAL_ZWRITE;
+	if ( m->m_blend )
+		flags |= CAPTURE_MATERIAL_BLEND;
+	if ( m->m_hasColor )
+		flags |= CAPTURE_MATERIAL_HASCOLOR;
+
+	store->WriteString( m->GetName() );
+	store->WriteUint8( m->m_drawMode );
+	store->WriteUint8( m->m_cullingType );
+	store->WriteUint8( flags );
+	store->WriteInt32( m->m_layer );
+	store->WriteColor( m->m_color );
+	store->WriteString( m->m_texture[0] ? m->m_texture[0]->GetResource()->GetName() : vsString() );
+}
+
+static vsMaterial * ReadMaterial( vsStore *store )
+{
+	vsString name = store->ReadString();
+	vsDrawMode drawMode = (vsDrawMode)store->ReadUint8();
+	CullingType cull = (CullingType)store->ReadUint8();
+	uint8_t flags = store->ReadUint8();
+	int layer = store->ReadInt32();
+	vsColor color;
+	store->ReadColor( &color );
+	vsString texture = store->ReadString();
+
+	if ( vsFile::Exists( vsFormatString("materials/%s.mat", name.c_str()) ) )
+		return new vsMaterial( name );
+
+	// It was built in code;  make something which draws the same way.
+	vsDynamicMaterial *result = new vsDynamicMaterial;
+	result->SetDrawMode( drawMode );
+	result->SetCullingType( cull );
+	result->SetZRead( (flags & CAPTURE_MATERIAL_ZREAD) != 0 );
+	result->SetZWrite( (flags & CAPTURE_MATERIAL_ZWRITE) != 0 );
+	result->SetBlend( (flags & CAPTURE_MATERIAL_BLEND) != 0 );
+	result->SetHasColor( (flags & CAPTURE_MATERIAL_HASCOLOR) != 0 );
+	result->SetLayer( layer );
+	result->SetColor( color );
+	if ( !texture.empty() && vsFile::Exists( texture ) )
+		result->SetTexture( 0, texture );
+	return result;
+}
+
+static vsRenderBuffer * ReadBuffer( vsStore *store )
+{
+	vsRenderBuffer::ContentType type = (vsRenderBuffer::ContentType)store->ReadUint8();
+	uint32_t bytes = store->ReadUint32();
+	const char *data = store->GetReadHead();
+	store->AdvanceReadHead( bytes );
+
+	vsRenderBuffer *buffer = new vsRenderBuffer( vsRenderBuffer::Type_Static );
+	if ( bytes == 0 )
+		return buffer;
+
+#define SET_ARRAY(T) buffer->SetArray( (const T*)data, bytes / sizeof(T) ); break;
+	switch ( type )
+	{
+		case vsRenderBuffer::ContentType_P: SET_ARRAY(vsRenderBuffer::P)
+		case vsRenderBuffer::ContentType_PC: SET_ARRAY(vsRenderBuffer::PC)
+		case vsRenderBuffer::ContentType_PT: SET_ARRAY(vsRenderBuffer::PT)
+		case vsRenderBuffer::ContentType_PN: SET_ARRAY(vsRenderBuffer::PN)
+		case vsRenderBuffer::ContentType_PCN: SET_ARRAY(vsRenderBuffer::PCN)
+		case vsRenderBuffer::ContentType_PCT: SET_ARRAY(vsRenderBuffer::PCT)
+		case vsRenderBuffer::ContentType_PNT: SET_ARRAY(vsRenderBuffer::PNT)
+		case vsRenderBuffer::ContentType_PCNT: SET_ARRAY(vsRenderBuffer::PCNT)
+		case vsRenderBuffer::ContentType_Matrix: SET_ARRAY(vsMatrix4x4)
+		case vsRenderBuffer::ContentType_Color: SET_ARRAY(vsColor)
+		case vsRenderBuffer::ContentType_Float: SET_ARRAY(float)
+		case vsRenderBuffer::ContentType_UInt16: SET_ARRAY(uint16_t)
+		case vsRenderBuffer::ContentType_UInt32: SET_ARRAY(uint32_t)
+		case vsRenderBuffer::ContentType_I32Vec4: SET_ARRAY(vsVector4D_i32)
+		case vsRenderBuffer::ContentType_UI32Vec4: SET_ARRAY(vsVector4D_ui32)
+		case vsRenderBuffer::ContentType_Custom:
+		default:
+			// old-style buffers with no content type are texel buffers.
+			SET_ARRAY(vsVector2D)
+	}
+#undef SET_ARRAY
+	return buffer;
+}
+
+bool
+vsDisplayListCapture::Save( vsDisplayList *list, const vsString &filename )
+{
+	// First pass:  collect the materials and buffers we point at, and work
+	// out how big the capture will be.
+	vsArray<vsMaterial*> materials;
+	vsArray<vsRenderBuffer*> buffers;
+	size_t bytes = 1024;
+
+	list->Rewind();
+	while ( vsDisplayList::op *op = list->PopOp() )
+	{
+		bytes += 128;
+		if ( op->type == vsDisplayList::OpCode_SetMaterial )
+		{
+			vsMaterial *material = (vsMaterial*)op->data.p;
+			if ( !materials.Contains( material ) )
+			{
+				materials.AddItem( material );
+				bytes += 256;
+			}
+		}
+		else if ( IsBufferOp( op->type ) )
+		{
+			vsRenderBuffer *buffer = (vsRenderBuffer*)op->data.p;
+			if ( !buffers.Contains( buffer ) )
+			{
+				buffers.AddItem( buffer );
+				bytes += 8 + buffer->GetGenericArraySize();
+			}
+		}
+		else if ( op->type == vsDisplayList::OpCode_Debug )
+			bytes += op->data.string.size();
+		bytes += op->data.i * ArrayElementSize( op->type );
+	}
+
+	vsStore store( bytes );
+	store.WriteString( CAPTURE_MAGIC );
+	store.WriteUint32( CAPTURE_VERSION );
+
+	store.WriteUint32( materials.ItemCount() );
+	for ( int i = 0; i < materials.ItemCount(); i++ )
+		WriteMaterial( &store, materials[i] );
+
+	store.WriteUint32( buffers.ItemCount() );
+	for ( int i = 0; i < buffers.ItemCount(); i++ )
+	{
+		store.WriteUint8( buffers[i]->GetContentType() );
+		store.WriteUint32( buffers[i]->GetGenericArraySize() );
+		store.WriteBuffer( buffers[i]->GetGenericArray(), buffers[i]->GetGenericArraySize() );
+	}
+
+	int droppedOps = 0;
+	list->Rewind();
+	while ( vsDisplayList::op *op = list->PopOp() )
+	{
+		if ( op->type == vsDisplayList::OpCode_BlitRenderTarget ||
+				op->type == vsDisplayList::OpCode_SetShaderValues )
+		{
+			droppedOps++;
+			continue;
+		}
+
+		store.WriteUint8( op->type );
+
+		size_t elementSize = ArrayElementSize( op->type );
+		if ( elementSize )
+		{
+			store.WriteUint32( op->data.i );
+			store.WriteBuffer( op->data.p, op->data.i * elementSize );
+			continue;
+		}
+		if ( IsBufferOp( op->type ) )
+		{
+			store.WriteInt32( buffers.Find( (vsRenderBuffer*)op->data.p ) );
+			continue;
+		}
+
+		switch ( op->type )
+		{
+			case vsDisplayList::OpCode_SetColor:
+				store.WriteColor( op->data.color );
+				break;
+			case vsDisplayList::OpCode_PushTranslation:
+				store.WriteVector3D( op->data.vector );
+				break;
+			case vsDisplayList::OpCode_PushTransform:
+			case vsDisplayList::OpCode_SetCameraTransform:
+				store.WriteTransform2D( op->data.transform );
+				break;
+			case vsDisplayList::OpCode_PushMatrix4x4:
+			case vsDisplayList::OpCode_SetMatrix4x4:
+			case vsDisplayList::OpCode_SetWorldToViewMatrix4x4:
+			case vsDisplayList::OpCode_SetProjectionMatrix4x4:
+				store.WriteMatrix4x4( op->data.matrix4x4 );
+				break;
+			case vsDisplayList::OpCode_Set3DProjection:
+				store.WriteFloat( op->data.fov );
+				store.WriteFloat( op->data.nearPlane );
+				store.WriteFloat( op->data.farPlane );
+				break;
+			case vsDisplayList::OpCode_SetMaterial:
+				store.WriteInt32( materials.Find( (vsMaterial*)op->data.p ) );
+				break;
+			case vsDisplayList::OpCode_Light:
+				store.WriteLight( op->data.light );
+				break;
+			case vsDisplayList::OpCode_Fog:
+				store.WriteFog( op->data.fog );
+				break;
+			case vsDisplayList::OpCode_SetViewport:
+			case vsDisplayList::OpCode_EnableScissor:
+				store.WriteBox2D( op->data.box2D );
+				break;
+			case vsDisplayList::OpCode_Debug:
+				store.WriteString( op->data.string );
+				break;
+			default:
+				// SetRenderTarget and ResolveRenderTarget lose their target;
+				// everything else has no arguments.
+				break;
+		}
+	}
+	list->Rewind();
+
+	vsFile file( filename, vsFile::MODE_Write );
+	file.Store( &store );
+
+	vsLog("Captured display list to '%s':  %d bytes, %d materials, %d buffers, %d ops dropped",
+			filename.c_str(), (int)store.Length(), materials.ItemCount(), buffers.ItemCount(), droppedOps);
+	return true;
+}
+
+vsDisplayListCapture::vsDisplayListCapture( const vsString &filename ):
+	m_list(NULL),
+	m_ok(false)
+{
+	if ( !vsFile::Exists( filename ) )
+	{
+		vsLog("Display list capture '%s' doesn't exist", filename.c_str());
+		return;
+	}
+
+	vsFile file( filename, vsFile::MODE_Read );
+	vsStore store( file.GetLength() );
+	file.Store( &store );
+
+	if ( store.ReadString() != CAPTURE_MAGIC || store.ReadUint32() != CAPTURE_VERSION )
+	{
+		vsLog("'%s' isn't a display list capture we understand", filename.c_str());
+		return;
+	}
+
+	int materialCount = store.ReadUint32();
+	for ( int i = 0; i < materialCount; i++ )
+		m_material.AddItem( ReadMaterial( &store ) );
+
+	int bufferCount = store.ReadUint32();
+	for ( int i = 0; i < bufferCount; i++ )
+		m_buffer.AddItem( ReadBuffer( &store ) );
+
+	// arrays come back out at much the same size they went in;  leave room
+	// for alignment padding and pointers.
+	m_list = new vsDisplayList( (store.Length() - store.GetReadHeadPosition()) * 2 + 4096 );
+	vsArray<int> indices;
+
+	while ( !store.AtEnd() )
+	{
+		vsDisplayList::OpCode type = (vsDisplayList::OpCode)store.ReadUint8();
+
+		size_t elementSize = ArrayElementSize( type );
+		if ( elementSize )
+		{
+			int count = store.ReadUint32();
+			const char *data = store.GetReadHead();
+			store.AdvanceReadHead( count * elementSize );
+
+			int *index = NULL;
+			if ( elementSize == sizeof(uint16_t) && count > 0 )
+			{
+				// the list's index array writers take ints.
+				indices.Clear();
+				for ( int i = 0; i < count; i++ )
+					indices.AddItem( ((const uint16_t*)data)[i] );
+				index = &indices[0];
+			}
+
+			switch ( type )
+			{
+				case vsDisplayList::OpCode_VertexArray: m_list->VertexArray( (const vsVector3D*)data, count ); break;
+				case vsDisplayList::OpCode_NormalArray: m_list->NormalArray( (const vsVector3D*)data, count ); break;
+				case vsDisplayList::OpCode_TexelArray: m_list->TexelArray( (const vsVector2D*)data, count ); break;
+				case vsDisplayList::OpCode_ColorArray: m_list->ColorArray( (const vsColor*)data, count ); break;
+				case vsDisplayList::OpCode_LineListArray: m_list->LineListArray( index, count ); break;
+				case vsDisplayList::OpCode_LineStripArray: m_list->LineStripArray( index, count ); break;
+				case vsDisplayList::OpCode_TriangleListArray: m_list->TriangleListArray( index, count ); break;
+				case vsDisplayList::OpCode_TriangleStripArray: m_list->TriangleStripArray( index, count ); break;
+				case vsDisplayList::OpCode_TriangleFanArray: m_list->TriangleFanArray( index, count ); break;
+				case vsDisplayList::OpCode_PointsArray: m_list->PointsArray( index, count ); break;
+				case vsDisplayList::OpCode_SetColors:
+				case vsDisplayList::OpCode_SetMatrices4x4:
+					{
+						// these point outside the list, so we keep the data.
+						char *block = new char[ vsMax( count * elementSize, (size_t)1 ) ];
+						memcpy( block, data, count * elementSize );
+						m_block.AddItem( block );
+						if ( type == vsDisplayList::OpCode_SetColors )
+							m_list->SetColors( (const vsColor*)block, count );
+						else
+							m_list->SetMatrices4x4( (const vsMatrix4x4*)block, count );
+						break;
+					}
+				default:
+					break;
+			}
+			continue;
+		}
+
+		if ( IsBufferOp( type ) )
+		{
+			int id = store.ReadInt32();
+			vsAssert( id >= 0 && id < m_buffer.ItemCount(), "Corrupt display list capture?" );
+			vsRenderBuffer *buffer = m_buffer[id];
+			switch ( type )
+			{
+				case vsDisplayList::OpCode_SetColorsBuffer: m_list->SetColorsBuffer( buffer ); break;
+				case vsDisplayList::OpCode_SetMatrices4x4Buffer: m_list->SetMatrices4x4Buffer( buffer ); break;
+				case vsDisplayList::OpCode_VertexBuffer: m_list->VertexBuffer( buffer ); break;
+				case vsDisplayList::OpCode_NormalBuffer: m_list->NormalBuffer( buffer ); break;
+				case vsDisplayList::OpCode_TexelBuffer: m_list->TexelBuffer( buffer ); break;
+				case vsDisplayList::OpCode_ColorBuffer: m_list->ColorBuffer( buffer ); break;
+				case vsDisplayList::OpCode_BindBuffer: m_list->BindBuffer( buffer ); break;
+				case vsDisplayList::OpCode_UnbindBuffer: m_list->UnbindBuffer( buffer ); break;
+				case vsDisplayList::OpCode_LineListBuffer: m_list->LineListBuffer( buffer ); break;
+				case vsDisplayList::OpCode_LineStripBuffer: m_list->LineStripBuffer( buffer ); break;
+				case vsDisplayList::OpCode_TriangleStripBuffer: m_list->TriangleStripBuffer( buffer ); break;
+				case vsDisplayList::OpCode_TriangleListBuffer: m_list->TriangleListBuffer( buffer ); break;
+				case vsDisplayList::OpCode_TriangleFanBuffer: m_list->TriangleFanBuffer( buffer ); break;
+				default: break;
+			}
+			continue;
+		}
+
+		switch ( type )
+		{
+			case vsDisplayList::OpCode_SetColor:
+				{
+					vsColor c;
+					store.ReadColor( &c );
+					m_list->SetColor( c );
+					break;
+				}
+			case vsDisplayList::OpCode_PushTranslation:
+				{
+					vsVector3D v;
+					store.ReadVector3D( &v );
+					m_list->PushTranslation( v );
+					break;
+				}
+			case vsDisplayList::OpCode_PushTransform:
+			case vsDisplayList::OpCode_SetCameraTransform:
+				{
+					vsTransform2D t;
+					store.ReadTransform2D( &t );
+					if ( type == vsDisplayList::OpCode_PushTransform )
+						m_list->PushTransform( t );
+					else
+						m_list->SetCameraTransform( t );
+					break;
+				}
+			case vsDisplayList::OpCode_PushMatrix4x4:
+			case vsDisplayList::OpCode_SetMatrix4x4:
+			case vsDisplayList::OpCode_SetWorldToViewMatrix4x4:
+			case vsDisplayList::OpCode_SetProjectionMatrix4x4:
+				{
+					vsMatrix4x4 m;
+					store.ReadMatrix4x4( &m );
+					if ( type == vsDisplayList::OpCode_PushMatrix4x4 )
+						m_list->PushMatrix4x4( m );
+					else if ( type == vsDisplayList::OpCode_SetMatrix4x4 )
+						m_list->SetMatrix4x4( m );
+					else if ( type == vsDisplayList::OpCode_SetWorldToViewMatrix4x4 )
+						m_list->SetWorldToViewMatrix4x4( m );
+					else
+						m_list->SetProjectionMatrix4x4( m );
+					break;
+				}
+			case vsDisplayList::OpCode_Set3DProjection:
+				{
+					float fov = store.ReadFloat();
+					float nearPlane = store.ReadFloat();
+					float farPlane = store.ReadFloat();
+					m_list->Set3DProjection( fov, nearPlane, farPlane );
+					break;
+				}
+			case vsDisplayList::OpCode_SetMaterial:
+				{
+					int id = store.ReadInt32();
+					vsAssert( id >= 0 && id < m_material.ItemCount(), "Corrupt display list capture?" );
+					m_list->SetMaterial( m_material[id] );
+					break;
+				}
+			case vsDisplayList::OpCode_Light:
+				{
+					vsLight l;
+					store.ReadLight( &l );
+					m_list->Light( l );
+					break;
+				}
+			case vsDisplayList::OpCode_Fog:
+				{
+					vsFog f;
+					store.ReadFog( &f );
+					m_list->Fog( f );
+					break;
+				}
+			case vsDisplayList::OpCode_SetViewport:
+			case vsDisplayList::OpCode_EnableScissor:
+				{
+					vsBox2D box;
+					store.ReadBox2D( &box );
+					if ( type == vsDisplayList::OpCode_SetViewport )
+						m_list->SetViewport( box );
+					else
+						m_list->EnableScissor( box );
+					break;
+				}
+			case vsDisplayList::OpCode_Debug:
+				m_list->Debug( store.ReadString() );
+				break;
+			case vsDisplayList::OpCode_SetRenderTarget:
+				m_list->SetRenderTarget( NULL );
+				break;
+			case vsDisplayList::OpCode_ResolveRenderTarget:
+				m_list->ResolveRenderTarget( NULL );
+				break;
+			case vsDisplayList::OpCode_ClearRenderTarget: m_list->ClearRenderTarget(); break;
+			case vsDisplayList::OpCode_PopTransform: m_list->PopTransform(); break;
+			case vsDisplayList::OpCode_SnapMatrix: m_list->SnapMatrix(); break;
+			case vsDisplayList::OpCode_ClearVertexArray: m_list->ClearVertexArray(); break;
+			case vsDisplayList::OpCode_ClearNormalArray: m_list->ClearNormalArray(); break;
+			case vsDisplayList::OpCode_ClearTexelArray: m_list->ClearTexelArray(); break;
+			case vsDisplayList::OpCode_ClearColorArray: m_list->ClearColorArray(); break;
+			case vsDisplayList::OpCode_ClearArrays: m_list->ClearArrays(); break;
+			case vsDisplayList::OpCode_ClearLights: m_list->ClearLights(); break;
+			case vsDisplayList::OpCode_ClearFog: m_list->ClearFog(); break;
+			case vsDisplayList::OpCode_FlatShading: m_list->FlatShading(); break;
+			case vsDisplayList::OpCode_SmoothShading: m_list->SmoothShading(); break;
+			case vsDisplayList::OpCode_EnableStencil: m_list->EnableStencil(); break;
+			case vsDisplayList::OpCode_DisableStencil: m_list->DisableStencil(); break;
+			case vsDisplayList::OpCode_ClearStencil: m_list->ClearStencil(); break;
+			case vsDisplayList::OpCode_DisableScissor: m_list->DisableScissor(); break;
+			case vsDisplayList::OpCode_ClearViewport: m_list->ClearViewport(); break;
+			default:
+				vsAssertF( false, "Unexpected op %d in display list capture", type );
+				return;
+		}
+	}
+
+	m_ok = true;
+	vsLog("Loaded display list capture '%s':  %d materials, %d buffers", filename.c_str(), materialCount, bufferCount);
+}
+
+vsDisplayListCapture::~vsDisplayListCapture()
+{
+	vsDelete( m_list );
+	for ( int i = 0; i < m_material.ItemCount(); i++ )
+		vsDelete( m_material[i] );
+	for ( int i = 0; i < m_buffer.ItemCount(); i++ )
+		vsDelete( m_buffer[i] );
+	for ( int i = 0; i < m_block.ItemCount(); i++ )
+		vsDeleteArray( m_block[i] );
+}
+
+void
+vsDisplayListCapture::Replay( vsRenderer *renderer, int iterations, vsDisplayList::OpTiming *timing )
+{
+	if ( !m_ok )
+		return;
+
+	vsRenderer::Settings settings = renderer->GetCurrentSettings();
+	m_list->SetOpTiming( timing );
+	for ( int i = 0; i < iterations; i++ )
+	{
+		renderer->PreRender( settings );
+		m_list->Rewind();
+		renderer->RenderDisplayList( m_list );
+		renderer->PostRender();
+	}
+	m_list->SetOpTiming( NULL );
+	m_list->Rewind();
+}
+
+void
+vsDisplayListCapture::LogTiming( const vsDisplayList::OpTiming &timing, int iterations )
+{
+	double msPerTick = 1000.0 / SDL_GetPerformanceFrequency();
+	double frames = vsMax( iterations, 1 );
+
+	uint64_t totalTicks = 0;
+	for ( int i = 0; i < vsDisplayList::OpCode_MAX; i++ )
+		totalTicks += timing.ticks[i];
+
+	vsLog("Display list replay:  %d iterations, %0.3f ms per frame", iterations, totalTicks * msPerTick / frames);
+	vsLog("  %-28s %10s %12s %10s %6s", "Op", "count", "ms/frame", "ns/op", "%");
+
+	// slowest first.
+	bool logged[vsDisplayList::OpCode_MAX] = { false };
+	for ( int n = 0; n < vsDisplayList::OpCode_MAX; n++ )
+	{
+		int slowest = -1;
+		for ( int i = 0; i < vsDisplayList::OpCode_MAX; i++ )
+		{
+			if ( !logged[i] && timing.count[i] && ( slowest < 0 || timing.ticks[i] > timing.ticks[slowest] ) )
+				slowest = i;
+		}
+		if ( slowest < 0 )
+			break;
+		logged[slowest] = true;
+
+		double ms = timing.ticks[slowest] * msPerTick;
+		vsLog("  %-28s %10.1f %12.4f %10.1f %6.2f",
+				vsDisplayList::GetOpCodeString( (vsDisplayList::OpCode)slowest ).c_str(),
+				timing.count[slowest] / frames,
+				ms / frames,
+				ms * 1000000.0 / timing.count[slowest],
+				totalTicks ? 100.0 * timing.ticks[slowest] / totalTicks : 0.0);
+	}
+}
@@ -0,0 +1,57 @@
+/*
+ *  VS_DisplayListCapture.h
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+#ifndef VS_DISPLAYLISTCAPTURE_H
+#define VS_DISPLAYLISTCAPTURE_H
+
+#include "VS_DisplayList.h"
+
+class vsMaterial;
+class vsRenderBuffer;
+class vsRenderer;
+
+// vsDisplayListCapture saves a display list to a file along with everything
+// it points at:  the contents of the render buffers it draws from, its
+// instance matrix and color arrays, and the names and basic settings of its
+// materials.  Loading a capture rebuilds an equivalent display list, which
+// can then be replayed as many times as we like against whatever renderer
+// is running, with the time spent on each opcode recorded.
+//
+// vsScreen::CaptureNextFrame() captures a whole frame.  Render targets and
+// shader values can't be captured;  SetRenderTarget and ResolveRenderTarget
+// are replayed against the main render target, and BlitRenderTarget and
+// SetShaderValues ops are dropped.  Array contents are stored in native byte
+// order.
+
+class vsDisplayListCapture
+{
+	vsDisplayList *				m_list;
+	vsArray<vsMaterial*>		m_material;
+	vsArray<vsRenderBuffer*>	m_buffer;
+	vsArray<char*>				m_block;	// instance matrices and colors
+	bool						m_ok;
+
+public:
+
+	static bool	Save( vsDisplayList *list, const vsString &filename );
+
+	vsDisplayListCapture( const vsString &filename );
+	~vsDisplayListCapture();
+
+	bool			IsOK() const { return m_ok; }
+	vsDisplayList *	GetDisplayList() { return m_list; }
+
+	// Renders the captured list 'iterations' times, one frame each.  If
+	// 'timing' is given, the time spent on each opcode is added into it.
+	void		Replay( vsRenderer *renderer, int iterations, vsDisplayList::OpTiming *timing = NULL );
+
+	static void	LogTiming( const vsDisplayList::OpTiming &timing, int iterations );
+};
+
+#endif // VS_DISPLAYLISTCAPTURE_H
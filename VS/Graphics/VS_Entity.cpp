@@ -19,7 +19,8 @@ vsEntity::vsEntity():
 	m_child(NULL),
 	m_visible(true),
 	m_processing(false),
-	m_extractQueued(false)
+	m_extractQueued(false),
+	m_drawOnMainThread(false)
 {
 	m_next = m_prev = this;
 	m_clickable = true;
@@ -86,6 +87,17 @@ vsEntity::AddChild( vsEntity *sprite )
 		m_child->m_prev = sprite;
 
 	m_child = sprite;
+
+	if ( sprite->m_drawOnMainThread )
+		SetDrawOnMainThread(true);
+}
+
+void
+vsEntity::SetDrawOnMainThread( bool mainThread )
+{
+	m_drawOnMainThread = mainThread;
+	if ( mainThread && m_parent )
+		m_parent->SetDrawOnMainThread(true);
 }
 
 void
@@ -36,6 +36,8 @@ protected:
 	bool			m_processing;
 	bool			m_extractQueued;
 
+	bool			m_drawOnMainThread;
+
 	void			DrawChildren( vsRenderQueue *queue );
 
 	void			DoExtract();
@@ -63,6 +65,14 @@ public:
 
 	void			SetClickable(bool clickable) { m_clickable = clickable; }
 
+	// Entities whose Draw() touches OpenGL (uploading buffers, building
+	// fonts, etc) must call this, so that a parallel-gathering vsScene draws
+	// them on the main thread.  It also applies to everything this entity
+	// is (or later becomes) a child of, since the scene only looks at its
+	// top-level entities.  It's never cleared from parents.
+	void			SetDrawOnMainThread(bool mainThread);
+	bool			DrawsOnMainThread() { return m_drawOnMainThread; }
+
 	vsEntity *		GetNext() { return m_next; }
 	vsEntity *		GetPrev() { return m_prev; }
 	vsEntity *		GetParent() { return m_parent; }
@@ -8,6 +8,7 @@
  */
 
 #include "VS_Font.h"
+#include "VS_FontLayoutCache.h"
 #include "VS_FontRenderer.h"
 
 #include "VS_DisplayList.h"
@@ -46,6 +47,8 @@ vsFontSize::vsFontSize( const vsString &filename ):
 	{
 		LoadBMFont(&fontData);
 	}
+	m_glyphMap.Build( m_glyph, m_glyphCount );
+	m_kerningMap.Build( m_kerning, m_kerningCount );
 }
 
 vsFontSize::~vsFontSize()
@@ -357,14 +360,8 @@ vsFontSize::LoadBMFont( vsFile *file )
 vsGlyph *
 vsFontSize::FindGlyphForCharacter(uint32_t letter)
 {
-	for ( int i = 0; i < m_glyphCount; i++ )
-	{
-		if ( m_glyph[i].glyph == letter )
-		{
-			return &m_glyph[i];
-		}
-	}
-	return NULL;
+	int i = m_glyphMap.Find(letter);
+	return ( i >= 0 ) ? &m_glyph[i] : NULL;
 }
 
 float
@@ -418,18 +415,122 @@ vsFontSize::GetCharacterAdvance( uint32_t c, float size )
 float
 vsFontSize::GetCharacterKerning( uint32_t pChar, uint32_t nChar, float size )
 {
-	// TODO:  Make less absurd than this linear search
-	for ( int i = 0; i < m_kerningCount; i++ )
+	int i = m_kerningMap.Find(pChar, nChar);
+	return ( i >= 0 ) ? m_kerning[i].xAdvance * size : 0.f;
+}
+
+// Our hash tables are a power of two in size, and at most half full, so that
+// probe sequences stay short.
+static uint32_t
+HashTableSize( int count )
+{
+	uint32_t size = 16;
+	while ( size < (uint32_t)count * 2 )
+		size *= 2;
+	return size;
+}
+
+vsGlyphMap::vsGlyphMap():
+	m_entry(NULL),
+	m_mask(0)
+{
+	for ( int i = 0; i < 256; i++ )
+		m_latin1[i] = -1;
+}
+
+vsGlyphMap::~vsGlyphMap()
+{
+	vsDeleteArray( m_entry );
+}
+
+void
+vsGlyphMap::Build( const vsGlyph *glyph, int glyphCount )
+{
+	vsDeleteArray( m_entry );
+	m_mask = 0;
+	for ( int i = 0; i < 256; i++ )
+		m_latin1[i] = -1;
+
+	int hashedCount = 0;
+	for ( int i = 0; i < glyphCount; i++ )
+	{
+		uint32_t codepoint = glyph[i].glyph;
+		if ( codepoint < 256 )
+		{
+			if ( m_latin1[codepoint] < 0 )
+				m_latin1[codepoint] = i;
+		}
+		else
+			hashedCount++;
+	}
+	if ( hashedCount == 0 )
+		return;
+
+	uint32_t size = HashTableSize( hashedCount );
+	m_entry = new Entry[size];
+	m_mask = size - 1;
+	for ( uint32_t i = 0; i < size; i++ )
+		m_entry[i].glyph = -1;
+
+	for ( int i = 0; i < glyphCount; i++ )
+	{
+		uint32_t codepoint = glyph[i].glyph;
+		if ( codepoint < 256 )
+			continue;
+		uint32_t slot = (codepoint * 2654435761u) & m_mask;
+		while ( m_entry[slot].glyph >= 0 && m_entry[slot].codepoint != codepoint )
+			slot = (slot + 1) & m_mask;
+		if ( m_entry[slot].glyph < 0 )
+		{
+			m_entry[slot].codepoint = codepoint;
+			m_entry[slot].glyph = i;
+		}
+	}
+}
+
+vsKerningMap::vsKerningMap():
+	m_entry(NULL),
+	m_mask(0)
+{
+}
+
+vsKerningMap::~vsKerningMap()
+{
+	vsDeleteArray( m_entry );
+}
+
+void
+vsKerningMap::Build( const vsKerning *kerning, int kerningCount )
+{
+	vsDeleteArray( m_entry );
+	m_mask = 0;
+	if ( kerningCount <= 0 )
+		return;
+
+	uint32_t size = HashTableSize( kerningCount );
+	m_entry = new Entry[size];
+	m_mask = size - 1;
+	for ( uint32_t i = 0; i < size; i++ )
+		m_entry[i].kerning = -1;
+
+	for ( int i = 0; i < kerningCount; i++ )
 	{
-		if ( m_kerning[i].glyphA == pChar && m_kerning[i].glyphB == nChar )
+		uint32_t glyphA = kerning[i].glyphA;
+		uint32_t glyphB = kerning[i].glyphB;
+		uint32_t slot = ((glyphA * 2654435761u) ^ (glyphB * 2246822519u)) & m_mask;
+		while ( m_entry[slot].kerning >= 0 && (m_entry[slot].glyphA != glyphA || m_entry[slot].glyphB != glyphB) )
+			slot = (slot + 1) & m_mask;
+		if ( m_entry[slot].kerning < 0 )
 		{
-			return m_kerning[i].xAdvance * size;
+			m_entry[slot].glyphA = glyphA;
+			m_entry[slot].glyphB = glyphB;
+			m_entry[slot].kerning = i;
 		}
 	}
-	return 0.f;
 }
 
-vsFont::vsFont(const vsString& filename)
+vsFont::vsFont(const vsString& filename):
+	m_layoutCache( new vsFontLayoutCache )
 {
 	vsFile file(filename);
 	vsRecord r;
@@ -456,6 +557,7 @@ vsFont::~vsFont()
 	{
 		m_fragment[i]->Detach();
 	}
+	vsDelete( m_layoutCache );
 }
 
 vsFontSize *
@@ -500,6 +602,9 @@ vsFont::RemoveFragment( vsFontFragment *fragment )
 void
 vsFont::RebuildFragments()
 {
+	// our cached layouts were built for the old font sizes.
+	m_layoutCache->Clear();
+
 	int fragmentCount = m_fragment.ItemCount();
 	for ( int i = 0; i < fragmentCount; i++ )
 	{
@@ -25,6 +25,7 @@ class vsFile;
 #include "VS/Math/VS_Vector.h"
 
 class vsFontFragment;
+class vsFontLayoutCache;
 
 enum JustificationType
 {
@@ -67,6 +68,74 @@ struct vsKerning
 	float xAdvance;
 };
 
+// vsGlyphMap finds a font's glyph for a code point without searching:  code
+// points below 256 (ASCII and Latin-1) index straight into a table, and the
+// rest are looked up in a hash table.  If a font has more than one glyph for
+// a code point, the first one wins, as it did when we searched for them.
+class vsGlyphMap
+{
+	struct Entry
+	{
+		uint32_t	codepoint;
+		int			glyph;		// -1 for an empty slot
+	};
+
+	int			m_latin1[256];
+	Entry *		m_entry;
+	uint32_t	m_mask;
+
+public:
+	vsGlyphMap();
+	~vsGlyphMap();
+
+	void	Build( const vsGlyph *glyph, int glyphCount );
+
+	// returns the index of the glyph for this code point, or -1 if there isn't one.
+	int		Find( uint32_t codepoint ) const
+	{
+		if ( codepoint < 256 )
+			return m_latin1[codepoint];
+		if ( !m_entry )
+			return -1;
+		uint32_t slot = (codepoint * 2654435761u) & m_mask;
+		while ( m_entry[slot].glyph >= 0 && m_entry[slot].codepoint != codepoint )
+			slot = (slot + 1) & m_mask;
+		return m_entry[slot].glyph;
+	}
+};
+
+// vsKerningMap finds the kerning for a pair of code points in a hash table.
+// As with vsGlyphMap, the first kerning listed for a pair wins.
+class vsKerningMap
+{
+	struct Entry
+	{
+		uint32_t	glyphA;
+		uint32_t	glyphB;
+		int			kerning;	// -1 for an empty slot
+	};
+
+	Entry *		m_entry;
+	uint32_t	m_mask;
+
+public:
+	vsKerningMap();
+	~vsKerningMap();
+
+	void	Build( const vsKerning *kerning, int kerningCount );
+
+	// returns the index of the kerning for this pair, or -1 if there isn't one.
+	int		Find( uint32_t glyphA, uint32_t glyphB ) const
+	{
+		if ( !m_entry )
+			return -1;
+		uint32_t slot = ((glyphA * 2654435761u) ^ (glyphB * 2246822519u)) & m_mask;
+		while ( m_entry[slot].kerning >= 0 && (m_entry[slot].glyphA != glyphA || m_entry[slot].glyphB != glyphB) )
+			slot = (slot + 1) & m_mask;
+		return m_entry[slot].kerning;
+	}
+};
+
 class vsFontSize
 {
 	vsRenderBuffer * m_ptBuffer;
@@ -82,6 +151,9 @@ class vsFontSize
 	vsKerning* m_kerning;
 	int m_kerningCount;
 
+	vsGlyphMap		m_glyphMap;
+	vsKerningMap	m_kerningMap;
+
 	vsRenderBuffer   m_glyphTriangleList;
 
 	vsGlyph *		FindGlyphForCharacter( uint32_t letter ); // in UTF8 codepoint format
@@ -119,6 +191,7 @@ class vsFont
 {
 	vsArrayStore<vsFontSize> m_size;
 	vsArray<vsFontFragment*> m_fragment;
+	vsFontLayoutCache *m_layoutCache;
 public:
 	vsFont( const vsString &filename );
 	~vsFont();
@@ -126,6 +199,10 @@ public:
 	vsFontSize* Size(float size);
 	float MaxSize();
 
+	// The layouts of recently built font fragments, which fragments built
+	// later with the same text and settings will share.
+	vsFontLayoutCache* GetLayoutCache() { return m_layoutCache; }
+
 	void RegisterFragment( vsFontFragment *fragment );
 	void RemoveFragment( vsFontFragment *fragment );
 
@@ -0,0 +1,203 @@
+/*
+ *  VS_FontLayoutCache.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+#include "VS_FontLayoutCache.h"
+#include "VS_HashTable.h"
+
+vsFontLayout::vsFontLayout():
+	vbo(NULL),
+	ibo(NULL),
+	texSize(0.f),
+	glyphBox(NULL),
+	glyphCount(0),
+	lineBox(NULL),
+	lineFirstGlyph(NULL),
+	lineLastGlyph(NULL),
+	lineCount(0),
+	bytes(0)
+{
+}
+
+vsFontLayout::~vsFontLayout()
+{
+	vsDelete( vbo );
+	vsDelete( ibo );
+	vsDeleteArray( glyphBox );
+	vsDeleteArray( lineBox );
+	vsDeleteArray( lineFirstGlyph );
+	vsDeleteArray( lineLastGlyph );
+}
+
+static uint32_t
+HashFloat( uint32_t hash, float value )
+{
+	uint32_t bits;
+	memcpy( &bits, &value, sizeof(bits) );
+	return (hash ^ bits) * 2654435761u;
+}
+
+uint32_t
+vsFontLayoutKey::Hash() const
+{
+	// The string, size, bounds and justification tell most layouts apart;
+	// operator== checks everything else.
+	uint32_t hash = vsCalculateHash( string.c_str(), (uint32_t)string.length() );
+	hash = HashFloat( hash, size );
+	hash = HashFloat( hash, bounds.x );
+	hash = HashFloat( hash, bounds.y );
+	hash = (hash ^ (uint32_t)justification) * 2654435761u;
+	hash = (hash ^ (uint32_t)context) * 2654435761u;
+	return hash ^ (hash >> 15);
+}
+
+bool
+vsFontLayoutKey::operator==( const vsFontLayoutKey &b ) const
+{
+	return ( context == b.context &&
+			size == b.size &&
+			sizeBias == b.sizeBias &&
+			bounds == b.bounds &&
+			justification == b.justification &&
+			transform == b.transform &&
+			color == b.color &&
+			dropShadowColor == b.dropShadowColor &&
+			dropShadowOffset == b.dropShadowOffset &&
+			hasColor == b.hasColor &&
+			hasDropShadow == b.hasDropShadow &&
+			snap == b.snap &&
+			buildMapping == b.buildMapping &&
+			string == b.string );
+}
+
+vsFontLayoutCache::vsFontLayoutCache( size_t budget, int bucketCount ):
+	m_newest(NULL),
+	m_oldest(NULL),
+	m_entryCount(0),
+	m_bytes(0),
+	m_budget(budget),
+	m_hits(0),
+	m_misses(0),
+	m_evictions(0)
+{
+	m_bucketCount = vsNextPowerOfTwo( vsMax(2, bucketCount) );
+	m_shift = 32 - vsHighBitPosition(m_bucketCount);
+
+	m_bucket = new Entry*[m_bucketCount];
+	for ( int i = 0; i < m_bucketCount; i++ )
+		m_bucket[i] = NULL;
+}
+
+vsFontLayoutCache::~vsFontLayoutCache()
+{
+	Clear();
+	vsDeleteArray( m_bucket );
+}
+
+void
+vsFontLayoutCache::Unlink( Entry *entry )
+{
+	if ( entry->newer )
+		entry->newer->older = entry->older;
+	else
+		m_newest = entry->older;
+	if ( entry->older )
+		entry->older->newer = entry->newer;
+	else
+		m_oldest = entry->newer;
+	entry->newer = entry->older = NULL;
+}
+
+void
+vsFontLayoutCache::LinkNewest( Entry *entry )
+{
+	entry->newer = NULL;
+	entry->older = m_newest;
+	if ( m_newest )
+		m_newest->newer = entry;
+	else
+		m_oldest = entry;
+	m_newest = entry;
+}
+
+void
+vsFontLayoutCache::Remove( Entry *entry )
+{
+	Entry **link = &m_bucket[ HashToBucket(entry->hash) ];
+	while ( *link != entry )
+		link = &(*link)->next;
+	*link = entry->next;
+
+	Unlink( entry );
+	m_bytes -= entry->layout->bytes;
+	m_entryCount--;
+	vsDelete( entry );
+}
+
+vsFontLayout *
+vsFontLayoutCache::Find( const vsFontLayoutKey &key )
+{
+	uint32_t hash = key.Hash();
+	for ( Entry *entry = m_bucket[ HashToBucket(hash) ]; entry; entry = entry->next )
+	{
+		if ( entry->hash == hash && entry->key == key )
+		{
+			Unlink( entry );
+			LinkNewest( entry );
+			m_hits++;
+			return entry->layout;
+		}
+	}
+	m_misses++;
+	return NULL;
+}
+
+void
+vsFontLayoutCache::Add( const vsFontLayoutKey &key, vsFontLayout *layout )
+{
+	// a layout bigger than our whole budget would only push everything else
+	// out, and then be dropped itself.
+	if ( layout->bytes > m_budget )
+		return;
+
+	Entry *entry = new Entry;
+	entry->key = key;
+	entry->hash = key.Hash();
+	entry->layout = layout;
+
+	int bucket = HashToBucket(entry->hash);
+	entry->next = m_bucket[bucket];
+	m_bucket[bucket] = entry;
+	LinkNewest( entry );
+	m_bytes += layout->bytes;
+	m_entryCount++;
+
+	while ( m_bytes > m_budget && m_oldest != entry )
+	{
+		Remove( m_oldest );
+		m_evictions++;
+	}
+}
+
+void
+vsFontLayoutCache::Clear()
+{
+	while ( m_oldest )
+		Remove( m_oldest );
+}
+
+void
+vsFontLayoutCache::SetBudget( size_t bytes )
+{
+	m_budget = bytes;
+	while ( m_bytes > m_budget && m_oldest )
+	{
+		Remove( m_oldest );
+		m_evictions++;
+	}
+}
@@ -0,0 +1,126 @@
+/*
+ *  VS_FontLayoutCache.h
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+#ifndef VS_FONTLAYOUTCACHE_H
+#define VS_FONTLAYOUTCACHE_H
+
+#include "VS/Graphics/VS_Font.h"
+#include "VS/Graphics/VS_Color.h"
+#include "VS/Utils/VS_StrongPointer.h"
+#include "VS/Utils/VS_StrongPointerTarget.h"
+
+// vsFontLayout is the geometry vsFontRenderer builds for a string:  a vertex
+// buffer and a triangle list ready to draw, and the glyph and line mappings,
+// if they were asked for.  A layout is shared by every vsFontFragment showing
+// that text with those settings, and by its font's vsFontLayoutCache;  it's
+// deleted when the last of them lets go of it.
+class vsFontLayout : public vsStrongPointerTarget
+{
+public:
+	vsRenderBuffer *vbo;
+	vsRenderBuffer *ibo;
+	float texSize;	// the font size whose material our texels refer to
+
+	vsBox2D *glyphBox;
+	size_t glyphCount;
+	vsBox2D *lineBox;
+	int *lineFirstGlyph;
+	int *lineLastGlyph;
+	size_t lineCount;
+
+	size_t bytes;	// how much memory the buffers and mappings take up
+
+	vsFontLayout();
+	virtual ~vsFontLayout();
+};
+
+// Everything about a vsFontRenderer and its string which affects the layout
+// it builds.
+struct vsFontLayoutKey
+{
+	vsString string;
+	FontContext context;
+	float size;
+	float sizeBias;
+	vsVector2D bounds;
+	JustificationType justification;
+	vsTransform3D transform;
+	vsColor color;
+	vsColor dropShadowColor;
+	vsVector3D dropShadowOffset;
+	bool hasColor;
+	bool hasDropShadow;
+	bool snap;
+	bool buildMapping;
+
+	uint32_t	Hash() const;
+	bool		operator==( const vsFontLayoutKey &b ) const;
+};
+
+// vsFontLayoutCache keeps a font's recently built layouts, so that rebuilding
+// a fragment whose text and settings haven't changed (as UI code does every
+// time it recreates a label) just shares the existing layout.  Once the
+// cached layouts take up more than the memory budget, the least recently
+// used are dropped from the cache;  fragments still using them keep them
+// alive.
+class vsFontLayoutCache
+{
+	struct Entry
+	{
+		vsFontLayoutKey					key;
+		uint32_t						hash;
+		vsStrongPointer<vsFontLayout>	layout;
+
+		Entry *		next;	// in our bucket
+		Entry *		newer;	// in order of use
+		Entry *		older;
+	};
+
+	Entry **	m_bucket;
+	int			m_bucketCount;
+	int			m_shift;
+
+	Entry *		m_newest;
+	Entry *		m_oldest;
+	int			m_entryCount;
+
+	size_t		m_bytes;
+	size_t		m_budget;
+
+	int			m_hits;
+	int			m_misses;
+	int			m_evictions;
+
+	uint32_t	HashToBucket( uint32_t hash ) const { return (hash * 2654435839U) >> m_shift; }
+	void		Unlink( Entry *entry );
+	void		LinkNewest( Entry *entry );
+	void		Remove( Entry *entry );
+
+public:
+
+	vsFontLayoutCache( size_t budget = 2 * 1024 * 1024, int bucketCount = 256 );
+	~vsFontLayoutCache();
+
+	// returns the cached layout for this key, or NULL if we don't have one.
+	vsFontLayout *	Find( const vsFontLayoutKey &key );
+	void			Add( const vsFontLayoutKey &key, vsFontLayout *layout );
+	void			Clear();
+
+	void			SetBudget( size_t bytes );
+	size_t			GetBudget() const { return m_budget; }
+	size_t			GetMemoryBytes() const { return m_bytes; }
+	int				GetEntryCount() const { return m_entryCount; }
+
+	int				GetHitCount() const { return m_hits; }
+	int				GetMissCount() const { return m_misses; }
+	int				GetEvictionCount() const { return m_evictions; }
+	void			ResetStats() { m_hits = m_misses = m_evictions = 0; }
+};
+
+#endif // VS_FONTLAYOUTCACHE_H
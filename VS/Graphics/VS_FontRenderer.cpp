@@ -182,15 +182,74 @@ void
 vsFontRenderer::CreateString_InFragment( FontContext context, vsFontFragment *fragment, const vsString& string )
 {
 	fragment->Clear();
+	fragment->m_layout = NULL;
 
+	if ( string.empty() )
+		return;
+
+	if ( ShouldSnap( context ) )
+	{
+		vsVector4D t = m_transform.GetTranslation();
+		t.x = (float)vsFloor(t.x + 0.5f);
+		t.y = (float)vsFloor(t.y + 0.5f);
+		t.z = (float)vsFloor(t.z + 0.5f);
+		m_transform.SetTranslation(t);
+	}
+
+	// Text with per-glyph transforms or colors is usually being animated, and
+	// would never be asked for again, so we don't cache its layout.
+	vsFontLayoutCache *cache = m_font->GetLayoutCache();
+	bool cacheable = m_glyphTransform.IsEmpty() && m_glyphColor.IsEmpty();
+
+	vsFontLayoutKey key;
+	vsFontLayout *layout = NULL;
+	if ( cacheable )
+	{
+		MakeLayoutKey( context, string, &key );
+		layout = cache->Find( key );
+	}
+	if ( !layout )
+	{
+		layout = BuildLayout( context, string );
+		if ( !layout )
+			return;
+		if ( cacheable )
+			cache->Add( key, layout );
+	}
+
+	fragment->m_layout = layout;
+	m_texSize = layout->texSize;
+	fragment->SetMaterial( m_font->Size(m_texSize)->m_material );
+	fragment->SetSimpleShared( layout->vbo, layout->ibo, vsFragment::SimpleType_TriangleList );
+}
+
+void
+vsFontRenderer::MakeLayoutKey( FontContext context, const vsString& string, vsFontLayoutKey *key )
+{
+	key->string = string;
+	key->context = context;
+	key->size = m_size;
+	key->sizeBias = m_sizeBias;
+	key->bounds = m_bounds;
+	key->justification = m_justification;
+	key->transform = m_transform;
+	key->color = m_color;
+	key->dropShadowColor = m_dropShadowColor;
+	key->dropShadowOffset = m_dropShadowOffset;
+	key->hasColor = m_hasColor;
+	key->hasDropShadow = m_hasDropShadow;
+	key->snap = ShouldSnap( context );
+	key->buildMapping = m_buildMapping;
+}
+
+vsFontLayout *
+vsFontRenderer::BuildLayout( FontContext context, const vsString& string )
+{
 	try
 	{
 		size_t stringLength = string.length();
 		float size = m_size;
 
-		if ( stringLength == 0 )
-			return;
-
 		size_t requiredSize = stringLength * 4;      // we need a maximum of four verts for each character in the string.
 		size_t requiredTriangles = stringLength * 6; // three indices per triangle, two triangles per character, max.
 
@@ -203,9 +262,6 @@ vsFontRenderer::CreateString_InFragment( FontContext context, vsFontFragment *fr
 		vsRenderBuffer::PCT *ptArray = new vsRenderBuffer::PCT[ requiredSize ];
 		uint16_t *tlArray = new uint16_t[ requiredTriangles ];
 
-		vsRenderBuffer *ptBuffer = new vsRenderBuffer;
-		vsRenderBuffer *tlBuffer = new vsRenderBuffer;
-
 		FragmentConstructor constructor;
 		constructor.ptArray = ptArray;
 		constructor.tlArray = tlArray;
@@ -257,16 +313,6 @@ vsFontRenderer::CreateString_InFragment( FontContext context, vsFontFragment *fr
 		float lineHeight = 1.f;
 		float lineMargin = lineHeight * m_font->Size(size)->m_lineSpacing;
 
-		bool doSnap = ShouldSnap( context );
-		if ( doSnap )
-		{
-			vsVector4D t = m_transform.GetTranslation();
-			t.x = (float)vsFloor(t.x + 0.5f);
-			t.y = (float)vsFloor(t.y + 0.5f);
-			t.z = (float)vsFloor(t.z + 0.5f);
-			m_transform.SetTranslation(t);
-		}
-
 		if ( m_hasDropShadow )
 		{
 			// BLAH.  Seems like our x offset is in pixels, and our y offset is scaled by font size?
@@ -294,47 +340,39 @@ vsFontRenderer::CreateString_InFragment( FontContext context, vsFontFragment *fr
 			nextGlyph += (int)glyphsInThisLine;
 		}
 
-
-		ptBuffer->SetArray( constructor.ptArray, constructor.ptIndex );
-		tlBuffer->SetArray( constructor.tlArray, constructor.tlIndex );
-
-		fragment->SetMaterial( m_font->Size(m_texSize)->m_material );
-		// fragment->AddBuffer( ptBuffer );
-		// fragment->AddBuffer( tlBuffer );
-
-		// vsDisplayList *list = new vsDisplayList(256);
-		//
-		// list->BindBuffer( ptBuffer );
-		// list->TriangleListBuffer( tlBuffer );
-		// list->ClearArrays();
-		//
-		// fragment->SetDisplayList( list );
-		fragment->SetSimple( ptBuffer, tlBuffer, vsFragment::SimpleType_TriangleList );
-		vsFontFragment* ff = dynamic_cast<vsFontFragment*>(fragment);
-		if ( ff )
-		{
-			ff->m_glyphBox = constructor.glyphBox;
-			ff->m_glyphCount = constructor.glyphCount;
-			ff->m_lineBox = constructor.lineBox;
-			ff->m_lineFirstGlyph = constructor.lineFirstGlyph;
-			ff->m_lineLastGlyph = constructor.lineLastGlyph;
-			ff->m_lineCount = constructor.lineCount;
-		}
-		else
+		vsFontLayout *layout = new vsFontLayout;
+		layout->vbo = new vsRenderBuffer;
+		layout->ibo = new vsRenderBuffer;
+		layout->vbo->SetArray( constructor.ptArray, constructor.ptIndex );
+		layout->ibo->SetArray( constructor.tlArray, constructor.tlIndex );
+		layout->texSize = m_texSize;
+
+		layout->glyphBox = constructor.glyphBox;
+		layout->glyphCount = constructor.glyphCount;
+		layout->lineBox = constructor.lineBox;
+		layout->lineFirstGlyph = constructor.lineFirstGlyph;
+		layout->lineLastGlyph = constructor.lineLastGlyph;
+		layout->lineCount = constructor.lineCount;
+
+		layout->bytes = sizeof(vsFontLayout) +
+			constructor.ptIndex * sizeof(vsRenderBuffer::PCT) +
+			constructor.tlIndex * sizeof(uint16_t);
+		if ( constructor.glyphBox )
 		{
-			vsDeleteArray( constructor.glyphBox );
-			vsDeleteArray( constructor.lineBox );
-			vsDeleteArray( constructor.lineFirstGlyph );
-			vsDeleteArray( constructor.lineLastGlyph );
+			layout->bytes += constructor.glyphCount * sizeof(vsBox2D) +
+				constructor.lineCount * (sizeof(vsBox2D) + 2 * sizeof(int));
 		}
 
 		vsDeleteArray( ptArray );
 		vsDeleteArray( tlArray );
+
+		return layout;
 	}
 	catch(...)
 	{
 		vsLog("Failed to build renderable text fragment for utf string: %s", string);
 	}
+	return NULL;
 }
 
 bool
@@ -617,7 +655,8 @@ vsFontRenderer::AppendStringToArrays( vsFontRenderer::FragmentConstructor *const
 
 	uint16_t glyphIndices[6] = { 0, 2, 1, 1, 2, 3 };
 
-	size_t len = utf8::distance(string, string + strlen(string));
+	const char* stringEnd = string + strlen(string);
+	size_t len = utf8::distance(string, stringEnd);
 	const char* w = string;
 	size_t startGlyphId = nextGlyphId;
 	size_t endGlyphId = nextGlyphId + len;
@@ -626,7 +665,7 @@ vsFontRenderer::AppendStringToArrays( vsFontRenderer::FragmentConstructor *const
 
 	for ( size_t glyphId = startGlyphId; glyphId < endGlyphId; glyphId++ )
 	{
-		uint32_t cp = utf8::next(w, string + strlen(string));
+		uint32_t cp = utf8::next(w, stringEnd);
 		vsGlyph *g = fontSize->FindGlyphForCharacter( cp );
 
 		if ( cp == '\r' )
@@ -718,7 +757,6 @@ vsFontRenderer::AppendStringToArrays( vsFontRenderer::FragmentConstructor *const
 
 			if ( glyphId < endGlyphId-1 )
 			{
-				const char* stringEnd = string + strlen(string);
 				uint32_t ncp = utf8::peek_next(w, stringEnd);
 				offset.x += fontSize->GetCharacterKerning( cp, ncp, sizeScale );
 			}
@@ -847,11 +885,7 @@ vsFontFragment::vsFontFragment( vsFontRenderer& renderer, FontContext fc, const
 	m_renderer(renderer),
 	m_context(fc),
 	m_string(string),
-	m_lineBox(NULL),
-	m_lineFirstGlyph(NULL),
-	m_lineLastGlyph(NULL),
-	m_lineCount(0),
-	m_glyphBox(NULL),
+	m_layout(NULL),
 	m_attached(true)
 {
 }
@@ -860,10 +894,6 @@ vsFontFragment::~vsFontFragment()
 {
 	if ( m_attached )
 		m_renderer.m_font->RemoveFragment(this);
-	vsDeleteArray(m_glyphBox);
-	vsDeleteArray(m_lineBox);
-	vsDeleteArray(m_lineFirstGlyph);
-	vsDeleteArray(m_lineLastGlyph);
 }
 
 void
@@ -871,11 +901,6 @@ vsFontFragment::Rebuild()
 {
 	if ( m_attached )
 	{
-		Clear();
-		vsDeleteArray(m_glyphBox);
-		vsDeleteArray(m_lineBox);
-		vsDeleteArray(m_lineFirstGlyph);
-		vsDeleteArray(m_lineLastGlyph);
 		m_renderer.CreateString_InFragment( m_context, this, m_string );
 	}
 }
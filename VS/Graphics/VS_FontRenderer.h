@@ -11,6 +11,7 @@
 #define VS_FONTRENDERER_H
 
 #include "VS/Graphics/VS_Font.h"
+#include "VS/Graphics/VS_FontLayoutCache.h"
 #include "VS/Graphics/VS_Fragment.h"
 
 class vsFontRenderer
@@ -64,6 +65,8 @@ class vsFontRenderer
 	void		WrapLine(const vsString &string, float size);
 	// vsFragment* CreateString_Fragment( FontContext context, const vsString& string );
 	void		CreateString_InFragment( FontContext context, vsFontFragment *fragment, const vsString& string );
+	vsFontLayout *	BuildLayout( FontContext context, const vsString& string );
+	void		MakeLayoutKey( FontContext context, const vsString& string, vsFontLayoutKey *key );
 	void		CreateString_InDisplayList( FontContext context, vsDisplayList *list, const vsString &string );
 	void		AppendStringToArrays( vsFontRenderer::FragmentConstructor *constructor, FontContext context, const char* string, const vsVector2D &size, JustificationType type, const vsVector2D &offset, int nextGlyphId, int lineId, bool dropShadow);
 	void		BuildDisplayListGeometryFromString( FontContext context, vsDisplayList * list, const char* string, float size, JustificationType type, const vsVector2D &offset);
@@ -156,13 +159,9 @@ class vsFontFragment: public vsFragment
 	FontContext m_context;
 	vsString m_string;
 
-	vsBox2D *m_lineBox; // contains a box around each wrapped line.
-	int *m_lineFirstGlyph; // the first glyph on each line.
-	int *m_lineLastGlyph; // the last glyph on each line.
-	size_t m_lineCount;
-
-	vsBox2D *m_glyphBox; // contains a box around each glyph.
-	size_t m_glyphCount;
+	// our geometry, and the boxes around each glyph and each wrapped line,
+	// which may be shared with other fragments showing the same text.
+	vsStrongPointer<vsFontLayout> m_layout;
 
 	bool m_attached;
 
@@ -172,15 +171,15 @@ public:
 
 	// If our font renderer had mapping enabled, these functions provide access
 	// to the generated glyph mapping.
-	size_t GetGlyphMappingCount() const { return m_glyphCount; }
-	const vsBox2D& GetGlyphMapping(int glyph) const { return m_glyphBox[glyph]; }
+	size_t GetGlyphMappingCount() const { return m_layout ? m_layout->glyphCount : 0; }
+	const vsBox2D& GetGlyphMapping(int glyph) const { return m_layout->glyphBox[glyph]; }
 
 	// If our font renderer had mapping enabled, these functions provide access
 	// to the generated line mapping.
-	size_t GetLineMappingCount() const { return m_lineCount; }
-	const vsBox2D& GetLineMapping(int line) const { return m_lineBox[line]; }
-	int GetLineFirstGlyph(int line) const { return m_lineFirstGlyph[line]; }
-	int GetLineLastGlyph(int line) const { return m_lineLastGlyph[line]; }
+	size_t GetLineMappingCount() const { return m_layout ? m_layout->lineCount : 0; }
+	const vsBox2D& GetLineMapping(int line) const { return m_layout->lineBox[line]; }
+	int GetLineFirstGlyph(int line) const { return m_layout->lineFirstGlyph[line]; }
+	int GetLineLastGlyph(int line) const { return m_layout->lineLastGlyph[line]; }
 
 	// Detach() makes the fragment aware that its font no longer exists.  Should
 	// only be called by the Font.  Calling it means that this fragment will no
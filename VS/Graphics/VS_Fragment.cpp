@@ -361,6 +361,15 @@ vsFragment::SetSimple( vsRenderBuffer *vbo, vsRenderBuffer *ibo, SimpleType type
 	AddBuffer(ibo);
 }
 
+void
+vsFragment::SetSimpleShared( vsRenderBuffer *vbo, vsRenderBuffer *ibo, SimpleType type )
+{
+	m_displayList = NULL;
+	m_simpleType = type;
+	m_vbo = vbo;
+	m_ibo = ibo;
+}
+
 void
 vsFragment::AddBuffer( vsRenderBuffer *buffer )
 {
@@ -56,6 +56,9 @@ public:
 	// A "Simple" fragment has no display list;  it just binds the vbo and
 	// draws the ibo as a triangle list.
 	void	SetSimple( vsRenderBuffer *vbo, vsRenderBuffer *ibo, SimpleType type );
+	// As SetSimple(), except that the fragment doesn't take ownership of the
+	// buffers;  the caller must keep them alive for as long as we use them.
+	void	SetSimpleShared( vsRenderBuffer *vbo, vsRenderBuffer *ibo, SimpleType type );
 	bool	IsSimple() const { return m_vbo && m_ibo; }
 	SimpleType GetSimpleType() const { return m_simpleType; }
 	vsRenderBuffer * GetSimpleVBO() { return m_vbo; }
@@ -11,6 +11,8 @@
 #include "VS_RenderQueue.h"
 #include "VS_Scene.h"
 #include "VS_Camera.h"
+#include "VS_Screen.h"
+#include "VS_ThreadPool.h"
 
 float vsLines3D::s_widthFactor = 1.f;
 
@@ -744,56 +746,226 @@ vsFragment *vsLineStrip3D( const vsString& material, vsVector3D *point, vsColor
 	return fragment;
 }
 
+static const int c_minVerticesPerTessellateJob = 2048;
+
 class vsLines3D::Strip
 {
 public:
 	vsVector3D *m_vertex;
 	vsColor *m_color;
+	float *m_distance;	// distance along the strip to each vertex, for texturing
 	int m_length;
+	int m_capacity;
+	int m_firstVertex;	// our first vertex's position in the whole set of strips
+	bool m_hasColor;
 	bool m_loop;
 
-	Strip( vsVector3D *array, int length ):
-		m_vertex( new vsVector3D[length] ),
+	Strip():
+		m_vertex( NULL ),
 		m_color( NULL ),
-		m_length( length ),
-		m_loop(false)
+		m_distance( NULL ),
+		m_length( 0 ),
+		m_capacity( 0 ),
+		m_firstVertex( 0 ),
+		m_hasColor( false ),
+		m_loop( false )
 	{
-		for ( int i = 0; i < length; i++ )
+	}
+	~Strip()
+	{
+		vsDeleteArray( m_vertex );
+		vsDeleteArray( m_color );
+		vsDeleteArray( m_distance );
+	}
+
+	// Returns false if we already held exactly this strip.
+	bool Set( const vsVector3D *array, const vsColor *carray, int length, bool loop )
+	{
+		if ( length == m_length && loop == m_loop && (carray != NULL) == m_hasColor &&
+				memcmp( array, m_vertex, sizeof(vsVector3D) * length ) == 0 &&
+				( !carray || memcmp( carray, m_color, sizeof(vsColor) * length ) == 0 ) )
+			return false;
+
+		if ( length > m_capacity )
 		{
+			vsDeleteArray( m_vertex );
+			vsDeleteArray( m_color );
+			vsDeleteArray( m_distance );
+			m_vertex = new vsVector3D[length];
+			m_distance = new float[length];
+			m_capacity = length;
+		}
+		if ( carray && !m_color )
+			m_color = new vsColor[m_capacity];
+
+		m_length = length;
+		m_loop = loop;
+		m_hasColor = (carray != NULL);
+		for ( int i = 0; i < length; i++ )
 			m_vertex[i] = array[i];
+		if ( carray )
+		{
+			for ( int i = 0; i < length; i++ )
+				m_color[i] = carray[i];
 		}
+
+		// Each vertex's texture coordinate is the sum of the distances back
+		// to the previous vertex of every vertex before it;  the first
+		// vertex of an open strip uses the distance forward to the second.
+		float distance = 0.f;
+		for ( int i = 0; i < length; i++ )
+		{
+			m_distance[i] = distance;
+			int preI = i-1;
+			if ( preI < 0 )
+				preI = loop ? length-1 : 0;
+			if ( preI == i )
+			{
+				int postI = i+1;
+				if ( postI >= length )
+					postI = loop ? 0 : length-1;
+				distance += (m_vertex[postI] - m_vertex[i]).Length();
+			}
+			else
+				distance += (m_vertex[i] - m_vertex[preI]).Length();
+		}
+		return true;
 	}
-	Strip( vsVector3D *array, vsColor *carray, int length ):
-		m_vertex( new vsVector3D[length] ),
-		m_color( new vsColor[length] ),
-		m_length( length ),
-		m_loop(false)
+
+	int GetIndexCount() const
 	{
-		for ( int i = 0; i < length; i++ )
+		// we're going to emit 18 indices for each quad.  We're going
+		// to emit one quad for each strip vertex, except for the last one
+		// of each strip.  ('n' vertices means 'n-1' quads)
+		int result = (m_length-1) * 18;
+		if ( m_loop )
+			result += 18;	// six more indices if we're looping, as we connect end->start
+		return result;
+	}
+
+	template<typename I>
+	void WriteIndices( I *ia ) const
+	{
+		int startOfStripVertexCursor = m_firstVertex * 4;
+		int vertexCursor = startOfStripVertexCursor;
+		for ( int i = 0; i < m_length - 1; i++ )
 		{
-			m_vertex[i] = array[i];
-			m_color[i] = carray[i];
+			for ( int q = 0; q < 3; q++ )
+			{
+				int nearMinVertex = vertexCursor;
+				int farMinVertex = vertexCursor+4;
+
+				ia[0] = nearMinVertex+0;
+				ia[1] = nearMinVertex+1;
+				ia[2] = farMinVertex+0;
+				ia[3] = farMinVertex+0;
+				ia[4] = nearMinVertex+1;
+				ia[5] = farMinVertex+1;
+
+				ia += 6;
+				vertexCursor ++;
+			}
+			vertexCursor ++;
+		}
+		vertexCursor += 4;
+
+		if ( m_loop )
+		{
+			for ( int q = 0; q < 3; q++ )
+			{
+				int nearMinVertex = vertexCursor+q-4;
+				int farMinVertex = startOfStripVertexCursor+q;
+
+				// and join up the end to the start.
+				ia[0] = nearMinVertex+0;
+				ia[1] = nearMinVertex+1;
+				ia[2] = farMinVertex+0;
+				ia[3] = farMinVertex+0;
+				ia[4] = nearMinVertex+1;
+				ia[5] = farMinVertex+1;
+
+				ia += 6;
+			}
 		}
 	}
-	~Strip()
+};
+
+// One contiguous run of strip vertices, tessellated on a thread pool worker.
+// Each vertex only depends on its strip and the view, so runs can split
+// strips anywhere.
+class vsLines3DTessellateJob : public vsJob
+{
+	vsLines3D *	m_lines;
+	int			m_start;
+	int			m_end;
+
+protected:
+	virtual void Execute()
+	{
+		m_lines->TessellateRange( m_start, m_end );
+	}
+
+public:
+	vsLines3DTessellateJob( vsLines3D *lines ):
+		m_lines(lines),
+		m_start(0),
+		m_end(0)
 	{
-		vsDeleteArray( m_vertex );
-		vsDeleteArray( m_color );
+	}
+
+	void Tessellate( int start, int end )
+	{
+		m_start = start;
+		m_end = end;
+		vsThreadPool::Instance()->Submit( this, vsThreadPool::Affinity_MainThreadL3 );
 	}
 };
 
+bool
+vsLines3D::View::Matches( const View &o ) const
+{
+	if ( leftWidth != o.leftWidth || rightWidth != o.rightWidth || texScale != o.texScale ||
+			widthInScreenspace != o.widthInScreenspace ||
+			useConstantViewDirection != o.useConstantViewDirection )
+		return false;
+
+	// only compare the parts of the view which our vertices use.
+	if ( useConstantViewDirection )
+	{
+		if ( constantViewDirection != o.constantViewDirection )
+			return false;
+	}
+	else if ( camPos != o.camPos )
+		return false;
+
+	if ( widthInScreenspace )
+	{
+		if ( orthographic != o.orthographic || fovPerPixel != o.fovPerPixel )
+			return false;
+		if ( !orthographic && localToView != o.localToView )
+			return false;
+	}
+	return true;
+}
+
 vsLines3D::vsLines3D( int maxStrips, float width, bool screenspace ):
 	m_strip( new Strip*[maxStrips] ),
 	m_stripCount( 0 ),
+	m_allocatedStripCount( 0 ),
 	m_maxStripCount( maxStrips ),
 	m_leftWidth( width * 0.5f ),
 	m_rightWidth( width * 0.5f ),
 	m_texScale( 1.0f ),
 	m_widthInScreenspace( screenspace ),
-	m_vertices( vsRenderBuffer::Type_Stream ),
-	m_indices( vsRenderBuffer::Type_Stream ),
+	m_vertices( vsRenderBuffer::Type_Dynamic ),
+	m_indices( vsRenderBuffer::Type_Dynamic ),
 	m_constantViewDirection(),
-	m_useConstantViewDirection(false)
+	m_useConstantViewDirection(false),
+	m_view(),
+	m_tessellatedStripCount( 0 ),
+	m_indexedStripCount( 0 ),
+	m_uploadedVertexCount( 0 ),
+	m_uploadedIndexCount( 0 )
 {
 	if ( m_widthInScreenspace )
 	{
@@ -805,11 +977,17 @@ vsLines3D::vsLines3D( int maxStrips, float width, bool screenspace ):
 		m_leftWidth *= 0.707f;
 		m_rightWidth *= 0.707f;
 	}
+
+	// DynamicDraw() uploads our tessellated geometry.
+	SetDrawOnMainThread(true);
 }
 
 vsLines3D::~vsLines3D()
 {
-	Clear();
+	for ( int i = 0; i < m_allocatedStripCount; i++ )
+	{
+		vsDelete( m_strip[i] );
+	}
 	vsDeleteArray( m_strip );
 }
 
@@ -823,10 +1001,8 @@ vsLines3D::SetConstantViewDirection( const vsVector3D& direction )
 void
 vsLines3D::Clear()
 {
-	for ( int i = 0; i < m_stripCount; i++ )
-	{
-		vsDelete( m_strip[i] );
-	}
+	// Keep our strips (and the geometry we built from them), so that if
+	// the same strips are added again we don't need to rebuild them.
 	m_stripCount = 0;
 }
 
@@ -840,290 +1016,315 @@ vsLines3D::AddLine( vsVector3D &a, vsVector3D &b )
 void
 vsLines3D::AddStrip( vsVector3D *array, vsColor *carray, int arraySize )
 {
-	vsAssert( m_stripCount < m_maxStripCount, "Too many strips in vsLines3D" );
-	int i = m_stripCount++;
-	if ( carray )
-		m_strip[i] = new Strip(array, carray, arraySize);
-	else
-		m_strip[i] = new Strip(array, arraySize);
+	SetStrip( array, carray, arraySize, false );
 }
 
 void
 vsLines3D::AddLoop( vsVector3D *array, vsColor *carray, int arraySize )
 {
-	vsAssert( m_stripCount < m_maxStripCount, "Too many strips in vsLines3D" );
-	int i = m_stripCount++;
-
-	if ( carray )
-		m_strip[i] = new Strip(array, carray, arraySize);
-	else
-		m_strip[i] = new Strip(array, arraySize);
-	m_strip[i]->m_loop = true;
+	SetStrip( array, carray, arraySize, true );
 }
 
-size_t
-vsLines3D::GetFinalVertexCount()
+void
+vsLines3D::SetStrip( vsVector3D *array, vsColor *carray, int arraySize, bool loop )
 {
-	size_t result = 0;
-	for ( int i = 0; i < m_stripCount; i++ )
-	{
-		// we're going to emit FOUR vertices per strip vertex.
-		//
-		// Assuming (for the sake of this diagram) that our line
-		// is travelling downward or upward, these vertices will be:
-		//
-		//  -> crossline direction
-		//
-		//  0  1  2  3
-		//  t  o  o  t
-		//
-		//  (t == transparent)
-		//  (o == opaque)
-		//
-		// The idea here is that if we're drawing one-pixel lines, this
-		// should give us some simple anti-aliasing in the pixels between 0 and 1,
-		// and between 2 and 3, even if MSAA is disabled
-		//
-		result += m_strip[i]->m_length * 4;
-	}
-	return result;
-}
+	vsAssert( m_stripCount < m_maxStripCount, "Too many strips in vsLines3D" );
+	int i = m_stripCount++;
+	if ( i == m_allocatedStripCount )
+		m_strip[m_allocatedStripCount++] = new Strip;
 
-size_t
-vsLines3D::GetFinalIndexCount()
-{
-	size_t result = 0;
-	for ( int i = 0; i < m_stripCount; i++ )
+	if ( m_strip[i]->Set( array, carray, arraySize, loop ) )
 	{
-		// we're going to emit 18 indices for each quad.  We're going
-		// to emit one quad for each strip vertex, except for the last one
-		// of each strip.  ('n' vertices means 'n-1' quads)
-		result += (m_strip[i]->m_length-1) * 18;
-		if ( m_strip[i]->m_loop )
-			result += 18;	// six more indices if we're looping, as we connect end->start
+		// this strip's geometry, and the position of every strip after it,
+		// may have changed.
+		m_tessellatedStripCount = vsMin( m_tessellatedStripCount, i );
+		m_indexedStripCount = vsMin( m_indexedStripCount, i );
 	}
-	return result;
 }
 
 void
 vsLines3D::DynamicDraw( vsRenderQueue *queue )
 {
-	m_vertexCursor = 0;
-	m_indexCursor = 0;
-
-	size_t vertexCount = GetFinalVertexCount();
-	size_t indexCount = GetFinalIndexCount();
+	// we're going to emit FOUR vertices per strip vertex.
+	//
+	// Assuming (for the sake of this diagram) that our line
+	// is travelling downward or upward, these vertices will be:
+	//
+	//  -> crossline direction
+	//
+	//  0  1  2  3
+	//  t  o  o  t
+	//
+	//  (t == transparent)
+	//  (o == opaque)
+	//
+	// The idea here is that if we're drawing one-pixel lines, this
+	// should give us some simple anti-aliasing in the pixels between 0 and 1,
+	// and between 2 and 3, even if MSAA is disabled
+	//
+	int stripVertexCount = 0;
+	int indexCount = 0;
+	for ( int i = 0; i < m_stripCount; i++ )
+	{
+		m_strip[i]->m_firstVertex = stripVertexCount;
+		stripVertexCount += m_strip[i]->m_length;
+		indexCount += m_strip[i]->GetIndexCount();
+	}
+	int vertexCount = stripVertexCount * 4;
 	if ( vertexCount == 0 || indexCount == 0 )
 		return;
 
-	m_vertices.ResizeArray( sizeof(vsRenderBuffer::PCT) * vertexCount );
-	m_indices.ResizeArray( sizeof(uint16_t) * indexCount );
+	View view;
+	view.fovPerPixel = queue->GetFOV() / vsScreen::Instance()->GetHeight();
+	view.tanHalfFovPerPixel = 2.f * vsTan( 0.5f * view.fovPerPixel );
+	view.orthographic = queue->IsOrthographic();
+	// vsMatrix4x4 localToView = queue->GetMatrix() * queue->GetWorldToViewMatrix();
+	view.localToView = queue->GetWorldToViewMatrix() * queue->GetMatrix();
+	view.camPos = view.localToView.Inverse().ApplyTo(vsVector3D::Zero);
+	view.constantViewDirection = m_constantViewDirection;
+	view.leftWidth = m_leftWidth;
+	view.rightWidth = m_rightWidth;
+	view.texScale = m_texScale;
+	view.widthInScreenspace = m_widthInScreenspace;
+	view.useConstantViewDirection = m_useConstantViewDirection;
+	if ( !view.Matches( m_view ) )
+	{
+		m_view = view;
+		m_tessellatedStripCount = 0;
+	}
 
-	for ( int i = 0; i < m_stripCount; i++ )
+	int tessellated = vsMin( m_tessellatedStripCount, m_stripCount );
+	if ( tessellated < m_stripCount )
 	{
-		DrawStrip( queue, m_strip[i] );
+		// ResizeArray() keeps the vertices of the strips before 'tessellated'.
+		m_vertices.ResizeArray( sizeof(vsRenderBuffer::PCT) * vertexCount );
+		Tessellate( m_strip[tessellated]->m_firstVertex, stripVertexCount );
+		m_tessellatedStripCount = m_stripCount;
 	}
+	if ( tessellated < m_stripCount || m_uploadedVertexCount != vertexCount )
+	{
+		// SetArray() trims the buffer to just the vertices we upload now, so
+		// a later ResizeArray() will only keep the strips we have this frame.
+		m_vertices.SetArray( m_vertices.GetPCTArray(), vertexCount );
+		m_uploadedVertexCount = vertexCount;
+		m_tessellatedStripCount = m_stripCount;
+	}
+
+	// 16-bit indices can only reach the first 65536 vertices.
+	bool wideIndices = ( vertexCount > 0x10000 );
+	int indexed = vsMin( m_indexedStripCount, m_stripCount );
+	if ( wideIndices != ( m_indices.GetContentType() == vsRenderBuffer::ContentType_UInt32 ) )
+		indexed = 0;
+	if ( indexed < m_stripCount || m_uploadedIndexCount != indexCount )
+	{
+		if ( indexed == 0 )
+		{
+			if ( wideIndices )
+				m_indices.SetUInt32ArraySize( indexCount );
+			else
+				m_indices.SetIntArraySize( indexCount );
+		}
+		else
+			m_indices.ResizeArray( m_indices.GetIndexBytes() * indexCount );
 
-	m_vertices.SetArray( m_vertices.GetPCTArray(), vertexCount );
-	// m_vertices.BakeArray();
-	// m_colors.BakeArray();
-	m_indices.BakeArray();
+		int indexCursor = 0;
+		for ( int i = 0; i < m_stripCount; i++ )
+		{
+			if ( i >= indexed )
+			{
+				if ( wideIndices )
+					m_strip[i]->WriteIndices( m_indices.GetUInt32Array() + indexCursor );
+				else
+					m_strip[i]->WriteIndices( m_indices.GetIntArray() + indexCursor );
+			}
+			indexCursor += m_strip[i]->GetIndexCount();
+		}
+		m_indices.BakeIndexArray();
+		m_indexedStripCount = m_stripCount;
+		m_uploadedIndexCount = indexCount;
+	}
 
 	vsDisplayList *	list = queue->MakeTemporaryBatchList( GetMaterial(), queue->GetMatrix(), 1024 );
 	list->BindBuffer(&m_vertices);
-	// list->ColorBuffer(&m_colors);
 	list->TriangleListBuffer(&m_indices);
 	list->ClearBuffers();
 }
 
 void
-vsLines3D::DrawStrip( vsRenderQueue *queue, Strip *strip )
+vsLines3D::Tessellate( int start, int end )
 {
-	int startOfStripVertexCursor = m_vertexCursor;
-	float fullFov = queue->GetFOV();
-	float fovPerPixel = fullFov / vsScreen::Instance()->GetHeight();
-	float tanHalfFovPerPixel = 2.f * vsTan( 0.5f * fovPerPixel );
-
-	// vsMatrix4x4 localToView = queue->GetMatrix() * queue->GetWorldToViewMatrix();
-	vsMatrix4x4 localToView = queue->GetWorldToViewMatrix() * queue->GetMatrix() ;
-	vsMatrix4x4 viewToLocal = localToView.Inverse();
-	vsVector3D camPos = viewToLocal.ApplyTo(vsVector3D::Zero);
-
-	vsRenderBuffer::PCT *va = m_vertices.GetPCTArray();
-	uint16_t *ia = m_indices.GetIntArray();
-	float distance = 0.0f;
-
-	for ( int i = 0; i < strip->m_length; i++ )
+	int count = end - start;
+	int runCount = 1;
+	// we may be drawn from a scene gathering on a worker thread;  if so, just
+	// tessellate everything here rather than wait on other workers.
+	if ( count >= c_minVerticesPerTessellateJob * 2 && !vsThreadPool::IsWorkerThread() )
+	{
+		int workerCount = vsThreadPool::Instance()->GetWorkerCount( vsThreadPool::Affinity_MainThreadL3 );
+		runCount = vsMax( 1, vsMin( workerCount + 1, count / c_minVerticesPerTessellateJob ) );
+	}
+	for ( int i = m_tessellateJob.ItemCount(); i < runCount-1; i++ )
+	{
+		m_tessellateJob.AddItem( new vsLines3DTessellateJob(this) );
+	}
+	for ( int i = 1; i < runCount; i++ )
+	{
+		m_tessellateJob[i-1]->Tessellate( start + (count * i) / runCount, start + (count * (i+1)) / runCount );
+	}
+	TessellateRange( start, start + count / runCount );
+	for ( int i = 1; i < runCount; i++ )
 	{
-		// vsVector3D dirOfTravel;
+		m_tessellateJob[i-1]->Wait();
+	}
+}
 
-		int midI = i;
-		int preI = midI-1;
-		int postI = midI+1;
+void
+vsLines3D::TessellateRange( int start, int end )
+{
+	if ( start >= end )
+		return;
 
-		if ( postI >= strip->m_length )
-		{
-			if ( strip->m_loop )
-				postI = 0;
-			else
-				postI = strip->m_length-1;
-		}
-		if ( preI < 0 )
-		{
-			if ( strip->m_loop )
-				preI = strip->m_length-1;
-			else
-				preI = 0;
-		}
+	// find the strip holding 'start'
+	int lo = 0;
+	int hi = m_stripCount - 1;
+	while ( lo < hi )
+	{
+		int mid = (lo + hi + 1) / 2;
+		if ( m_strip[mid]->m_firstVertex <= start )
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
 
-		vsVector3D cameraForward = strip->m_vertex[midI] - camPos;
-		if ( m_useConstantViewDirection )
-			cameraForward = m_constantViewDirection;
-		// vsVector3D cameraForward = viewToLocal.z;
-		cameraForward.NormaliseSafe();
+	vsRenderBuffer::PCT *va = m_vertices.GetPCTArray();
+	for ( int s = lo; s < m_stripCount; s++ )
+	{
+		Strip *strip = m_strip[s];
+		if ( strip->m_firstVertex >= end )
+			break;
+		int first = vsMax( 0, start - strip->m_firstVertex );
+		int last = vsMin( strip->m_length, end - strip->m_firstVertex );
+		for ( int i = first; i < last; i++ )
+			TessellateVertex( strip, i, va + (strip->m_firstVertex + i) * 4 );
+	}
+}
 
-		vsVector3D dirOfTravelPre = strip->m_vertex[midI] - strip->m_vertex[preI];
-		vsVector3D dirOfTravelPost = strip->m_vertex[postI] - strip->m_vertex[midI];
-		if ( midI == preI )
-			dirOfTravelPre = dirOfTravelPost;
-		if ( midI == postI )
-			dirOfTravelPost = dirOfTravelPre;
-		float distanceOfTravelPre = dirOfTravelPre.Length();
-		float distanceOfTravelPost = dirOfTravelPost.Length();
-		dirOfTravelPre.NormaliseSafe();
-		dirOfTravelPost.NormaliseSafe();
+void
+vsLines3D::TessellateVertex( Strip *strip, int i, vsRenderBuffer::PCT *va )
+{
+	const View &view = m_view;
 
-		vsVector3D offsetPre = dirOfTravelPre.Cross( cameraForward );
-		vsVector3D offsetPost = dirOfTravelPost.Cross( cameraForward );
-		offsetPre.NormaliseSafe();
-		offsetPost.NormaliseSafe();
+	int midI = i;
+	int preI = midI-1;
+	int postI = midI+1;
 
-		float leftWidthHere = m_leftWidth;
-		float rightWidthHere = m_rightWidth;
-		if ( m_widthInScreenspace )
-		{
-			if ( queue->IsOrthographic() )
-			{
-				leftWidthHere *= fovPerPixel;
-				rightWidthHere *= fovPerPixel;
-			}
-			else
-			{
-				vsVector3D viewPos = localToView.ApplyTo( vsVector4D(strip->m_vertex[midI],1.f) );
-				leftWidthHere *= tanHalfFovPerPixel * viewPos.z;
-				rightWidthHere *= tanHalfFovPerPixel * viewPos.z;
-			}
-		}
+	if ( postI >= strip->m_length )
+	{
+		if ( strip->m_loop )
+			postI = 0;
+		else
+			postI = strip->m_length-1;
+	}
+	if ( preI < 0 )
+	{
+		if ( strip->m_loop )
+			preI = strip->m_length-1;
+		else
+			preI = 0;
+	}
 
-		vsVector3D vertexPosition;
-		if ( offsetPre != offsetPost )
+	vsVector3D cameraForward = strip->m_vertex[midI] - view.camPos;
+	if ( view.useConstantViewDirection )
+		cameraForward = view.constantViewDirection;
+	// vsVector3D cameraForward = viewToLocal.z;
+	cameraForward.NormaliseSafe();
+
+	vsVector3D dirOfTravelPre = strip->m_vertex[midI] - strip->m_vertex[preI];
+	vsVector3D dirOfTravelPost = strip->m_vertex[postI] - strip->m_vertex[midI];
+	if ( midI == preI )
+		dirOfTravelPre = dirOfTravelPost;
+	if ( midI == postI )
+		dirOfTravelPost = dirOfTravelPre;
+	float distanceOfTravelPre = dirOfTravelPre.Length();
+	float distanceOfTravelPost = dirOfTravelPost.Length();
+	dirOfTravelPre.NormaliseSafe();
+	dirOfTravelPost.NormaliseSafe();
+
+	vsVector3D offsetPre = dirOfTravelPre.Cross( cameraForward );
+	vsVector3D offsetPost = dirOfTravelPost.Cross( cameraForward );
+	offsetPre.NormaliseSafe();
+	offsetPost.NormaliseSafe();
+
+	float leftWidthHere = view.leftWidth;
+	float rightWidthHere = view.rightWidth;
+	if ( view.widthInScreenspace )
+	{
+		if ( view.orthographic )
 		{
-			vsVector3D closestPre, closestPost;
-			vsVector3D insidePre = strip->m_vertex[preI] - (offsetPre * rightWidthHere);
-			vsVector3D insidePost = strip->m_vertex[postI] - (offsetPost * rightWidthHere);
-
-			vsSqDistanceBetweenLineSegments( insidePre,
-					insidePre + dirOfTravelPre * (distanceOfTravelPre + 3.f * rightWidthHere),
-					insidePost,
-					insidePost - dirOfTravelPost * (distanceOfTravelPost + 3.f * rightWidthHere),
-					&closestPre, &closestPost );
-
-			vertexPosition = vsInterpolate(0.5f, closestPre, closestPost);
+			leftWidthHere *= view.fovPerPixel;
+			rightWidthHere *= view.fovPerPixel;
 		}
 		else
 		{
-			vertexPosition = strip->m_vertex[midI] - offsetPre * rightWidthHere;
+			vsVector3D viewPos = view.localToView.ApplyTo( vsVector4D(strip->m_vertex[midI],1.f) );
+			leftWidthHere *= view.tanHalfFovPerPixel * viewPos.z;
+			rightWidthHere *= view.tanHalfFovPerPixel * viewPos.z;
 		}
+	}
 
-		va[m_vertexCursor+0].position = 3.0f * (vertexPosition - strip->m_vertex[midI]) + vertexPosition;
-		va[m_vertexCursor+1].position = vertexPosition;
-
-		if ( offsetPre != offsetPost )
-		{
-			vsVector3D closestPre, closestPost;
-			vsVector3D outsidePre = strip->m_vertex[preI] + (offsetPre * leftWidthHere);
-			vsVector3D outsidePost = strip->m_vertex[postI] + (offsetPost * leftWidthHere);
+	vsVector3D vertexPosition;
+	if ( offsetPre != offsetPost )
+	{
+		vsVector3D closestPre, closestPost;
+		vsVector3D insidePre = strip->m_vertex[preI] - (offsetPre * rightWidthHere);
+		vsVector3D insidePost = strip->m_vertex[postI] - (offsetPost * rightWidthHere);
 
-			vsSqDistanceBetweenLineSegments( outsidePre,
-					outsidePre + dirOfTravelPre * (distanceOfTravelPre + 3.f * leftWidthHere),
-					outsidePost,
-					outsidePost - dirOfTravelPost * (distanceOfTravelPost + 3.f * leftWidthHere),
-					&closestPre, &closestPost );
+		vsSqDistanceBetweenLineSegments( insidePre,
+				insidePre + dirOfTravelPre * (distanceOfTravelPre + 3.f * rightWidthHere),
+				insidePost,
+				insidePost - dirOfTravelPost * (distanceOfTravelPost + 3.f * rightWidthHere),
+				&closestPre, &closestPost );
 
-			vertexPosition = vsInterpolate(0.5f, closestPre, closestPost);
-		}
-		else
-		{
-			vertexPosition = strip->m_vertex[midI] + offsetPre * leftWidthHere;
-		}
+		vertexPosition = vsInterpolate(0.5f, closestPre, closestPost);
+	}
+	else
+	{
+		vertexPosition = strip->m_vertex[midI] - offsetPre * rightWidthHere;
+	}
 
-		va[m_vertexCursor+2].position = vertexPosition;
-		va[m_vertexCursor+3].position = 3.0f * (vertexPosition - strip->m_vertex[midI]) + vertexPosition;
+	va[0].position = 3.0f * (vertexPosition - strip->m_vertex[midI]) + vertexPosition;
+	va[1].position = vertexPosition;
 
-		if ( strip->m_color )
-		{
-			va[m_vertexCursor+0].color = strip->m_color[i];
-			va[m_vertexCursor+1].color = strip->m_color[i];
-			va[m_vertexCursor+2].color = strip->m_color[i];
-			va[m_vertexCursor+3].color = strip->m_color[i];
-		}
-		else
-		{
-			va[m_vertexCursor+0].color = c_white;
-			va[m_vertexCursor+1].color = c_white;
-			va[m_vertexCursor+2].color = c_white;
-			va[m_vertexCursor+3].color = c_white;
-		}
-		va[m_vertexCursor+0].color.a = 0;
-		va[m_vertexCursor+3].color.a = 0;
-		va[m_vertexCursor+0].texel.Set(0.f,distance/m_texScale);
-		va[m_vertexCursor+1].texel.Set(0.f,distance/m_texScale);
-		va[m_vertexCursor+2].texel.Set(0.f,distance/m_texScale);
-		va[m_vertexCursor+3].texel.Set(0.f,distance/m_texScale);
+	if ( offsetPre != offsetPost )
+	{
+		vsVector3D closestPre, closestPost;
+		vsVector3D outsidePre = strip->m_vertex[preI] + (offsetPre * leftWidthHere);
+		vsVector3D outsidePost = strip->m_vertex[postI] + (offsetPost * leftWidthHere);
 
-		distance += distanceOfTravelPre;
+		vsSqDistanceBetweenLineSegments( outsidePre,
+				outsidePre + dirOfTravelPre * (distanceOfTravelPre + 3.f * leftWidthHere),
+				outsidePost,
+				outsidePost - dirOfTravelPost * (distanceOfTravelPost + 3.f * leftWidthHere),
+				&closestPre, &closestPost );
 
-		if ( i != strip->m_length - 1 ) // not at the end of the strip
-		{
-			for ( int i = 0; i < 3; i++ )
-			{
-				int nearMinVertex = m_vertexCursor;
-				int farMinVertex = m_vertexCursor+4;
-
-				ia[m_indexCursor+0] = nearMinVertex+0;
-				ia[m_indexCursor+1] = nearMinVertex+1;
-				ia[m_indexCursor+2] = farMinVertex+0;
-				ia[m_indexCursor+3] = farMinVertex+0;
-				ia[m_indexCursor+4] = nearMinVertex+1;
-				ia[m_indexCursor+5] = farMinVertex+1;
-
-				m_indexCursor += 6;
-				m_vertexCursor ++;
-			}
-			m_vertexCursor ++;
-		}
-		else
-			m_vertexCursor += 4;
+		vertexPosition = vsInterpolate(0.5f, closestPre, closestPost);
+	}
+	else
+	{
+		vertexPosition = strip->m_vertex[midI] + offsetPre * leftWidthHere;
 	}
 
-	if ( strip->m_loop )
+	va[2].position = vertexPosition;
+	va[3].position = 3.0f * (vertexPosition - strip->m_vertex[midI]) + vertexPosition;
+
+	vsColorPacked color = strip->m_hasColor ? strip->m_color[i] : c_white;
+	float texel = strip->m_distance[i] / view.texScale;
+	for ( int v = 0; v < 4; v++ )
 	{
-		for ( int i = 0; i < 3; i++ )
-		{
-			int nearMinVertex = m_vertexCursor+i-4;
-			int farMinVertex = startOfStripVertexCursor+i;
-
-			// and join up the end to the start.
-			ia[m_indexCursor+0] = nearMinVertex+0;
-			ia[m_indexCursor+1] = nearMinVertex+1;
-			ia[m_indexCursor+2] = farMinVertex+0;
-			ia[m_indexCursor+3] = farMinVertex+0;
-			ia[m_indexCursor+4] = nearMinVertex+1;
-			ia[m_indexCursor+5] = farMinVertex+1;
-
-			m_indexCursor += 6;
-		}
+		va[v].color = color;
+		va[v].texel.Set(0.f,texel);
 	}
+	va[0].color.a = 0;
+	va[3].color.a = 0;
 }
 
 void vsMakeOutlineFromLineStrip2D( vsArray<vsVector2D> *result, vsVector2D *point, int count, float width, bool loop )
@@ -1230,8 +1431,103 @@ void vsMakeOutlineFromLineStrip2D( vsArray<vsVector2D> *result, vsVector2D *poin
 	}
 }
 
-vsLineBuilder2D::vsLineBuilder2D()
+void
+vsLineBuilder2D::strip::Flatten()
 {
+	if ( head.IsEmpty() )
+		return;
+	vsArray<vsVector2D> joined( head.ItemCount() + vert.ItemCount() );
+	for ( int i = head.ItemCount()-1; i >= 0; i-- )
+		joined.AddItem( head[i] );
+	for ( int i = 0; i < vert.ItemCount(); i++ )
+		joined.AddItem( vert[i] );
+	vert = joined;
+	head.Clear();
+}
+
+vsLineBuilder2D::vsLineBuilder2D():
+	m_stripCount(0),
+	m_endpointCount(0)
+{
+	ReserveEndpoints(32);
+}
+
+uint32_t
+vsLineBuilder2D::HashEndpoint( const vsVector2D& v ) const
+{
+	// We join exactly matching points, so we hash the exact bits of each
+	// coordinate.  (Adding zero turns -0 into +0, which compare equal.)
+	float x = v.x + 0.f;
+	float y = v.y + 0.f;
+	uint32_t bx, by;
+	memcpy( &bx, &x, sizeof(bx) );
+	memcpy( &by, &y, sizeof(by) );
+	uint32_t hash = (bx * 2654435761u) ^ (by * 2246822519u);
+	return hash ^ (hash >> 15);
+}
+
+void
+vsLineBuilder2D::ReserveEndpoints( int count )
+{
+	int size = m_endpoint.ItemCount();
+	if ( count * 2 <= size )
+		return;
+	if ( size == 0 )
+		size = 64;
+	while ( size < count * 2 )
+		size *= 2;
+
+	vsArray<endpoint> old( m_endpoint );
+	m_endpoint.Clear();
+	m_endpoint.SetArraySize( size );
+	m_endpointCount = 0;
+	for ( int i = 0; i < old.ItemCount(); i++ )
+	{
+		if ( old[i].stripId >= 0 )
+			AddEndpoint( old[i].position, old[i].stripId, old[i].end );
+	}
+}
+
+void
+vsLineBuilder2D::AddEndpoint( const vsVector2D& v, int stripId, End whichEnd )
+{
+	ReserveEndpoints( m_endpointCount + 1 );
+
+	int mask = m_endpoint.ItemCount() - 1;
+	int slot = HashEndpoint(v) & mask;
+	while ( m_endpoint[slot].stripId >= 0 )
+		slot = (slot + 1) & mask;
+	m_endpoint[slot].position = v;
+	m_endpoint[slot].stripId = stripId;
+	m_endpoint[slot].end = whichEnd;
+	m_endpointCount++;
+}
+
+void
+vsLineBuilder2D::RemoveEndpoint( const vsVector2D& v, int stripId, End whichEnd )
+{
+	int mask = m_endpoint.ItemCount() - 1;
+	int slot = HashEndpoint(v) & mask;
+	while ( m_endpoint[slot].stripId != stripId || m_endpoint[slot].end != whichEnd )
+	{
+		vsAssert( m_endpoint[slot].stripId >= 0, "vsLineBuilder2D lost track of a strip end" );
+		slot = (slot + 1) & mask;
+	}
+
+	// Empty the slot, then pull back any later entries in its probe run
+	// which could have used it, so that lookups never stop short of them.
+	int hole = slot;
+	for ( slot = (slot + 1) & mask; m_endpoint[slot].stripId >= 0; slot = (slot + 1) & mask )
+	{
+		int home = HashEndpoint( m_endpoint[slot].position ) & mask;
+		if ( ((slot - home) & mask) >= ((slot - hole) & mask) )
+		{
+			m_endpoint[hole] = m_endpoint[slot];
+			hole = slot;
+		}
+	}
+	m_endpoint[hole].stripId = -1;
+	m_endpointCount--;
 }
 
 vsLineBuilder2D::touches
@@ -1241,28 +1537,34 @@ vsLineBuilder2D::touchesStripId( const vsVector2D& v )
 	result.stripId = -1;
 	result.end = End_Start;
 
-	for ( int i = 0; i < m_strip.ItemCount(); i++ )
+	// Several strips may end here;  take the earliest, and its start ahead
+	// of its end.  (Closed loops have no ends in the table, so are never
+	// matched.)
+	int mask = m_endpoint.ItemCount() - 1;
+	for ( int slot = HashEndpoint(v) & mask; m_endpoint[slot].stripId >= 0; slot = (slot + 1) & mask )
 	{
-		if ( m_strip[i].loop ) // if we're a closed loop, don't match against it.
+		const endpoint &e = m_endpoint[slot];
+		if ( e.position != v )
 			continue;
-
-		if ( *m_strip[i].vert.Front() == v )
+		if ( result.stripId < 0 || e.stripId < result.stripId ||
+				( e.stripId == result.stripId && e.end == End_Start ) )
 		{
-			result.stripId = i;
-			result.end = End_Start;
-			break;
-		}
-		if ( *m_strip[i].vert.Back() == v )
-		{
-			result.stripId = i;
-			result.end = End_End;
-			break;
+			result.stripId = e.stripId;
+			result.end = e.end;
 		}
 	}
 
 	return result;
 }
 
+void
+vsLineBuilder2D::AddLineSegments( const vsVector2D *point, int count )
+{
+	ReserveEndpoints( m_endpointCount + count );
+	for ( int i = 0; i+1 < count; i += 2 )
+		AddLineSegment( point[i], point[i+1] );
+}
+
 void
 vsLineBuilder2D::AddLineSegment( const vsVector2D& from, const vsVector2D& to )
 {
@@ -1283,6 +1585,9 @@ vsLineBuilder2D::AddLineSegment( const vsVector2D& from, const vsVector2D& to )
 		s.vert.AddItem(from);
 		s.vert.AddItem(to);
 		m_strip.AddItem(s);
+		m_stripCount++;
+		AddEndpoint( from, m_strip.ItemCount()-1, End_Start );
+		AddEndpoint( to, m_strip.ItemCount()-1, End_End );
 	}
 	// 2. Both points touch THE SAME STRIP
 	else if ( fromTouch.stripId == toTouch.stripId )
@@ -1290,7 +1595,10 @@ vsLineBuilder2D::AddLineSegment( const vsVector2D& from, const vsVector2D& to )
 		// we should just be closing this strip?
 		vsAssert( fromTouch.end != toTouch.end, "vsLineBuilder2D::AddLineSegment confusion" );
 
-		m_strip[fromTouch.stripId].loop = true;
+		strip &s = m_strip[fromTouch.stripId];
+		RemoveEndpoint( s.Front(), fromTouch.stripId, End_Start );
+		RemoveEndpoint( s.Back(), fromTouch.stripId, End_End );
+		s.loop = true;
 	}
 	// 3. Both points touch DIFFERENT STRIPS
 	else if ( fromTouch.stripId >= 0 && toTouch.stripId >= 0 )
@@ -1305,12 +1613,20 @@ vsLineBuilder2D::AddLineSegment( const vsVector2D& from, const vsVector2D& to )
 			laterStripId = toTouch.stripId;
 			addBackward = (toTouch.end == End_End);
 		}
-		strip held = m_strip[laterStripId];
-		//ugly!
-		vsArrayIterator<strip> it = m_strip.Begin();
-		for( int i = 0; i < laterStripId; i++ )
-			it++;
-		m_strip.RemoveItem( it );
+
+		// The later strip stays in m_strip (so that every other strip keeps
+		// its id), but is marked as removed and drops out of the table.
+		strip &later = m_strip[laterStripId];
+		RemoveEndpoint( later.Front(), laterStripId, End_Start );
+		RemoveEndpoint( later.Back(), laterStripId, End_End );
+		later.Flatten();
+		vsArray<vsVector2D> held;
+		held.Reserve( later.vert.ItemCount() );
+		for ( int i = 0; i < later.vert.ItemCount(); i++ )
+			held.AddItem( later.vert[i] );
+		later.vert.Clear();
+		later.removed = true;
+		m_stripCount--;
 
 		// Now, we're going to add our joining segment, and then the segments
 		// from the strip.
@@ -1321,16 +1637,16 @@ vsLineBuilder2D::AddLineSegment( const vsVector2D& from, const vsVector2D& to )
 
 		if ( addBackward )
 		{
-			for ( int i = held.vert.ItemCount()-2; i >= 0; i-- )
+			for ( int i = held.ItemCount()-2; i >= 0; i-- )
 			{
-				AddLineSegment( held.vert[i], held.vert[i+1] );
+				AddLineSegment( held[i], held[i+1] );
 			}
 		}
 		else
 		{
-			for ( int i = 0; i < held.vert.ItemCount()-1; i++ )
+			for ( int i = 0; i < held.ItemCount()-1; i++ )
 			{
-				AddLineSegment( held.vert[i], held.vert[i+1] );
+				AddLineSegment( held[i], held[i+1] );
 			}
 		}
 
@@ -1354,29 +1670,35 @@ vsLineBuilder2D::AddLineSegment( const vsVector2D& from, const vsVector2D& to )
 void
 vsLineBuilder2D::AddVertToStrip( const vsVector2D& v, int stripId, End whichEnd )
 {
+	strip &s = m_strip[stripId];
 	if ( whichEnd == End_Start )
 	{
-		// Ew.  We've got to prepend this.
-		m_strip[stripId].vert.SetArraySize( m_strip[stripId].vert.ItemCount()+1 );
-		for ( int i = m_strip[stripId].vert.ItemCount()-1; i > 0; i-- )
-			m_strip[stripId].vert[i] = m_strip[stripId].vert[i-1];
-
-		m_strip[stripId].vert[0] = v;
+		// prepending to 'vert' would mean moving everything in it, so we
+		// collect prepended vertices separately until we need them in order.
+		RemoveEndpoint( s.Front(), stripId, End_Start );
+		s.head.AddItem(v);
 	}
 	else
 	{
-		m_strip[stripId].vert.AddItem(v);
+		RemoveEndpoint( s.Back(), stripId, End_End );
+		s.vert.AddItem(v);
 	}
+	AddEndpoint( v, stripId, whichEnd );
 }
 
 vsFragment *
 vsLineBuilder2D::Bake( const vsString& material, float width )
 {
-	if ( m_strip.ItemCount() == 1 )
-	{
-		return vsLineStrip2D( material, &m_strip[0].vert[0], NULL, m_strip[0].vert.ItemCount(), width, m_strip[0].loop );
-	}
-	return vsLineStrip2D( material, &m_strip[0].vert[0], NULL, m_strip[0].vert.ItemCount(), width, m_strip[0].loop );
-	return NULL;
+	// merged strips are left behind in m_strip;  we bake the first strip
+	// which is still in use.
+	int first = 0;
+	while ( first < m_strip.ItemCount() && m_strip[first].removed )
+		first++;
+	if ( first == m_strip.ItemCount() )
+		return NULL;
+
+	strip &s = m_strip[first];
+	s.Flatten();
+	return vsLineStrip2D( material, &s.vert[0], NULL, s.vert.ItemCount(), width, s.loop );
 }
 
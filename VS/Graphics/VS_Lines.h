@@ -11,10 +11,15 @@
 #define VS_LINES_H
 
 #include "VS/Utils/VS_Array.h"
+#include "VS/Utils/VS_ArrayStore.h"
 #include "VS/Math/VS_Vector.h"
 #include "VS/Graphics/VS_RenderBuffer.h"
 #include "VS/Graphics/VS_Model.h"
 
+// vsLineBuilder2D joins line segments which share exact endpoints into
+// strips (and closes strips whose ends meet into loops).  The ends of the
+// open strips are kept in a hash table keyed on their positions, so that
+// joining each new segment doesn't need to look through every strip.
 class vsLineBuilder2D
 {
 	enum End
@@ -26,16 +31,40 @@ class vsLineBuilder2D
 	{
 	public:
 		vsArray<vsVector2D> vert;
+		vsArray<vsVector2D> head;	// vertices prepended to 'vert', most recent last
 		bool loop;
-		strip(): loop(false) {}
+		bool removed;	// merged into another strip
+		strip(): loop(false), removed(false) {}
+
+		const vsVector2D& Front() const { return head.IsEmpty() ? vert[0] : head[head.ItemCount()-1]; }
+		const vsVector2D& Back() const { return vert[vert.ItemCount()-1]; }
+		void Flatten();
 	};
 	vsArray<strip> m_strip;
+	int m_stripCount;
 
 	struct touches
 	{
 		int stripId;
 		End end;
 	};
+
+	// open-addressed (linear probing) hash table of open strips' ends
+	struct endpoint
+	{
+		vsVector2D position;
+		int stripId;	// -1 for an empty slot
+		End end;
+		endpoint(): position(), stripId(-1), end(End_Start) {}
+	};
+	vsArray<endpoint> m_endpoint;
+	int m_endpointCount;
+
+	uint32_t HashEndpoint( const vsVector2D& v ) const;
+	void AddEndpoint( const vsVector2D& v, int stripId, End whichEnd );
+	void RemoveEndpoint( const vsVector2D& v, int stripId, End whichEnd );
+	void ReserveEndpoints( int count );
+
 	touches touchesStripId( const vsVector2D& v );
 	void AddVertToStrip( const vsVector2D& v, int stripId, End whichEnd );
 
@@ -43,6 +72,10 @@ public:
 	vsLineBuilder2D();
 
 	void AddLineSegment( const vsVector2D& from, const vsVector2D& to );
+	// adds 'count'/2 segments, from point[0] to point[1], point[2] to point[3], etc.
+	void AddLineSegments( const vsVector2D *point, int count );
+
+	int GetStripCount() const { return m_stripCount; }
 
 	vsFragment *Bake( const vsString& material, float width );
 };
@@ -69,11 +102,21 @@ vsFragment *vsLineList3D( const vsString &material, vsVector3D *array, int count
 vsFragment *vsLineStrip3D( const vsString &material, vsVector3D *array, vsColor *carray, int count, float width, bool loop );
 vsFragment *vsLineList3D( const vsString &material, vsVector3D *array, vsColor *carray, int count, float width );
 
+class vsLines3DTessellateJob;
+
+// vsLines3D keeps the geometry it built for the last frame, and only rebuilds
+// what has changed:  strips re-added after Clear() with the same contents as
+// before keep their vertices, new strips are appended to the existing ones,
+// and everything is rebuilt only when the view (or our widths) change in a
+// way that moves the vertices.  Large rebuilds are split across the thread
+// pool's workers, and more than 65536 vertices switch the index buffer to
+// 32-bit indices.
 class vsLines3D: public vsModel
 {
 	class Strip;
 	Strip **m_strip;
 	int m_stripCount;
+	int m_allocatedStripCount;	// strips past m_stripCount are kept after Clear(), for reuse
 	int m_maxStripCount;
 
 	static float s_widthFactor;
@@ -84,16 +127,44 @@ class vsLines3D: public vsModel
 
 	vsRenderBuffer m_vertices;
 	vsRenderBuffer m_indices;
-	int m_vertexCursor;
-	int m_indexCursor;
 
 	vsVector3D m_constantViewDirection;
 	bool m_useConstantViewDirection;
 
-	void DrawStrip( vsRenderQueue *queue, Strip *strip );
+	// Everything besides the strips themselves which our vertices depend on.
+	struct View
+	{
+		vsMatrix4x4 localToView;
+		vsVector3D camPos;
+		vsVector3D constantViewDirection;
+		float fovPerPixel;
+		float tanHalfFovPerPixel;
+		float leftWidth;
+		float rightWidth;
+		float texScale;
+		bool orthographic;
+		bool widthInScreenspace;
+		bool useConstantViewDirection;
+
+		bool Matches( const View &o ) const;
+	};
+	View m_view;
+
+	// how many strips, from the first, still have correct vertices for
+	// m_view, and correct indices.
+	int m_tessellatedStripCount;
+	int m_indexedStripCount;
+	int m_uploadedVertexCount;
+	int m_uploadedIndexCount;
+
+	vsArrayStore<vsLines3DTessellateJob> m_tessellateJob;
+	friend class vsLines3DTessellateJob;
+
+	void SetStrip( vsVector3D *array, vsColor *carray, int arraySize, bool loop );
 
-	size_t GetFinalVertexCount();
-	size_t GetFinalIndexCount();
+	void Tessellate( int start, int end );
+	void TessellateRange( int start, int end );
+	void TessellateVertex( Strip *strip, int i, vsRenderBuffer::PCT *va );
 
 public:
 	vsLines3D( int maxStrips, float width = 1.f, bool screenSpaceWidth = true );
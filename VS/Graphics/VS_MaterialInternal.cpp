@@ -358,7 +358,7 @@ vsMaterialInternal::LoadFromFile( vsFile *materialFile )
 void
 vsMaterialInternal::SetShader()
 {
-	if (!m_shader && !m_shaderRef )
+	if (!m_shader && !m_shaderRef && !vsRenderer::IsHeadless() )
 	{
 		m_shader = vsRenderer_OpenGL3::Instance()->DefaultShaderFor(this);
 		m_shaderIsMine = false;
@@ -12,14 +12,18 @@
 #include "VS_ModelInstanceGroup.h"
 
 #include "VS_DisplayList.h"
+#include "VS_Frustum.h"
 #include "VS_RenderQueue.h"
 #include "VS_EulerAngles.h"
+#include "VS_TriangleBVH.h"
 
 #include "VS_File.h"
 #include "VS_Record.h"
 #include "VS_Serialiser.h"
 #include "VS_Store.h"
 
+bool vsModel::s_compileDisplayLists = false;
+vsDisplayList::CompileStats vsModel::s_compileStats = { 0, 0, 0 };
 
 vsModel *
 vsModel::Load( const vsString &filename_in )
@@ -390,6 +394,9 @@ vsModel::LoadFrom( vsRecord *record )
 		else if ( srLabel == "DisplayList" )
 		{
 			vsDisplayList *list = vsDisplayList::Load( sr );
+			vsDisplayList::CompileStats stats;
+			if ( list && s_compileDisplayLists && list->Compile( &stats ) )
+				s_compileStats += stats;
 			SetDisplayList( list );
 		}
 		else if ( srLabel == "Fragment" )
@@ -403,6 +410,8 @@ vsModel::LoadFrom( vsRecord *record )
 
 vsModel::vsModel( vsDisplayList *list ):
 	m_material(NULL),
+	m_frustumCulled(false),
+	m_collision(NULL),
 	m_instanceGroup(NULL),
 	m_displayList(list)
 {
@@ -418,6 +427,7 @@ vsModel::~vsModel()
 		vsDelete(m_displayList);
 	vsDelete( m_material );
 	vsDelete( m_instanceGroup );
+	vsDelete( m_collision );
 }
 
 void
@@ -437,6 +447,7 @@ vsModel::SetDisplayList( vsDisplayList *list )
 	m_displayList = list;
 
 	BuildBoundingBox();
+	InvalidateCollision();
 }
 
 void
@@ -445,6 +456,8 @@ vsModel::AddLodFragment( int lodLevel, vsFragment *fragment )
 	vsAssert((int)lodLevel < m_lod.ItemCount(), "Tried to add a fragment to a non-existant lod??");
 	if ( fragment )
 		m_lod[lodLevel]->fragment.AddItem( fragment );
+	if ( lodLevel == 0 )
+		InvalidateCollision();
 }
 
 void
@@ -452,12 +465,14 @@ vsModel::DestroyFragment( vsFragment *fragment )
 {
 	for ( int i = 0; i < m_lod.ItemCount(); i++ )
 		m_lod[i]->fragment.RemoveItem( fragment );
+	InvalidateCollision();
 }
 
 void
 vsModel::ClearFragments()
 {
 	m_lod[0]->fragment.Clear();
+	InvalidateCollision();
 }
 
 void
@@ -556,33 +571,36 @@ vsModel::Draw( vsRenderQueue *queue )
 				queue->PushMatrix( m_transform.GetMatrix() );
 			}
 
-			if ( m_displayList )
+			if ( !m_frustumCulled || !IsOutsideFrustum( queue ) )
 			{
-				// old rendering support
-				vsDisplayList *list = queue->GetGenericList();
-				if ( m_material )
+				if ( m_displayList )
 				{
-					list->SetMaterial( m_material );
+					// old rendering support
+					vsDisplayList *list = queue->GetGenericList();
+					if ( m_material )
+					{
+						list->SetMaterial( m_material );
+					}
+					list->SetMatrix4x4( queue->GetMatrix() );
+					list->Append( *m_displayList );
+					list->PopTransform();
+				}
+				else
+				{
+					DynamicDraw( queue );
 				}
-				list->SetMatrix4x4( queue->GetMatrix() );
-				list->Append( *m_displayList );
-				list->PopTransform();
-			}
-			else
-			{
-				DynamicDraw( queue );
-			}
 
-			if ( !m_lod[m_lodLevel]->fragment.IsEmpty() )
-			{
-				for( vsArrayStoreIterator<vsFragment> iter = m_lod[m_lodLevel]->fragment.Begin(); iter != m_lod[m_lodLevel]->fragment.End(); iter++ )
+				if ( !m_lod[m_lodLevel]->fragment.IsEmpty() )
 				{
-					if ( iter->IsVisible() )
-						queue->AddFragmentBatch( *iter );
+					for( vsArrayStoreIterator<vsFragment> iter = m_lod[m_lodLevel]->fragment.Begin(); iter != m_lod[m_lodLevel]->fragment.End(); iter++ )
+					{
+						if ( iter->IsVisible() )
+							queue->AddFragmentBatch( *iter );
+					}
 				}
-			}
 
-			DrawChildren(queue);
+				DrawChildren(queue);
+			}
 
 			if ( hasTransform )
 			{
@@ -592,6 +610,20 @@ vsModel::Draw( vsRenderQueue *queue )
 	}
 }
 
+bool
+vsModel::IsOutsideFrustum( vsRenderQueue *queue )
+{
+	const vsFrustum *frustum = queue->GetFrustum();
+	if ( !frustum )
+		return false;
+
+	// BuildBoundingBox() includes our child models, so they're culled
+	// along with us.
+	vsBox3D worldBox = m_boundingBox.TransformedBy( queue->GetMatrix() );
+	vsFrustum::Classification classification;
+	return frustum->ClassifyBoxes( &worldBox, 1, &classification ) == 0;
+}
+
 vsModelInstance *
 vsModel::MakeInstance()
 {
@@ -625,33 +657,96 @@ vsModel::GetLodFragmentCount( int lodId ) const
 	return m_lod[lodId]->fragment.ItemCount();
 }
 
+const vsTriangleBVH *
+vsModel::GetCollisionBVH()
+{
+	if ( !m_collision )
+	{
+		vsArray<vsDisplayList::Triangle> triangles;
+		if ( m_displayList )
+			m_displayList->GetTriangles(triangles);
+		for ( int i = 0; i < GetFragmentCount(); i++ )
+		{
+			m_lod[0]->fragment[i]->GetDisplayList()->GetTriangles(triangles);
+		}
+
+		m_collision = new vsTriangleBVH;
+		if ( !triangles.IsEmpty() )
+			m_collision->Build( triangles[0].vert, triangles.ItemCount() );
+	}
+	return m_collision;
+}
+
+void
+vsModel::InvalidateCollision()
+{
+	vsDelete( m_collision );
+}
+
 bool
 vsModel::CollideRay(vsVector3D *result, float *resultT, const vsVector3D &pos, const vsVector3D &dir)
 {
-	vsVector3D localPos = m_transform.ApplyInverseTo(pos);
-	vsVector3D localDir = m_transform.GetRotation().Inverse().ApplyTo(dir);
-
-	// now we need to collision test against all our triangles.
-	vsArray<vsDisplayList::Triangle> triangles;
-	if ( m_displayList )
-		m_displayList->GetTriangles(triangles);
-	for ( int i = 0; i < GetFragmentCount(); i++ )
+	// Transform both ends of the ray, so that 't' means the same thing in
+	// our local space as it does in the world, whatever our scale.
+	vsMatrix4x4 inverse = GetMatrix().Inverse();
+	vsVector3D localPos = inverse.ApplyTo(pos);
+	vsVector3D localDir = inverse.ApplyTo(pos + dir) - localPos;
+
+	vsTriangleBVH::Hit hit;
+	if ( GetCollisionBVH()->ClosestHit( localPos, localDir, 1e30f, &hit ) )
 	{
-		m_lod[0]->fragment[i]->GetDisplayList()->GetTriangles(triangles);
+		*resultT = hit.t;
+		*result = pos + dir * hit.t;
+		return true;
 	}
+	return false;
+}
+
+bool
+vsModel::CollideRayAny(const vsVector3D &pos, const vsVector3D &dir, float maxT)
+{
+	vsMatrix4x4 inverse = GetMatrix().Inverse();
+	vsVector3D localPos = inverse.ApplyTo(pos);
+	vsVector3D localDir = inverse.ApplyTo(pos + dir) - localPos;
+
+	return GetCollisionBVH()->AnyHit( localPos, localDir, maxT );
+}
+
+// Takes a batch of world space rays into our local space.  Returns the
+// rays to cast, which are the originals if we have no transform.
+static const vsTriangleBVH::Ray *
+LocalRays( const vsMatrix4x4 &matrix, const vsTriangleBVH::Ray *ray, int count, vsArray<vsTriangleBVH::Ray> &localRay )
+{
+	if ( matrix == vsMatrix4x4::Identity )
+		return ray;
 
-	for ( int i = 0; i < triangles.ItemCount(); i++ )
+	vsMatrix4x4 inverse = matrix.Inverse();
+	localRay.SetArraySize( count );
+	for ( int i = 0; i < count; i++ )
 	{
-		float u, v;
-		vsDisplayList::Triangle &t = triangles[i];
-		if ( vsCollideRayVsTriangle( localPos, localDir,
-					t.vert[0], t.vert[1], t.vert[2],
-					resultT, &u, &v ) )
-		{
-			*result = pos + dir * (*resultT);
-			return true;
-		}
+		vsTriangleBVH::Ray &local = localRay[i];
+		local.pos = inverse.ApplyTo( ray[i].pos );
+		local.dir = inverse.ApplyTo( ray[i].pos + ray[i].dir ) - local.pos;
+		local.maxT = ray[i].maxT;
 	}
-	return false;
+	return &localRay[0];
+}
+
+void
+vsModel::CollideRays(const vsTriangleBVH::Ray *ray, int count, vsTriangleBVH::Hit *hit, int threadCount)
+{
+	if ( count <= 0 )
+		return;
+	const vsTriangleBVH *bvh = GetCollisionBVH();
+	bvh->ClosestHits( LocalRays( GetMatrix(), ray, count, m_localRay ), count, hit, threadCount );
+}
+
+void
+vsModel::CollideRaysAny(const vsTriangleBVH::Ray *ray, int count, bool *hit, int threadCount)
+{
+	if ( count <= 0 )
+		return;
+	const vsTriangleBVH *bvh = GetCollisionBVH();
+	bvh->AnyHits( LocalRays( GetMatrix(), ray, count, m_localRay ), count, hit, threadCount );
 }
 
@@ -17,6 +17,7 @@
 #include "VS/Graphics/VS_Material.h"
 #include "VS/Math/VS_Box.h"
 #include "VS/Math/VS_Transform.h"
+#include "VS/Math/VS_TriangleBVH.h"
 #include "VS/Utils/VS_Array.h"
 #include "VS/Utils/VS_ArrayStore.h"
 
@@ -37,12 +38,20 @@ class vsModel : public vsEntity
 
 	vsBox3D				m_boundingBox;
 	float				m_boundingRadius;
+	bool				m_frustumCulled;
+	vsTriangleBVH *		m_collision;	// built from our triangles on the first ray query
+	vsArray<vsTriangleBVH::Ray>	m_localRay;	// scratch space for batched ray queries
+
+	bool				IsOutsideFrustum( vsRenderQueue *queue );
 
 	static vsModel* LoadModel_Internal( vsSerialiserRead& r );
 	static vsModel* LoadModel_InternalV1( vsSerialiserRead& r );
 	static vsModel* LoadModel_InternalV2( vsSerialiserRead& r );
 	static vsFragment* LoadFragment_Internal( vsSerialiserRead& r );
 
+	static bool							s_compileDisplayLists;
+	static vsDisplayList::CompileStats	s_compileStats;
+
 	vsArrayStore<vsLod> m_lod; // new-new-style rendering.
 	int m_lodLevel; // which lod am I rendering right now?  0 == 'm_fragment'.
 	vsModelInstanceGroup *m_instanceGroup;
@@ -58,6 +67,14 @@ public:
 	static vsModel *	LoadBinary( const vsString &filename );
 	static vsModel *	LoadText( const vsString &filename );
 
+	// Display lists loaded from model files are usually static, so we can
+	// compile them into GPU buffers as they're loaded.  Off by default,
+	// since a compiled list no longer holds its vertex arrays, so helpers
+	// which rewrite them (such as vsDisplayList::ApplyOffset()) can't be used
+	// on it.  The stats are totals across every model loaded so far.
+	static void			SetCompileDisplayLists( bool compile ) { s_compileDisplayLists = compile; }
+	static const vsDisplayList::CompileStats&	GetCompileStats() { return s_compileStats; }
+
 	vsModel( vsDisplayList *displayList = NULL );
 	virtual			~vsModel();
 
@@ -92,6 +109,12 @@ public:
 
 	float					GetBoundingRadius() { return m_boundingRadius; }
 
+	// If set, we (and our instances) skip drawing when our bounding box is
+	// entirely outside the 3D camera's view.  Off by default, since it
+	// relies on the bounding box being kept up to date.
+	void					SetFrustumCulled( bool culled ) { m_frustumCulled = culled; }
+	bool					IsFrustumCulled() const { return m_frustumCulled; }
+
 	void				SetTransform( const vsTransform3D &t ) { m_transform = t; }
 	const vsTransform3D&	GetTransform() const { return m_transform; }
 
@@ -116,7 +139,21 @@ public:
 	void	DrawInstanced( vsRenderQueue *list, const vsMatrix4x4* matrices, const vsColor* colors, int instanceCount, vsShaderValues *values, int lodLevel );
 	void	DrawInstanced( vsRenderQueue *list, vsRenderBuffer* matrixBuffer, vsRenderBuffer* colorBuffer, vsShaderValues *values, int lodLevel );
 
+	// Ray queries against our own display list and our lod 0 fragments.
+	// The triangles are gathered into a vsTriangleBVH on the first query and
+	// kept until our fragments change;  call InvalidateCollision() after
+	// modifying a display list we're already using.  CollideRay() finds the
+	// nearest hit;  CollideRayAny() just reports whether anything is hit
+	// within 'maxT'.  't' is measured in units of 'dir'.
 	bool		CollideRay(vsVector3D *result, float *resultT, const vsVector3D &pos, const vsVector3D &dir);
+	bool		CollideRayAny(const vsVector3D &pos, const vsVector3D &dir, float maxT);
+
+	// Batch versions, for casting many rays (in world space) at once.  See
+	// vsTriangleBVH::ClosestHits() for the meaning of 'threadCount'.
+	void		CollideRays(const vsTriangleBVH::Ray *ray, int count, vsTriangleBVH::Hit *hit, int threadCount = 0);
+	void		CollideRaysAny(const vsTriangleBVH::Ray *ray, int count, bool *hit, int threadCount = 0);
+	const vsTriangleBVH *	GetCollisionBVH();
+	void		InvalidateCollision();
 };
 
 #endif // VS_MODEL_H
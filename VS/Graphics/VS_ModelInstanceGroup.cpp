@@ -9,18 +9,74 @@
 
 #include "VS_ModelInstanceGroup.h"
 #include "VS_ModelInstance.h"
+#include "VS_Camera.h"
 #include "VS_Model.h"
+#include "VS_Frustum.h"
+#include "VS_RenderQueue.h"
+#include "VS_ThreadPool.h"
+
+static const int c_maxCulledLods = 8;
+static const int c_instanceBlockSize = 64;	// instances per dirty-tracking block
+static const int c_minInstancesPerLodJob = 4096;
+static const float c_defaultLodHysteresis = 0.1f;
+
+// One contiguous run of instances whose lods are chosen on a thread pool
+// worker.  Like the scene's gather jobs, these share data with the main
+// thread, so we keep them within its L3 cache.
+class vsModelInstanceLodJob : public vsJob
+{
+	vsModelInstanceGroup *	m_group;
+	int						m_start;
+	int						m_end;
+
+protected:
+	virtual void Execute()
+	{
+		m_group->ChooseLods( m_start, m_end );
+	}
+
+public:
+	vsModelInstanceLodJob( vsModelInstanceGroup *group ):
+		m_group(group),
+		m_start(0),
+		m_end(0)
+	{
+	}
+
+	void Choose( int start, int end )
+	{
+		m_start = start;
+		m_end = end;
+		vsThreadPool::Instance()->Submit( this, vsThreadPool::Affinity_MainThreadL3 );
+	}
+};
+
+void
+vsModelInstanceLodGroup::UploadStats::operator+=( const UploadStats &o )
+{
+	instances += o.instances;
+	drawn += o.drawn;
+	fullUploads += o.fullUploads;
+	rangeUploads += o.rangeUploads;
+	bytesUploaded += o.bytesUploaded;
+}
 
 vsModelInstanceLodGroup::vsModelInstanceLodGroup( vsModelInstanceGroup *group, vsModel *model, size_t lodLevel ):
 	m_group(group),
 	m_model(model),
 	m_lodLevel(lodLevel),
-	m_values(NULL)
+	m_values(NULL),
+	m_boundsAreDirty(true),
+	m_cullInstances(false),
+	m_spheresAreDirty(true),
+	m_drawCount(0)
 #ifdef INSTANCED_MODEL_USES_LOCAL_BUFFER
 	,
 	m_matrixBuffer(vsRenderBuffer::Type_Dynamic),
 	m_colorBuffer(vsRenderBuffer::Type_Dynamic),
-	m_bufferIsDirty(false)
+	m_bufferIsDirty(false),
+	m_uploadedCount(0),
+	m_bufferCapacity(0)
 #endif // INSTANCED_MODEL_USES_LOCAL_BUFFER
 {
 }
@@ -66,16 +122,24 @@ vsModelInstanceLodGroup::UpdateInstance( vsModelInstance *inst, bool show )
 			m_matrix.AddItem( inst->matrix );
 			m_color.AddItem( inst->color );
 			m_matrixInstanceId.AddItem( inst->index );
+			m_boundsAreDirty = true;
+			m_spheresAreDirty = true;
 #ifdef INSTANCED_MODEL_USES_LOCAL_BUFFER
 			m_bufferIsDirty = true;
+			if ( !m_cullInstances )
+				MarkDirty( inst->matrixIndex );
 #endif
 		}
 		else // we were already in view;  just update our matrix
 		{
 			m_matrix[inst->matrixIndex] = inst->matrix;
 			m_color[inst->matrixIndex] = inst->color;
+			m_boundsAreDirty = true;
+			m_spheresAreDirty = true;
 #ifdef INSTANCED_MODEL_USES_LOCAL_BUFFER
 			m_bufferIsDirty = true;
+			if ( !m_cullInstances )
+				MarkDirty( inst->matrixIndex );
 #endif
 		}
 	}
@@ -94,11 +158,17 @@ vsModelInstanceLodGroup::UpdateInstance( vsModelInstance *inst, bool show )
 			m_color[swapTo] = m_color[swapFrom];
 			m_matrixInstanceId[swapTo] = m_matrixInstanceId[swapFrom];
 			swapper->matrixIndex = swapTo;
+#ifdef INSTANCED_MODEL_USES_LOCAL_BUFFER
+			if ( !m_cullInstances )
+				MarkDirty( swapTo );
+#endif
 		}
 		m_matrix.PopBack();
 		m_color.PopBack();
 		m_matrixInstanceId.PopBack();
 		inst->matrixIndex = -1;
+		m_boundsAreDirty = true;
+		m_spheresAreDirty = true;
 #ifdef INSTANCED_MODEL_USES_LOCAL_BUFFER
 		m_bufferIsDirty = true;
 #endif
@@ -178,25 +248,204 @@ vsModelInstanceLodGroup::RemoveInstance( vsModelInstance *inst )
 	inst->lodGroup = NULL;
 }
 
+void
+vsModelInstanceLodGroup::SetCullInstances( bool cull )
+{
+	if ( cull == m_cullInstances )
+		return;
+
+	// our buffers are switching between holding every instance and holding
+	// just the visible ones, so everything in them needs replacing.
+	m_cullInstances = cull;
+	m_spheresAreDirty = true;
+	m_drawCount = 0;
+#ifdef INSTANCED_MODEL_USES_LOCAL_BUFFER
+	m_bufferIsDirty = true;
+	m_uploadedCount = 0;
+#endif // INSTANCED_MODEL_USES_LOCAL_BUFFER
+}
+
+static float
+MaxScale( const vsMatrix4x4 &m )
+{
+	float sqScale = vsMax( vsVector3D(m.x).SqLength(), vsMax( vsVector3D(m.y).SqLength(), vsVector3D(m.z).SqLength() ) );
+	return vsSqrt( sqScale );
+}
+
+void
+vsModelInstanceLodGroup::BuildSpheres( const vsMatrix4x4 &queueMatrix )
+{
+	const vsBox3D &box = m_model->GetBoundingBox();
+	vsVector3D middle = box.Middle();
+	float radius = box.Extents().Length() * 0.5f;
+	bool transformed = ( queueMatrix != vsMatrix4x4::Identity );
+	if ( transformed )
+		radius *= MaxScale( queueMatrix );
+
+	m_sphere.SetArraySize( m_matrix.ItemCount() );
+	for ( int i = 0; i < m_matrix.ItemCount(); i++ )
+	{
+		vsVector3D center = m_matrix[i].ApplyTo( middle );
+		if ( transformed )
+			center = queueMatrix.ApplyTo( center );
+		m_sphere[i] = vsVector4D( center, radius * MaxScale( m_matrix[i] ) );
+	}
+	m_sphereMatrix = queueMatrix;
+	m_spheresAreDirty = false;
+}
+
+void
+vsModelInstanceLodGroup::CullInstances( const vsFrustum *frustum )
+{
+	int count = m_matrix.ItemCount();
+	if ( frustum )
+	{
+		m_cullResult.SetArraySize( count );
+		frustum->ClassifySpheres( &m_sphere[0], count, &m_cullResult[0] );
+	}
+	if ( m_drawMatrix.ItemCount() < count )
+	{
+		m_drawMatrix.SetArraySize( count );
+		m_drawColor.SetArraySize( count );
+	}
+
+	// compact the survivors to the front of m_drawMatrix and m_drawColor,
+	// only writing (and marking dirty) the entries which actually change.
+	int drawn = 0;
+	for ( int i = 0; i < count; i++ )
+	{
+		if ( frustum && m_cullResult[i] == vsFrustum::Outside )
+			continue;
+
+		if ( memcmp( &m_drawMatrix[drawn], &m_matrix[i], sizeof(vsMatrix4x4) ) != 0 ||
+				memcmp( &m_drawColor[drawn], &m_color[i], sizeof(vsColor) ) != 0 )
+		{
+			m_drawMatrix[drawn] = m_matrix[i];
+			m_drawColor[drawn] = m_color[i];
+#ifdef INSTANCED_MODEL_USES_LOCAL_BUFFER
+			MarkDirty( drawn );
+#endif // INSTANCED_MODEL_USES_LOCAL_BUFFER
+		}
+		drawn++;
+	}
+	m_drawCount = drawn;
+}
+
+#ifdef INSTANCED_MODEL_USES_LOCAL_BUFFER
+void
+vsModelInstanceLodGroup::MarkDirty( int index )
+{
+	int block = index / c_instanceBlockSize;
+	while ( m_dirtyBlock.ItemCount() <= block )
+		m_dirtyBlock.AddItem( false );
+	m_dirtyBlock[block] = true;
+}
+
+void
+vsModelInstanceLodGroup::UploadInstances( const vsMatrix4x4 *matrix, const vsColor *color, int count )
+{
+	const size_t instanceBytes = sizeof(vsMatrix4x4) + sizeof(vsColor);
+	int blockCount = (count + c_instanceBlockSize - 1) / c_instanceBlockSize;
+
+	// anything beyond what we uploaded last time is new.
+	if ( count > m_uploadedCount )
+		MarkDirty( count - 1 );
+	for ( int b = m_uploadedCount / c_instanceBlockSize; b < blockCount; b++ )
+		m_dirtyBlock[b] = true;
+
+	int dirtyBlocks = 0;
+	for ( int b = 0; b < blockCount; b++ )
+	{
+		if ( m_dirtyBlock[b] )
+			dirtyBlocks++;
+	}
+
+	if ( count > m_bufferCapacity || dirtyBlocks * 2 > blockCount )
+	{
+		// the GPU buffers need to grow, or most of them changed anyway;  just
+		// send everything.
+		m_matrixBuffer.SetArray( matrix, count );
+		m_colorBuffer.SetArray( color, count );
+		m_bufferCapacity = vsMax( m_bufferCapacity, count );
+		m_uploadStats.fullUploads++;
+		m_uploadStats.bytesUploaded += count * instanceBytes;
+	}
+	else
+	{
+		if ( count != m_uploadedCount )
+		{
+			m_matrixBuffer.ResizeArray( count * sizeof(vsMatrix4x4) );
+			m_colorBuffer.ResizeArray( count * sizeof(vsColor) );
+		}
+
+		// upload each run of consecutive dirty blocks in one go.
+		int b = 0;
+		while ( b < blockCount )
+		{
+			if ( !m_dirtyBlock[b] )
+			{
+				b++;
+				continue;
+			}
+			int end = b;
+			while ( end < blockCount && m_dirtyBlock[end] )
+				end++;
+
+			int start = b * c_instanceBlockSize;
+			int spanCount = vsMin( end * c_instanceBlockSize, count ) - start;
+			m_matrixBuffer.SetArrayRange( matrix + start, start, spanCount );
+			m_colorBuffer.SetArrayRange( color + start, start, spanCount );
+			m_uploadStats.rangeUploads++;
+			m_uploadStats.bytesUploaded += spanCount * instanceBytes;
+			b = end;
+		}
+	}
+
+	for ( int i = 0; i < m_dirtyBlock.ItemCount(); i++ )
+		m_dirtyBlock[i] = false;
+	m_uploadedCount = count;
+}
+#endif // INSTANCED_MODEL_USES_LOCAL_BUFFER
+
 void
 vsModelInstanceLodGroup::Draw( vsRenderQueue *queue )
 {
+	m_uploadStats = UploadStats();
 	if ( m_matrix.IsEmpty() )
 		return;
 
+	const vsMatrix4x4 *matrix = &m_matrix[0];
+	const vsColor *color = &m_color[0];
+	int count = m_matrix.ItemCount();
+	m_uploadStats.instances = count;
+
+	if ( m_cullInstances )
+	{
+		const vsFrustum *frustum = queue->GetFrustum();
+		if ( frustum && ( m_spheresAreDirty || m_sphereMatrix != queue->GetMatrix() ) )
+			BuildSpheres( queue->GetMatrix() );
+		CullInstances( frustum );
+
+		count = m_drawCount;
+		if ( count == 0 )
+			return;
+		matrix = &m_drawMatrix[0];
+		color = &m_drawColor[0];
+	}
+	m_uploadStats.drawn = count;
+
 	// int preLodLevel = m_model->GetLodLevel();
 	// m_model->SetLodLevel( m_lodLevel );
 #ifdef INSTANCED_MODEL_USES_LOCAL_BUFFER
-	if ( m_bufferIsDirty )
+	if ( m_bufferIsDirty || m_cullInstances )
 	{
 		vsAssert(m_matrix.ItemCount() == m_color.ItemCount(), "Non-equal instance buffers??");
-		m_matrixBuffer.SetArray(&m_matrix[0], m_matrix.ItemCount() );
-		m_colorBuffer.SetArray(&m_color[0], m_color.ItemCount() );
+		UploadInstances( matrix, color, count );
 		m_bufferIsDirty = false;
 	}
 	m_model->DrawInstanced( queue, &m_matrixBuffer, &m_colorBuffer, m_values, m_lodLevel );
 #else
-	m_model->DrawInstanced( queue, &m_matrix[0], &m_color[0], m_matrix.ItemCount(), m_values, m_lodLevel );
+	m_model->DrawInstanced( queue, matrix, color, count, m_values, m_lodLevel );
 #endif // INSTANCED_MODEL_USES_LOCAL_BUFFER
 
 	// m_model->SetLodLevel( preLodLevel );
@@ -225,14 +474,37 @@ vsModelInstanceLodGroup::CalculateBounds( vsBox3D& out )
 	}
 }
 
+const vsBox3D&
+vsModelInstanceLodGroup::GetBounds()
+{
+	if ( m_boundsAreDirty )
+	{
+		CalculateBounds( m_bounds );
+		m_boundsAreDirty = false;
+	}
+	return m_bounds;
+}
+
 vsModelInstanceGroup::vsModelInstanceGroup( vsModel *model ):
 	m_model( model ),
-	m_lod( model->GetLodCount() )
+	m_lod( model->GetLodCount() ),
+	m_lodHysteresis( c_defaultLodHysteresis ),
+	m_lodMigrations( 0 ),
+	m_lodSizeScale( 0.f ),
+	m_lodOrthographic( false )
 {
 	for ( int i = 0; i < model->GetLodCount(); i++ )
 	{
 		m_lod.AddItem( new vsModelInstanceLodGroup(this, model,i) );
+		m_lodScreenSize.AddItem( 0.f );
 	}
+
+	// Draw() uploads our instance buffers, and chooses lods with jobs.
+	SetDrawOnMainThread(true);
+}
+
+vsModelInstanceGroup::~vsModelInstanceGroup()
+{
 }
 
 void
@@ -350,9 +622,168 @@ vsModelInstanceGroup::CalculateBounds( vsBox3D& out )
 	}
 }
 
+void
+vsModelInstanceGroup::SetCullInstances( bool cull )
+{
+	for ( int i = 0; i < m_lod.ItemCount(); i++ )
+	{
+		m_lod[i]->SetCullInstances(cull);
+	}
+}
+
+vsModelInstanceLodGroup::UploadStats
+vsModelInstanceGroup::GetUploadStats()
+{
+	vsModelInstanceLodGroup::UploadStats result;
+	for ( int i = 0; i < m_lod.ItemCount(); i++ )
+	{
+		result += m_lod[i]->GetUploadStats();
+	}
+	return result;
+}
+
+void
+vsModelInstanceGroup::SetLodScreenSize( int lod, float screenSize )
+{
+	vsAssert( lod > 0 && lod < m_lodScreenSize.ItemCount(), "Requested invalid lod level?" );
+	m_lodScreenSize[lod] = screenSize;
+}
+
+void
+vsModelInstanceGroup::ChooseLods( int start, int end )
+{
+	const vsBox3D &box = m_model->GetBoundingBox();
+	vsVector3D middle = box.Middle();
+	float radius = box.Extents().Length() * 0.5f;
+	int lodCount = m_lodScreenSize.ItemCount();
+	const float *threshold = &m_lodScreenSize[0];
+	float shrink = 1.f - m_lodHysteresis;
+	float grow = 1.f + m_lodHysteresis;
+
+	for ( int i = start; i < end; i++ )
+	{
+		const vsModelInstance *inst = m_lodInstance[i];
+		const vsMatrix4x4 &m = inst->matrix;
+		float size = radius * MaxScale(m) * m_lodSizeScale;
+		if ( !m_lodOrthographic )
+		{
+			float distance = (m.ApplyTo(middle) - m_lodCameraPosition).Length();
+			size = ( distance > radius ) ? size / distance : 1.f;
+		}
+
+		// the lod we'd use if there were no hysteresis
+		int lod = 0;
+		while ( lod+1 < lodCount && size < threshold[lod+1] )
+			lod++;
+
+		// only cross thresholds we're clearly past
+		int current = (int)inst->lodLevel;
+		while ( lod > current && size >= threshold[lod] * shrink )
+			lod--;
+		while ( lod < current && size <= threshold[lod+1] * grow )
+			lod++;
+
+		m_lodChoice[i] = lod;
+	}
+}
+
+void
+vsModelInstanceGroup::UpdateLods( const vsCamera3D *camera )
+{
+	m_lodMigrations = 0;
+	if ( m_lod.ItemCount() <= 1 )
+		return;
+
+	m_lodInstance.Clear();
+	for ( int i = 0; i < m_lod.ItemCount(); i++ )
+	{
+		const vsArray<vsModelInstance*> &instance = m_lod[i]->m_instance;
+		for ( int j = 0; j < instance.ItemCount(); j++ )
+			m_lodInstance.AddItem( instance[j] );
+	}
+	int instanceCount = m_lodInstance.ItemCount();
+	if ( instanceCount == 0 )
+		return;
+	m_lodChoice.SetArraySize( instanceCount );
+
+	// screen size is the sphere's diameter over the height of the view;  for
+	// a perspective camera that height is measured at the instance's distance.
+	m_lodCameraPosition = camera->GetPosition();
+	m_lodOrthographic = ( camera->GetProjectionType() == vsCamera3D::PT_Orthographic );
+	if ( m_lodOrthographic )
+		m_lodSizeScale = 2.f / camera->GetFieldOfView();
+	else
+		m_lodSizeScale = 1.f / vsTan( camera->GetFieldOfView() * 0.5f );
+
+	int workerCount = vsThreadPool::Instance()->GetWorkerCount( vsThreadPool::Affinity_MainThreadL3 );
+	int runCount = vsMax( 1, vsMin( workerCount + 1, instanceCount / c_minInstancesPerLodJob ) );
+	for ( int i = m_lodJob.ItemCount(); i < runCount-1; i++ )
+	{
+		m_lodJob.AddItem( new vsModelInstanceLodJob(this) );
+	}
+	for ( int i = 1; i < runCount; i++ )
+	{
+		m_lodJob[i-1]->Choose( (instanceCount * i) / runCount, (instanceCount * (i+1)) / runCount );
+	}
+	ChooseLods( 0, instanceCount / runCount );
+	for ( int i = 1; i < runCount; i++ )
+	{
+		m_lodJob[i-1]->Wait();
+	}
+
+	// Now move everything which changed.  Pulling all of the movers out
+	// before adding any of them back means each lod group only reshuffles
+	// its own arrays once per mover, and the new arrivals land together at
+	// the ends of their new lod groups' arrays.
+	int moved = 0;
+	for ( int i = 0; i < instanceCount; i++ )
+	{
+		vsModelInstance *inst = m_lodInstance[i];
+		if ( m_lodChoice[i] != (int)inst->lodLevel )
+		{
+			inst->lodGroup->RemoveInstance( inst );
+			m_lodInstance[moved] = inst;
+			m_lodChoice[moved] = m_lodChoice[i];
+			moved++;
+		}
+	}
+	for ( int i = 0; i < moved; i++ )
+	{
+		m_lod[ m_lodChoice[i] ]->AddInstance( m_lodInstance[i] );
+	}
+	m_lodMigrations = moved;
+}
+
 void
 vsModelInstanceGroup::Draw( vsRenderQueue *queue )
 {
+	for ( int i = 0; i < m_lod.ItemCount(); i++ )
+	{
+		m_lod[i]->ClearUploadStats();
+	}
+
+	const vsFrustum *frustum = m_model->IsFrustumCulled() ? queue->GetFrustum() : NULL;
+	if ( frustum )
+	{
+		// classify every lod's instances at once, by the bounds of all of
+		// that lod's visible instances.
+		vsBox3D box[c_maxCulledLods];
+		vsFrustum::Classification classification[c_maxCulledLods];
+		for ( int start = 0; start < m_lod.ItemCount(); start += c_maxCulledLods )
+		{
+			int count = vsMin( c_maxCulledLods, m_lod.ItemCount() - start );
+			for ( int i = 0; i < count; i++ )
+				box[i] = m_lod[start+i]->GetBounds().TransformedBy( queue->GetMatrix() );
+			frustum->ClassifyBoxes( box, count, classification );
+			for ( int i = 0; i < count; i++ )
+			{
+				if ( classification[i] != vsFrustum::Outside )
+					m_lod[start+i]->Draw(queue);
+			}
+		}
+		return;
+	}
+
 	for ( int i = 0; i < m_lod.ItemCount(); i++ )
 	{
 		m_lod[i]->Draw(queue);
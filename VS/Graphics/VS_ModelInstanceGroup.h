@@ -11,6 +11,7 @@
 #define VS_MODELINSTANCEGROUP_H
 
 #include "VS/Math/VS_Box.h"
+#include "VS/Math/VS_Frustum.h"
 #include "VS/Math/VS_Matrix.h"
 #include "VS/Graphics/VS_Color.h"
 #include "VS/Graphics/VS_Entity.h"
@@ -18,6 +19,7 @@
 #include "VS/Utils/VS_Array.h"
 #include "VS/Utils/VS_ArrayStore.h"
 
+class vsCamera3D;
 class vsModel;
 struct vsModelInstance;
 class vsModelInstanceGroup;
@@ -27,6 +29,29 @@ class vsShaderValues;
 
 class vsModelInstanceLodGroup : public vsEntity
 {
+public:
+	// What the last Draw() sent to the GPU.
+	struct UploadStats
+	{
+		int instances;			// visible instances
+		int drawn;				// ..of which, how many survived frustum culling
+		int fullUploads;		// times the whole buffer was re-uploaded
+		int rangeUploads;		// times just a dirty span was uploaded
+		size_t bytesUploaded;	// matrices and colors
+
+		UploadStats():
+			instances(0),
+			drawn(0),
+			fullUploads(0),
+			rangeUploads(0),
+			bytesUploaded(0)
+		{
+		}
+
+		void operator+=( const UploadStats &o );
+	};
+
+private:
 	vsModelInstanceGroup *m_group; // what group am a part of
 	vsModel *m_model;
 	size_t m_lodLevel;
@@ -35,11 +60,43 @@ class vsModelInstanceLodGroup : public vsEntity
 	vsArray<vsColor> m_color;
 	vsArray<int> m_matrixInstanceId;
 	vsArray<vsModelInstance*> m_instance;
+	vsBox3D m_bounds;
+	bool m_boundsAreDirty;
+
+	// Per-instance frustum culling.  Each visible instance's bounding sphere
+	// is rebuilt when instances change (or when the queue's matrix does),
+	// and the instances which pass are compacted into m_drawMatrix and
+	// m_drawColor.  Those keep their contents between frames, so we can
+	// tell which parts of them actually changed.
+	bool m_cullInstances;
+	bool m_spheresAreDirty;
+	vsMatrix4x4 m_sphereMatrix;
+	vsArray<vsVector4D> m_sphere;
+	vsArray<vsFrustum::Classification> m_cullResult;
+	vsArray<vsMatrix4x4> m_drawMatrix;
+	vsArray<vsColor> m_drawColor;
+	int m_drawCount;
+
+	UploadStats m_uploadStats;
+
+	void BuildSpheres( const vsMatrix4x4 &queueMatrix );
+	void CullInstances( const vsFrustum *frustum );
 #ifdef INSTANCED_MODEL_USES_LOCAL_BUFFER
 	vsRenderBuffer m_matrixBuffer;
 	vsRenderBuffer m_colorBuffer;
 	bool m_bufferIsDirty;
+
+	// The buffers are tracked as blocks of instances, and only blocks which
+	// changed since we last uploaded are sent again.
+	vsArray<bool> m_dirtyBlock;
+	int m_uploadedCount;	// instances in the buffers after our last upload
+	int m_bufferCapacity;	// instances the GPU buffers have room for
+
+	void MarkDirty( int index );
+	void UploadInstances( const vsMatrix4x4 *matrix, const vsColor *color, int count );
 #endif // INSTANCED_MODEL_USES_LOCAL_BUFFER
+
+	friend class vsModelInstanceGroup;
 public:
 
 	vsModelInstanceLodGroup( vsModelInstanceGroup *group, vsModel *model, size_t lodLevel );
@@ -59,17 +116,48 @@ public:
 	// find the bounds of our matrix translations.
 	void CalculateMatrixBounds( vsBox3D& out );
 	void CalculateBounds( vsBox3D& out );
+	const vsBox3D& GetBounds(); // CalculateBounds(), cached until an instance changes
+
+	// If set, each instance is tested against the 3D camera's frustum using
+	// its model's bounding box, and only the instances in view are drawn.
+	void SetCullInstances( bool cull );
+	bool IsCullingInstances() const { return m_cullInstances; }
+
+	void ClearUploadStats() { m_uploadStats = UploadStats(); }
+	const UploadStats& GetUploadStats() const { return m_uploadStats; }
 
 	virtual void Draw( vsRenderQueue *queue );
 };
 
+class vsModelInstanceLodJob;
+
 class vsModelInstanceGroup: public vsEntity
 {
 	vsModel *m_model;
 	vsArrayStore<vsModelInstanceLodGroup> m_lod;
+
+	// Automatic lod selection.  m_lodScreenSize[i] is the screen size below
+	// which lod 'i' should be used;  m_lodScreenSize[0] is unused.
+	vsArray<float> m_lodScreenSize;
+	float m_lodHysteresis;
+	int m_lodMigrations;
+
+	// Scratch space for UpdateLods().  Every instance we own is gathered into
+	// m_lodInstance, and each one's chosen lod is written into the matching
+	// slot of m_lodChoice (possibly on a thread pool worker).
+	vsArray<vsModelInstance*> m_lodInstance;
+	vsArray<int> m_lodChoice;
+	vsArrayStore<vsModelInstanceLodJob> m_lodJob;
+	vsVector3D m_lodCameraPosition;
+	float m_lodSizeScale;		// converts radius/distance into screen size
+	bool m_lodOrthographic;
+
+	void ChooseLods( int start, int end );
+	friend class vsModelInstanceLodJob;
 public:
 
 	vsModelInstanceGroup( vsModel *model );
+	virtual ~vsModelInstanceGroup();
 
 	void TakeInstancesFromGroup( vsModelInstanceGroup *otherGroup );
 	void SetShaderValues( vsShaderValues *values );
@@ -86,6 +174,28 @@ public:
 	void CalculateMatrixBounds( vsBox3D& out );
 	void CalculateBounds( vsBox3D& out );
 
+	void SetCullInstances( bool cull );
+	vsModelInstanceLodGroup::UploadStats GetUploadStats(); // totals across all our lods
+
+	// Screen size is the fraction of the screen's height covered by an
+	// instance's bounding sphere.  Instances smaller than lod 'lod's screen
+	// size use that lod (or a coarser one);  sizes should shrink as lods get
+	// coarser.  A lod with no screen size set is never chosen automatically.
+	void SetLodScreenSize( int lod, float screenSize );
+	float GetLodScreenSize( int lod ) const { return m_lodScreenSize[lod]; }
+
+	// To stop instances flickering between two lods when they sit right at a
+	// threshold, an instance only changes lod once its size is this fraction
+	// past the threshold.  Defaults to 0.1.
+	void SetLodHysteresis( float fraction ) { m_lodHysteresis = fraction; }
+
+	// Chooses a lod for every instance from its size as seen by 'camera', and
+	// moves the instances which need to change.  Instance matrices are treated
+	// as world space.  Call once per frame from the main thread, before
+	// drawing;  large groups are split across the thread pool.
+	void UpdateLods( const vsCamera3D *camera );
+	int GetLodMigrations() const { return m_lodMigrations; } // instances moved by the last UpdateLods()
+
 	virtual void Draw( vsRenderQueue *queue );
 };
 
@@ -10,9 +10,11 @@
 #include "VS_RenderBuffer.h"
 
 #include "VS_RendererState.h"
+#include "VS_RenderStats.h"
 
 #include "VS_OpenGL.h"
 #include "VS_Profile.h"
+#include "VS_ThreadPool.h"
 
 
 #define POS_ATTRIBUTE (0)
@@ -49,6 +51,7 @@ vsRenderBuffer::vsRenderBuffer(vsRenderBuffer::Type type):
 #if !TARGET_OS_IPHONE
 	if ( glGenBuffers && m_type != Type_NoVBO )
 	{
+		vsAssert( !vsThreadPool::IsWorkerThread(), "Created a GPU buffer from a thread pool worker;  did an entity drawn by a parallel gather forget SetDrawOnMainThread()?" );
 		glGenBuffers(1, (GLuint*)&m_bufferID);
 		m_vbo = true;
 	}
@@ -128,11 +131,13 @@ vsRenderBuffer::SetArray_Internal( char *data, int size, vsRenderBuffer::BindTyp
 
 	if ( m_vbo )
 	{
+		vsAssert( !vsThreadPool::IsWorkerThread(), "Uploaded a GPU buffer from a thread pool worker;  did an entity drawn by a parallel gather forget SetDrawOnMainThread()?" );
 		glBindBuffer(bindPoint, m_bufferID);
 
 		if ( size > m_glArrayBytes )
 		{
 			glBufferData(bindPoint, size, data, s_glBufferType[m_type]);
+			vsRenderStats::CountBufferData( size );
 			m_glArrayBytes = size;
 		}
 		else
@@ -140,6 +145,7 @@ vsRenderBuffer::SetArray_Internal( char *data, int size, vsRenderBuffer::BindTyp
 			// glBufferData(bindPoint, size, NULL, s_glBufferType[m_type]);
 			// glBufferData(bindPoint, size, data, s_glBufferType[m_type]);
 			void *ptr = glMapBufferRange(bindPoint, 0, m_glArrayBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			vsRenderStats::CountMapBufferRange( m_glArrayBytes );
 
 			if ( ptr )
 			{
@@ -161,6 +167,42 @@ vsRenderBuffer::SetArray_Internal( char *data, int size, vsRenderBuffer::BindTyp
 	}
 }
 
+void
+vsRenderBuffer::SetArrayRange_Internal( const char *data, int startByte, int bytes, vsRenderBuffer::BindType bindType )
+{
+	vsAssert( startByte >= 0 && startByte + bytes <= m_activeBytes, "Tried to set a range outside of the GPU buffer!" );
+
+	memcpy( m_array + startByte, data, bytes );
+
+	if ( m_vbo )
+	{
+		if ( m_activeBytes > m_glArrayBytes )
+		{
+			// the GL buffer hasn't got room for everything yet, so we need to
+			// upload the whole array anyway.
+			SetArray_Internal( m_array, m_activeBytes, bindType );
+			return;
+		}
+
+		int bindPoints[BindType_MAX] =
+		{
+			GL_ARRAY_BUFFER,
+			GL_ELEMENT_ARRAY_BUFFER,
+			GL_TEXTURE_BUFFER
+		};
+		int bindPoint = bindPoints[bindType];
+		m_bindType = bindType;
+
+		vsAssert( !vsThreadPool::IsWorkerThread(), "Uploaded a GPU buffer from a thread pool worker;  did an entity drawn by a parallel gather forget SetDrawOnMainThread()?" );
+		glBindBuffer(bindPoint, m_bufferID);
+		glBufferSubData(bindPoint, startByte, bytes, data);
+		vsRenderStats::CountBufferData( bytes );
+#ifdef VS_PRISTINE_BINDINGS
+		glBindBuffer(bindPoint, 0);
+#endif
+	}
+}
+
 void
 vsRenderBuffer::SetArray( const vsRenderBuffer::P *array, int size )
 {
@@ -232,6 +274,20 @@ vsRenderBuffer::SetArray( const vsMatrix4x4 *array, int size )
 	SetArray_Internal((char *)array, size*sizeof(vsMatrix4x4), BindType_Array);
 }
 
+void
+vsRenderBuffer::SetArrayRange( const vsMatrix4x4 *array, int start, int count )
+{
+	m_contentType = ContentType_Matrix;
+	SetArrayRange_Internal((const char *)array, start*sizeof(vsMatrix4x4), count*sizeof(vsMatrix4x4), BindType_Array);
+}
+
+void
+vsRenderBuffer::SetArrayRange( const vsColor *array, int start, int count )
+{
+	m_contentType = ContentType_Color;
+	SetArrayRange_Internal((const char *)array, start*sizeof(vsColor), count*sizeof(vsColor), BindType_Array);
+}
+
 void
 vsRenderBuffer::SetArray( const vsVector3D *array, int size )
 {
@@ -308,9 +364,17 @@ vsRenderBuffer::SetColorArraySize( int size )
 void
 vsRenderBuffer::SetIntArraySize( int size )
 {
+	m_contentType = ContentType_UInt16;
 	SetArraySize_Internal(size*sizeof(uint16_t));
 }
 
+void
+vsRenderBuffer::SetUInt32ArraySize( int size )
+{
+	m_contentType = ContentType_UInt32;
+	SetArraySize_Internal(size*sizeof(uint32_t));
+}
+
 void
 vsRenderBuffer::BakeArray()
 {
@@ -995,6 +1059,12 @@ vsRenderBuffer::GetColor(int i)
 }
 
 
+static GLenum
+IndexType( vsRenderBuffer::ContentType contentType )
+{
+	return contentType == vsRenderBuffer::ContentType_UInt32 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+}
+
 void
 vsRenderBuffer::TriStripBuffer(int instanceCount)
 {
@@ -1003,7 +1073,7 @@ vsRenderBuffer::TriStripBuffer(int instanceCount)
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufferID);
 		//glDrawElements(GL_TRIANGLE_STRIP, m_activeBytes/sizeof(int), GL_UNSIGNED_INT, 0);
 		// glDrawElements(GL_TRIANGLE_STRIP, m_activeBytes/sizeof(uint16_t), GL_UNSIGNED_SHORT, 0 );
-		glDrawElementsInstanced(GL_TRIANGLE_STRIP, m_activeBytes/sizeof(uint16_t), GL_UNSIGNED_SHORT, 0, instanceCount);
+		glDrawElementsInstanced(GL_TRIANGLE_STRIP, GetIntArraySize(), IndexType(m_contentType), 0, instanceCount);
 #ifdef VS_PRISTINE_BINDINGS
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 #endif // VS_PRISTINE_BINDINGS
@@ -1011,7 +1081,7 @@ vsRenderBuffer::TriStripBuffer(int instanceCount)
 	else
 	{
 		// glDrawElements(GL_TRIANGLE_STRIP, m_activeBytes/sizeof(uint16_t), GL_UNSIGNED_SHORT, m_array );
-		DrawElementsImmediate( GL_TRIANGLE_STRIP, m_array, m_activeBytes/sizeof(uint16_t), instanceCount );
+		DrawElementsImmediate( GL_TRIANGLE_STRIP, m_array, GetIntArraySize(), instanceCount, GetIndexBytes() );
 	}
 }
 
@@ -1020,7 +1090,7 @@ vsRenderBuffer::TriListBuffer(int instanceCount)
 {
 	if ( m_vbo )
 	{
-		int elements = m_activeBytes/sizeof(uint16_t);
+		int elements = GetIntArraySize();
 		// vsString prf;// = "TriListBuffer";
 		// if ( elements <= 6 )
 		// 	prf = "TriListBufferTiny";
@@ -1034,11 +1104,11 @@ vsRenderBuffer::TriListBuffer(int instanceCount)
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufferID);
 		if ( instanceCount == 1 )
 		{
-			glDrawElements(GL_TRIANGLES, elements, GL_UNSIGNED_SHORT, 0);
+			glDrawElements(GL_TRIANGLES, elements, IndexType(m_contentType), 0);
 		}
 		else
 		{
-			glDrawElementsInstanced(GL_TRIANGLES, elements, GL_UNSIGNED_SHORT, 0, instanceCount);
+			glDrawElementsInstanced(GL_TRIANGLES, elements, IndexType(m_contentType), 0, instanceCount);
 		}
 		// }
 		//glDrawRangeElements(GL_TRIANGLES, 0, m_activeBytes/sizeof(uint16_t), m_activeBytes/sizeof(uint16_t), GL_UNSIGNED_SHORT, 0);
@@ -1047,7 +1117,7 @@ vsRenderBuffer::TriListBuffer(int instanceCount)
 	else
 	{
 		// glDrawElements(GL_TRIANGLES, m_activeBytes/sizeof(uint16_t), GL_UNSIGNED_SHORT, m_array );
-		DrawElementsImmediate( GL_TRIANGLES, m_array, m_activeBytes/sizeof(uint16_t), instanceCount );
+		DrawElementsImmediate( GL_TRIANGLES, m_array, GetIntArraySize(), instanceCount, GetIndexBytes() );
 	}
 }
 
@@ -1058,13 +1128,13 @@ vsRenderBuffer::TriFanBuffer(int instanceCount)
 	{
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufferID);
 		// glDrawElements(GL_TRIANGLE_FAN, m_activeBytes/sizeof(uint16_t), GL_UNSIGNED_SHORT, 0);
-		glDrawElementsInstanced(GL_TRIANGLE_FAN, m_activeBytes/sizeof(uint16_t), GL_UNSIGNED_SHORT, 0, instanceCount);
+		glDrawElementsInstanced(GL_TRIANGLE_FAN, GetIntArraySize(), IndexType(m_contentType), 0, instanceCount);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 	else
 	{
 		// glDrawElements(GL_TRIANGLE_FAN, m_activeBytes/sizeof(uint16_t), GL_UNSIGNED_SHORT, m_array );
-		DrawElementsImmediate( GL_TRIANGLE_FAN, m_array, m_activeBytes/sizeof(uint16_t), instanceCount );
+		DrawElementsImmediate( GL_TRIANGLE_FAN, m_array, GetIntArraySize(), instanceCount, GetIndexBytes() );
 	}
 }
 
@@ -1074,13 +1144,13 @@ vsRenderBuffer::LineStripBuffer(int instanceCount)
 	if ( m_vbo )
 	{
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufferID);
-		glDrawElementsInstanced(GL_LINE_STRIP, m_activeBytes/sizeof(uint16_t), GL_UNSIGNED_SHORT, 0, instanceCount);
+		glDrawElementsInstanced(GL_LINE_STRIP, GetIntArraySize(), IndexType(m_contentType), 0, instanceCount);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 	else
 	{
 		// glDrawElements(GL_LINE_STRIP, m_activeBytes/sizeof(uint16_t), GL_UNSIGNED_SHORT, m_array );
-		DrawElementsImmediate( GL_LINE_STRIP, m_array, m_activeBytes/sizeof(uint16_t), instanceCount );
+		DrawElementsImmediate( GL_LINE_STRIP, m_array, GetIntArraySize(), instanceCount, GetIndexBytes() );
 	}
 }
 
@@ -1090,13 +1160,13 @@ vsRenderBuffer::LineListBuffer(int instanceCount)
 	if ( m_vbo )
 	{
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufferID);
-		glDrawElementsInstanced(GL_LINES, m_activeBytes/sizeof(uint16_t), GL_UNSIGNED_SHORT, 0, instanceCount);
+		glDrawElementsInstanced(GL_LINES, GetIntArraySize(), IndexType(m_contentType), 0, instanceCount);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 	else
 	{
 		// glDrawElements(GL_LINES, m_activeBytes/sizeof(uint16_t), GL_UNSIGNED_SHORT, m_array );
-		DrawElementsImmediate( GL_LINES, m_array, m_activeBytes/sizeof(uint16_t), instanceCount );
+		DrawElementsImmediate( GL_LINES, m_array, GetIntArraySize(), instanceCount, GetIndexBytes() );
 	}
 }
 
@@ -1124,6 +1194,7 @@ vsRenderBuffer::BindArrayToAttribute( void* buffer, size_t bufferSize, int attri
 		g_vboCursor = 0;
 	}
 	glBufferSubData(GL_ARRAY_BUFFER, g_vboCursor, bufferSize, buffer);
+	vsRenderStats::CountBufferData( bufferSize );
 
 	glVertexAttribPointer( attribute, elementCount, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid*>(g_vboCursor) );
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -1189,9 +1260,9 @@ static GLuint g_evbo = 0xffffffff;
 static int g_evboCursor = EVBO_SIZE;
 
 void
-vsRenderBuffer::DrawElementsImmediate( int type, void* buffer, int count, int instanceCount )
+vsRenderBuffer::DrawElementsImmediate( int type, void* buffer, int count, int instanceCount, int indexBytes )
 {
-	int bufferSize = count * sizeof(uint16_t);
+	int bufferSize = count * indexBytes;
 	if ( g_evbo == 0xffffffff )
 	{
 		glGenBuffers(1, &g_evbo);
@@ -1199,14 +1270,19 @@ vsRenderBuffer::DrawElementsImmediate( int type, void* buffer, int count, int in
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_evbo);
 
+	// we stream 16-bit and 32-bit indices through the same buffer, and GL
+	// needs each draw's offset to be a multiple of its index size.
+	g_evboCursor = (g_evboCursor + indexBytes - 1) & ~(indexBytes - 1);
+
 	if ( g_evboCursor + bufferSize >= EVBO_SIZE )
 	{
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, EVBO_SIZE, NULL, GL_STREAM_DRAW);
 		g_evboCursor = 0;
 	}
 	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, g_evboCursor, bufferSize, buffer);
+	vsRenderStats::CountBufferData( bufferSize );
 
-	glDrawElementsInstanced(type, count, GL_UNSIGNED_SHORT, reinterpret_cast<GLvoid*>(g_evboCursor), instanceCount );
+	glDrawElementsInstanced(type, count, indexBytes == sizeof(uint32_t) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT, reinterpret_cast<GLvoid*>(g_evboCursor), instanceCount );
 
 #ifdef VS_PRISTINE_BINDINGS
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -1230,6 +1306,7 @@ vsRenderBuffer::BindRange(int startByte, int length)
 		int bindPoint = GL_ARRAY_BUFFER;
 		glBindBuffer(bindPoint, m_bufferID);
 		void *ptr = glMapBufferRange(bindPoint, startByte, length, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		vsRenderStats::CountMapBufferRange( length );
 		return ptr;
 	}
 	// otherwise, just give them a pointer into our array data
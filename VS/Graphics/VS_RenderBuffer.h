@@ -88,6 +88,7 @@ private:
 	BindType		m_bindType;
 
 	void	SetArray_Internal( char *data, int bytes, BindType bindType);
+	void	SetArrayRange_Internal( const char *data, int startByte, int bytes, BindType bindType );
 	void	SetArraySize_Internal( int bytes );
 	void	ResizeArray_Internal( int bytes ); // like the above, but retain saved array data.
 
@@ -168,15 +169,29 @@ public:
 	void	SetArray( const vsVector4D_i32 *array, int size );
     void    ResizeArray( int size );
 
+	// Replace 'count' elements starting at element 'start', leaving the rest
+	// of the buffer untouched.  The buffer must already hold at least
+	// start+count elements (use ResizeArray() to change its size).
+	void	SetArrayRange( const vsMatrix4x4 *array, int start, int count );
+	void	SetArrayRange( const vsColor *array, int start, int count );
+
 	void	SetActiveSize( int size );
 
 	void			SetVector3DArraySize( int size );
 	int				GetVector3DArraySize() { return m_activeBytes/sizeof(vsVector3D); }
 	vsVector3D *	GetVector3DArray() { return (vsVector3D*)m_array; }
 
+	// Index arrays hold uint16_t indices unless they were set up through
+	// SetArray(const uint32_t*) or SetUInt32ArraySize(), for drawing more
+	// than 65536 vertices;  GetIntArraySize() and the draw functions below
+	// count and draw whichever they hold, and GetIndex() reads either.
 	void			SetIntArraySize( int size );
-	int				GetIntArraySize() { return m_activeBytes/sizeof(uint16_t); }
+	void			SetUInt32ArraySize( int size );
+	int				GetIndexBytes() const { return m_contentType == ContentType_UInt32 ? sizeof(uint32_t) : sizeof(uint16_t); }
+	int				GetIntArraySize() { return m_activeBytes/GetIndexBytes(); }
 	uint16_t *		GetIntArray() { return (uint16_t*)m_array; }
+	uint32_t *		GetUInt32Array() { return (uint32_t*)m_array; }
+	uint32_t		GetIndex( int i ) const { return m_contentType == ContentType_UInt32 ? ((uint32_t*)m_array)[i] : ((uint16_t*)m_array)[i]; }
 
 	void			SetColorArraySize( int size );
 	vsColor *		GetColorArray() { return (vsColor*)m_array; }
@@ -237,7 +252,7 @@ public:
 	static void BindTexelArray( vsRendererState *state, void* buffer, int vertexCount );
 	static void BindNormalArray( vsRendererState *state, void* buffer, int vertexCount );
 
-	static void DrawElementsImmediate( int type, void* buffer, int count, int instanceCount );
+	static void DrawElementsImmediate( int type, void* buffer, int count, int instanceCount, int indexBytes = sizeof(uint16_t) );
 
 	void	TriStripBuffer(int instanceCount);
 	void	TriListBuffer(int instanceCount);
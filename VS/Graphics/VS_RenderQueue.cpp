@@ -18,11 +18,65 @@
 #include "VS_DynamicBatchManager.h"
 
 #include "VS_MaterialInternal.h"
+#include "VS_RadixSort.h"
 
 #include "VS/VS_DisableDebugNew.h"
+#include <algorithm>
 #include <map>
+#include <vector>
 #include "VS/VS_EnableDebugNew.h"
 
+// Temporary display lists come in power-of-two sizes from 1kb up to 32mb.
+// Larger requests get a list of their own, which is freed at the end of the
+// frame.  Pooled lists beyond the most we used at once during the last
+// c_temporaryListTrimFrames frames are freed.
+static const int c_temporaryListBuckets = 16;
+static const size_t c_minTemporaryListSize = 1024;
+static const int c_temporaryListTrimFrames = 300;
+
+// Hands out small, dense ids for pointers, in the order they're first seen,
+// so that they can be packed into a few bits of a sort key.  Ids past 'maxId'
+// all share 'maxId';  that only costs us some sorting quality.
+class vsSortIdTable
+{
+	std::vector<const void*>	m_key;
+	std::vector<int>			m_id;
+	int							m_count;
+	int							m_maxId;
+
+public:
+	vsSortIdTable( int maxId ):
+		m_count(0),
+		m_maxId(maxId)
+	{
+	}
+
+	void Reset( int expected )
+	{
+		size_t size = 64;
+		while ( size < (size_t)expected * 2 )
+			size *= 2;
+		m_key.assign( size, NULL );
+		m_id.resize( size );
+		m_count = 0;
+	}
+
+	int Get( const void *pointer )
+	{
+		size_t mask = m_key.size() - 1;
+		size_t slot = ((uintptr_t)pointer >> 4) * 2654435761u & mask;
+		while ( m_key[slot] && m_key[slot] != pointer )
+			slot = (slot + 1) & mask;
+		if ( !m_key[slot] )
+		{
+			m_key[slot] = pointer;
+			m_id[slot] = vsMin( m_count, m_maxId );
+			m_count++;
+		}
+		return m_id[slot];
+	}
+};
+
 class vsRenderQueueStage
 {
 public:
@@ -38,9 +92,46 @@ private:
 	Batch *				m_batchPool;
 	BatchElement * 		m_batchElementPool;
 
-	vsLinkedListStore<vsDisplayList>	m_temporaryLists;
+	struct TemporaryListBucket
+	{
+		std::vector<vsDisplayList*>	free;
+		std::vector<vsDisplayList*>	used;	// handed out this frame
+		size_t						peakUsed;
+
+		TemporaryListBucket(): peakUsed(0) {}
+	};
+	TemporaryListBucket					m_temporaryBucket[c_temporaryListBuckets];
+	vsLinkedListStore<vsDisplayList>	m_temporaryLists;	// too big to pool
+	int									m_framesSinceTrim;
+	vsRenderQueue::TemporaryListStats	m_temporaryListStats;
+
+	bool				m_deferDynamicBatching;
+
+	// sorting scratch space, kept between frames to avoid reallocating
+	std::vector<BatchElement*>	m_sortElement;
+	std::vector<vsMaterialInternal*>	m_sortMaterial;
+	std::vector<vsSortItem>		m_sortItem;
+	std::vector<vsSortItem>		m_sortScratch;
+	vsSortIdTable				m_shaderIds;
+	vsSortIdTable				m_textureIds;
+
+	// auto-instancing scratch space.  Each instanced group's matrices live
+	// until EndRender(), since the display list only points at them.
+	std::vector<BatchElement*>	m_instanceCandidate;
+	std::vector< std::vector<vsMatrix4x4> >	m_instanceMatrices;
+	int							m_instanceMatrixSets;
+
+	uint64_t		MakeSortKey( BatchElement *e, vsMaterialInternal *material, int stageId, int layerRank, int segment, const vsMatrix4x4 &worldToView );
+	void			CountSwitches( const vsSortItem *order, int *materialSwitches, int *shaderSwitches, int *textureSwitches );
+	void			DrawElement( vsDisplayList *list, BatchElement *e );
+	std::vector<vsMatrix4x4>&	NextInstanceMatrices();
+	vsDisplayList *	AcquireTemporaryList( int size );
+	void			RecycleTemporaryLists();
 
 	Batch *			FindBatch( vsMaterial *material );
+	Batch *			FindBatch( vsMaterialInternal *material );
+	BatchElement *	NewElement();
+	bool			TryDynamicBatch( Batch *batch, vsMaterial *material, const vsMatrix4x4 &matrix, vsRenderBuffer* vbo, vsRenderBuffer* ibo, vsFragment::SimpleType type );
 
 
 public:
@@ -49,9 +140,21 @@ public:
 	~vsRenderQueueStage();
 
 	void			StartRender();
-	void			Draw( vsDisplayList *list );	// write our batches into here.
+	void			Draw( vsDisplayList *list );	// write our batches into here, in the order they were queued.
+	void			DrawSorted( vsDisplayList *list, int stageId, const vsMatrix4x4 &worldToView, vsRenderQueue::SortStats *stats );	// ..or sorted to minimise state changes.
+	void			AutoInstance( int threshold, vsRenderQueue::InstancingStats *stats );	// before drawing, combine identical elements into instanced draws
 	void			EndRender();
 
+	// Dynamic batching isn't threadsafe, so stages being filled on worker
+	// threads hold onto their simple batches unmerged, and we do the merging
+	// when they're merged into the main thread's stage.
+	void			SetDeferDynamicBatching( bool defer ) { m_deferDynamicBatching = defer; }
+
+	// Take copies of everything queued into 'other', as though it had all been
+	// added to us directly (and in the same order), after everything we
+	// already contain.  'other' must not be ended until we've been drawn.
+	void			Merge( vsRenderQueueStage *other );
+
 	// Add a batch to this stage
 	void			AddBatch( vsMaterial *material, const vsMatrix4x4 &matrix, vsDisplayList *batch );
 	void			AddSimpleBatch( vsMaterial *material, const vsMatrix4x4 &matrix, vsRenderBuffer* vbo, vsRenderBuffer* ibo, vsFragment::SimpleType type );
@@ -65,6 +168,7 @@ public:
 
 	// For stuff which really doesn't want to keep its display list around, call this to get a temporary display list.
 	vsDisplayList *	MakeTemporaryBatchList( vsMaterial *material, const vsMatrix4x4 &matrix, int size );
+	const vsRenderQueue::TemporaryListStats&	GetTemporaryListStats() const { return m_temporaryListStats; }
 };
 
 
@@ -82,6 +186,8 @@ struct vsRenderQueueStage::BatchElement
 	vsRenderBuffer *vbo;
 	vsRenderBuffer *ibo;
 	vsFragment::SimpleType simpleType;
+	bool			simpleBatch;	// added via AddSimpleBatch(), so is a candidate for dynamic batching
+	bool			merged;			// drawn as part of another element's instanced draw
 	BatchElement *	next;
 
 	vsDynamicBatch * batch;
@@ -97,6 +203,8 @@ struct vsRenderQueueStage::BatchElement
 		list(NULL),
 		vbo(NULL),
 		ibo(NULL),
+		simpleBatch(false),
+		merged(false),
 		next(NULL),
 		batch(NULL)
 	{
@@ -114,6 +222,8 @@ struct vsRenderQueueStage::BatchElement
 		list = NULL;
 		vbo = NULL;
 		ibo = NULL;
+		simpleBatch = false;
+		merged = false;
 		batch = NULL;
 	}
 
@@ -150,7 +260,12 @@ vsRenderQueueStage::vsRenderQueueStage():
 	m_batch(NULL),
 	m_batchCount(0),
 	m_batchPool(NULL),
-	m_batchElementPool(NULL)
+	m_batchElementPool(NULL),
+	m_framesSinceTrim(0),
+	m_deferDynamicBatching(false),
+	m_shaderIds(0x3ff),
+	m_textureIds(0xfff),
+	m_instanceMatrixSets(0)
 {
 }
 
@@ -169,12 +284,26 @@ vsRenderQueueStage::~vsRenderQueueStage()
 		m_batchElementPool = m_batchElementPool->next;
 		vsDelete(e);
 	}
+	for ( int i = 0; i < c_temporaryListBuckets; i++ )
+	{
+		TemporaryListBucket &bucket = m_temporaryBucket[i];
+		for ( size_t j = 0; j < bucket.free.size(); j++ )
+			vsDelete( bucket.free[j] );
+		for ( size_t j = 0; j < bucket.used.size(); j++ )
+			vsDelete( bucket.used[j] );
+	}
 }
 
 vsRenderQueueStage::Batch *
 vsRenderQueueStage::FindBatch( vsMaterial *material )
 {
-	std::map<vsMaterialInternal*, vsRenderQueueStage::Batch*>::iterator it = m_batchMap->map.find(material->GetResource());
+	return FindBatch( material->GetResource() );
+}
+
+vsRenderQueueStage::Batch *
+vsRenderQueueStage::FindBatch( vsMaterialInternal *material )
+{
+	std::map<vsMaterialInternal*, vsRenderQueueStage::Batch*>::iterator it = m_batchMap->map.find(material);
 	if ( it != m_batchMap->map.end() )
 	{
 		return it->second;
@@ -187,7 +316,7 @@ vsRenderQueueStage::FindBatch( vsMaterial *material )
 	Batch *batch = m_batchPool;
 	m_batchPool = batch->next;
 	batch->next = NULL;
-	batch->material = material->GetResource();
+	batch->material = material;
 
 	// insert this batch into our batch list, SORTED.
 	bool inserted = false;
@@ -198,7 +327,7 @@ vsRenderQueueStage::FindBatch( vsMaterial *material )
 	}
 	else
 	{
-		if ( m_batch->material->m_layer > material->GetResource()->m_layer )
+		if ( m_batch->material->m_layer > material->m_layer )
 		{
 			// we should sort before the first thing in the batch list.
 			batch->next = m_batch;
@@ -210,7 +339,7 @@ vsRenderQueueStage::FindBatch( vsMaterial *material )
 			Batch *lb;
 			for(lb = m_batch; lb->next; lb = lb->next)
 			{
-				if ( lb->next->material->m_layer > material->GetResource()->m_layer )
+				if ( lb->next->material->m_layer > material->m_layer )
 				{
 					batch->next = lb->next;
 					lb->next = batch;
@@ -226,11 +355,25 @@ vsRenderQueueStage::FindBatch( vsMaterial *material )
 		}
 	}
 	m_batchCount++;
-	m_batchMap->map[material->GetResource()] = batch;
+	m_batchMap->map[material] = batch;
 
 	return batch;
 }
 
+vsRenderQueueStage::BatchElement *
+vsRenderQueueStage::NewElement()
+{
+	if ( !m_batchElementPool )
+	{
+		m_batchElementPool = new BatchElement;
+	}
+	BatchElement *element = m_batchElementPool;
+	m_batchElementPool = element->next;
+	element->next = NULL;
+	element->Clear();
+	return element;
+}
+
 
 void
 vsRenderQueueStage::AddBatch( vsMaterial *material, const vsMatrix4x4 &matrix, vsDisplayList *batchList )
@@ -257,89 +400,97 @@ vsRenderQueueStage::AddBatch( vsMaterial *material, const vsMatrix4x4 &matrix, v
 	batch->elementList = element;
 }
 
-void
-vsRenderQueueStage::AddSimpleBatch( vsMaterial *material, const vsMatrix4x4 &matrix, vsRenderBuffer* vbo, vsRenderBuffer* ibo, vsFragment::SimpleType simpleType)
+bool
+vsRenderQueueStage::TryDynamicBatch( Batch *batch, vsMaterial *material, const vsMatrix4x4 &matrix, vsRenderBuffer* vbo, vsRenderBuffer* ibo, vsFragment::SimpleType simpleType )
 {
-	Batch *batch = FindBatch(material);
-
-	if ( vsSystem::Instance()->GetPreferences()->GetDynamicBatching() )
+	// Check for compatible simple BatchElements
+	// in this batch.  If I find one, we'll merge together.
+	//
+	// "Compatible" means:  VBO is the same format and simpleType is the same.
+	// And no instance data;  batching doesn't work with instanced draws!
+	//
+	// Actually..  I can ignore 'simpleType' and just convert everything into
+	// triangle lists.  That'd get around the issue of primitive restarts in
+	// the case of fans and strips.
+	//
+	// Also, I probably want to have a rule like "if we add the size of their
+	// VBO array to the size of our VBO array, the total size should be under
+	// <X>".  (Unity has a limit of 900 vertex attributes and 300 vertices..  so..
+	// with a three-attribute vertex format like PCT, you can do 300 vertices.
+	// But with PCNT, you only get 225.)  I could do something like that, I guess?
+
+	BatchElement *mergeCandidate = NULL;
+	if ( vsDynamicBatch::Supports( vbo->GetContentType() ) &&
+			vbo->GetPositionCount() < 200 ) // don't even try to merge things that are too big.
 	{
-		// Check for compatible simple BatchElements
-		// in this batch.  If I find one, we'll merge together.
-		//
-		// "Compatible" means:  VBO is the same format and simpleType is the same.
-		// And no instance data;  batching doesn't work with instanced draws!
-		//
-		// Actually..  I can ignore 'simpleType' and just convert everything into
-		// triangle lists.  That'd get around the issue of primitive restarts in
-		// the case of fans and strips.
-		//
-		// Also, I probably want to have a rule like "if we add the size of their
-		// VBO array to the size of our VBO array, the total size should be under
-		// <X>".  (Unity has a limit of 900 vertex attributes and 300 vertices..  so..
-		// with a three-attribute vertex format like PCT, you can do 300 vertices.
-		// But with PCNT, you only get 225.)  I could do something like that, I guess?
-
-		BatchElement *mergeCandidate = NULL;
-		if ( vsDynamicBatch::Supports( vbo->GetContentType() ) &&
-				vbo->GetPositionCount() < 200 ) // don't even try to merge things that are too big.
+		mergeCandidate = batch->elementList;
+		while(mergeCandidate)
 		{
-			mergeCandidate = batch->elementList;
-			while(mergeCandidate)
+			// [TODO] I should also be checking whether there's space in the
+			// mergeCandidate's buffer to merge with it.
+			//
+			// Also, we really don't want to merge into a renderbuffer *every*
+			// time, because each time it would initiate a transfer to the GPU.
+			// Instead, we want to be doing these merges into CPU-side memory
+			// and only push into a GPU buffer once we're *done* merging!
+			if ( mergeCandidate->instanceMatrix == NULL &&
+					mergeCandidate->vbo &&
+					mergeCandidate->vbo->GetContentType() == vbo->GetContentType() &&
+					mergeCandidate->material->MatchesForBatching( material ) )
 			{
-				// [TODO] I should also be checking whether there's space in the
-				// mergeCandidate's buffer to merge with it.
-				//
-				// Also, we really don't want to merge into a renderbuffer *every*
-				// time, because each time it would initiate a transfer to the GPU.
-				// Instead, we want to be doing these merges into CPU-side memory
-				// and only push into a GPU buffer once we're *done* merging!
-				if ( mergeCandidate->instanceMatrix == NULL &&
-						mergeCandidate->vbo &&
-						mergeCandidate->vbo->GetContentType() == vbo->GetContentType() &&
-						mergeCandidate->material->MatchesForBatching( material ) )
+				// break;
+				if ( mergeCandidate->batch == NULL )
+				{
+					if ( mergeCandidate->vbo->GetPositionCount() + vbo->GetPositionCount() < 300 )
+						break;
+				}
+				else
 				{
-					// break;
-					if ( mergeCandidate->batch == NULL )
-					{
-						if ( mergeCandidate->vbo->GetPositionCount() + vbo->GetPositionCount() < 300 )
-							break;
-					}
-					else
-					{
-						if ( mergeCandidate->batch->CanFitVertices( vbo->GetPositionCount() ) )
-							break;
-					}
+					if ( mergeCandidate->batch->CanFitVertices( vbo->GetPositionCount() ) )
+						break;
 				}
-				mergeCandidate = mergeCandidate->next;
 			}
+			mergeCandidate = mergeCandidate->next;
 		}
+	}
+
+	if (mergeCandidate)
+	{
+		// vsLog("Found merge candidate!");
+		// Okay.  So what we're going to do is this:
+		//
+		// First, we need to understand whether this batch is already a "merge"
+		// batch, because if so we can safely add ourself to it.  If NOT, we
+		// must create a "merge" batch and add BOTH the merge candidate AND
+		// this batch to it, then remove the mergeCandidate.
+		//
+		// This implies that we need to have some set of "merge" batches around
+		// and ready for use.  And we need a way to mark which BatchElements
+		// represent these "merge" batches
 
-		if (mergeCandidate)
+		if ( mergeCandidate->batch == NULL )
 		{
-			// vsLog("Found merge candidate!");
-			// Okay.  So what we're going to do is this:
-			//
-			// First, we need to understand whether this batch is already a "merge"
-			// batch, because if so we can safely add ourself to it.  If NOT, we
-			// must create a "merge" batch and add BOTH the merge candidate AND
-			// this batch to it, then remove the mergeCandidate.
-			//
-			// This implies that we need to have some set of "merge" batches around
-			// and ready for use.  And we need a way to mark which BatchElements
-			// represent these "merge" batches
+			mergeCandidate->batch = vsDynamicBatchManager::Instance()->GetNewBatch();
+			mergeCandidate->batch->StartBatch( mergeCandidate->vbo,
+					mergeCandidate->ibo,
+					mergeCandidate->matrix,
+					mergeCandidate->simpleType );
+		}
+		mergeCandidate->batch->AddToBatch( vbo, ibo, matrix, simpleType );
+		return true;
+	}
+	return false;
+}
 
-			if ( mergeCandidate->batch == NULL )
-			{
-				mergeCandidate->batch = vsDynamicBatchManager::Instance()->GetNewBatch();
-				mergeCandidate->batch->StartBatch( mergeCandidate->vbo,
-						mergeCandidate->ibo,
-						mergeCandidate->matrix,
-						mergeCandidate->simpleType );
-			}
-			mergeCandidate->batch->AddToBatch( vbo, ibo, matrix, simpleType );
+void
+vsRenderQueueStage::AddSimpleBatch( vsMaterial *material, const vsMatrix4x4 &matrix, vsRenderBuffer* vbo, vsRenderBuffer* ibo, vsFragment::SimpleType simpleType)
+{
+	Batch *batch = FindBatch(material);
+
+	if ( !m_deferDynamicBatching && vsSystem::Instance()->GetPreferences()->GetDynamicBatching() )
+	{
+		if ( TryDynamicBatch( batch, material, matrix, vbo, ibo, simpleType ) )
 			return;
-		}
 	}
 
 	if ( !m_batchElementPool )
@@ -358,6 +509,7 @@ vsRenderQueueStage::AddSimpleBatch( vsMaterial *material, const vsMatrix4x4 &mat
 	element->vbo = vbo;
 	element->ibo = ibo;
 	element->simpleType = simpleType;
+	element->simpleBatch = true;
 	element->instanceMatrix = NULL;
 	element->instanceMatrixBuffer = NULL;
 	element->instanceColorBuffer = NULL;
@@ -533,15 +685,90 @@ vsRenderQueueStage::MakeTemporaryBatchList( vsMaterial *material, const vsMatrix
 
 	element->material = material;
 	element->matrix = matrix;
-	element->list = new vsDisplayList(size);
+	element->list = AcquireTemporaryList(size);
 
 	element->next = batch->elementList;
 	batch->elementList = element;
-	m_temporaryLists.AddItem(element->list);
 
 	return element->list;
 }
 
+vsDisplayList *
+vsRenderQueueStage::AcquireTemporaryList( int size )
+{
+	m_temporaryListStats.requested++;
+
+	int bucketId = 0;
+	size_t bucketSize = c_minTemporaryListSize;
+	while ( bucketSize < (size_t)size && bucketId < c_temporaryListBuckets )
+	{
+		bucketSize *= 2;
+		bucketId++;
+	}
+
+	if ( bucketId == c_temporaryListBuckets )
+	{
+		vsDisplayList *list = new vsDisplayList(size);
+		m_temporaryLists.AddItem(list);
+		m_temporaryListStats.allocated++;
+		return list;
+	}
+
+	TemporaryListBucket &bucket = m_temporaryBucket[bucketId];
+	vsDisplayList *list;
+	if ( bucket.free.empty() )
+	{
+		list = new vsDisplayList(bucketSize);
+		m_temporaryListStats.allocated++;
+	}
+	else
+	{
+		list = bucket.free.back();
+		bucket.free.pop_back();
+	}
+	bucket.used.push_back(list);
+	return list;
+}
+
+void
+vsRenderQueueStage::RecycleTemporaryLists()
+{
+	bool trim = ( ++m_framesSinceTrim >= c_temporaryListTrimFrames );
+	if ( trim )
+		m_framesSinceTrim = 0;
+
+	m_temporaryListStats.pooled = 0;
+	m_temporaryListStats.pooledBytes = 0;
+	size_t bucketSize = c_minTemporaryListSize;
+	for ( int i = 0; i < c_temporaryListBuckets; i++, bucketSize *= 2 )
+	{
+		TemporaryListBucket &bucket = m_temporaryBucket[i];
+		bucket.peakUsed = vsMax( bucket.peakUsed, bucket.used.size() );
+		for ( size_t j = 0; j < bucket.used.size(); j++ )
+		{
+			bucket.used[j]->Clear();
+			bucket.free.push_back( bucket.used[j] );
+		}
+		bucket.used.clear();
+
+		if ( trim )
+		{
+			while ( bucket.free.size() > bucket.peakUsed )
+			{
+				vsDelete( bucket.free.back() );
+				bucket.free.pop_back();
+				m_temporaryListStats.released++;
+			}
+			bucket.peakUsed = 0;
+		}
+
+		m_temporaryListStats.pooled += bucket.free.size();
+		m_temporaryListStats.pooledBytes += bucket.free.size() * bucketSize;
+	}
+
+	m_temporaryLists.Clear();
+}
+
 void
 vsRenderQueueStage::StartRender()
 {
@@ -549,9 +776,54 @@ vsRenderQueueStage::StartRender()
 	vsAssert( m_batch == NULL, "Batches not cleared?" );
 	//	m_batch = NULL;
 
+	m_temporaryListStats.requested = 0;
+	m_temporaryListStats.allocated = 0;
+	m_temporaryListStats.released = 0;
+
 
 }
 
+void
+vsRenderQueueStage::DrawElement( vsDisplayList *list, BatchElement *e )
+{
+	list->SetMaterial( e->material );
+	if ( e->batch )
+	{
+		list->SetMatrix4x4( vsMatrix4x4::Identity );
+		e->batch->Draw(list);
+		list->PopTransform();
+	}
+	else
+	{
+		if ( e->instanceMatrixBuffer )
+			list->SetMatrices4x4Buffer( e->instanceMatrixBuffer );
+		else if ( e->instanceMatrix )
+			list->SetMatrices4x4( e->instanceMatrix, e->instanceMatrixCount );
+		else
+			list->SetMatrix4x4( e->matrix );
+		list->SetShaderValues( e->shaderValues );
+		if ( e->instanceColorBuffer )
+			list->SetColorsBuffer( e->instanceColorBuffer );
+		else if ( e->instanceColor )
+			list->SetColors( e->instanceColor, e->instanceMatrixCount );
+
+		if ( e->list )
+			list->Append( *e->list );
+		else if ( e->vbo && e->ibo )
+		{
+			list->BindBuffer( e->vbo );
+			if ( e->simpleType == vsFragment::SimpleType_TriangleList )
+				list->TriangleListBuffer( e->ibo );
+			else if ( e->simpleType == vsFragment::SimpleType_TriangleFan )
+				list->TriangleFanBuffer( e->ibo );
+			else if ( e->simpleType == vsFragment::SimpleType_TriangleStrip )
+				list->TriangleStripBuffer( e->ibo );
+			list->ClearArrays();
+		}
+		list->PopTransform();
+	}
+}
+
 void
 vsRenderQueueStage::Draw( vsDisplayList *list )
 {
@@ -559,41 +831,289 @@ vsRenderQueueStage::Draw( vsDisplayList *list )
 	{
 		for (BatchElement *e = b->elementList; e; e = e->next)
 		{
-			list->SetMaterial( e->material );
-			if ( e->batch )
+			DrawElement( list, e );
+		}
+	}
+}
+
+// Sort key layout, from most to least significant bits:
+//
+//   63-62  stage
+//   61-54  material layer, as its rank among the layers in this stage
+//   53-42  segment
+//   41     translucent
+//   40-0   opaque:       shader (10) | texture (12) | depth, front to back (19)
+//          translucent:  depth, back to front (19) | shader (10) | texture (12)
+//
+// Materials which don't read the depth buffer rely entirely on draw order, so
+// each of them starts a new "segment";  nothing may be reordered across one.
+// Such an element has zero in all bits below its segment, so it always
+// stays first within its own segment.  Within a segment, depth-tested opaque
+// draws are grouped by shader and texture, and blended depth-tested draws
+// come afterward, back to front.  The radix sort is stable, so anything with
+// an identical key keeps the order it was queued in.
+//
+// Layers can be any int, so rather than the layer itself we store its rank:
+// our batches are already kept in layer order, so we number the distinct
+// layers as we walk them.  That allows up to 256 distinct layers per stage.
+#define SORT_DEPTH_BITS (19)
+#define SORT_MAX_LAYERS (256)
+
+static uint64_t DepthBits( float distanceSquared, bool backToFront )
+{
+	// the bit pattern of a positive float sorts the same way as its value, so
+	// we can just keep its most significant bits.
+	union { float f; uint32_t u; } depth;
+	depth.f = vsMax( distanceSquared, 0.f );
+	uint64_t bits = depth.u >> (32 - SORT_DEPTH_BITS);
+	if ( backToFront )
+		bits = ((1 << SORT_DEPTH_BITS) - 1) - bits;
+	return bits;
+}
+
+static const void * ShaderIdentity( vsMaterialInternal *material )
+{
+	if ( material->m_shader )
+		return material->m_shader;
+	// no explicit shader;  the renderer picks one from the shader suite,
+	// based upon draw mode and whether there's a texture.
+	uintptr_t builtIn = 1 + (material->m_drawMode == DrawMode_Lit ? 2 : 0) + (material->m_texture[0] ? 1 : 0);
+	return (const void*)(builtIn << 4);
+}
+
+static const void * TextureIdentity( vsMaterialInternal *material )
+{
+	if ( material->m_texture[0] )
+		return material->m_texture[0]->GetResource();
+	return NULL;
+}
+
+uint64_t
+vsRenderQueueStage::MakeSortKey( BatchElement *e, vsMaterialInternal *material, int stageId, int layerRank, int segment, const vsMatrix4x4 &worldToView )
+{
+	uint64_t key = ((uint64_t)stageId << 62) | ((uint64_t)layerRank << 54) | ((uint64_t)segment << 42);
+
+	if ( !material->m_zRead )
+		return key;
+
+	float distanceSquared = 0.f;
+	if ( !e->batch && !e->instanceMatrix && !e->instanceMatrixBuffer )
+	{
+		vsVector4D view = worldToView.ApplyTo( e->matrix.w );
+		distanceSquared = view.x*view.x + view.y*view.y + view.z*view.z;
+	}
+
+	const void *shader = ShaderIdentity( material );
+	const void *texture = TextureIdentity( material );
+	uint64_t shaderId = shader ? m_shaderIds.Get( shader ) : 0;
+	uint64_t textureId = texture ? m_textureIds.Get( texture ) : 0;
+
+	if ( material->m_blend )
+	{
+		key |= (uint64_t)1 << 41;
+		key |= DepthBits( distanceSquared, true ) << 22;
+		key |= shaderId << 12;
+		key |= textureId;
+	}
+	else
+	{
+		key |= shaderId << 31;
+		key |= textureId << SORT_DEPTH_BITS;
+		key |= DepthBits( distanceSquared, false );
+	}
+	return key;
+}
+
+void
+vsRenderQueueStage::CountSwitches( const vsSortItem *order, int *materialSwitches, int *shaderSwitches, int *textureSwitches )
+{
+	vsMaterialInternal *lastMaterial = NULL;
+	const void *lastShader = NULL;
+	const void *lastTexture = NULL;
+	for ( size_t i = 0; i < m_sortItem.size(); i++ )
+	{
+		vsMaterialInternal *material = m_sortMaterial[ order[i].index ];
+		const void *shader = ShaderIdentity( material );
+		const void *texture = TextureIdentity( material );
+		if ( i == 0 || material != lastMaterial )
+			(*materialSwitches)++;
+		if ( i == 0 || shader != lastShader )
+			(*shaderSwitches)++;
+		if ( i == 0 || texture != lastTexture )
+			(*textureSwitches)++;
+		lastMaterial = material;
+		lastShader = shader;
+		lastTexture = texture;
+	}
+}
+
+void
+vsRenderQueueStage::DrawSorted( vsDisplayList *list, int stageId, const vsMatrix4x4 &worldToView, vsRenderQueue::SortStats *stats )
+{
+	m_sortElement.clear();
+	m_sortMaterial.clear();
+	for (Batch *b = m_batch; b; b = b->next)
+	{
+		for (BatchElement *e = b->elementList; e; e = e->next)
+		{
+			m_sortElement.push_back( e );
+			m_sortMaterial.push_back( b->material );
+		}
+	}
+	int count = (int)m_sortElement.size();
+	if ( count == 0 )
+		return;
+
+	m_shaderIds.Reset( count );
+	m_textureIds.Reset( count );
+	m_sortItem.resize( count );
+	m_sortScratch.resize( count );
+
+	int segment = 0;
+	int layerRank = 0;
+	for ( int i = 0; i < count; i++ )
+	{
+		vsMaterialInternal *material = m_sortMaterial[i];
+		if ( i > 0 && material->m_layer != m_sortMaterial[i-1]->m_layer )
+		{
+			layerRank++;
+			vsAssert( layerRank < SORT_MAX_LAYERS, "Too many distinct material layers in one render queue stage to sort;  turn off sorting, or use fewer layers" );
+		}
+		if ( !material->m_zRead )
+			segment = vsMin( segment+1, 0xfff );
+		m_sortItem[i].key = MakeSortKey( m_sortElement[i], material, stageId, layerRank, segment, worldToView );
+		m_sortItem[i].index = i;
+	}
+
+	if ( stats )
+		CountSwitches( &m_sortItem[0], &stats->materialSwitchesUnsorted, &stats->shaderSwitchesUnsorted, &stats->textureSwitchesUnsorted );
+
+	vsRadixSort( &m_sortItem[0], &m_sortScratch[0], count );
+
+	if ( stats )
+	{
+		stats->elements += count;
+		CountSwitches( &m_sortItem[0], &stats->materialSwitchesSorted, &stats->shaderSwitchesSorted, &stats->textureSwitchesSorted );
+	}
+
+	for ( int i = 0; i < count; i++ )
+	{
+		DrawElement( list, m_sortElement[ m_sortItem[i].index ] );
+	}
+}
+
+static bool IsInstanceCandidate( const vsRenderQueueStage::BatchElement *e )
+{
+	return !e->batch && !e->instanceMatrix && !e->instanceMatrixBuffer &&
+		!e->instanceColor && !e->instanceColorBuffer && !e->shaderValues &&
+		( e->list || ( e->vbo && e->ibo ) );
+}
+
+// Orders elements so that those drawing the same thing are adjacent.
+struct vsInstanceSourceLess
+{
+	bool operator()( const vsRenderQueueStage::BatchElement *a, const vsRenderQueueStage::BatchElement *b ) const
+	{
+		if ( a->list != b->list )
+			return a->list < b->list;
+		if ( a->list )
+			return false;
+		if ( a->vbo != b->vbo )
+			return a->vbo < b->vbo;
+		if ( a->ibo != b->ibo )
+			return a->ibo < b->ibo;
+		return a->simpleType < b->simpleType;
+	}
+};
+
+std::vector<vsMatrix4x4>&
+vsRenderQueueStage::NextInstanceMatrices()
+{
+	// growing the outer vector moves the inner ones, which keeps their
+	// contents where they were;  pointers we've already handed out stay good.
+	if ( m_instanceMatrixSets == (int)m_instanceMatrices.size() )
+		m_instanceMatrices.resize( m_instanceMatrixSets + 1 );
+	std::vector<vsMatrix4x4>& result = m_instanceMatrices[m_instanceMatrixSets++];
+	result.clear();
+	return result;
+}
+
+void
+vsRenderQueueStage::AutoInstance( int threshold, vsRenderQueue::InstancingStats *stats )
+{
+	vsInstanceSourceLess less;
+	for (Batch *b = m_batch; b; b = b->next)
+	{
+		// an instanced group is drawn where its first element was queued,
+		// so the others move earlier.  Only safe when order doesn't matter.
+		if ( !b->material->m_zRead || b->material->m_blend )
+			continue;
+
+		m_instanceCandidate.clear();
+		for (BatchElement *e = b->elementList; e; e = e->next)
+		{
+			if ( IsInstanceCandidate(e) )
+				m_instanceCandidate.push_back( e );
+		}
+		int count = (int)m_instanceCandidate.size();
+		if ( count < threshold )
+			continue;
+
+		// elements are stored newest-first;  the stable sort keeps each
+		// group that way.
+		std::stable_sort( m_instanceCandidate.begin(), m_instanceCandidate.end(), less );
+
+		bool mergedAny = false;
+		int start = 0;
+		while ( start < count )
+		{
+			int end = start+1;
+			while ( end < count && !less( m_instanceCandidate[start], m_instanceCandidate[end] ) )
+				end++;
+
+			int groupSize = end - start;
+			vsDisplayList *groupList = m_instanceCandidate[start]->list;
+			if ( groupSize >= threshold && ( !groupList || groupList->IsInstanceable() ) )
 			{
-				list->SetMatrix4x4( vsMatrix4x4::Identity );
-				e->batch->Draw(list);
-				list->PopTransform();
+				std::vector<vsMatrix4x4>& matrices = NextInstanceMatrices();
+				for ( int i = end-1; i >= start; i-- )
+				{
+					matrices.push_back( m_instanceCandidate[i]->matrix );
+					m_instanceCandidate[i]->merged = true;
+				}
+
+				BatchElement *first = m_instanceCandidate[end-1];
+				first->merged = false;
+				first->instanceMatrix = &matrices[0];
+				first->instanceMatrixCount = groupSize;
+				mergedAny = true;
+
+				if ( stats )
+				{
+					stats->instancedDraws++;
+					stats->elementsInstanced += groupSize;
+					stats->drawsSaved += groupSize - 1;
+				}
 			}
-			else
+			start = end;
+		}
+
+		if ( mergedAny )
+		{
+			BatchElement **link = &b->elementList;
+			while ( *link )
 			{
-				if ( e->instanceMatrixBuffer )
-					list->SetMatrices4x4Buffer( e->instanceMatrixBuffer );
-				else if ( e->instanceMatrix )
-					list->SetMatrices4x4( e->instanceMatrix, e->instanceMatrixCount );
+				BatchElement *e = *link;
+				if ( e->merged )
+				{
+					*link = e->next;
+					e->next = m_batchElementPool;
+					m_batchElementPool = e;
+				}
 				else
-					list->SetMatrix4x4( e->matrix );
-				list->SetShaderValues( e->shaderValues );
-				if ( e->instanceColorBuffer )
-					list->SetColorsBuffer( e->instanceColorBuffer );
-				else if ( e->instanceColor )
-					list->SetColors( e->instanceColor, e->instanceMatrixCount );
-
-				if ( e->list )
-					list->Append( *e->list );
-				else if ( e->vbo && e->ibo )
 				{
-					list->BindBuffer( e->vbo );
-					if ( e->simpleType == vsFragment::SimpleType_TriangleList )
-						list->TriangleListBuffer( e->ibo );
-					else if ( e->simpleType == vsFragment::SimpleType_TriangleFan )
-						list->TriangleFanBuffer( e->ibo );
-					else if ( e->simpleType == vsFragment::SimpleType_TriangleStrip )
-						list->TriangleStripBuffer( e->ibo );
-					list->ClearArrays();
+					link = &e->next;
 				}
-				list->PopTransform();
 			}
 		}
 	}
@@ -627,8 +1147,51 @@ vsRenderQueueStage::EndRender()
 	}
 	m_batch = NULL;
 
-	m_temporaryLists.Clear();
+	RecycleTemporaryLists();
 	m_batchMap->map.clear();
+	m_instanceMatrixSets = 0;
+}
+
+void
+vsRenderQueueStage::Merge( vsRenderQueueStage *other )
+{
+	bool dynamicBatching = !m_deferDynamicBatching && vsSystem::Instance()->GetPreferences()->GetDynamicBatching();
+
+	// 'other' keeps its batches in layer order, with batches on the same layer
+	// in the order they were first used.  FindBatch() inserts new batches
+	// after any existing batches on the same layer, so walking 'other' in
+	// order gives us exactly the batch order we'd have had if everything had
+	// been added to us directly.
+	for (Batch *b = other->m_batch; b; b = b->next)
+	{
+		Batch *batch = FindBatch( b->material );
+
+		// Elements are stored newest-first.  Flip the other stage's list so
+		// we can replay its elements in the order they were added.  (It's
+		// only going to be recycled by EndRender(), so the order it's left in
+		// doesn't matter)
+		BatchElement *reversed = NULL;
+		while ( b->elementList )
+		{
+			BatchElement *e = b->elementList;
+			b->elementList = e->next;
+			e->next = reversed;
+			reversed = e;
+		}
+		b->elementList = reversed;
+
+		for (BatchElement *e = b->elementList; e; e = e->next)
+		{
+			if ( dynamicBatching && e->simpleBatch &&
+					TryDynamicBatch( batch, e->material, e->matrix, e->vbo, e->ibo, e->simpleType ) )
+				continue;
+
+			BatchElement *element = NewElement();
+			*element = *e;
+			element->next = batch->elementList;
+			batch->elementList = element;
+		}
+	}
 }
 
 vsRenderQueue::vsRenderQueue( int stageCount, int genericListSize):
@@ -637,9 +1200,17 @@ vsRenderQueue::vsRenderQueue( int stageCount, int genericListSize):
 	m_stage(new vsRenderQueueStage[4]),
 	m_stageCount(4),
 	m_transformStack(),
-	m_transformStackLevel(0)
+	m_transformStackLevel(0),
+	m_sorting(false),
+	m_optimizing(false),
+	m_autoInstancing(false),
+	m_autoInstanceThreshold(4)
 	// m_orthographic(true)
 {
+	m_optimizeStats.opsBefore = 0;
+	m_optimizeStats.opsRemoved = 0;
+	m_optimizeStats.bytesBefore = 0;
+	m_optimizeStats.bytesRemoved = 0;
 }
 
 vsRenderQueue::~vsRenderQueue()
@@ -679,26 +1250,73 @@ vsRenderQueue::StartRender( const vsMatrix4x4& projection, const vsMatrix4x4& wo
 	m_genericList->Clear();
 }
 
+void
+vsRenderQueue::DrawStage( vsDisplayList *list, int stageId )
+{
+	if ( m_autoInstancing )
+		m_stage[stageId].AutoInstance( m_autoInstanceThreshold, &m_instancingStats );
+	if ( m_sorting )
+		m_stage[stageId].DrawSorted( list, stageId, m_worldToView, &m_sortStats );
+	else
+		m_stage[stageId].Draw( list );
+}
+
 void
 vsRenderQueue::Draw( vsDisplayList *list )
 {
+	m_sortStats = SortStats();
+	m_instancingStats = InstancingStats();
+	size_t start = list->GetSize();
 	for ( int i = 0; i < 3; i++ )
 	{
-		m_stage[i].Draw(list);
+		DrawStage( list, i );
 	}
 	list->Append(*m_genericList);
-	m_stage[3].Draw(list);
+	DrawStage( list, 3 );
+
+	if ( m_optimizing )
+		m_optimizeStats = list->Optimize( start );
 
 	DeinitialiseTransformStack();
 	vsAssert( m_transformStackLevel == 0, "Unbalanced push/pop of transforms?");
 }
 
+void
+vsRenderQueue::SetDeferDynamicBatching( bool defer )
+{
+	for ( int i = 0; i < m_stageCount; i++ )
+	{
+		m_stage[i].SetDeferDynamicBatching( defer );
+	}
+}
+
+void
+vsRenderQueue::Merge( vsRenderQueue *other )
+{
+	vsAssert( other->m_transformStackLevel == 1, "Unbalanced push/pop of transforms?");
+	vsAssert( other->m_stageCount == m_stageCount, "Merging mismatched render queues?");
+
+	for ( int i = 0; i < m_stageCount; i++ )
+	{
+		m_stage[i].Merge( &other->m_stage[i] );
+	}
+	m_genericList->Append(*other->m_genericList);
+}
+
 void
 vsRenderQueue::EndRender()
 {
+	m_temporaryListStats = TemporaryListStats();
 	for ( int i = 0; i < m_stageCount; i++ )
 	{
 		m_stage[i].EndRender();
+
+		const TemporaryListStats &s = m_stage[i].GetTemporaryListStats();
+		m_temporaryListStats.requested += s.requested;
+		m_temporaryListStats.allocated += s.allocated;
+		m_temporaryListStats.released += s.released;
+		m_temporaryListStats.pooled += s.pooled;
+		m_temporaryListStats.pooledBytes += s.pooledBytes;
 	}
 	m_genericList->Clear();
 }
@@ -798,6 +1416,14 @@ vsRenderQueue::IsOrthographic()
 	return true;
 }
 
+const vsFrustum *
+vsRenderQueue::GetFrustum()
+{
+	if ( m_parent && m_parent->Is3D() && m_parent->GetCamera3D() )
+		return &m_parent->GetCamera3D()->GetFrustum();
+	return NULL;
+}
+
 void
 vsRenderQueue::DeinitialiseTransformStack()
 {
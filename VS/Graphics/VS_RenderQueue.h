@@ -24,6 +24,7 @@ class vsDisplayList;
 class vsCamera2D;
 class vsCamera3D;
 class vsFog;
+class vsFrustum;
 class vsLight;
 class vsFragment;
 class vsShaderValues;
@@ -33,6 +34,69 @@ class vsRenderQueueStage;
 
 class vsRenderQueue
 {
+public:
+	// How many material, shader and texture changes the queue's contents
+	// needed during the last Draw(), in the order they were queued and in the
+	// order they were actually drawn after sorting.
+	struct SortStats
+	{
+		int elements;
+		int materialSwitchesUnsorted;
+		int materialSwitchesSorted;
+		int shaderSwitchesUnsorted;
+		int shaderSwitchesSorted;
+		int textureSwitchesUnsorted;
+		int textureSwitchesSorted;
+
+		SortStats():
+			elements(0),
+			materialSwitchesUnsorted(0),
+			materialSwitchesSorted(0),
+			shaderSwitchesUnsorted(0),
+			shaderSwitchesSorted(0),
+			textureSwitchesUnsorted(0),
+			textureSwitchesSorted(0)
+		{
+		}
+	};
+
+	// How many elements the last Draw() drew instanced automatically.
+	struct InstancingStats
+	{
+		int instancedDraws;		// instanced draws we made
+		int elementsInstanced;	// how many separate elements went into them
+		int drawsSaved;			// elementsInstanced - instancedDraws
+
+		InstancingStats():
+			instancedDraws(0),
+			elementsInstanced(0),
+			drawsSaved(0)
+		{
+		}
+	};
+
+	// How the queue handed out temporary display lists during the last frame.
+	// Temporary lists are pooled by size and kept between frames, so once
+	// the pool has warmed up, 'allocated' should stay at zero.
+	struct TemporaryListStats
+	{
+		int requested;		// MakeTemporaryBatchList() calls
+		int allocated;		// ..which needed a new display list
+		int released;		// pooled lists freed after going unused for a while
+		int pooled;			// display lists held in the pool
+		size_t pooledBytes;	// ..and their total capacity
+
+		TemporaryListStats():
+			requested(0),
+			allocated(0),
+			released(0),
+			pooled(0),
+			pooledBytes(0)
+		{
+		}
+	};
+
+private:
 	vsScene *				m_parent;
 
 	vsDisplayList *			m_genericList;
@@ -50,7 +114,20 @@ class vsRenderQueue
 	float m_fov;
 	// bool m_orthographic;
 
+	bool					m_sorting;
+	SortStats				m_sortStats;
+
+	bool					m_optimizing;
+	vsDisplayList::OptimizeStats	m_optimizeStats;
+
+	bool					m_autoInstancing;
+	int						m_autoInstanceThreshold;
+	InstancingStats			m_instancingStats;
+
+	TemporaryListStats		m_temporaryListStats;
+
 	int				PickStageForMaterial( vsMaterial *material );
+	void			DrawStage( vsDisplayList *list, int stageId );
 
 	void			InitialiseTransformStack();
 	void			DeinitialiseTransformStack();
@@ -72,6 +149,49 @@ public:
 	void			Draw( vsDisplayList *list );	// write our queue contents into here.  Called internally.
 	void			EndRender();
 
+	// Parallel gathering.  A queue being filled on a worker thread must defer
+	// its dynamic batching (which isn't threadsafe);  that happens instead when
+	// it's merged into the main thread's queue.
+	void			SetDeferDynamicBatching( bool defer );
+
+	// Append everything queued into 'other' onto this queue, producing exactly
+	// the same result as if it had all been queued into this queue directly,
+	// after everything already here.  Both queues must have been started with
+	// the same scene, and 'other' mustn't be ended until after we've drawn.
+	void			Merge( vsRenderQueue *other );
+
+	// When sorting is enabled, each stage's contents are radix-sorted by a
+	// packed 64-bit key before being drawn, to group draws by shader and
+	// texture.  Material layers still draw in order (a stage may use up to
+	// 256 distinct layers while sorting), materials which don't read the
+	// depth buffer are never reordered relative to anything else, and blended
+	// materials draw after opaque ones, back to front.  See
+	// VS_RenderQueue.cpp.  Off by default, since it changes the order in
+	// which things draw.
+	void			SetSorting( bool sort ) { m_sorting = sort; }
+	bool			IsSorting() { return m_sorting; }
+	const SortStats& GetSortStats() { return m_sortStats; }
+
+	// When optimizing is enabled, the ops we write in Draw() are passed
+	// through vsDisplayList::Optimize() afterward, to strip out the state
+	// changes which consecutive elements didn't actually need.  Off by default.
+	void			SetOptimizing( bool optimize ) { m_optimizing = optimize; }
+	bool			IsOptimizing() { return m_optimizing; }
+	const vsDisplayList::OptimizeStats& GetOptimizeStats() { return m_optimizeStats; }
+
+	// When auto-instancing is enabled, at least 'threshold' non-instanced
+	// elements in one stage drawing the same vbo/ibo or display list with the
+	// same material are drawn as a single instanced draw instead.  Only
+	// depth-tested, unblended materials are instanced this way, since it
+	// changes the order in which those elements are drawn.  Off by default.
+	void			SetAutoInstancing( bool instance ) { m_autoInstancing = instance; }
+	bool			IsAutoInstancing() { return m_autoInstancing; }
+	void			SetAutoInstanceThreshold( int threshold ) { m_autoInstanceThreshold = vsMax( 2, threshold ); }
+	int				GetAutoInstanceThreshold() { return m_autoInstanceThreshold; }
+	const InstancingStats& GetInstancingStats() { return m_instancingStats; }
+
+	const TemporaryListStats& GetTemporaryListStats() { return m_temporaryListStats; }
+
 	const vsMatrix4x4& PushMatrix( const vsMatrix4x4 &matrix );
     const vsMatrix4x4& PushTransform2D( const vsTransform2D &transform );
 	const vsMatrix4x4& PushTranslation( const vsVector3D &vector );
@@ -85,6 +205,7 @@ public:
 	float			GetFOV() { return m_fov; }
 	void			SetFOV( float fov ) { m_fov = fov; }
 	bool			IsOrthographic();
+	const vsFrustum *	GetFrustum();	// the 3D camera's view frustum, or NULL if we're not drawing a 3D scene
 
 	void SetProjectionMatrix( const vsMatrix4x4& mat ) { m_projection = mat; }
 
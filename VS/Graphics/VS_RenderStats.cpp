@@ -0,0 +1,208 @@
+/*
+ *  VS_RenderStats.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+#include "VS_RenderStats.h"
+
+#include "VS_BuiltInFont.h"
+#include "VS_Renderer.h"
+#include "VS_Scene.h"
+#include "VS_Screen.h"
+#include "VS_Sprite.h"
+
+#include "VS/Files/VS_File.h"
+
+#include "VS_DisableDebugNew.h"
+#include <atomic>
+#include "VS_EnableDebugNew.h"
+
+static std::atomic<int> s_bufferDataCalls(0);
+static std::atomic<size_t> s_bufferDataBytes(0);
+static std::atomic<int> s_mapBufferRangeCalls(0);
+static std::atomic<size_t> s_mapBufferRangeBytes(0);
+
+static vsFile *s_csv = NULL;
+
+vsRenderStats::vsRenderStats()
+{
+	Clear();
+}
+
+void
+vsRenderStats::Clear()
+{
+	frame = 0;
+	ops = 0;
+	for ( int i = 0; i < vsDisplayList::OpCode_MAX; i++ )
+		opCount[i] = 0;
+	drawCalls = 0;
+	instancedDrawCalls = 0;
+	instances = 0;
+	triangles = 0;
+	stateFlushes = 0;
+	stateChanges = 0;
+	shaderBinds = 0;
+	textureBinds = 0;
+	bufferDataCalls = 0;
+	bufferDataBytes = 0;
+	mapBufferRangeCalls = 0;
+	mapBufferRangeBytes = 0;
+}
+
+void
+vsRenderStats::CountBufferData( size_t bytes )
+{
+	s_bufferDataCalls.fetch_add( 1, std::memory_order_relaxed );
+	s_bufferDataBytes.fetch_add( bytes, std::memory_order_relaxed );
+}
+
+void
+vsRenderStats::CountMapBufferRange( size_t bytes )
+{
+	s_mapBufferRangeCalls.fetch_add( 1, std::memory_order_relaxed );
+	s_mapBufferRangeBytes.fetch_add( bytes, std::memory_order_relaxed );
+}
+
+void
+vsRenderStats::CollectBufferCounts()
+{
+	bufferDataCalls += s_bufferDataCalls.exchange( 0, std::memory_order_relaxed );
+	bufferDataBytes += s_bufferDataBytes.exchange( 0, std::memory_order_relaxed );
+	mapBufferRangeCalls += s_mapBufferRangeCalls.exchange( 0, std::memory_order_relaxed );
+	mapBufferRangeBytes += s_mapBufferRangeBytes.exchange( 0, std::memory_order_relaxed );
+}
+
+vsString
+vsRenderStats::ToString() const
+{
+	return vsFormatString("%d draws (%d instanced), %d instances, %d triangles\n"
+			"%d state flushes, %d state changes\n"
+			"%d shader binds, %d texture binds\n"
+			"%d buffer uploads, %d kb\n"
+			"%d buffer maps, %d kb\n"
+			"%d ops",
+			drawCalls, instancedDrawCalls, instances, triangles,
+			stateFlushes, stateChanges,
+			shaderBinds, textureBinds,
+			bufferDataCalls, (int)(bufferDataBytes / 1024),
+			mapBufferRangeCalls, (int)(mapBufferRangeBytes / 1024),
+			ops);
+}
+
+#if defined(DEBUG_SCENE)
+
+// Draws the renderer's stats for the previous frame at the top left of the
+// debug scene.
+class vsRenderStatsSprite : public vsSprite
+{
+	vsDisplayList m_line;
+public:
+	vsRenderStatsSprite():
+		vsSprite( new vsDisplayList(1024 * 16) ),
+		m_line(1024 * 2)
+	{
+		SetMaterial("White");
+	}
+
+	virtual void Update( float timeStep )
+	{
+		UNUSED(timeStep);
+		const float c_size = 12.f;
+		const float c_lineHeight = 16.f;
+
+		m_displayList->Clear();
+		const vsRenderStats *stats = vsRenderer::Instance()->GetRenderStats();
+		if ( !stats )
+			return;
+
+		SetPosition( vsScreen::Instance()->GetDebugScene()->GetTopLeftCorner() + vsVector2D(10.f, 20.f) );
+
+		vsString text = stats->ToString();
+		float y = 0.f;
+		size_t start = 0;
+		while ( start < text.size() )
+		{
+			size_t end = text.find('\n', start);
+			if ( end == vsString::npos )
+				end = text.size();
+			vsBuiltInFont::CreateStringInDisplayList( &m_line, text.substr(start, end-start), c_size );
+			m_displayList->PushTranslation( vsVector3D(0.f, y, 0.f) );
+			m_displayList->Append( m_line );
+			m_displayList->PopTransform();
+			y += c_lineHeight;
+			start = end + 1;
+		}
+	}
+};
+
+static vsRenderStatsSprite *s_overlay = NULL;
+
+#endif // DEBUG_SCENE
+
+void
+vsRenderStats::ShowOverlay( bool show )
+{
+#if defined(DEBUG_SCENE)
+	if ( show && !s_overlay )
+	{
+		s_overlay = new vsRenderStatsSprite;
+		vsScreen::Instance()->GetDebugScene()->RegisterEntityOnTop( s_overlay );
+	}
+	else if ( !show )
+	{
+		vsDelete( s_overlay );
+	}
+#endif // DEBUG_SCENE
+}
+
+bool
+vsRenderStats::IsOverlayVisible()
+{
+#if defined(DEBUG_SCENE)
+	return s_overlay != NULL;
+#else
+	return false;
+#endif // DEBUG_SCENE
+}
+
+void
+vsRenderStats::StartCSV( const vsString &filename )
+{
+	StopCSV();
+	s_csv = new vsFile( filename, vsFile::MODE_WriteDirectly );
+
+	vsString header("frame,draws,instanced_draws,instances,triangles,state_flushes,state_changes,shader_binds,texture_binds,buffer_data_calls,buffer_data_bytes,map_buffer_range_calls,map_buffer_range_bytes,ops");
+	for ( int i = 0; i < vsDisplayList::OpCode_MAX; i++ )
+		header += "," + vsDisplayList::GetOpCodeString( (vsDisplayList::OpCode)i );
+	header += "\n";
+	s_csv->WriteBytes( header.c_str(), header.size() );
+}
+
+void
+vsRenderStats::StopCSV()
+{
+	vsDelete( s_csv );
+}
+
+void
+vsRenderStats::WriteCSV( const vsRenderStats &s )
+{
+	if ( !s_csv )
+		return;
+
+	vsString line = vsFormatString("%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d",
+			s.frame, s.drawCalls, s.instancedDrawCalls, s.instances, s.triangles,
+			s.stateFlushes, s.stateChanges, s.shaderBinds, s.textureBinds,
+			s.bufferDataCalls, s.bufferDataBytes,
+			s.mapBufferRangeCalls, s.mapBufferRangeBytes,
+			s.ops);
+	for ( int i = 0; i < vsDisplayList::OpCode_MAX; i++ )
+		line += vsFormatString(",%d", s.opCount[i]);
+	line += "\n";
+	s_csv->WriteBytes( line.c_str(), line.size() );
+}
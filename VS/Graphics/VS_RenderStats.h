@@ -0,0 +1,67 @@
+/*
+ *  VS_RenderStats.h
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+#ifndef VS_RENDERSTATS_H
+#define VS_RENDERSTATS_H
+
+#include "VS_DisplayList.h"
+
+class vsFile;
+
+// vsRenderStats counts the work a renderer did during one frame:  how many
+// draw calls, instances and triangles it submitted, how often it flushed
+// render state (and how many GL states actually changed as a result), how
+// many shader and texture binds it made, how much data it pushed into GL
+// buffers, and how many of each display list op it processed.
+//
+// vsRenderer::GetRenderStats() returns the totals for the most recently
+// completed frame.  vsRenderStats::ShowOverlay() draws those on screen, in
+// the debug scene, and vsRenderStats::StartCSV() writes one line per frame
+// into a CSV file until StopCSV() is called.
+
+struct vsRenderStats
+{
+	int		frame;
+	int		ops;
+	int		opCount[vsDisplayList::OpCode_MAX];
+	int		drawCalls;
+	int		instancedDrawCalls;
+	int		instances;			// every instance drawn, including single-instance draws
+	int		triangles;			// across all instances
+	int		stateFlushes;		// vsRendererState::Flush() calls
+	int		stateChanges;		// GL state actually changed by those flushes
+	int		shaderBinds;
+	int		textureBinds;
+	int		bufferDataCalls;	// glBufferData and glBufferSubData uploads;  orphaning isn't counted
+	size_t	bufferDataBytes;
+	int		mapBufferRangeCalls;
+	size_t	mapBufferRangeBytes;
+
+	vsRenderStats();
+	void Clear();
+
+	// GL buffer traffic comes from vsRenderBuffer and vsShader, which don't
+	// know which renderer they're working for (and which may be called from
+	// a loading thread), so it's counted here and collected into each frame's
+	// stats by the renderer when the frame ends.
+	static void CountBufferData( size_t bytes );
+	static void CountMapBufferRange( size_t bytes );
+	void		CollectBufferCounts();
+
+	vsString	ToString() const;
+
+	static void	ShowOverlay( bool show );
+	static bool	IsOverlayVisible();
+
+	static void	StartCSV( const vsString &filename );
+	static void	StopCSV();
+	static void	WriteCSV( const vsRenderStats &stats );	// called by the renderer at the end of each frame
+};
+
+#endif // VS_RENDERSTATS_H
@@ -29,6 +29,7 @@ class vsShaderSuite;
 class vsTransform2D;
 class vsVector2D;
 struct SDL_Surface;
+struct vsRenderStats;
 
 class vsRenderer
 {
@@ -65,9 +66,14 @@ public:
 	int					m_viewportWidthPixels;
 	int					m_viewportHeightPixels;
 
+	// true if we're not really drawing anything (see vsRenderer_Null), so
+	// there's no GL context for shaders, textures, and so on to use.
+	bool				m_headless;
+
 public:
 
 	static vsRenderer* Instance() { return s_instance; }
+	static bool IsHeadless() { return s_instance && s_instance->m_headless; }
 	enum
 	{
 		Flag_Fullscreen = BIT(0),
@@ -116,6 +122,10 @@ public:
 	virtual vsImage*	ScreenshotBack() = 0;
 	virtual vsImage*	ScreenshotDepth() = 0;
 	virtual vsImage*	ScreenshotAlpha() = 0;
+
+	// Counters for the most recently completed frame, or NULL if this
+	// renderer doesn't keep them.
+	virtual const vsRenderStats *	GetRenderStats() const { return NULL; }
 };
 
 #endif // VS_RENDERER_H
@@ -114,7 +114,9 @@ public:
 	}
 };
 
-vsRendererState::vsRendererState()
+vsRendererState::vsRendererState():
+	m_flushCount(0),
+	m_changeCount(0)
 {
 	// m_boolState[Bool_AlphaTest] =		new glEnableSetter( GL_ALPHA_TEST, false );
 	m_boolState[Bool_Blend] =			new glEnableSetter( GL_BLEND, false );
@@ -192,13 +194,16 @@ vsRendererState::SetInt( vsRendererState::Int key, int value )
 void
 vsRendererState::Flush()
 {
+	m_flushCount++;
 	for ( int i = 0; i < BOOL_COUNT; i++ )
 	{
-		m_boolState[i]->Flush();
+		if ( m_boolState[i]->Flush() )
+			m_changeCount++;
 	}
     for ( int i = 0; i < INT_COUNT; i++ )
     {
-        m_intState[i]->Flush();
+        if ( m_intState[i]->Flush() )
+            m_changeCount++;
     }
 	/*for ( int i = 0; i < FLOAT_COUNT; i++ )
 	{
@@ -206,7 +211,8 @@ vsRendererState::Flush()
 	}*/
 	for ( int i = 0; i < FLOAT2_COUNT; i++ )
 	{
-		m_float2State[i]->Flush();
+		if ( m_float2State[i]->Flush() )
+			m_changeCount++;
 	}
 }
 
@@ -32,13 +32,15 @@ public:
 
 	virtual void DoFlush() = 0;
 
-	void Flush()
+	bool Flush()	// returns true if the value changed
 	{
 		if ( m_nextValue != m_value )
 		{
 			m_value = m_nextValue;
 			DoFlush();
+			return true;
 		}
+		return false;
 	}
 	void Force()
 	{
@@ -74,14 +76,16 @@ public:
 
 	virtual void DoFlush() = 0;
 
-	void Flush()
+	bool Flush()	// returns true if either value changed
 	{
 		if ( m_nextValueA != m_valueA || m_nextValueB != m_valueB )
 		{
 			m_valueA = m_nextValueA;
 			m_valueB = m_nextValueB;
 			DoFlush();
+			return true;
 		}
+		return false;
 	}
 	void Force()
 	{
@@ -137,6 +141,8 @@ private:
     StateSetter2<float,float>	*m_float2State[FLOAT2_COUNT];
 	StateSetter<int>	*m_intState[INT_COUNT];
 
+	int		m_flushCount;
+	int		m_changeCount;
 
 public:
 
@@ -151,6 +157,12 @@ public:
 	void	Flush();
 	void	Force();
 
+	// How many times we've been flushed, and how many GL states those
+	// flushes actually changed, since the last ResetStats().
+	int		GetFlushCount() const { return m_flushCount; }
+	int		GetChangeCount() const { return m_changeCount; }
+	void	ResetStats() { m_flushCount = m_changeCount = 0; }
+
 };
 
 #endif // VS_RENDERER_STATE_H
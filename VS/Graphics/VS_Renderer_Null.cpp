@@ -0,0 +1,479 @@
+/*
+ *  VS_Renderer_Null.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+#include "VS_Renderer_Null.h"
+
+#include "VS_Material.h"
+#include "VS_RenderBuffer.h"
+#include "VS_Texture.h"
+
+vsRenderer_Null::Stats::Stats()
+{
+	Clear();
+}
+
+void
+vsRenderer_Null::Stats::Clear()
+{
+	ops = 0;
+	for ( int i = 0; i < vsDisplayList::OpCode_MAX; i++ )
+		opCount[i] = 0;
+	drawCalls = 0;
+	instancedDrawCalls = 0;
+	instances = 0;
+	indices = 0;
+	primitives = 0;
+	materialChanges = 0;
+	shaderChanges = 0;
+	textureChanges = 0;
+	renderTargetChanges = 0;
+	maxTransformStackDepth = 0;
+}
+
+vsRenderer_Null::Stats&
+vsRenderer_Null::Stats::operator+=( const Stats& o )
+{
+	ops += o.ops;
+	for ( int i = 0; i < vsDisplayList::OpCode_MAX; i++ )
+		opCount[i] += o.opCount[i];
+	drawCalls += o.drawCalls;
+	instancedDrawCalls += o.instancedDrawCalls;
+	instances += o.instances;
+	indices += o.indices;
+	primitives += o.primitives;
+	materialChanges += o.materialChanges;
+	shaderChanges += o.shaderChanges;
+	textureChanges += o.textureChanges;
+	renderTargetChanges += o.renderTargetChanges;
+	maxTransformStackDepth = vsMax( maxTransformStackDepth, o.maxTransformStackDepth );
+	return *this;
+}
+
+vsRenderer_Null::vsRenderer_Null(int width, int height, int depth, int flags):
+	vsRenderer(width, height, depth, flags),
+	m_currentTransformStackLevel(0),
+	m_currentLocalToWorld(NULL),
+	m_currentLocalToWorldBuffer(NULL),
+	m_currentLocalToWorldCount(0),
+	m_currentColors(NULL),
+	m_currentColorsBuffer(NULL),
+	m_currentMaterial(NULL),
+	m_currentMaterialInternal(NULL),
+	m_currentShader(NULL),
+	m_currentShaderVariant(-1),
+	m_currentShaderValues(NULL),
+	m_currentRenderTarget(NULL),
+	m_currentVertexArray(NULL),
+	m_currentVertexBuffer(NULL),
+	m_currentVertexArrayCount(0),
+	m_currentBoundBuffer(NULL),
+	m_frameCount(0)
+{
+	m_headless = true;
+	m_widthPixels = m_viewportWidthPixels = width;
+	m_heightPixels = m_viewportHeightPixels = height;
+	for ( int i = 0; i < MAX_TEXTURE_SLOTS; i++ )
+		m_currentTexture[i] = NULL;
+
+	vsLog("Headless renderer: %dx%d, no GL context", width, height);
+}
+
+vsRenderer_Null::~vsRenderer_Null()
+{
+	if ( m_frameCount > 0 )
+		LogStats();
+}
+
+bool
+vsRenderer_Null::CheckVideoMode()
+{
+	return false;
+}
+
+void
+vsRenderer_Null::UpdateVideoMode(int width, int height, int depth, WindowType type, int bufferCount, bool antialias, bool vsync)
+{
+	NotifyResized(width, height);
+}
+
+void
+vsRenderer_Null::NotifyResized(int width, int height)
+{
+	m_width = m_viewportWidth = width;
+	m_height = m_viewportHeight = height;
+	m_widthPixels = m_viewportWidthPixels = width;
+	m_heightPixels = m_viewportHeightPixels = height;
+}
+
+void
+vsRenderer_Null::PreRender(const Settings &s)
+{
+	m_currentSettings = s;
+	m_currentMaterial = NULL;
+	m_currentMaterialInternal = NULL;
+	m_currentShader = NULL;
+	m_currentShaderVariant = -1;
+	m_currentShaderValues = NULL;
+	m_currentColor = c_white;
+	m_currentRenderTarget = NULL;
+	m_currentBoundBuffer = NULL;
+	for ( int i = 0; i < MAX_TEXTURE_SLOTS; i++ )
+		m_currentTexture[i] = NULL;
+
+	m_frameStats.Clear();
+}
+
+void
+vsRenderer_Null::RenderDisplayList( vsDisplayList *list )
+{
+	RawRenderDisplayList(list);
+}
+
+void
+vsRenderer_Null::PostRender()
+{
+	m_lastFrameStats = m_frameStats;
+	m_totalStats += m_frameStats;
+	m_frameCount++;
+}
+
+void
+vsRenderer_Null::ResetStats()
+{
+	m_frameStats.Clear();
+	m_lastFrameStats.Clear();
+	m_totalStats.Clear();
+	m_frameCount = 0;
+}
+
+void
+vsRenderer_Null::LogStats() const
+{
+	float frames = (float)vsMax(m_frameCount, 1);
+	vsLog("Headless renderer: %d frames", m_frameCount);
+	vsLog("  per frame: %0.1f ops, %0.1f draws (%0.1f instanced, %0.1f instances), %0.1f primitives",
+			m_totalStats.ops / frames,
+			m_totalStats.drawCalls / frames,
+			m_totalStats.instancedDrawCalls / frames,
+			m_totalStats.instances / frames,
+			m_totalStats.primitives / frames);
+	vsLog("  per frame: %0.1f material, %0.1f shader, %0.1f texture, %0.1f render target changes",
+			m_totalStats.materialChanges / frames,
+			m_totalStats.shaderChanges / frames,
+			m_totalStats.textureChanges / frames,
+			m_totalStats.renderTargetChanges / frames);
+	for ( int i = 0; i < vsDisplayList::OpCode_MAX; i++ )
+	{
+		if ( m_totalStats.opCount[i] )
+			vsLog("  %s: %0.1f", vsDisplayList::GetOpCodeString((vsDisplayList::OpCode)i).c_str(), m_totalStats.opCount[i] / frames);
+	}
+}
+
+void
+vsRenderer_Null::SetMaterialInternal(vsMaterialInternal *material)
+{
+	if ( material == m_currentMaterialInternal )
+		return;
+
+	m_currentMaterialInternal = material;
+	m_frameStats.materialChanges++;
+
+	// With no GL context, materials which rely on a default shader don't
+	// have one assigned;  treat each draw mode (with or without texture) as
+	// its own shader, as vsRenderer_OpenGL3::SetMaterialInternal() would.
+	int variant = -1;
+	if ( !material->m_shader )
+		variant = material->m_drawMode * 2 + (material->m_texture[0] ? 1 : 0);
+	if ( material->m_shader != m_currentShader || variant != m_currentShaderVariant )
+	{
+		m_currentShader = material->m_shader;
+		m_currentShaderVariant = variant;
+		m_frameStats.shaderChanges++;
+	}
+
+	for ( int i = 0; i < MAX_TEXTURE_SLOTS; i++ )
+	{
+		vsTextureInternal *t = material->m_texture[i] ? material->m_texture[i]->GetResource() : NULL;
+		if ( t != m_currentTexture[i] )
+		{
+			m_currentTexture[i] = t;
+			if ( t )
+				m_frameStats.textureChanges++;
+		}
+	}
+}
+
+void
+vsRenderer_Null::Draw( int indexCount, int primitives )
+{
+	int instances = vsMax( 1, m_currentLocalToWorldCount );	// 0 means "no transform set yet", not "no instances"
+	m_frameStats.drawCalls++;
+	if ( instances > 1 )
+		m_frameStats.instancedDrawCalls++;
+	m_frameStats.instances += instances;
+	m_frameStats.indices += indexCount;
+	m_frameStats.primitives += primitives * instances;
+}
+
+void
+vsRenderer_Null::RawRenderDisplayList( vsDisplayList *list )
+{
+	m_currentLocalToWorld = NULL;
+	m_currentLocalToWorldCount = 0;
+	m_currentLocalToWorldBuffer = NULL;
+	m_currentColors = NULL;
+	m_currentColorsBuffer = NULL;
+	m_currentVertexArray = NULL;
+	m_currentVertexBuffer = NULL;
+	m_currentVertexArrayCount = 0;
+	m_currentTransformStackLevel = 0;
+
+	m_transformStack[m_currentTransformStackLevel] = vsMatrix4x4::Identity;
+
+	vsDisplayList::op *op = list->PopOp();
+	while(op)
+	{
+		m_frameStats.ops++;
+		m_frameStats.opCount[op->type]++;
+
+		switch( op->type )
+		{
+			case vsDisplayList::OpCode_SetColor:
+				{
+					m_currentColor = op->data.GetColor();
+					m_currentColors = NULL;
+					m_currentColorsBuffer = NULL;
+					break;
+				}
+			case vsDisplayList::OpCode_SetColors:
+				{
+					m_currentColors = (vsColor*)op->data.p;
+					m_currentColorsBuffer = NULL;
+					break;
+				}
+			case vsDisplayList::OpCode_SetColorsBuffer:
+				{
+					m_currentColors = NULL;
+					m_currentColorsBuffer = (vsRenderBuffer*)op->data.p;
+					break;
+				}
+			case vsDisplayList::OpCode_SetMaterial:
+				{
+					vsMaterial *material = (vsMaterial *)op->data.p;
+					SetMaterialInternal( material->GetResource() );
+					m_currentMaterial = material;
+					m_currentColors = NULL;
+					m_currentColorsBuffer = NULL;
+					break;
+				}
+			case vsDisplayList::OpCode_SetRenderTarget:
+				{
+					vsRenderTarget *target = (vsRenderTarget*)op->data.p;
+					if ( target != m_currentRenderTarget )
+					{
+						m_currentRenderTarget = target;
+						m_frameStats.renderTargetChanges++;
+					}
+					break;
+				}
+			case vsDisplayList::OpCode_PushTransform:
+				{
+					vsTransform2D t = op->data.GetTransform();
+					vsMatrix4x4 localToWorld = m_transformStack[m_currentTransformStackLevel] * t.GetMatrix();
+					m_transformStack[++m_currentTransformStackLevel] = localToWorld;
+					m_currentLocalToWorld = &m_transformStack[m_currentTransformStackLevel];
+					m_currentLocalToWorldCount = 1;
+					m_currentLocalToWorldBuffer = NULL;
+					break;
+				}
+			case vsDisplayList::OpCode_PushTranslation:
+				{
+					vsMatrix4x4 m;
+					m.SetTranslation(op->data.vector);
+					vsMatrix4x4 localToWorld = m_transformStack[m_currentTransformStackLevel] * m;
+					m_transformStack[++m_currentTransformStackLevel] = localToWorld;
+					m_currentLocalToWorld = &m_transformStack[m_currentTransformStackLevel];
+					m_currentLocalToWorldCount = 1;
+					m_currentLocalToWorldBuffer = NULL;
+					break;
+				}
+			case vsDisplayList::OpCode_PushMatrix4x4:
+				{
+					vsMatrix4x4 localToWorld = m_transformStack[m_currentTransformStackLevel] * op->data.GetMatrix4x4();
+					m_transformStack[++m_currentTransformStackLevel] = localToWorld;
+					m_currentLocalToWorld = &m_transformStack[m_currentTransformStackLevel];
+					m_currentLocalToWorldCount = 1;
+					m_currentLocalToWorldBuffer = NULL;
+					break;
+				}
+			case vsDisplayList::OpCode_SetMatrix4x4:
+				{
+					m_transformStack[++m_currentTransformStackLevel] = op->data.matrix4x4;
+					m_currentLocalToWorld = &m_transformStack[m_currentTransformStackLevel];
+					m_currentLocalToWorldCount = 1;
+					m_currentLocalToWorldBuffer = NULL;
+					break;
+				}
+			case vsDisplayList::OpCode_SetMatrices4x4:
+				{
+					vsMatrix4x4 *m = (vsMatrix4x4*)op->data.p;
+					m_transformStack[++m_currentTransformStackLevel] = m[0];
+					m_currentLocalToWorld = m;
+					m_currentLocalToWorldCount = op->data.i;
+					m_currentLocalToWorldBuffer = NULL;
+					break;
+				}
+			case vsDisplayList::OpCode_SetMatrices4x4Buffer:
+				{
+					vsRenderBuffer *b = (vsRenderBuffer*)op->data.p;
+					m_transformStack[++m_currentTransformStackLevel] = vsMatrix4x4::Identity;
+					m_currentLocalToWorld = NULL;
+					m_currentLocalToWorldCount = b->GetActiveMatrix4x4ArraySize();
+					m_currentLocalToWorldBuffer = b;
+					break;
+				}
+			case vsDisplayList::OpCode_SnapMatrix:
+				{
+					vsMatrix4x4 m = m_transformStack[m_currentTransformStackLevel];
+					vsVector4D &t = m.w;
+					t.x = (float)vsFloor(t.x + 0.5f);
+					t.y = (float)vsFloor(t.y + 0.5f);
+					t.z = (float)vsFloor(t.z + 0.5f);
+					m_transformStack[++m_currentTransformStackLevel] = m;
+					m_currentLocalToWorld = &m_transformStack[m_currentTransformStackLevel];
+					m_currentLocalToWorldCount = 1;
+					m_currentLocalToWorldBuffer = NULL;
+					break;
+				}
+			case vsDisplayList::OpCode_PopTransform:
+				{
+					vsAssert(m_currentTransformStackLevel > 0, "Renderer transform stack underflow??");
+					m_currentTransformStackLevel--;
+					m_currentLocalToWorld = &m_transformStack[m_currentTransformStackLevel];
+					m_currentLocalToWorldCount = 1;
+					m_currentLocalToWorldBuffer = NULL;
+					break;
+				}
+			case vsDisplayList::OpCode_SetWorldToViewMatrix4x4:
+				{
+					m_currentWorldToView = op->data.GetMatrix4x4();
+					break;
+				}
+			case vsDisplayList::OpCode_SetProjectionMatrix4x4:
+				{
+					m_currentViewToProjection = op->data.GetMatrix4x4();
+					break;
+				}
+			case vsDisplayList::OpCode_SetShaderValues:
+				{
+					m_currentShaderValues = (vsShaderValues*)op->data.p;
+					break;
+				}
+			case vsDisplayList::OpCode_VertexArray:
+				{
+					m_currentVertexArray = (vsVector3D*)op->data.p;
+					m_currentVertexArrayCount = op->data.i;
+					m_currentVertexBuffer = NULL;
+					break;
+				}
+			case vsDisplayList::OpCode_VertexBuffer:
+				{
+					m_currentVertexBuffer = (vsRenderBuffer *)op->data.p;
+					m_currentVertexArray = NULL;
+					m_currentVertexArrayCount = 0;
+					break;
+				}
+			case vsDisplayList::OpCode_ClearVertexArray:
+			case vsDisplayList::OpCode_ClearArrays:
+				{
+					m_currentVertexBuffer = NULL;
+					m_currentVertexArray = NULL;
+					m_currentVertexArrayCount = 0;
+					break;
+				}
+			case vsDisplayList::OpCode_BindBuffer:
+				{
+					m_currentVertexBuffer = NULL;
+					m_currentVertexArray = NULL;
+					m_currentVertexArrayCount = 0;
+					m_currentBoundBuffer = (vsRenderBuffer *)op->data.p;
+					break;
+				}
+			case vsDisplayList::OpCode_UnbindBuffer:
+				{
+					m_currentBoundBuffer = NULL;
+					break;
+				}
+			case vsDisplayList::OpCode_LineListArray:
+				{
+					int count = op->data.GetUInt();
+					Draw( count, count / 2 );
+					break;
+				}
+			case vsDisplayList::OpCode_LineStripArray:
+				{
+					int count = op->data.GetUInt();
+					Draw( count, vsMax(count - 1, 0) );
+					break;
+				}
+			case vsDisplayList::OpCode_TriangleListArray:
+				{
+					int count = op->data.GetUInt();
+					Draw( count, count / 3 );
+					break;
+				}
+			case vsDisplayList::OpCode_TriangleStripArray:
+			case vsDisplayList::OpCode_TriangleFanArray:
+				{
+					int count = op->data.GetUInt();
+					Draw( count, vsMax(count - 2, 0) );
+					break;
+				}
+			case vsDisplayList::OpCode_PointsArray:
+				{
+					int count = op->data.GetUInt();
+					Draw( count, count );
+					break;
+				}
+			case vsDisplayList::OpCode_LineListBuffer:
+				{
+					int count = ((vsRenderBuffer *)op->data.p)->GetIntArraySize();
+					Draw( count, count / 2 );
+					break;
+				}
+			case vsDisplayList::OpCode_LineStripBuffer:
+				{
+					int count = ((vsRenderBuffer *)op->data.p)->GetIntArraySize();
+					Draw( count, vsMax(count - 1, 0) );
+					break;
+				}
+			case vsDisplayList::OpCode_TriangleListBuffer:
+				{
+					int count = ((vsRenderBuffer *)op->data.p)->GetIntArraySize();
+					Draw( count, count / 3 );
+					break;
+				}
+			case vsDisplayList::OpCode_TriangleStripBuffer:
+			case vsDisplayList::OpCode_TriangleFanBuffer:
+				{
+					int count = ((vsRenderBuffer *)op->data.p)->GetIntArraySize();
+					Draw( count, vsMax(count - 2, 0) );
+					break;
+				}
+			default:
+				// Everything else is GPU state which we don't model;  counting
+				// the op is all there is to do.
+				break;
+		}
+		m_frameStats.maxTransformStackDepth = vsMax( m_frameStats.maxTransformStackDepth, m_currentTransformStackLevel );
+		vsAssert( m_currentTransformStackLevel < NULL_RENDERER_STACK_LEVEL, "Renderer transform stack overflow??" );
+
+		op = list->PopOp();
+	}
+}
@@ -0,0 +1,120 @@
+/*
+ *  VS_Renderer_Null.h
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+#ifndef VS_RENDERER_NULL_H
+#define VS_RENDERER_NULL_H
+
+#include "VS_Renderer.h"
+#include "VS_DisplayList.h"
+#include "VS_MaterialInternal.h"
+
+#define NULL_RENDERER_STACK_LEVEL (30)
+
+// vsRenderer_Null is a headless renderer.  It decodes display lists exactly
+// as vsRenderer_OpenGL3 does, tracking the transform stack, material, array
+// and buffer state, but it never talks to a GPU;  instead, it counts what
+// it would have done.  Use it (via the '--headless' command line argument)
+// to measure the CPU side of rendering -- gathering, sorting, and display
+// list processing -- without the driver getting in the way.
+
+class vsRenderer_Null: public vsRenderer
+{
+public:
+
+	struct Stats
+	{
+		int ops;
+		int opCount[vsDisplayList::OpCode_MAX];
+		int drawCalls;
+		int instancedDrawCalls;
+		int instances;			// total instances drawn, including single-instance draws
+		int indices;			// indices submitted, per instance
+		int primitives;			// triangles, lines, or points, across all instances
+		int materialChanges;
+		int shaderChanges;
+		int textureChanges;
+		int renderTargetChanges;
+		int maxTransformStackDepth;
+
+		Stats();
+		void Clear();
+		Stats& operator+=( const Stats& o );
+	};
+
+private:
+
+	vsMatrix4x4			m_transformStack[NULL_RENDERER_STACK_LEVEL];
+	int					m_currentTransformStackLevel;
+
+	vsMatrix4x4 *		m_currentLocalToWorld;
+	vsRenderBuffer *	m_currentLocalToWorldBuffer;
+	int					m_currentLocalToWorldCount;
+	vsMatrix4x4			m_currentWorldToView;
+	vsMatrix4x4			m_currentViewToProjection;
+
+	vsColor				m_currentColor;
+	vsColor *			m_currentColors;
+	vsRenderBuffer *	m_currentColorsBuffer;
+
+	vsMaterial *		m_currentMaterial;
+	vsMaterialInternal *m_currentMaterialInternal;
+	vsShader *			m_currentShader;
+	int					m_currentShaderVariant;	// for materials using default shaders;  see SetMaterialInternal()
+	vsShaderValues *	m_currentShaderValues;
+	vsTextureInternal *	m_currentTexture[MAX_TEXTURE_SLOTS];
+	vsRenderTarget *	m_currentRenderTarget;
+
+	vsVector3D *		m_currentVertexArray;
+	vsRenderBuffer *	m_currentVertexBuffer;
+	int					m_currentVertexArrayCount;
+	vsRenderBuffer *	m_currentBoundBuffer;
+
+	Stats				m_frameStats;		// the frame being rendered right now
+	Stats				m_lastFrameStats;	// the most recently completed frame
+	Stats				m_totalStats;		// every completed frame since the last ResetStats()
+	int					m_frameCount;
+
+	void	SetMaterialInternal( vsMaterialInternal *material );
+	void	Draw( int indexCount, int primitives );
+
+public:
+
+	vsRenderer_Null(int width, int height, int depth, int flags);
+	virtual ~vsRenderer_Null();
+
+	static vsRenderer_Null* Instance() { return IsHeadless() ? static_cast<vsRenderer_Null*>(vsRenderer::Instance()) : NULL; }
+
+	virtual bool	CheckVideoMode();
+	virtual void	UpdateVideoMode(int width, int height, int depth, WindowType type, int bufferCount, bool antialias, bool vsync);
+	virtual void	NotifyResized(int width, int height);
+
+	virtual void	PreRender( const Settings &s );
+	virtual void	RenderDisplayList( vsDisplayList *list );
+	virtual void	RawRenderDisplayList( vsDisplayList *list );
+	virtual void	PostRender();
+
+	// We have no render targets;  display lists may reference them, but we
+	// never look at them.
+	virtual vsRenderTarget *GetMainRenderTarget() { return NULL; }
+	virtual vsRenderTarget *GetPresentTarget() { return NULL; }
+
+	virtual vsImage*	Screenshot() { return NULL; }
+	virtual vsImage*	Screenshot_Async() { return NULL; }
+	virtual vsImage*	ScreenshotBack() { return NULL; }
+	virtual vsImage*	ScreenshotDepth() { return NULL; }
+	virtual vsImage*	ScreenshotAlpha() { return NULL; }
+
+	const Stats&	GetFrameStats() const { return m_lastFrameStats; }
+	const Stats&	GetTotalStats() const { return m_totalStats; }
+	int				GetFrameCount() const { return m_frameCount; }
+	void			ResetStats();
+	void			LogStats() const;
+};
+
+#endif // VS_RENDERER_NULL_H
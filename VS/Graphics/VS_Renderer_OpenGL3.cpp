@@ -63,7 +63,7 @@ extern "C" {
 SDL_Window *g_sdlWindow = NULL;
 static SDL_GLContext m_sdlGlContext;
 static SDL_GLContext m_loadingGlContext;
-static vsMutex m_loadingGlContextMutex;
+static vsMutex m_loadingGlContextMutex("GL context loading");
 
 bool g_crashOnTextureStateUsageWarning = false;
 
@@ -243,7 +243,8 @@ vsRenderer_OpenGL3::vsRenderer_OpenGL3(int width, int height, int depth, int fla
 	m_scene(NULL),
 	m_currentShaderValues(NULL),
 	m_lastShaderId(0),
-	m_bufferCount(bufferCount)
+	m_bufferCount(bufferCount),
+	m_frameNumber(0)
 {
 	int displayCount = SDL_GetNumVideoDisplays();
 	if (displayCount < 1)
@@ -514,6 +515,7 @@ vsRenderer_OpenGL3::vsRenderer_OpenGL3(int width, int height, int depth, int fla
 
 vsRenderer_OpenGL3::~vsRenderer_OpenGL3()
 {
+	vsRenderStats::StopCSV();
 	{
 		GL_CHECK_SCOPED("vsRenderer_OpenGL3 destructor");
 		vsDelete(m_window);
@@ -865,6 +867,15 @@ vsRenderer_OpenGL3::PostRender()
 
 	vsTimerSystem::Instance()->EndGPUTime();
 	}
+
+	m_stats.frame = m_frameNumber++;
+	m_stats.stateFlushes = m_state.GetFlushCount();
+	m_stats.stateChanges = m_state.GetChangeCount();
+	m_stats.CollectBufferCounts();
+	vsRenderStats::WriteCSV( m_stats );
+	m_lastStats = m_stats;
+	m_stats.Clear();
+	m_state.ResetStats();
 	// {
 	// 	int nowWidth, nowHeight;
 	// 	SDL_GetWindowSize(g_sdlWindow, &nowWidth, &nowHeight);
@@ -938,6 +949,7 @@ vsRenderer_OpenGL3::FlushRenderState()
 		if ( m_lastShaderId != m_currentShader->GetShaderId() )
 		{
 			glUseProgram( m_currentShader->GetShaderId() );
+			m_stats.shaderBinds++;
 			m_currentShader->Prepare( m_currentMaterial, m_currentShaderValues );
 			m_lastShaderId = m_currentShader->GetShaderId();
 			s_previousMaterial = m_currentMaterial;
@@ -995,6 +1007,23 @@ vsRenderer_OpenGL3::FlushRenderState()
 
 }
 
+void
+vsRenderer_OpenGL3::CountDraw( GLenum mode, int indexCount )
+{
+	int instances = vsMax( 1, m_currentLocalToWorldCount );
+	int triangles = 0;
+	if ( mode == GL_TRIANGLES )
+		triangles = indexCount / 3;
+	else if ( mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN )
+		triangles = vsMax( 0, indexCount - 2 );
+
+	m_stats.drawCalls++;
+	if ( instances > 1 )
+		m_stats.instancedDrawCalls++;
+	m_stats.instances += instances;
+	m_stats.triangles += triangles * instances;
+}
+
 void
 vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 {
@@ -1042,6 +1071,8 @@ vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 #ifdef LOG_OPS
 		vsLog("%s", vsDisplayList::GetOpCodeString(op->type).c_str());
 #endif // LOG_OPS
+		m_stats.ops++;
+		m_stats.opCount[op->type]++;
 		switch( op->type )
 		{
 			case vsDisplayList::OpCode_SetColor:
@@ -1366,6 +1397,7 @@ vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 					PROFILE("LineListArray");
 					FlushRenderState();
 					vsRenderBuffer::DrawElementsImmediate( GL_LINES, op->data.p, op->data.GetUInt(), m_currentLocalToWorldCount );
+					CountDraw( GL_LINES, op->data.GetUInt() );
 					break;
 				}
 			case vsDisplayList::OpCode_LineStripArray:
@@ -1373,6 +1405,7 @@ vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 					PROFILE("LineStripArray");
 					FlushRenderState();
 					vsRenderBuffer::DrawElementsImmediate( GL_LINE_STRIP, op->data.p, op->data.GetUInt(), m_currentLocalToWorldCount );
+					CountDraw( GL_LINE_STRIP, op->data.GetUInt() );
 					break;
 				}
 			case vsDisplayList::OpCode_TriangleListArray:
@@ -1382,6 +1415,7 @@ vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 					FlushRenderState();
 
 					vsRenderBuffer::DrawElementsImmediate( GL_TRIANGLES, op->data.p, op->data.GetUInt(), m_currentLocalToWorldCount );
+					CountDraw( GL_TRIANGLES, op->data.GetUInt() );
 					break;
 				}
 			case vsDisplayList::OpCode_TriangleStripArray:
@@ -1390,6 +1424,7 @@ vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 					PROFILE("TriangleStripArray");
 					FlushRenderState();
 					vsRenderBuffer::DrawElementsImmediate( GL_TRIANGLE_STRIP, op->data.p, op->data.GetUInt(), m_currentLocalToWorldCount );
+					CountDraw( GL_TRIANGLE_STRIP, op->data.GetUInt() );
 					break;
 				}
 			case vsDisplayList::OpCode_TriangleStripBuffer:
@@ -1399,6 +1434,7 @@ vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 					FlushRenderState();
 					vsRenderBuffer *ib = (vsRenderBuffer *)op->data.p;
 					ib->TriStripBuffer(m_currentLocalToWorldCount);
+					CountDraw( GL_TRIANGLE_STRIP, ib->GetIntArraySize() );
 					break;
 				}
 			case vsDisplayList::OpCode_TriangleListBuffer:
@@ -1409,6 +1445,7 @@ vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 					FlushRenderState();
 					vsRenderBuffer *ib = (vsRenderBuffer *)op->data.p;
 					ib->TriListBuffer(m_currentLocalToWorldCount);
+					CountDraw( GL_TRIANGLES, ib->GetIntArraySize() );
 					// m_currentShader->ValidateCache( m_currentMaterial );
 					break;
 				}
@@ -1418,6 +1455,7 @@ vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 					FlushRenderState();
 					vsRenderBuffer *ib = (vsRenderBuffer *)op->data.p;
 					ib->TriFanBuffer(m_currentLocalToWorldCount);
+					CountDraw( GL_TRIANGLE_FAN, ib->GetIntArraySize() );
 					break;
 				}
 			case vsDisplayList::OpCode_LineListBuffer:
@@ -1426,6 +1464,7 @@ vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 					FlushRenderState();
 					vsRenderBuffer *ib = (vsRenderBuffer *)op->data.p;
 					ib->LineListBuffer(m_currentLocalToWorldCount);
+					CountDraw( GL_LINES, ib->GetIntArraySize() );
 					break;
 				}
 			case vsDisplayList::OpCode_LineStripBuffer:
@@ -1434,6 +1473,7 @@ vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 					FlushRenderState();
 					vsRenderBuffer *ib = (vsRenderBuffer *)op->data.p;
 					ib->LineStripBuffer(m_currentLocalToWorldCount);
+					CountDraw( GL_LINE_STRIP, ib->GetIntArraySize() );
 					break;
 				}
 			case vsDisplayList::OpCode_TriangleFanArray:
@@ -1441,6 +1481,7 @@ vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 					PROFILE("TriangleFanArray");
 					FlushRenderState();
 					vsRenderBuffer::DrawElementsImmediate( GL_TRIANGLE_FAN, op->data.p, op->data.GetUInt(), m_currentLocalToWorldCount );
+					CountDraw( GL_TRIANGLE_FAN, op->data.GetUInt() );
 					// glDrawElements( GL_TRIANGLE_FAN, op->data.GetUInt(), GL_UNSIGNED_SHORT, op->data.p );
 					break;
 				}
@@ -1449,6 +1490,7 @@ vsRenderer_OpenGL3::RawRenderDisplayList( vsDisplayList *list )
 					PROFILE("PointsArray");
 					FlushRenderState();
 					vsRenderBuffer::DrawElementsImmediate( GL_POINTS, op->data.p, op->data.GetUInt(), m_currentLocalToWorldCount );
+					CountDraw( GL_POINTS, op->data.GetUInt() );
 					// glDrawElements( GL_POINTS, op->data.GetUInt(), GL_UNSIGNED_SHORT, op->data.p );
 					break;
 				}
@@ -1747,6 +1789,7 @@ vsRenderer_OpenGL3::SetMaterialInternal(vsMaterialInternal *material)
 				{
 					GL_CHECK_SCOPED("BufferTexture");
 					glBindTexture( GL_TEXTURE_BUFFER, t->GetResource()->GetTexture() );
+					m_stats.textureBinds++;
 					vsRenderBuffer * buffer = t->GetResource()->GetTextureBuffer();
 					buffer->BindAsTexture();
 				}
@@ -1766,6 +1809,7 @@ vsRenderer_OpenGL3::SetMaterialInternal(vsMaterialInternal *material)
 					else
 					{
 						glBindTexture( GL_TEXTURE_2D, tval);
+						m_stats.textureBinds++;
 						if ( material->m_clampU )
 							glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, material->m_clampU ? GL_CLAMP_TO_EDGE : GL_REPEAT );
 						if ( material->m_clampV )
@@ -17,6 +17,7 @@
 #include "VS_Fog.h"
 #include "VS_Material.h"
 #include "VS_RendererState.h"
+#include "VS_RenderStats.h"
 #include "VS_ShaderSuite.h"
 #include "VS_Texture.h"
 #include "Math/VS_Transform.h"
@@ -110,7 +111,12 @@ class vsRenderer_OpenGL3: public vsRenderer
 
 	WindowType m_windowType;
 
+	vsRenderStats		m_stats;		// the frame being rendered right now
+	vsRenderStats		m_lastStats;	// the most recently completed frame
+	int					m_frameNumber;
+
 	void				FlushRenderState();
+	void				CountDraw( GLenum mode, int indexCount );
 	virtual void		SetMaterialInternal(vsMaterialInternal *material);
 	virtual void		SetMaterial(vsMaterial *material);
 	//virtual void		SetDrawMode(vsDrawMode mode);
@@ -171,6 +177,8 @@ public:
 
 	vsShader*	DefaultShaderFor( vsMaterialInternal *mat );
 
+	virtual const vsRenderStats *	GetRenderStats() const { return &m_lastStats; }
+
 };
 
 #endif // VS_RENDERER_OPENGL3_H
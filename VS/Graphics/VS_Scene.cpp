@@ -16,11 +16,74 @@
 #include "VS_Screen.h"
 #include "VS_System.h"
 #include "VS_Profile.h"
+#include "VS_ThreadPool.h"
 //#include "VS_Transform.h"
 
 #include "VS_OpenGL.h"
 
-vsTransform2D	g_drawingCameraTransform = vsTransform2D::Zero;
+thread_local vsTransform2D	g_drawingCameraTransform = vsTransform2D::Zero;
+
+// Parallel gathering isn't worth the synchronisation cost for small scenes;
+// each thread should get at least this many top-level entities.
+#define MIN_ENTITIES_PER_GATHER_THREAD (32)
+
+// Draw a run of top-level entities into a render queue.  'camera' is NULL for
+// 3D scenes, which don't do 2D visibility tests.
+static void GatherEntities( vsEntity **entity, int count, vsRenderQueue *queue, vsCamera2D *camera )
+{
+	for ( int i = 0; i < count; i++ )
+	{
+		if ( !camera || entity[i]->OnScreen( camera->GetCameraTransform() ) )
+		{
+			entity[i]->Draw( queue );
+		}
+	}
+}
+
+// One contiguous run of entities to be gathered on a thread pool worker.
+// These jobs share the entities with the main thread (which has just updated
+// them), so we keep them within the main thread's L3 cache.
+class vsSceneGatherJob : public vsJob
+{
+	vsRenderQueue *	m_queue;
+	vsEntity **		m_entity;
+	int				m_count;
+	vsCamera2D *	m_camera;
+	vsTransform2D	m_cameraTransform;
+
+protected:
+	virtual void Execute()
+	{
+		g_drawingCameraTransform = m_cameraTransform;
+		GatherEntities( m_entity, m_count, m_queue, m_camera );
+	}
+
+public:
+	vsSceneGatherJob():
+		m_queue( new vsRenderQueue( 3, 1024*200 ) ),
+		m_entity(NULL),
+		m_count(0),
+		m_camera(NULL)
+	{
+		m_queue->SetDeferDynamicBatching( true );
+	}
+
+	~vsSceneGatherJob()
+	{
+		vsDelete( m_queue );
+	}
+
+	vsRenderQueue * GetQueue() { return m_queue; }
+
+	void Gather( vsEntity **entity, int count, vsCamera2D *camera )
+	{
+		m_entity = entity;
+		m_count = count;
+		m_camera = camera;
+		m_cameraTransform = g_drawingCameraTransform;
+		vsThreadPool::Instance()->Submit( this, vsThreadPool::Affinity_MainThreadL3 );
+	}
+};
 
 #if defined(DEBUG_SCENE)
 
@@ -65,7 +128,8 @@ vsScene::vsScene():
 	m_flatShading( false ),
 	m_stencilTest( false ),
 	m_hasViewport( false ),
-	m_enabled( true )
+	m_enabled( true ),
+	m_parallelGather( false )
 {
 	m_camera = m_defaultCamera;
 	m_camera3D = m_defaultCamera3D;
@@ -79,6 +143,10 @@ vsScene::vsScene():
 vsScene::~vsScene()
 {
 	vsDelete( m_queue );
+	for ( int i = 0; i < m_gatherJob.ItemCount(); i++ )
+	{
+		vsDelete( m_gatherJob[i] );
+	}
 	vsDelete( m_defaultCamera3D );
 	vsDelete( m_defaultCamera );
 
@@ -250,19 +318,18 @@ vsScene::Draw( vsDisplayList *list, int flags )
 		list->EnableStencil();
 	}
 
-	vsEntity *entity = m_entityList->GetNext();
-	while ( entity != m_entityList )
-	{
-		if ( m_is3d || (!m_camera || entity->OnScreen( m_camera->GetCameraTransform() )) )
-		{
-			entity->Draw( m_queue );
-		}
-		entity = entity->GetNext();
-	}
+	if ( m_parallelGather )
+		GatherParallel( flags );
+	else
+		Gather();
 
 	m_queue->Draw(list);
 
 	m_queue->EndRender();
+	for ( int i = 0; i < m_gatherJob.ItemCount(); i++ )
+	{
+		m_gatherJob[i]->GetQueue()->EndRender();
+	}
 
 	if ( m_stencilTest )
 	{
@@ -278,6 +345,98 @@ vsScene::Draw( vsDisplayList *list, int flags )
 	// list->SetMaterial(vsMaterial::White);
 }
 
+void
+vsScene::Gather()
+{
+	vsEntity *entity = m_entityList->GetNext();
+	while ( entity != m_entityList )
+	{
+		if ( m_is3d || (!m_camera || entity->OnScreen( m_camera->GetCameraTransform() )) )
+		{
+			entity->Draw( m_queue );
+		}
+		entity = entity->GetNext();
+	}
+}
+
+void
+vsScene::GatherParallel( int flags )
+{
+	m_gatherList.Clear();
+	for ( vsEntity *entity = m_entityList->GetNext(); entity != m_entityList; entity = entity->GetNext() )
+	{
+		m_gatherList.AddItem( entity );
+	}
+
+	// Entities which must draw on the main thread split the list into
+	// sections;  we gather each section in parallel, then draw the entity
+	// which ended it straight into our own queue.  Each of those entities
+	// costs us a wait for the workers, so they're best kept few, or together.
+	int jobsUsed = 0;
+	int sectionStart = 0;
+	vsCamera2D *camera = m_is3d ? NULL : m_camera;
+	for ( int i = 0; i < m_gatherList.ItemCount(); i++ )
+	{
+		if ( m_gatherList[i]->DrawsOnMainThread() )
+		{
+			GatherSection( flags, sectionStart, i - sectionStart, jobsUsed );
+			GatherEntities( &m_gatherList[i], 1, m_queue, camera );
+			sectionStart = i+1;
+		}
+	}
+	GatherSection( flags, sectionStart, m_gatherList.ItemCount() - sectionStart, jobsUsed );
+}
+
+void
+vsScene::GatherSection( int flags, int start, int entityCount, int &jobsUsed )
+{
+	if ( entityCount <= 0 )
+		return;
+
+	vsEntity **entities = &m_gatherList[start];
+	vsCamera2D *camera = m_is3d ? NULL : m_camera;
+	int workerCount = vsThreadPool::Instance()->GetWorkerCount( vsThreadPool::Affinity_MainThreadL3 );
+	int runCount = vsMin( workerCount + 1, entityCount / MIN_ENTITIES_PER_GATHER_THREAD );
+	if ( runCount <= 1 )
+	{
+		GatherEntities( entities, entityCount, m_queue, camera );
+		return;
+	}
+
+	// Each job's queue is merged into ours, and can't be reused until after
+	// we've drawn;  so every section this frame gets its own jobs.
+	while ( m_gatherJob.ItemCount() < jobsUsed + runCount-1 )
+	{
+		m_gatherJob.AddItem( new vsSceneGatherJob );
+	}
+	vsSceneGatherJob **job = &m_gatherJob[jobsUsed];
+	jobsUsed += runCount-1;
+
+	// Split the entities into contiguous runs.  The main thread gathers the
+	// first run straight into our own queue, and each worker gathers one of
+	// the later runs into its own queue.  Merging those queues back in run
+	// order then gives us exactly what a serial gather would have.
+	for ( int i = 1; i < runCount; i++ )
+	{
+		vsRenderQueue *queue = job[i-1]->GetQueue();
+		queue->StartRender( this, flags );
+		queue->SetProjectionMatrix( m_queue->GetProjectionMatrix() );
+		queue->SetFOV( m_queue->GetFOV() );
+
+		int runStart = (entityCount * i) / runCount;
+		int runEnd = (entityCount * (i+1)) / runCount;
+		job[i-1]->Gather( entities + runStart, runEnd - runStart, camera );
+	}
+
+	GatherEntities( entities, entityCount / runCount, m_queue, camera );
+
+	for ( int i = 1; i < runCount; i++ )
+	{
+		job[i-1]->Wait();
+		m_queue->Merge( job[i-1]->GetQueue() );
+	}
+}
+
 void
 vsScene::RegisterEntityOnBottom( vsEntity *sprite )
 {
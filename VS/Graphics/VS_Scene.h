@@ -15,6 +15,7 @@
 #include "VS/Math/VS_Transform.h"
 #include "VS/Graphics/VS_DisplayList.h"
 #include "VS/Graphics/VS_Screen.h"
+#include "VS/Utils/VS_Array.h"
 
 class vsEntity;
 class vsDisplayList;
@@ -23,8 +24,9 @@ class vsCamera3D;
 class vsFog;
 class vsLight;
 class vsRenderQueue;
+class vsSceneGatherJob;
 
-extern vsTransform2D	g_drawingCameraTransform;	// this transform is active during Draw() calls, and should tell the camera transform in LOCAL coordinates!
+extern thread_local vsTransform2D	g_drawingCameraTransform;	// this transform is active during Draw() calls, and should tell the camera transform in LOCAL coordinates!  (Each gathering thread has its own)
 
 #define MAX_SCENE_LIGHTS	(8)
 #define MAX_SCENE_STACK		(20)
@@ -32,6 +34,8 @@ extern vsTransform2D	g_drawingCameraTransform;	// this transform is active durin
 class vsScene
 {
 	vsRenderQueue *	m_queue;
+	vsArray<vsSceneGatherJob*>	m_gatherJob;	// for parallel gathering
+	vsArray<vsEntity*>	m_gatherList;
 	vsEntity *		m_entityList;
 	vsCamera2D *	m_defaultCamera;
 	vsCamera2D *	m_camera;
@@ -48,6 +52,11 @@ class vsScene
 	bool			m_stencilTest;
 	bool			m_hasViewport;
 	bool			m_enabled;	// if false, we won't automatically draw this scene
+	bool			m_parallelGather;
+
+	void			Gather();
+	void			GatherParallel( int flags );
+	void			GatherSection( int flags, int start, int entityCount, int &jobsUsed );
 
 public:
 
@@ -60,6 +69,17 @@ public:
 	void			SetEnabled(bool enable) { m_enabled = enable; }
 	bool			IsEnabled() { return m_enabled; }
 
+	// If set, Draw() splits our top-level entities into contiguous runs and
+	// gathers each run into its own render queue on a worker thread, then
+	// merges those queues back together in order.  The resulting display list
+	// is identical to what a serial Draw() would produce.  Only enable this if
+	// every entity in the scene can safely Draw() from a worker thread;  Draw()
+	// mustn't touch OpenGL there.  Entities which do (such as vsLines3D) must
+	// be flagged with vsEntity::SetDrawOnMainThread(), and are drawn on the
+	// main thread, in order.  Debug builds assert if a worker uploads a buffer.
+	void			SetParallelGather(bool parallel) { m_parallelGather = parallel; }
+	bool			IsParallelGather() { return m_parallelGather; }
+
 	float			GetFOV();
 
 	void			UpdateVideoMode();
@@ -9,11 +9,14 @@
 
 #include "VS_Screen.h"
 #include "VS_DisplayList.h"
+#include "VS_DisplayListCapture.h"
 #include "VS_RenderPipeline.h"
 #include "VS_RenderPipelineStage.h"
 #include "VS_RenderPipelineStageBlit.h"
 #include "VS_RenderPipelineStageScenes.h"
+#include "VS_Renderer_Null.h"
 #include "VS_Renderer_OpenGL3.h"
+#include "VS_RenderStats.h"
 #include "VS_RenderTarget.h"
 #include "VS_Scene.h"
 #include "VS_System.h"
@@ -25,7 +28,7 @@
 const int c_fifoSize = 1024 * 4000;		// 2mb for our FIFO display list
 vsScreen *	vsScreen::s_instance = NULL;
 
-vsScreen::vsScreen(int width, int height, int depth, vsRenderer::WindowType windowType, int bufferCount, bool vsync, bool antialias,bool highDPI):
+vsScreen::vsScreen(int width, int height, int depth, vsRenderer::WindowType windowType, int bufferCount, bool vsync, bool antialias,bool highDPI, bool headless):
 	m_renderer(NULL),
 	m_pipeline(NULL),
 	m_scene(NULL),
@@ -59,7 +62,10 @@ vsScreen::vsScreen(int width, int height, int depth, vsRenderer::WindowType wind
 	flags |= vsRenderer::Flag_Resizable;
 
 	vsLog("Width before:  %d", m_width);
-	m_renderer = new vsRenderer_OpenGL3(m_width, m_height, m_depth, flags, bufferCount);
+	if ( headless )
+		m_renderer = new vsRenderer_Null(m_width, m_height, m_depth, flags);
+	else
+		m_renderer = new vsRenderer_OpenGL3(m_width, m_height, m_depth, flags, bufferCount);
 
 	m_width = m_renderer->GetWidth();
 	m_height = m_renderer->GetHeight();
@@ -202,6 +208,7 @@ vsScreen::GetPresentTarget()
 void
 vsScreen::DestroyScenes()
 {
+	vsRenderStats::ShowOverlay(false);	// it lives in our debug scene
 	if ( m_pipeline )
 		vsDelete( m_pipeline );
 	if ( m_scene )
@@ -262,6 +269,11 @@ vsScreen::DrawPipeline( vsRenderPipeline *pipeline )
 #ifdef DEBUG_SCENE
 	m_scene[m_sceneCount-1]->Draw(m_fifo);
 #endif
+	if ( !m_captureFilename.empty() )
+	{
+		vsDisplayListCapture::Save( m_fifo, m_captureFilename );
+		m_captureFilename.clear();
+	}
 	m_renderer->RenderDisplayList(m_fifo);
 	vsTimerSystem::Instance()->EndDrawTime();
 	m_renderer->PostRender();
@@ -53,13 +53,15 @@ class vsScreen
 	vsRenderTarget *	m_currentRenderTarget;
     const vsRenderer::Settings *m_currentSettings;
 
+	vsString			m_captureFilename;	// if set, capture the next frame's display list to this file
+
 	void BuildDefaultPipeline();
 
 public:
 
 	static vsScreen *	Instance() { return s_instance; }
 
-	vsScreen(int width, int height, int depth, vsRenderer::WindowType type, int bufferCount, bool vsync, bool antialias, bool highDPI);
+	vsScreen(int width, int height, int depth, vsRenderer::WindowType type, int bufferCount, bool vsync, bool antialias, bool highDPI, bool headless = false);
 	~vsScreen();
 
 	vsRenderTarget *	GetMainRenderTarget();
@@ -113,6 +115,10 @@ public:
 	void			Draw();
 	void			DrawPipeline( vsRenderPipeline *pipeline );
 
+	// Saves the next frame's display list to 'filename', for replaying later
+	// with vsDisplayListCapture.
+	void			CaptureNextFrame( const vsString &filename ) { m_captureFilename = filename; }
+
 	vsImage *       Screenshot();
 	vsImage *       Screenshot_Async();
 	vsImage *       ScreenshotBack();
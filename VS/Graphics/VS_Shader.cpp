@@ -12,6 +12,7 @@
 #include "VS_File.h"
 #include "VS_Input.h"
 #include "VS_RenderBuffer.h"
+#include "VS_RenderStats.h"
 #include "VS_Renderer_OpenGL3.h"
 #include "VS_Screen.h"
 #include "VS_ShaderValues.h"
@@ -108,6 +109,13 @@ void DoPreprocessor( vsString &s )
 void
 vsShader::Compile( const vsString &vertexShader, const vsString &fragmentShader, bool lit, bool texture )
 {
+	if ( vsRenderer::IsHeadless() )
+	{
+		// no GL context to compile into;  we'll have no uniforms or attributes.
+		m_globalTimeUniformId = m_fogDensityId = m_fogColorId = -1;
+		return;
+	}
+
 	GL_CHECK_SCOPED("Shader::Compile");
 	Uniform *oldUniform = m_uniform;
 	Attribute *oldAttribute = m_attribute;
@@ -337,7 +345,8 @@ vsShader::Compile( const vsString &vertexShader, const vsString &fragmentShader,
 vsShader::~vsShader()
 {
 	// vsLog("Destroyed shader %d", m_shader);
-	vsRenderer_OpenGL3::DestroyShader(m_shader);
+	if ( m_shader != 0xffffffff )
+		vsRenderer_OpenGL3::DestroyShader(m_shader);
 	vsDeleteArray( m_uniform );
 	vsDeleteArray( m_attribute );
 }
@@ -518,11 +527,13 @@ vsShader::SetInstanceColors( const vsColor* color, int matCount )
 			if ( size > g_vboSize )
 			{
 				glBufferData(GL_ARRAY_BUFFER, size, color, GL_STREAM_DRAW);
+				vsRenderStats::CountBufferData( size );
 				g_vboSize = size;
 			}
 			else
 			{
 				void *ptr = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+				vsRenderStats::CountMapBufferRange( size );
 				if ( ptr )
 				{
 					memcpy(ptr, color, size);
@@ -640,11 +651,13 @@ vsShader::SetLocalToWorld( const vsMatrix4x4* localToWorld, int matCount )
 			if ( size > g_vboSize )
 			{
 				glBufferData(GL_ARRAY_BUFFER, size, localToWorld, GL_STREAM_DRAW);
+				vsRenderStats::CountBufferData( size );
 				g_vboSize = size;
 			}
 			else
 			{
 				void *ptr = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+				vsRenderStats::CountMapBufferRange( size );
 				if ( ptr )
 				{
 					memcpy(ptr, localToWorld, size);
@@ -15,7 +15,7 @@
 #include "VS_File.h"
 #include "VS_Record.h"
 
-extern vsTransform2D g_drawingCameraTransform;
+extern thread_local vsTransform2D g_drawingCameraTransform;
 
 vsSprite *
 vsSprite::Load( const vsString &filename )
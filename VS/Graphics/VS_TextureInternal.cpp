@@ -14,6 +14,7 @@
 #include "VS_Image.h"
 #include "VS_RenderTarget.h"	// for vsSurface.  Should move into its own file.
 #include "VS_RenderBuffer.h"
+#include "VS_Renderer.h"
 
 #include "VS/Files/VS_File.h"
 #include "VS/Memory/VS_Store.h"
@@ -108,7 +109,7 @@ vsTextureInternal::vsTextureInternal( const vsString &filename_in ):
 {
 	vsImage image(filename_in);
 
-	if ( image.IsOK() )
+	if ( image.IsOK() && !vsRenderer::IsHeadless() )
 	{
 		int w = image.GetWidth();
 		int h = image.GetHeight();
@@ -143,6 +144,9 @@ vsTextureInternal::vsTextureInternal( const vsString&name, const vsArray<vsStrin
 	m_premultipliedAlpha(false),
 	m_tbo(NULL)
 {
+	if ( vsRenderer::IsHeadless() )
+		return;
+
 	GLuint t;
 	glGenTextures(1, &t);
 	m_texture = t;
@@ -198,6 +202,10 @@ vsTextureInternal::vsTextureInternal( const vsString &name, vsImage *image ):
 
 	m_width = w;
 	m_height = w;
+	m_nearestSampling = false;
+
+	if ( vsRenderer::IsHeadless() )
+		return;
 
 	GLuint t;
 	glGenTextures(1, &t);
@@ -215,7 +223,6 @@ vsTextureInternal::vsTextureInternal( const vsString &name, vsImage *image ):
 			GL_UNSIGNED_INT_8_8_8_8_REV,
 			image->RawData());
 	glGenerateMipmap(GL_TEXTURE_2D);
-	m_nearestSampling = false;
 }
 
 vsTextureInternal::vsTextureInternal( const vsString &name, vsFloatImage *image ):
@@ -230,6 +237,10 @@ vsTextureInternal::vsTextureInternal( const vsString &name, vsFloatImage *image
 
 	m_width = w;
 	m_height = w;
+	m_nearestSampling = false;
+
+	if ( vsRenderer::IsHeadless() )
+		return;
 
 	GLuint t;
 	glGenTextures(1, &t);
@@ -247,7 +258,6 @@ vsTextureInternal::vsTextureInternal( const vsString &name, vsFloatImage *image
 			GL_FLOAT,
 			image->RawData());
 	glGenerateMipmap(GL_TEXTURE_2D);
-	m_nearestSampling = false;
 }
 
 vsTextureInternal::vsTextureInternal( const vsString &name, vsRenderBuffer *buffer ):
@@ -256,10 +266,13 @@ vsTextureInternal::vsTextureInternal( const vsString &name, vsRenderBuffer *buff
 	m_premultipliedAlpha(false),
 	m_tbo(buffer)
 {
+	m_nearestSampling = false;
+	if ( vsRenderer::IsHeadless() )
+		return;
+
 	GLuint t;
 	glGenTextures(1, &t);
 	m_texture = t;
-	m_nearestSampling = false;
 }
 
 vsTextureInternal::vsTextureInternal( const vsString &name, uint32_t glTextureId ):
@@ -275,6 +288,8 @@ vsTextureInternal::vsTextureInternal( const vsString &name, uint32_t glTextureId
 void
 vsTextureInternal::Blit( vsImage *image, const vsVector2D &where)
 {
+	if ( !m_texture )
+		return;
 	glBindTexture(GL_TEXTURE_2D, m_texture);
 	glTexSubImage2D(GL_TEXTURE_2D,
 			0,
@@ -289,6 +304,8 @@ vsTextureInternal::Blit( vsImage *image, const vsVector2D &where)
 void
 vsTextureInternal::Blit( vsFloatImage *image, const vsVector2D &where)
 {
+	if ( !m_texture )
+		return;
 	glBindTexture(GL_TEXTURE_2D, m_texture);
 	glTexSubImage2D(GL_TEXTURE_2D,
 			0,
@@ -320,8 +337,11 @@ vsTextureInternal::vsTextureInternal( const vsString &name, vsSurface *surface,
 
 vsTextureInternal::~vsTextureInternal()
 {
-	GLuint t = m_texture;
-	glDeleteTextures(1, &t);
+	if ( m_texture )
+	{
+		GLuint t = m_texture;
+		glDeleteTextures(1, &t);
+	}
 	m_texture = 0;
 
 
@@ -331,22 +351,26 @@ vsTextureInternal::~vsTextureInternal()
 void
 vsTextureInternal::SetNearestSampling()
 {
+	m_nearestSampling = true;
+	if ( !m_texture )
+		return;
 	glBindTexture(GL_TEXTURE_2D, m_texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	m_nearestSampling = true;
 }
 
 void
 vsTextureInternal::SetLinearSampling(bool linearMipmaps)
 {
+	m_nearestSampling = false;
+	if ( !m_texture )
+		return;
 	glBindTexture(GL_TEXTURE_2D, m_texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	if ( linearMipmaps )
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	else
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	m_nearestSampling = false;
 }
 
 #endif // TARGET_OS_IPHONE
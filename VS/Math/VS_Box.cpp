@@ -239,6 +239,20 @@ vsBox3D::Corner(int i) const
 	return result;
 }
 
+vsBox3D
+vsBox3D::TransformedBy( const vsMatrix4x4 &mat ) const
+{
+	// transform our middle, then find how far our half-extents can reach
+	// along each axis once they've been rotated and scaled.
+	vsVector3D middle = mat.ApplyTo( Middle() );
+	vsVector3D half = Extents() * 0.5f;
+	vsVector3D reach(
+			vsFabs(mat.x.x) * half.x + vsFabs(mat.y.x) * half.y + vsFabs(mat.z.x) * half.z,
+			vsFabs(mat.x.y) * half.x + vsFabs(mat.y.y) * half.y + vsFabs(mat.z.y) * half.z,
+			vsFabs(mat.x.z) * half.x + vsFabs(mat.y.z) * half.y + vsFabs(mat.z.z) * half.z );
+	return vsBox3D( middle - reach, middle + reach );
+}
+
 
 void
 vsBox3D::DrawOutline( vsDisplayList *list )
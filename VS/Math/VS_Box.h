@@ -125,6 +125,10 @@ public:
 
 	vsVector3D	Corner(int i) const;
 
+	// returns the axis-aligned box which encloses this box once it's been
+	// transformed by 'mat'.
+	vsBox3D		TransformedBy( const vsMatrix4x4 &mat ) const;
+
 	void		Expand( float amt ) { min += -amt * vsVector3D::One; max += amt * vsVector3D::One; }
 	void		Expand( const vsVector3D &amt ) { min -= amt; max += amt; }
 	void		Contract( float amt ) { Expand(-amt); }	// TODO:  Make sure we don't invert ourselves.
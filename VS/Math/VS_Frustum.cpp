@@ -13,8 +13,16 @@
 #include "VS/Graphics/VS_Screen.h"
 #include "VS/Utils/VS_System.h"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_USES_SSE
+#include "VS_DisableDebugNew.h"
+#include <xmmintrin.h>
+#include "VS_EnableDebugNew.h"
+#endif
+
 vsFrustum::vsFrustum()
 {
+	BuildPlaneEquations();
 }
 
 void
@@ -97,6 +105,19 @@ vsFrustum::Set( vsCamera3D *camera )
 			m_planeNormal[i].Normalise();
 		}
 	}
+	BuildPlaneEquations();
+}
+
+void
+vsFrustum::BuildPlaneEquations()
+{
+	for ( int i = 0; i < 6; i++ )
+	{
+		m_planeX[i] = m_planeNormal[i].x;
+		m_planeY[i] = m_planeNormal[i].y;
+		m_planeZ[i] = m_planeNormal[i].z;
+		m_planeD[i] = -m_planeNormal[i].Dot(m_planePoint[i]);
+	}
 }
 
 bool
@@ -203,3 +224,142 @@ vsFrustum::ClassifyBox3D( const vsBox3D &box ) const
 	return Intersect;
 }
 
+
+// Writes classifications for up to four items from the bitmasks built by the
+// batched tests below (bit n set in 'outside' means item n is outside at least
+// one plane;  bit n set in 'partial' means item n crosses at least one plane),
+// and returns how many weren't outside.
+static int
+WriteClassifications( int outside, int partial, int count, vsFrustum::Classification *result )
+{
+	int visible = 0;
+	for ( int k = 0; k < count; k++ )
+	{
+		if ( outside & (1<<k) )
+			result[k] = vsFrustum::Outside;
+		else
+		{
+			result[k] = ( partial & (1<<k) ) ? vsFrustum::Intersect : vsFrustum::Inside;
+			visible++;
+		}
+	}
+	return visible;
+}
+
+int
+vsFrustum::ClassifyBoxes( const vsBox3D *box, int count, Classification *result ) const
+{
+	int visible = 0;
+	int i = 0;
+
+#if defined(FRUSTUM_USES_SSE)
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const vsBox3D *b = &box[i];
+		__m128 minX = _mm_setr_ps( b[0].GetMin().x, b[1].GetMin().x, b[2].GetMin().x, b[3].GetMin().x );
+		__m128 minY = _mm_setr_ps( b[0].GetMin().y, b[1].GetMin().y, b[2].GetMin().y, b[3].GetMin().y );
+		__m128 minZ = _mm_setr_ps( b[0].GetMin().z, b[1].GetMin().z, b[2].GetMin().z, b[3].GetMin().z );
+		__m128 maxX = _mm_setr_ps( b[0].GetMax().x, b[1].GetMax().x, b[2].GetMax().x, b[3].GetMax().x );
+		__m128 maxY = _mm_setr_ps( b[0].GetMax().y, b[1].GetMax().y, b[2].GetMax().y, b[3].GetMax().y );
+		__m128 maxZ = _mm_setr_ps( b[0].GetMax().z, b[1].GetMax().z, b[2].GetMax().z, b[3].GetMax().z );
+
+		__m128 cx = _mm_mul_ps( _mm_add_ps(maxX, minX), half );
+		__m128 cy = _mm_mul_ps( _mm_add_ps(maxY, minY), half );
+		__m128 cz = _mm_mul_ps( _mm_add_ps(maxZ, minZ), half );
+		__m128 ex = _mm_mul_ps( _mm_sub_ps(maxX, minX), half );
+		__m128 ey = _mm_mul_ps( _mm_sub_ps(maxY, minY), half );
+		__m128 ez = _mm_mul_ps( _mm_sub_ps(maxZ, minZ), half );
+
+		__m128 outside = zero;
+		__m128 partial = zero;
+		for ( int p = 0; p < 6; p++ )
+		{
+			// distance from the plane to the box's center, and the furthest
+			// the box reaches towards the plane from there.
+			__m128 dist = _mm_add_ps(
+					_mm_add_ps( _mm_mul_ps(cx, _mm_set1_ps(m_planeX[p])), _mm_mul_ps(cy, _mm_set1_ps(m_planeY[p])) ),
+					_mm_add_ps( _mm_mul_ps(cz, _mm_set1_ps(m_planeZ[p])), _mm_set1_ps(m_planeD[p]) ) );
+			__m128 reach = _mm_add_ps(
+					_mm_add_ps( _mm_mul_ps(ex, _mm_set1_ps(vsFabs(m_planeX[p]))), _mm_mul_ps(ey, _mm_set1_ps(vsFabs(m_planeY[p]))) ),
+					_mm_mul_ps(ez, _mm_set1_ps(vsFabs(m_planeZ[p]))) );
+
+			outside = _mm_or_ps( outside, _mm_cmplt_ps(dist, _mm_sub_ps(zero, reach)) );
+			partial = _mm_or_ps( partial, _mm_cmplt_ps(dist, reach) );
+			if ( _mm_movemask_ps(outside) == 0xf )
+				break;
+		}
+		visible += WriteClassifications( _mm_movemask_ps(outside), _mm_movemask_ps(partial), 4, &result[i] );
+	}
+#endif // FRUSTUM_USES_SSE
+
+	for ( ; i < count; i++ )
+	{
+		vsVector3D center = box[i].Middle();
+		vsVector3D extent = box[i].Extents() * 0.5f;
+		int outside = 0, partial = 0;
+		for ( int p = 0; p < 6 && !outside; p++ )
+		{
+			float dist = center.x * m_planeX[p] + center.y * m_planeY[p] + center.z * m_planeZ[p] + m_planeD[p];
+			float reach = extent.x * vsFabs(m_planeX[p]) + extent.y * vsFabs(m_planeY[p]) + extent.z * vsFabs(m_planeZ[p]);
+			if ( dist < -reach )
+				outside = 1;
+			else if ( dist < reach )
+				partial = 1;
+		}
+		visible += WriteClassifications( outside, partial, 1, &result[i] );
+	}
+	return visible;
+}
+
+int
+vsFrustum::ClassifySpheres( const vsVector4D *sphere, int count, Classification *result ) const
+{
+	int visible = 0;
+	int i = 0;
+
+#if defined(FRUSTUM_USES_SSE)
+	const __m128 zero = _mm_setzero_ps();
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128 x = _mm_loadu_ps( &sphere[i].x );
+		__m128 y = _mm_loadu_ps( &sphere[i+1].x );
+		__m128 z = _mm_loadu_ps( &sphere[i+2].x );
+		__m128 r = _mm_loadu_ps( &sphere[i+3].x );
+		_MM_TRANSPOSE4_PS( x, y, z, r );
+
+		__m128 negR = _mm_sub_ps(zero, r);
+		__m128 outside = zero;
+		__m128 partial = zero;
+		for ( int p = 0; p < 6; p++ )
+		{
+			__m128 dist = _mm_add_ps(
+					_mm_add_ps( _mm_mul_ps(x, _mm_set1_ps(m_planeX[p])), _mm_mul_ps(y, _mm_set1_ps(m_planeY[p])) ),
+					_mm_add_ps( _mm_mul_ps(z, _mm_set1_ps(m_planeZ[p])), _mm_set1_ps(m_planeD[p]) ) );
+
+			outside = _mm_or_ps( outside, _mm_cmplt_ps(dist, negR) );
+			partial = _mm_or_ps( partial, _mm_cmplt_ps(dist, r) );
+			if ( _mm_movemask_ps(outside) == 0xf )
+				break;
+		}
+		visible += WriteClassifications( _mm_movemask_ps(outside), _mm_movemask_ps(partial), 4, &result[i] );
+	}
+#endif // FRUSTUM_USES_SSE
+
+	for ( ; i < count; i++ )
+	{
+		const vsVector4D &s = sphere[i];
+		int outside = 0, partial = 0;
+		for ( int p = 0; p < 6 && !outside; p++ )
+		{
+			float dist = s.x * m_planeX[p] + s.y * m_planeY[p] + s.z * m_planeZ[p] + m_planeD[p];
+			if ( dist < -s.w )
+				outside = 1;
+			else if ( dist < s.w )
+				partial = 1;
+		}
+		visible += WriteClassifications( outside, partial, 1, &result[i] );
+	}
+	return visible;
+}
@@ -20,6 +20,15 @@ class vsFrustum
 	vsVector3D		m_planePoint[6];
 	vsVector3D		m_planeNormal[6];
 
+	// the same planes as equations (inward normal and distance term), in
+	// structure-of-arrays form for the batched tests.
+	float			m_planeX[6];
+	float			m_planeY[6];
+	float			m_planeZ[6];
+	float			m_planeD[6];
+
+	void	BuildPlaneEquations();
+
 public:
 
 	vsFrustum();
@@ -37,6 +46,18 @@ public:
 	};
 	Classification ClassifyBox3D( const vsBox3D &box ) const;
 	Classification ClassifySphere( const vsVector3D &position, float radius ) const;
+
+	// Batched tests.  These classify 'count' world-space boxes or spheres in
+	// one call, writing one Classification per item into 'result', and
+	// return how many weren't Outside.  Where SSE is available, four items
+	// are tested against each plane at once.  Spheres are packed as
+	// (center.x, center.y, center.z, radius).
+	//
+	// Boxes are tested by their center and half-extents against each plane.
+	// That finds the same boxes Outside as ClassifyBox3D(), but is more
+	// precise about which boxes are entirely Inside.
+	int		ClassifyBoxes( const vsBox3D *box, int count, Classification *result ) const;
+	int		ClassifySpheres( const vsVector4D *sphere, int count, Classification *result ) const;
 };
 
 #endif // VS_FRUSTUM_H
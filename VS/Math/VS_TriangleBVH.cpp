@@ -0,0 +1,724 @@
+/*
+ *  VS_TriangleBVH.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+#include "VS_TriangleBVH.h"
+
+#include "VS_Math.h"
+#include "VS/Threads/VS_ThreadPool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRIANGLEBVH_USES_SSE
+#include "VS_DisableDebugNew.h"
+#include <xmmintrin.h>
+#include "VS_EnableDebugNew.h"
+#endif
+
+static const int c_binCount = 12;			// candidate split planes per axis, when building
+static const int c_maxLeafTriangles = 8;	// leaves may be larger than this only if we run out of depth
+static const int c_maxDepth = 60;
+static const int c_stackSize = c_maxDepth + 4;
+static const int c_packetSize = 4;
+static const int c_minRaysPerThread = 256;
+static const int c_maxThreads = 64;
+
+// One contiguous run of a ray batch, cast on a thread pool worker.  The
+// caller has usually just written the rays, so we keep these within the
+// main thread's L3 cache.
+class vsTriangleBVHJob : public vsJob
+{
+	const vsTriangleBVH *			m_bvh;
+	const vsTriangleBVH::Ray *		m_ray;
+	int								m_count;
+	vsTriangleBVH::Hit *			m_hit;
+	bool *							m_anyHit;
+
+protected:
+	virtual void Execute()
+	{
+		m_bvh->TraceRange( m_ray, m_count, m_hit, m_anyHit );
+	}
+
+public:
+	vsTriangleBVHJob():
+		m_bvh(NULL),
+		m_ray(NULL),
+		m_count(0),
+		m_hit(NULL),
+		m_anyHit(NULL)
+	{
+	}
+
+	void Trace( const vsTriangleBVH *bvh, const vsTriangleBVH::Ray *ray, int count, vsTriangleBVH::Hit *hit, bool *anyHit )
+	{
+		m_bvh = bvh;
+		m_ray = ray;
+		m_count = count;
+		m_hit = hit;
+		m_anyHit = anyHit;
+		vsThreadPool::Instance()->Submit( this, vsThreadPool::Affinity_MainThreadL3 );
+	}
+};
+
+static inline float
+Axis( const vsVector3D &v, int axis )
+{
+	return (&v.x)[axis];
+}
+
+namespace
+{
+	struct Bounds
+	{
+		vsVector3D min;
+		vsVector3D max;
+
+		Bounds():
+			min( 1e30f, 1e30f, 1e30f ),
+			max( -1e30f, -1e30f, -1e30f )
+		{
+		}
+
+		void Include( const vsVector3D &p )
+		{
+			min.Set( vsMin(min.x, p.x), vsMin(min.y, p.y), vsMin(min.z, p.z) );
+			max.Set( vsMax(max.x, p.x), vsMax(max.y, p.y), vsMax(max.z, p.z) );
+		}
+
+		void Include( const Bounds &b )
+		{
+			Include( b.min );
+			Include( b.max );
+		}
+
+		float HalfArea() const
+		{
+			if ( max.x < min.x )
+				return 0.f;
+			vsVector3D e = max - min;
+			return e.x * e.y + e.y * e.z + e.z * e.x;
+		}
+	};
+
+	struct Bin
+	{
+		Bounds	bounds;
+		int		count;
+
+		Bin(): count(0) {}
+	};
+}
+
+vsTriangleBVH::vsTriangleBVH()
+{
+}
+
+void
+vsTriangleBVH::Clear()
+{
+	m_node.Clear();
+	m_vertex.Clear();
+	m_triangleId.Clear();
+}
+
+void
+vsTriangleBVH::Build( const vsVector3D *vertex, int triangleCount )
+{
+	Clear();
+	if ( triangleCount <= 0 )
+		return;
+
+	vsArray<vsVector3D> centroid;
+	m_vertex.Reserve( triangleCount * 3 );
+	m_triangleId.Reserve( triangleCount );
+	centroid.Reserve( triangleCount );
+	for ( int i = 0; i < triangleCount; i++ )
+	{
+		const vsVector3D *v = &vertex[i*3];
+		m_vertex.AddItem( v[0] );
+		m_vertex.AddItem( v[1] );
+		m_vertex.AddItem( v[2] );
+		m_triangleId.AddItem( i );
+		centroid.AddItem( (v[0] + v[1] + v[2]) * (1.f / 3.f) );
+	}
+
+	m_node.Reserve( 2 * triangleCount );
+	m_node.AddItem( Node() );
+	BuildNode( 0, 0, triangleCount, 0, centroid );
+}
+
+void
+vsTriangleBVH::SwapTriangles( int a, int b, vsArray<vsVector3D> &centroid )
+{
+	for ( int i = 0; i < 3; i++ )
+	{
+		vsVector3D v = m_vertex[a*3+i];
+		m_vertex[a*3+i] = m_vertex[b*3+i];
+		m_vertex[b*3+i] = v;
+	}
+	int id = m_triangleId[a];
+	m_triangleId[a] = m_triangleId[b];
+	m_triangleId[b] = id;
+	vsVector3D c = centroid[a];
+	centroid[a] = centroid[b];
+	centroid[b] = c;
+}
+
+void
+vsTriangleBVH::BuildNode( int nodeId, int first, int count, int depth, vsArray<vsVector3D> &centroid )
+{
+	Bounds bounds, centroidBounds;
+	for ( int i = first; i < first + count; i++ )
+	{
+		bounds.Include( m_vertex[i*3] );
+		bounds.Include( m_vertex[i*3+1] );
+		bounds.Include( m_vertex[i*3+2] );
+		centroidBounds.Include( centroid[i] );
+	}
+	{
+		Node &node = m_node[nodeId];
+		for ( int i = 0; i < 3; i++ )
+		{
+			node.min[i] = Axis( bounds.min, i );
+			node.max[i] = Axis( bounds.max, i );
+		}
+		node.first = first;
+		node.count = count;
+	}
+	if ( count <= 2 || depth >= c_maxDepth )
+		return;
+
+	// Sort the centroids into bins along each axis, and find the boundary
+	// between bins which minimises the surface area heuristic:  the total
+	// area of each side's bounds, weighted by how many triangles are in it.
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = 1e30f;
+	for ( int axis = 0; axis < 3; axis++ )
+	{
+		float lo = Axis( centroidBounds.min, axis );
+		float extent = Axis( centroidBounds.max, axis ) - lo;
+		if ( extent <= 0.f )
+			continue;
+		float scale = c_binCount / extent;
+
+		Bin bin[c_binCount];
+		for ( int i = first; i < first + count; i++ )
+		{
+			int b = vsMin( c_binCount-1, (int)((Axis( centroid[i], axis ) - lo) * scale) );
+			bin[b].count++;
+			bin[b].bounds.Include( m_vertex[i*3] );
+			bin[b].bounds.Include( m_vertex[i*3+1] );
+			bin[b].bounds.Include( m_vertex[i*3+2] );
+		}
+
+		// sweep from the right first, so the left-to-right sweep can total
+		// each candidate as it goes.
+		float rightArea[c_binCount];
+		int rightCount[c_binCount];
+		Bounds right;
+		int rightTotal = 0;
+		for ( int b = c_binCount-1; b > 0; b-- )
+		{
+			right.Include( bin[b].bounds );
+			rightTotal += bin[b].count;
+			rightArea[b] = right.HalfArea();
+			rightCount[b] = rightTotal;
+		}
+		Bounds left;
+		int leftTotal = 0;
+		for ( int b = 1; b < c_binCount; b++ )
+		{
+			left.Include( bin[b-1].bounds );
+			leftTotal += bin[b-1].count;
+			if ( leftTotal == 0 || rightCount[b] == 0 )
+				continue;
+			float cost = left.HalfArea() * leftTotal + rightArea[b] * rightCount[b];
+			if ( cost < bestCost )
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+
+	// Splitting costs a box test per child;  stop if that's more than just
+	// testing all the triangles here would be.
+	float leafCost = bounds.HalfArea() * count;
+	if ( count <= c_maxLeafTriangles && ( bestAxis < 0 || bestCost + bounds.HalfArea() >= leafCost ) )
+		return;
+
+	int mid = first;
+	if ( bestAxis >= 0 )
+	{
+		float lo = Axis( centroidBounds.min, bestAxis );
+		float scale = c_binCount / ( Axis( centroidBounds.max, bestAxis ) - lo );
+		int end = first + count;
+		while ( mid < end )
+		{
+			int b = vsMin( c_binCount-1, (int)((Axis( centroid[mid], bestAxis ) - lo) * scale) );
+			if ( b < bestSplit )
+				mid++;
+			else
+				SwapTriangles( mid, --end, centroid );
+		}
+	}
+	if ( mid == first || mid == first + count )
+	{
+		// every centroid is in the same place;  any split is as good as any other.
+		mid = first + count / 2;
+	}
+
+	int child = m_node.ItemCount();
+	m_node.AddItem( Node() );
+	m_node.AddItem( Node() );
+	m_node[nodeId].first = child;
+	m_node[nodeId].count = 0;
+
+	BuildNode( child, first, mid - first, depth+1, centroid );
+	BuildNode( child+1, mid, first + count - mid, depth+1, centroid );
+}
+
+static inline bool
+RayHitsNode( const float *min, const float *max, const vsVector3D &pos, const vsVector3D &invDir, float maxT, float *tNear )
+{
+	float t1 = (min[0] - pos.x) * invDir.x;
+	float t2 = (max[0] - pos.x) * invDir.x;
+	float lo = vsMin( t1, t2 );
+	float hi = vsMax( t1, t2 );
+
+	t1 = (min[1] - pos.y) * invDir.y;
+	t2 = (max[1] - pos.y) * invDir.y;
+	lo = vsMax( lo, vsMin( t1, t2 ) );
+	hi = vsMin( hi, vsMax( t1, t2 ) );
+
+	t1 = (min[2] - pos.z) * invDir.z;
+	t2 = (max[2] - pos.z) * invDir.z;
+	lo = vsMax( lo, vsMin( t1, t2 ) );
+	hi = vsMin( hi, vsMax( t1, t2 ) );
+
+	*tNear = lo;
+	return hi >= vsMax( lo, 0.f ) && lo <= maxT;
+}
+
+static inline float
+Inverse( float f )
+{
+	return ( f == 0.f ) ? 1e30f : 1.f / f;
+}
+
+bool
+vsTriangleBVH::ClosestHit( const vsVector3D &pos, const vsVector3D &dir, float maxT, Hit *hit ) const
+{
+	if ( m_node.IsEmpty() )
+		return false;
+
+	vsVector3D invDir( Inverse(dir.x), Inverse(dir.y), Inverse(dir.z) );
+	float bestT = maxT;
+	int bestTriangle = -1;
+
+	int stack[c_stackSize];
+	float stackT[c_stackSize];
+	int depth = 0;
+
+	float tNear;
+	if ( !RayHitsNode( m_node[0].min, m_node[0].max, pos, invDir, bestT, &tNear ) )
+		return false;
+	stack[depth] = 0;
+	stackT[depth++] = tNear;
+
+	while ( depth > 0 )
+	{
+		depth--;
+		if ( stackT[depth] > bestT )
+			continue;	// we've found a hit nearer than this node since we pushed it
+		const Node &node = m_node[ stack[depth] ];
+
+		if ( node.count > 0 )
+		{
+			for ( int i = node.first; i < node.first + node.count; i++ )
+			{
+				float t, u, v;
+				if ( vsCollideRayVsTriangle( pos, dir, m_vertex[i*3], m_vertex[i*3+1], m_vertex[i*3+2], &t, &u, &v ) &&
+						t <= bestT )
+				{
+					bestT = t;
+					bestTriangle = i;
+					hit->u = u;
+					hit->v = v;
+				}
+			}
+			continue;
+		}
+
+		// visit the nearer child first, by pushing it last.
+		float tA, tB;
+		bool hitA = RayHitsNode( m_node[node.first].min, m_node[node.first].max, pos, invDir, bestT, &tA );
+		bool hitB = RayHitsNode( m_node[node.first+1].min, m_node[node.first+1].max, pos, invDir, bestT, &tB );
+		vsAssert( depth + 2 <= c_stackSize, "Triangle BVH traversal stack overflow" );
+		if ( hitA && hitB )
+		{
+			bool aFirst = ( tA <= tB );
+			stack[depth] = aFirst ? node.first+1 : node.first;
+			stackT[depth++] = aFirst ? tB : tA;
+			stack[depth] = aFirst ? node.first : node.first+1;
+			stackT[depth++] = aFirst ? tA : tB;
+		}
+		else if ( hitA )
+		{
+			stack[depth] = node.first;
+			stackT[depth++] = tA;
+		}
+		else if ( hitB )
+		{
+			stack[depth] = node.first+1;
+			stackT[depth++] = tB;
+		}
+	}
+
+	if ( bestTriangle < 0 )
+		return false;
+	hit->t = bestT;
+	hit->triangle = m_triangleId[bestTriangle];
+	return true;
+}
+
+bool
+vsTriangleBVH::AnyHit( const vsVector3D &pos, const vsVector3D &dir, float maxT ) const
+{
+	if ( m_node.IsEmpty() )
+		return false;
+
+	vsVector3D invDir( Inverse(dir.x), Inverse(dir.y), Inverse(dir.z) );
+	int stack[c_stackSize];
+	int depth = 0;
+	stack[depth++] = 0;
+
+	while ( depth > 0 )
+	{
+		const Node &node = m_node[ stack[--depth] ];
+		float tNear;
+		if ( !RayHitsNode( node.min, node.max, pos, invDir, maxT, &tNear ) )
+			continue;
+
+		if ( node.count > 0 )
+		{
+			for ( int i = node.first; i < node.first + node.count; i++ )
+			{
+				float t, u, v;
+				if ( vsCollideRayVsTriangle( pos, dir, m_vertex[i*3], m_vertex[i*3+1], m_vertex[i*3+2], &t, &u, &v ) &&
+						t <= maxT )
+					return true;
+			}
+			continue;
+		}
+
+		vsAssert( depth + 2 <= c_stackSize, "Triangle BVH traversal stack overflow" );
+		stack[depth++] = node.first+1;
+		stack[depth++] = node.first;
+	}
+	return false;
+}
+
+void
+vsTriangleBVH::ClosestHits( const Ray *ray, int count, Hit *hit, int threadCount ) const
+{
+	Trace( ray, count, hit, NULL, threadCount );
+}
+
+void
+vsTriangleBVH::AnyHits( const Ray *ray, int count, bool *hit, int threadCount ) const
+{
+	Trace( ray, count, NULL, hit, threadCount );
+}
+
+void
+vsTriangleBVH::Trace( const Ray *ray, int count, Hit *hit, bool *anyHit, int threadCount ) const
+{
+	int runCount = 1;
+	if ( threadCount != 1 && count >= 2 * c_minRaysPerThread )
+	{
+		int available = vsThreadPool::Instance()->GetWorkerCount( vsThreadPool::Affinity_MainThreadL3 ) + 1;
+		if ( threadCount <= 0 || threadCount > available )
+			threadCount = available;
+		runCount = vsMin( vsMin( threadCount, c_maxThreads ), count / c_minRaysPerThread );
+	}
+	if ( runCount <= 1 )
+	{
+		TraceRange( ray, count, hit, anyHit );
+		return;
+	}
+
+	// Split the batch into contiguous runs, on packet boundaries.  The
+	// calling thread casts the first run itself.
+	vsTriangleBVHJob job[c_maxThreads-1];
+	int firstEnd = 0;
+	for ( int i = 0; i < runCount; i++ )
+	{
+		int start = ((count * i) / runCount) & ~(c_packetSize-1);
+		int end = ( i == runCount-1 ) ? count : ((count * (i+1)) / runCount) & ~(c_packetSize-1);
+		if ( i == 0 )
+			firstEnd = end;
+		else
+			job[i-1].Trace( this, ray + start, end - start, hit ? hit + start : NULL, anyHit ? anyHit + start : NULL );
+	}
+	TraceRange( ray, firstEnd, hit, anyHit );
+	for ( int i = 1; i < runCount; i++ )
+	{
+		job[i-1].Wait();
+	}
+}
+
+void
+vsTriangleBVH::TraceRange( const Ray *ray, int count, Hit *hit, bool *anyHit ) const
+{
+	for ( int i = 0; i < count; i += c_packetSize )
+	{
+		TracePacket( ray + i, vsMin( c_packetSize, count - i ), hit ? hit + i : NULL, anyHit ? anyHit + i : NULL );
+	}
+}
+
+#if defined(TRIANGLEBVH_USES_SSE)
+
+// Slab tests a node's bounds against four rays at once.  Returns a bitmask
+// of the rays which pass through it no further than 'maxT' along them.
+static inline int
+PacketHitsNode( const float *min, const float *max, __m128 posX, __m128 posY, __m128 posZ,
+		__m128 invX, __m128 invY, __m128 invZ, __m128 maxT, __m128 *tNear )
+{
+	__m128 t1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( min[0] ), posX ), invX );
+	__m128 t2 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( max[0] ), posX ), invX );
+	__m128 lo = _mm_min_ps( t1, t2 );
+	__m128 hi = _mm_max_ps( t1, t2 );
+	t1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( min[1] ), posY ), invY );
+	t2 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( max[1] ), posY ), invY );
+	lo = _mm_max_ps( lo, _mm_min_ps( t1, t2 ) );
+	hi = _mm_min_ps( hi, _mm_max_ps( t1, t2 ) );
+	t1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( min[2] ), posZ ), invZ );
+	t2 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( max[2] ), posZ ), invZ );
+	lo = _mm_max_ps( lo, _mm_min_ps( t1, t2 ) );
+	hi = _mm_min_ps( hi, _mm_max_ps( t1, t2 ) );
+
+	*tNear = lo;
+	__m128 inRange = _mm_and_ps( _mm_cmpge_ps( hi, _mm_max_ps( lo, _mm_setzero_ps() ) ), _mm_cmple_ps( lo, maxT ) );
+	return _mm_movemask_ps( inRange );
+}
+
+// Expands a bitmask of lanes (as from _mm_movemask_ps) back into a vector.
+static inline __m128
+LaneMask( int bits )
+{
+	return _mm_cmpneq_ps( _mm_setr_ps( (float)(bits & 0x1), (float)(bits & 0x2), (float)(bits & 0x4), (float)(bits & 0x8) ), _mm_setzero_ps() );
+}
+
+// vsCollideRayVsTriangle() for four rays at once, with the arithmetic done
+// in the same order so that the results match it exactly.  Returns a
+// bitmask of the rays in 'lanes' which hit the triangle no further than
+// 'maxT' along them.
+static inline int
+PacketHitsTriangle( const vsVector3D *vert, __m128 posX, __m128 posY, __m128 posZ,
+		__m128 dirX, __m128 dirY, __m128 dirZ, __m128 lanes, __m128 maxT, __m128 *t, __m128 *u, __m128 *v )
+{
+	const float EPSILON = 0.000001f;
+	vsVector3D edge1 = vert[1] - vert[0];
+	vsVector3D edge2 = vert[2] - vert[0];
+	__m128 e1x = _mm_set1_ps( edge1.x ), e1y = _mm_set1_ps( edge1.y ), e1z = _mm_set1_ps( edge1.z );
+	__m128 e2x = _mm_set1_ps( edge2.x ), e2y = _mm_set1_ps( edge2.y ), e2z = _mm_set1_ps( edge2.z );
+
+	// pvec = dir x edge2
+	__m128 px = _mm_sub_ps( _mm_mul_ps( dirY, e2z ), _mm_mul_ps( dirZ, e2y ) );
+	__m128 py = _mm_sub_ps( _mm_mul_ps( dirZ, e2x ), _mm_mul_ps( dirX, e2z ) );
+	__m128 pz = _mm_sub_ps( _mm_mul_ps( dirX, e2y ), _mm_mul_ps( dirY, e2x ) );
+	__m128 det = _mm_add_ps( _mm_add_ps( _mm_mul_ps( e1x, px ), _mm_mul_ps( e1y, py ) ), _mm_mul_ps( e1z, pz ) );
+	__m128 valid = _mm_or_ps( _mm_cmple_ps( det, _mm_set1_ps( -EPSILON ) ), _mm_cmpge_ps( det, _mm_set1_ps( EPSILON ) ) );
+	valid = _mm_and_ps( valid, lanes );
+	if ( !_mm_movemask_ps( valid ) )
+		return 0;
+	__m128 invDet = _mm_div_ps( _mm_set1_ps( 1.f ), det );
+
+	// tvec = pos - vert0
+	__m128 tx = _mm_sub_ps( posX, _mm_set1_ps( vert[0].x ) );
+	__m128 ty = _mm_sub_ps( posY, _mm_set1_ps( vert[0].y ) );
+	__m128 tz = _mm_sub_ps( posZ, _mm_set1_ps( vert[0].z ) );
+	*u = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( tx, px ), _mm_mul_ps( ty, py ) ), _mm_mul_ps( tz, pz ) ), invDet );
+	valid = _mm_and_ps( valid, _mm_and_ps( _mm_cmpge_ps( *u, _mm_setzero_ps() ), _mm_cmple_ps( *u, _mm_set1_ps( 1.f ) ) ) );
+
+	// qvec = tvec x edge1
+	__m128 qx = _mm_sub_ps( _mm_mul_ps( ty, e1z ), _mm_mul_ps( tz, e1y ) );
+	__m128 qy = _mm_sub_ps( _mm_mul_ps( tz, e1x ), _mm_mul_ps( tx, e1z ) );
+	__m128 qz = _mm_sub_ps( _mm_mul_ps( tx, e1y ), _mm_mul_ps( ty, e1x ) );
+	*v = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( dirX, qx ), _mm_mul_ps( dirY, qy ) ), _mm_mul_ps( dirZ, qz ) ), invDet );
+	valid = _mm_and_ps( valid, _mm_and_ps( _mm_cmpge_ps( *v, _mm_setzero_ps() ), _mm_cmple_ps( _mm_add_ps( *u, *v ), _mm_set1_ps( 1.f ) ) ) );
+
+	*t = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( e2x, qx ), _mm_mul_ps( e2y, qy ) ), _mm_mul_ps( e2z, qz ) ), invDet );
+	valid = _mm_and_ps( valid, _mm_and_ps( _mm_cmpge_ps( *t, _mm_setzero_ps() ), _mm_cmple_ps( *t, maxT ) ) );
+	return _mm_movemask_ps( valid );
+}
+
+void
+vsTriangleBVH::TracePacket( const Ray *ray, int count, Hit *hit, bool *anyHit ) const
+{
+	// One lane per ray.  Lanes past 'count' start inactive, with a negative
+	// maximum 't' so that they never hit anything.
+	float ox[c_packetSize], oy[c_packetSize], oz[c_packetSize];
+	float ix[c_packetSize], iy[c_packetSize], iz[c_packetSize];
+	float bestT[c_packetSize];
+	float bestU[c_packetSize], bestV[c_packetSize];
+	int bestTriangle[c_packetSize];
+	int active = 0;
+	for ( int l = 0; l < c_packetSize; l++ )
+	{
+		const Ray &r = ray[ vsMin(l, count-1) ];
+		ox[l] = r.pos.x;
+		oy[l] = r.pos.y;
+		oz[l] = r.pos.z;
+		ix[l] = Inverse( r.dir.x );
+		iy[l] = Inverse( r.dir.y );
+		iz[l] = Inverse( r.dir.z );
+		bestT[l] = ( l < count ) ? r.maxT : -1.f;
+		bestU[l] = bestV[l] = 0.f;
+		bestTriangle[l] = -1;
+		if ( l < count )
+			active |= 1 << l;
+	}
+
+	const __m128 posX = _mm_loadu_ps( ox );
+	const __m128 posY = _mm_loadu_ps( oy );
+	const __m128 posZ = _mm_loadu_ps( oz );
+	const __m128 invX = _mm_loadu_ps( ix );
+	const __m128 invY = _mm_loadu_ps( iy );
+	const __m128 invZ = _mm_loadu_ps( iz );
+	const __m128 dirX = _mm_setr_ps( ray[0].dir.x, ray[vsMin(1,count-1)].dir.x, ray[vsMin(2,count-1)].dir.x, ray[vsMin(3,count-1)].dir.x );
+	const __m128 dirY = _mm_setr_ps( ray[0].dir.y, ray[vsMin(1,count-1)].dir.y, ray[vsMin(2,count-1)].dir.y, ray[vsMin(3,count-1)].dir.y );
+	const __m128 dirZ = _mm_setr_ps( ray[0].dir.z, ray[vsMin(1,count-1)].dir.z, ray[vsMin(2,count-1)].dir.z, ray[vsMin(3,count-1)].dir.z );
+
+	// Each stack entry remembers which rays hit it and where they entered
+	// it, so that it can be skipped once those rays have all found nearer
+	// hits.
+	int stack[c_stackSize];
+	int stackMask[c_stackSize];
+	__m128 stackT[c_stackSize];
+	int depth = 0;
+	if ( !m_node.IsEmpty() )
+	{
+		__m128 tNear;
+		int mask = PacketHitsNode( m_node[0].min, m_node[0].max, posX, posY, posZ, invX, invY, invZ, _mm_loadu_ps( bestT ), &tNear ) & active;
+		if ( mask )
+		{
+			stack[depth] = 0;
+			stackMask[depth] = mask;
+			stackT[depth++] = tNear;
+		}
+	}
+
+	while ( depth > 0 && active )
+	{
+		depth--;
+		__m128 best = _mm_loadu_ps( bestT );
+		int mask = stackMask[depth] & active & _mm_movemask_ps( _mm_cmple_ps( stackT[depth], best ) );
+		if ( !mask )
+			continue;
+		const Node &node = m_node[ stack[depth] ];
+
+		if ( node.count > 0 )
+		{
+			// test each triangle against all four rays at once.
+			__m128 lanes = LaneMask( mask );
+			for ( int i = node.first; i < node.first + node.count; i++ )
+			{
+				__m128 t, u, v;
+				int hits = PacketHitsTriangle( &m_vertex[i*3], posX, posY, posZ, dirX, dirY, dirZ,
+						lanes, _mm_loadu_ps( bestT ), &t, &u, &v );
+				if ( !hits )
+					continue;
+
+				__m128 hitLanes = LaneMask( hits );
+				_mm_storeu_ps( bestT, _mm_or_ps( _mm_and_ps( hitLanes, t ), _mm_andnot_ps( hitLanes, _mm_loadu_ps( bestT ) ) ) );
+				_mm_storeu_ps( bestU, _mm_or_ps( _mm_and_ps( hitLanes, u ), _mm_andnot_ps( hitLanes, _mm_loadu_ps( bestU ) ) ) );
+				_mm_storeu_ps( bestV, _mm_or_ps( _mm_and_ps( hitLanes, v ), _mm_andnot_ps( hitLanes, _mm_loadu_ps( bestV ) ) ) );
+				for ( int l = 0; l < c_packetSize; l++ )
+				{
+					if ( hits & (1 << l) )
+						bestTriangle[l] = i;
+				}
+				if ( anyHit )
+				{
+					// rays which have hit something are finished.
+					active &= ~hits;
+					mask &= ~hits;
+					if ( !mask )
+						break;
+					lanes = _mm_andnot_ps( hitLanes, lanes );
+				}
+			}
+			continue;
+		}
+
+		// test both children, and visit the one nearer to the first ray
+		// which hit us first, by pushing it last.
+		__m128 tA, tB;
+		int maskA = PacketHitsNode( m_node[node.first].min, m_node[node.first].max, posX, posY, posZ, invX, invY, invZ, best, &tA ) & mask;
+		int maskB = PacketHitsNode( m_node[node.first+1].min, m_node[node.first+1].max, posX, posY, posZ, invX, invY, invZ, best, &tB ) & mask;
+		float nearA[c_packetSize], nearB[c_packetSize];
+		_mm_storeu_ps( nearA, tA );
+		_mm_storeu_ps( nearB, tB );
+		int l = 0;
+		while ( !(mask & (1 << l)) )
+			l++;
+		bool aFirst = !maskB || ( maskA && nearA[l] <= nearB[l] );
+
+		vsAssert( depth + 2 <= c_stackSize, "Triangle BVH traversal stack overflow" );
+		if ( aFirst ? maskB : maskA )
+		{
+			stack[depth] = aFirst ? node.first+1 : node.first;
+			stackMask[depth] = aFirst ? maskB : maskA;
+			stackT[depth++] = aFirst ? tB : tA;
+		}
+		if ( aFirst ? maskA : maskB )
+		{
+			stack[depth] = aFirst ? node.first : node.first+1;
+			stackMask[depth] = aFirst ? maskA : maskB;
+			stackT[depth++] = aFirst ? tA : tB;
+		}
+	}
+
+	for ( int l = 0; l < count; l++ )
+	{
+		if ( anyHit )
+			anyHit[l] = ( bestTriangle[l] >= 0 );
+		else
+		{
+			hit[l].t = bestT[l];
+			hit[l].u = bestU[l];
+			hit[l].v = bestV[l];
+			hit[l].triangle = ( bestTriangle[l] >= 0 ) ? m_triangleId[ bestTriangle[l] ] : -1;
+		}
+	}
+}
+
+#else // TRIANGLEBVH_USES_SSE
+
+void
+vsTriangleBVH::TracePacket( const Ray *ray, int count, Hit *hit, bool *anyHit ) const
+{
+	for ( int l = 0; l < count; l++ )
+	{
+		const Ray &r = ray[l];
+		if ( anyHit )
+			anyHit[l] = AnyHit( r.pos, r.dir, r.maxT );
+		else if ( !ClosestHit( r.pos, r.dir, r.maxT, &hit[l] ) )
+		{
+			hit[l].t = r.maxT;
+			hit[l].u = hit[l].v = 0.f;
+			hit[l].triangle = -1;
+		}
+	}
+}
+
+#endif // TRIANGLEBVH_USES_SSE
@@ -0,0 +1,101 @@
+/*
+ *  VS_TriangleBVH.h
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+#ifndef VS_TRIANGLEBVH_H
+#define VS_TRIANGLEBVH_H
+
+#include "VS_Vector.h"
+#include "VS/Utils/VS_Array.h"
+
+// vsTriangleBVH is a bounding volume hierarchy over a fixed set of triangles,
+// for answering ray queries without testing every triangle.  It's built once
+// using the surface area heuristic, and stored as a flat array of nodes with
+// the triangles reordered to match, so that each leaf's triangles sit next to
+// each other in memory.
+//
+// Rays are tested against triangles with vsCollideRayVsTriangle(), so hits
+// are double-sided and 't' is measured in units of 'dir'.
+//
+// Many rays may be cast at once through ClosestHits() and AnyHits().  Those
+// walk the tree with packets of four rays at a time, testing all four
+// against each node's bounds together, and split large batches across the
+// thread pool.  Packets work best when neighbouring rays in the batch start
+// near each other and point in similar directions.
+
+class vsTriangleBVHJob;
+
+class vsTriangleBVH
+{
+	struct Node
+	{
+		float	min[3];
+		float	max[3];
+		int		first;	// leaf:  first triangle.  interior:  first of our two child nodes
+		int		count;	// leaf:  triangle count.  interior:  zero
+	};
+
+	vsArray<Node>		m_node;
+	vsArray<vsVector3D>	m_vertex;	// three per triangle, in leaf order
+	vsArray<int>		m_triangleId;	// index each of those triangles had when passed to Build()
+
+	void	BuildNode( int nodeId, int first, int count, int depth, vsArray<vsVector3D> &centroid );
+	void	SwapTriangles( int a, int b, vsArray<vsVector3D> &centroid );
+
+public:
+
+	struct Hit
+	{
+		float	t;
+		float	u;			// barycentric coordinates of the hit, as from vsCollideRayVsTriangle()
+		float	v;
+		int		triangle;	// as numbered in the array passed to Build();  -1 for a miss in a batch query
+	};
+
+	struct Ray
+	{
+		vsVector3D	pos;
+		vsVector3D	dir;
+		float		maxT;
+	};
+
+	vsTriangleBVH();
+
+	// 'vertex' holds three vertices for each triangle.
+	void	Build( const vsVector3D *vertex, int triangleCount );
+	void	Clear();
+
+	// Finds the nearest hit with 't' no greater than 'maxT'.
+	bool	ClosestHit( const vsVector3D &pos, const vsVector3D &dir, float maxT, Hit *hit ) const;
+	// Stops at the first hit found with 't' no greater than 'maxT';  for
+	// line-of-sight tests, where we don't care which triangle is in the way.
+	bool	AnyHit( const vsVector3D &pos, const vsVector3D &dir, float maxT ) const;
+
+	// Batch versions of the above, writing one result per ray.  'threadCount'
+	// limits how many threads may share the work, counting the calling
+	// thread;  0 means the calling thread plus every worker sharing its L3
+	// cache.  Threaded batches must be cast from the main thread.
+	void	ClosestHits( const Ray *ray, int count, Hit *hit, int threadCount = 0 ) const;
+	void	AnyHits( const Ray *ray, int count, bool *hit, int threadCount = 0 ) const;
+
+	int		GetTriangleCount() const { return m_triangleId.ItemCount(); }
+	int		GetNodeCount() const { return m_node.ItemCount(); }
+
+private:
+
+	// batch queries fill in 'hit' when finding closest hits, or 'anyHit'
+	// when just checking for any hit.
+	void	Trace( const Ray *ray, int count, Hit *hit, bool *anyHit, int threadCount ) const;
+	void	TraceRange( const Ray *ray, int count, Hit *hit, bool *anyHit ) const;
+	void	TracePacket( const Ray *ray, int count, Hit *hit, bool *anyHit ) const;
+
+	friend class vsTriangleBVHJob;
+};
+
+#endif // VS_TRIANGLEBVH_H
+
@@ -26,7 +26,8 @@ static vsHeap *	s_stack[MAX_HEAP_STACK] = {NULL,NULL,NULL,NULL};
 #undef free
 
 vsHeap::vsHeap(vsString name, size_t size):
-	m_name(name)
+	m_name(name),
+	m_lock("vsHeap")
 {
 #ifdef VS_OVERLOAD_ALLOCATORS
 	if ( s_current )
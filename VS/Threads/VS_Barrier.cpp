@@ -0,0 +1,85 @@
+//
+//  VS_Barrier.cpp
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#include "VS_Barrier.h"
+
+// m_generation counts how many times the barrier has opened.  Waiters park on
+// it, and wake when it changes.  Its top bit is our 'released' flag.
+#define BARRIER_RELEASED (0x80000000u)
+#define BARRIER_GENERATION_MASK (0x7fffffffu)
+
+vsBarrier::vsBarrier( unsigned int threadCount ):
+	m_generation( 0 ),
+	m_arrived( 0 ),
+	m_waiters( 0 ),
+	m_count( threadCount )
+{
+	vsAssert( threadCount > 0, "Barrier needs at least one thread!" );
+}
+
+vsBarrier::~vsBarrier()
+{
+	vsAssert(IsReleased(), "Barrier destroyed without being released?");
+}
+
+bool
+vsBarrier::ArriveAndWait()
+{
+	uint32_t generation = m_generation.load( std::memory_order_acquire );
+	if ( generation & BARRIER_RELEASED )
+		return false;
+
+	if ( m_arrived.fetch_add(1) + 1 == m_count )
+	{
+		// we're the last to arrive.  Reset for the next phase, then open the
+		// barrier by advancing the generation.  Nobody can arrive for the next
+		// phase until they've seen the new generation, so resetting the
+		// arrival count first is safe.
+		m_arrived.store(0);
+		uint32_t next;
+		do
+		{
+			next = ((generation + 1) & BARRIER_GENERATION_MASK) | (generation & BARRIER_RELEASED);
+		} while ( !m_generation.compare_exchange_weak( generation, next ) );
+
+		if ( m_waiters.load() != 0 )
+			vsFutex::WakeAll( &m_generation );
+		return (next & BARRIER_RELEASED) == 0;
+	}
+
+	while ( true )
+	{
+		uint32_t current = m_generation.load( std::memory_order_acquire );
+		if ( current & BARRIER_RELEASED )
+			return false;
+		if ( current != generation )
+			return true;
+
+		if ( vsFutexSpin( &m_generation, current ) )
+			continue;
+
+		m_waiters.fetch_add(1);
+		vsFutex::Wait( &m_generation, current );
+		m_waiters.fetch_sub(1);
+	}
+}
+
+void
+vsBarrier::Release()
+{
+	uint32_t generation = m_generation.fetch_or( BARRIER_RELEASED );
+	if ( !(generation & BARRIER_RELEASED) )
+		vsFutex::WakeAll( &m_generation );
+}
+
+bool
+vsBarrier::IsReleased() const
+{
+	return (m_generation.load() & BARRIER_RELEASED) != 0;
+}
+
@@ -0,0 +1,42 @@
+//
+//  VS_Barrier.h
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#ifndef VS_BARRIER_H
+#define VS_BARRIER_H
+
+#include "VS_Futex.h"
+
+// vsBarrier is a reusable rendezvous point for a fixed number of threads.
+// Each thread calls ArriveAndWait();  nobody gets through until all of them
+// have arrived, at which point they're all let through together and the
+// barrier resets itself for the next phase.
+
+class vsBarrier
+{
+	vsFutexWord		m_generation;
+	vsFutexWord		m_arrived;
+	vsFutexWord		m_waiters;
+	uint32_t		m_count;
+
+public:
+
+	vsBarrier( unsigned int threadCount );
+	~vsBarrier();
+
+	// Returns 'true' once every participating thread has arrived, or 'false'
+	// if the barrier has been released, as with vsSemaphore::Wait().
+	bool ArriveAndWait();
+
+	// Release() must be called before destroying the vsBarrier!  Wakes all
+	// waiting threads, and causes all future ArriveAndWait() calls to return
+	// 'false' immediately.
+	void Release();
+	bool IsReleased() const;
+};
+
+#endif // VS_BARRIER_H
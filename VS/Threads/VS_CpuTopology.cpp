@@ -0,0 +1,325 @@
+//
+//  VS_CpuTopology.cpp
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#include "VS_CpuTopology.h"
+
+#include <SDL2/SDL.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <stdio.h>
+#endif
+
+void
+vsCpuSet::Clear()
+{
+	for ( int i = 0; i < VS_MAX_CPUS/64; i++ )
+		m_bits[i] = 0;
+}
+
+void
+vsCpuSet::Add( int cpu )
+{
+	if ( cpu >= 0 && cpu < VS_MAX_CPUS )
+		m_bits[cpu/64] |= (uint64_t)1 << (cpu%64);
+}
+
+void
+vsCpuSet::Add( const vsCpuSet& other )
+{
+	for ( int i = 0; i < VS_MAX_CPUS/64; i++ )
+		m_bits[i] |= other.m_bits[i];
+}
+
+bool
+vsCpuSet::Contains( int cpu ) const
+{
+	if ( cpu < 0 || cpu >= VS_MAX_CPUS )
+		return false;
+	return (m_bits[cpu/64] & ((uint64_t)1 << (cpu%64))) != 0;
+}
+
+int
+vsCpuSet::Count() const
+{
+	int count = 0;
+	for ( int i = 0; i < VS_MAX_CPUS/64; i++ )
+	{
+		// clear the lowest set bit until there are none left.  We only call
+		// this while setting up threads, so there's no need for intrinsics.
+		for ( uint64_t bits = m_bits[i]; bits; bits &= bits-1 )
+			count++;
+	}
+	return count;
+}
+
+int
+vsCpuSet::First() const
+{
+	for ( int i = 0; i < VS_MAX_CPUS; i++ )
+		if ( Contains(i) )
+			return i;
+	return -1;
+}
+
+vsString
+vsCpuSet::ToString() const
+{
+	vsString result;
+	int i = 0;
+	while ( i < VS_MAX_CPUS )
+	{
+		if ( !Contains(i) )
+		{
+			i++;
+			continue;
+		}
+		int end = i;
+		while ( end+1 < VS_MAX_CPUS && Contains(end+1) )
+			end++;
+
+		if ( !result.empty() )
+			result += ",";
+		if ( end == i )
+			result += vsFormatString("%d", i);
+		else
+			result += vsFormatString("%d-%d", i, end);
+		i = end+1;
+	}
+	return result;
+}
+
+#if defined(__linux__)
+
+// sysfs files are tiny;  we just want their first line.
+static bool ReadLine( const vsString& path, vsString *result )
+{
+	FILE *f = fopen( path.c_str(), "r" );
+	if ( !f )
+		return false;
+
+	char buffer[1024];
+	bool success = ( fgets( buffer, sizeof(buffer), f ) != NULL );
+	fclose(f);
+
+	if ( success )
+	{
+		*result = buffer;
+		while ( !result->empty() && ( (*result)[result->size()-1] == '\n' || (*result)[result->size()-1] == ' ' ) )
+			result->resize( result->size()-1 );
+	}
+	return success;
+}
+
+static bool ReadInt( const vsString& path, int *result )
+{
+	vsString line;
+	if ( !ReadLine( path, &line ) )
+		return false;
+	return sscanf( line.c_str(), "%d", result ) == 1;
+}
+
+// parse a kernel cpu list, such as "0-3,8-11"
+static bool ParseCpuList( const vsString& list, vsCpuSet *result )
+{
+	result->Clear();
+	const char *c = list.c_str();
+	while ( *c )
+	{
+		int first, last;
+		int consumed = 0;
+		if ( sscanf( c, "%d%n", &first, &consumed ) != 1 )
+			return false;
+		c += consumed;
+		last = first;
+		if ( *c == '-' )
+		{
+			c++;
+			if ( sscanf( c, "%d%n", &last, &consumed ) != 1 )
+				return false;
+			c += consumed;
+		}
+		for ( int i = first; i <= last; i++ )
+			result->Add(i);
+		if ( *c == ',' )
+			c++;
+		else if ( *c )
+			return false;
+	}
+	return !result->IsEmpty();
+}
+
+#endif // __linux__
+
+vsCpuTopology::vsCpuTopology():
+	m_logicalCount(0)
+{
+	Detect();
+	if ( m_core.IsEmpty() )
+		DetectFallback();
+}
+
+const vsCpuTopology&
+vsCpuTopology::Instance()
+{
+	static vsCpuTopology s_topology;
+	return s_topology;
+}
+
+void
+vsCpuTopology::Detect()
+{
+#if defined(__linux__)
+	vsString line;
+	vsCpuSet online;
+	if ( !ReadLine( "/sys/devices/system/cpu/online", &line ) || !ParseCpuList( line, &online ) )
+		return;
+
+	// physical cores are identified by their (package, core_id) pair;  L3
+	// domains by the list of CPUs sharing the cache.
+	vsArray<int> corePackage;
+	vsArray<int> coreId;
+
+	for ( int cpu = 0; cpu < VS_MAX_CPUS; cpu++ )
+	{
+		while ( m_cpu.ItemCount() <= cpu )
+		{
+			Cpu unknown = { -1, -1 };
+			m_cpu.AddItem( unknown );
+		}
+		if ( !online.Contains(cpu) )
+			continue;
+
+		vsString base = vsFormatString("/sys/devices/system/cpu/cpu%d/", cpu);
+		int package = 0, id = cpu;
+		ReadInt( base + "topology/physical_package_id", &package );
+		ReadInt( base + "topology/core_id", &id );
+
+		int core = -1;
+		for ( int i = 0; i < m_core.ItemCount(); i++ )
+		{
+			if ( corePackage[i] == package && coreId[i] == id )
+			{
+				core = i;
+				break;
+			}
+		}
+		if ( core == -1 )
+		{
+			core = m_core.ItemCount();
+			m_core.AddItem( vsCpuSet() );
+			corePackage.AddItem( package );
+			coreId.AddItem( id );
+		}
+		m_core[core].Add( cpu );
+
+		// find the L3 cache.  If there isn't one, treat each package as one
+		// cache domain.
+		vsCpuSet shared;
+		bool foundL3 = false;
+		for ( int index = 0; !foundL3; index++ )
+		{
+			vsString cache = base + vsFormatString("cache/index%d/", index);
+			int level;
+			if ( !ReadInt( cache + "level", &level ) )
+				break;
+			if ( level == 3 && ReadLine( cache + "shared_cpu_list", &line ) )
+				foundL3 = ParseCpuList( line, &shared );
+		}
+		if ( !foundL3 )
+		{
+			shared.Clear();
+			shared.Add( cpu );
+			for ( int other = 0; other < VS_MAX_CPUS; other++ )
+			{
+				int otherPackage;
+				if ( other != cpu && online.Contains(other) &&
+						ReadInt( vsFormatString("/sys/devices/system/cpu/cpu%d/topology/physical_package_id", other), &otherPackage ) &&
+						otherPackage == package )
+					shared.Add( other );
+			}
+		}
+
+		int l3 = -1;
+		for ( int i = 0; i < m_l3.ItemCount(); i++ )
+		{
+			if ( m_l3[i].Contains(cpu) )
+			{
+				l3 = i;
+				break;
+			}
+		}
+		if ( l3 == -1 )
+		{
+			l3 = m_l3.ItemCount();
+			m_l3.AddItem( shared );
+		}
+
+		m_cpu[cpu].core = core;
+		m_cpu[cpu].l3 = l3;
+		m_logicalCount++;
+	}
+#endif // __linux__
+}
+
+void
+vsCpuTopology::DetectFallback()
+{
+	m_cpu.Clear();
+	m_core.Clear();
+	m_l3.Clear();
+
+	m_logicalCount = vsClamp( SDL_GetCPUCount(), 1, VS_MAX_CPUS );
+	m_l3.AddItem( vsCpuSet() );
+	for ( int cpu = 0; cpu < m_logicalCount; cpu++ )
+	{
+		Cpu c = { cpu, 0 };
+		m_cpu.AddItem( c );
+		m_core.AddItem( vsCpuSet() );
+		m_core[cpu].Add( cpu );
+		m_l3[0].Add( cpu );
+	}
+}
+
+int
+vsCpuTopology::GetCoreForCpu( int cpu ) const
+{
+	if ( cpu < 0 || cpu >= m_cpu.ItemCount() )
+		return -1;
+	return m_cpu[cpu].core;
+}
+
+int
+vsCpuTopology::GetL3ForCpu( int cpu ) const
+{
+	if ( cpu < 0 || cpu >= m_cpu.ItemCount() )
+		return -1;
+	return m_cpu[cpu].l3;
+}
+
+int
+vsCpuTopology::GetCurrentCpu()
+{
+#if defined(__linux__)
+	return sched_getcpu();
+#else
+	return -1;
+#endif
+}
+
+void
+vsCpuTopology::Log() const
+{
+	vsLog("CPU topology: %d logical CPUs, %d physical cores, %d L3 domains",
+			m_logicalCount, m_core.ItemCount(), m_l3.ItemCount());
+	for ( int i = 0; i < m_l3.ItemCount(); i++ )
+	{
+		vsLog("  L3 %d: CPUs %s", i, m_l3[i].ToString().c_str());
+	}
+}
+
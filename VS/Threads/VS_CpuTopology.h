@@ -0,0 +1,86 @@
+//
+//  VS_CpuTopology.h
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#ifndef VS_CPUTOPOLOGY_H
+#define VS_CPUTOPOLOGY_H
+
+#include "VS/Utils/VS_Array.h"
+
+#define VS_MAX_CPUS (256)
+
+// A set of logical CPUs, for thread affinity.
+class vsCpuSet
+{
+	uint64_t m_bits[VS_MAX_CPUS/64];
+
+public:
+	vsCpuSet() { Clear(); }
+
+	void	Clear();
+	void	Add( int cpu );
+	void	Add( const vsCpuSet& other );
+	bool	Contains( int cpu ) const;
+	bool	IsEmpty() const { return Count() == 0; }
+	int		Count() const;
+	int		First() const;	// returns -1 if the set is empty
+
+	vsString ToString() const;	// "0-3,8-11", as the kernel writes them
+};
+
+// vsCpuTopology describes how the logical CPUs on this machine are grouped;
+// which logical CPUs are SMT siblings sharing a single physical core, and
+// which physical cores share a single L3 cache.
+//
+// On Linux, this is read from /sys/devices/system/cpu.  Elsewhere (or if
+// sysfs isn't available), we assume that every logical CPU is its own core,
+// and that they all share one L3.
+
+class vsCpuTopology
+{
+	struct Cpu
+	{
+		int core;	// index into m_core
+		int l3;		// index into m_l3
+	};
+
+	vsArray<Cpu>		m_cpu;	// indexed by logical CPU id;  offline CPUs have core -1.
+	vsArray<vsCpuSet>	m_core;
+	vsArray<vsCpuSet>	m_l3;
+	int					m_logicalCount;
+
+	void	Detect();
+	void	DetectFallback();
+
+	vsCpuTopology();
+
+public:
+
+	static const vsCpuTopology& Instance();
+
+	int		GetLogicalCpuCount() const { return m_logicalCount; }
+	int		GetPhysicalCoreCount() const { return m_core.ItemCount(); }
+	int		GetL3DomainCount() const { return m_l3.ItemCount(); }
+
+	// The logical CPUs making up a physical core (ie: SMT siblings), or
+	// sharing an L3 cache.
+	const vsCpuSet&	GetCoreCpus( int core ) const { return m_core[core]; }
+	const vsCpuSet&	GetL3Cpus( int l3 ) const { return m_l3[l3]; }
+
+	// Returns -1 for CPUs we don't know about.
+	int		GetCoreForCpu( int cpu ) const;
+	int		GetL3ForCpu( int cpu ) const;
+
+	// Which logical CPU is the calling thread running on right now?  Returns
+	// -1 if the platform can't tell us.
+	static int GetCurrentCpu();
+
+	void	Log() const;
+};
+
+#endif // VS_CPUTOPOLOGY_H
+
@@ -0,0 +1,91 @@
+//
+//  VS_Event.cpp
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#include "VS_Event.h"
+
+#define EVENT_SET (0x1u)
+#define EVENT_RELEASED (0x80000000u)
+
+vsEvent::vsEvent( bool autoReset ):
+	m_state( 0 ),
+	m_waiters( 0 ),
+	m_autoReset( autoReset )
+{
+}
+
+vsEvent::~vsEvent()
+{
+	vsAssert(IsReleased(), "Event destroyed without being released?");
+}
+
+void
+vsEvent::Set()
+{
+	uint32_t state = m_state.fetch_or( EVENT_SET );
+	if ( !(state & EVENT_SET) && m_waiters.load() != 0 )
+	{
+		if ( m_autoReset )
+			vsFutex::WakeOne( &m_state );
+		else
+			vsFutex::WakeAll( &m_state );
+	}
+}
+
+void
+vsEvent::Reset()
+{
+	m_state.fetch_and( ~EVENT_SET );
+}
+
+bool
+vsEvent::IsSet() const
+{
+	return (m_state.load() & EVENT_SET) != 0;
+}
+
+bool
+vsEvent::Wait()
+{
+	while ( true )
+	{
+		uint32_t state = m_state.load( std::memory_order_acquire );
+		if ( state & EVENT_RELEASED )
+			return false;
+
+		if ( state & EVENT_SET )
+		{
+			if ( !m_autoReset )
+				return true;
+			if ( m_state.compare_exchange_weak( state, state & ~EVENT_SET, std::memory_order_acquire, std::memory_order_relaxed ) )
+				return true;
+			continue;
+		}
+
+		if ( vsFutexSpin( &m_state, state ) )
+			continue;
+
+		m_waiters.fetch_add(1);
+		vsFutex::Wait( &m_state, state );
+		m_waiters.fetch_sub(1);
+	}
+}
+
+void
+vsEvent::Release()
+{
+	uint32_t state = m_state.fetch_or( EVENT_RELEASED );
+	if ( !(state & EVENT_RELEASED) )
+		vsFutex::WakeAll( &m_state );
+}
+
+bool
+vsEvent::IsReleased() const
+{
+	return (m_state.load() & EVENT_RELEASED) != 0;
+}
+
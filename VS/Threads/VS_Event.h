@@ -0,0 +1,46 @@
+//
+//  VS_Event.h
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#ifndef VS_EVENT_H
+#define VS_EVENT_H
+
+#include "VS_Futex.h"
+
+// vsEvent is a simple "this thing has happened" flag which threads can sleep
+// on.  By default it's a manual-reset event;  once Set(), every waiter passes
+// through until somebody calls Reset().  An auto-reset event instead lets
+// exactly one waiter through per Set().
+
+class vsEvent
+{
+	vsFutexWord		m_state;
+	vsFutexWord		m_waiters;
+	bool			m_autoReset;
+
+public:
+
+	vsEvent( bool autoReset = false );
+	~vsEvent();
+
+	void Set();
+	void Reset();
+	bool IsSet() const;
+
+	// Wait until the event has been set, or until the event has been
+	// released.  As with vsSemaphore, returns 'false' if the event has been
+	// released, as a signal that the waiting thread should exit.
+	bool Wait();
+
+	// Release() must be called before destroying the vsEvent!  After
+	// releasing, Wait() will return 'false' immediately for every thread
+	// which is now waiting or ever waits on this event in the future.
+	void Release();
+	bool IsReleased() const;
+};
+
+#endif // VS_EVENT_H
@@ -0,0 +1,133 @@
+//
+//  VS_Futex.cpp
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#include "VS_Futex.h"
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#define vsCpuRelax() _mm_pause()
+#else
+#define vsCpuRelax()
+#endif
+
+// how many times we'll poll a word before giving up and going to sleep on it.
+#define FUTEX_SPIN_COUNT (128)
+
+bool vsFutexSpin( vsFutexWord *word, uint32_t expected )
+{
+	for ( int i = 0; i < FUTEX_SPIN_COUNT; i++ )
+	{
+		if ( word->load( std::memory_order_acquire ) != expected )
+			return true;
+		vsCpuRelax();
+	}
+	return false;
+}
+
+#if defined(__linux__)
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+
+static long futex( vsFutexWord *word, int op, uint32_t value )
+{
+	// std::atomic<uint32_t> is guaranteed to be lock-free and the same size as
+	// a uint32_t on every Linux target we support, so the kernel can operate
+	// on it directly.
+	return syscall( SYS_futex, reinterpret_cast<uint32_t*>(word), op, value, NULL, NULL, 0 );
+}
+
+void
+vsFutex::Wait( vsFutexWord *word, uint32_t expected )
+{
+	// EAGAIN (value already changed) and EINTR are both fine;  our callers
+	// re-check their state and come back here if they still need to sleep.
+	futex( word, FUTEX_WAIT_PRIVATE, expected );
+}
+
+void
+vsFutex::WakeOne( vsFutexWord *word )
+{
+	futex( word, FUTEX_WAKE_PRIVATE, 1 );
+}
+
+void
+vsFutex::WakeAll( vsFutexWord *word )
+{
+	futex( word, FUTEX_WAKE_PRIVATE, INT_MAX );
+}
+
+#else
+
+// No futex syscall available, so emulate one with a "parking lot";  a fixed
+// table of mutex/condition variable pairs, indexed by a hash of the word's
+// address.  Several words may share a bucket, so wakes are always broadcast
+// and waiters re-check their own word.
+
+#include <SDL2/SDL.h>
+
+#define FUTEX_BUCKET_COUNT (64)
+
+struct vsFutexBucket
+{
+	SDL_mutex *mutex;
+	SDL_cond *cond;
+
+	vsFutexBucket():
+		mutex( SDL_CreateMutex() ),
+		cond( SDL_CreateCond() )
+	{
+	}
+
+	~vsFutexBucket()
+	{
+		SDL_DestroyCond( cond );
+		SDL_DestroyMutex( mutex );
+	}
+};
+
+static vsFutexBucket s_bucket[FUTEX_BUCKET_COUNT];
+
+static vsFutexBucket& GetBucket( vsFutexWord *word )
+{
+	uintptr_t address = reinterpret_cast<uintptr_t>(word);
+	return s_bucket[ (address >> 4) % FUTEX_BUCKET_COUNT ];
+}
+
+void
+vsFutex::Wait( vsFutexWord *word, uint32_t expected )
+{
+	vsFutexBucket& bucket = GetBucket(word);
+	SDL_LockMutex( bucket.mutex );
+	if ( word->load() == expected )
+		SDL_CondWait( bucket.cond, bucket.mutex );
+	SDL_UnlockMutex( bucket.mutex );
+}
+
+void
+vsFutex::WakeOne( vsFutexWord *word )
+{
+	WakeAll(word);
+}
+
+void
+vsFutex::WakeAll( vsFutexWord *word )
+{
+	// taking the mutex here means that a waiter can't be between checking its
+	// word and going to sleep on the condition variable, so we can never miss
+	// waking it.
+	vsFutexBucket& bucket = GetBucket(word);
+	SDL_LockMutex( bucket.mutex );
+	SDL_CondBroadcast( bucket.cond );
+	SDL_UnlockMutex( bucket.mutex );
+}
+
+#endif
+
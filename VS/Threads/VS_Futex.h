@@ -0,0 +1,50 @@
+//
+//  VS_Futex.h
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#ifndef VS_FUTEX_H
+#define VS_FUTEX_H
+
+#include "VS_DisableDebugNew.h"
+#include <atomic>
+#include "VS_EnableDebugNew.h"
+
+// vsFutex is the "park this thread until somebody pokes this word" building
+// block which our lightweight synchronisation primitives (vsSemaphore,
+// vsEvent, vsLatch, vsBarrier) sit on top of.
+//
+// Those primitives keep all of their state in a single 32-bit atomic word, and
+// only ever come here when they genuinely need to sleep or to wake a sleeping
+// thread.  The uncontended paths never touch the kernel.
+//
+// On Linux, this maps directly onto the futex syscall.  On other platforms we
+// emulate it with a small hashed table of SDL mutexes and condition variables.
+
+typedef std::atomic<uint32_t> vsFutexWord;
+
+class vsFutex
+{
+public:
+
+	// Sleep the calling thread for as long as 'word' still contains
+	// 'expected'.  May return spuriously;  callers must re-check their
+	// condition in a loop.
+	static void Wait( vsFutexWord *word, uint32_t expected );
+
+	// Wake up to one/all threads currently sleeping on 'word'.
+	static void WakeOne( vsFutexWord *word );
+	static void WakeAll( vsFutexWord *word );
+};
+
+// Spin briefly on a word before falling back to sleeping on it.  Most of our
+// waits are very short (a worker finishing a job), and a little spinning saves
+// a round trip through the kernel.  Returns true if 'word' no longer contains
+// 'expected'.
+bool vsFutexSpin( vsFutexWord *word, uint32_t expected );
+
+#endif // VS_FUTEX_H
+
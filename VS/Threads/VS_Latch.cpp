@@ -0,0 +1,81 @@
+//
+//  VS_Latch.cpp
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#include "VS_Latch.h"
+
+#define LATCH_RELEASED (0x80000000u)
+#define LATCH_COUNT_MASK (0x7fffffffu)
+
+vsLatch::vsLatch( unsigned int count ):
+	m_count( count & LATCH_COUNT_MASK ),
+	m_waiters( 0 )
+{
+}
+
+vsLatch::~vsLatch()
+{
+	vsAssert(IsReleased(), "Latch destroyed without being released?");
+}
+
+void
+vsLatch::CountDown( unsigned int n )
+{
+	uint32_t count = m_count.fetch_sub( n );
+	vsAssert( (count & LATCH_COUNT_MASK) >= n, "Latch counted down past zero!" );
+
+	if ( (count & LATCH_COUNT_MASK) == n && m_waiters.load() != 0 )
+		vsFutex::WakeAll( &m_count );
+}
+
+bool
+vsLatch::TryWait() const
+{
+	return (m_count.load( std::memory_order_acquire ) & LATCH_COUNT_MASK) == 0;
+}
+
+bool
+vsLatch::Wait()
+{
+	while ( true )
+	{
+		uint32_t count = m_count.load( std::memory_order_acquire );
+		if ( count & LATCH_RELEASED )
+			return false;
+		if ( count == 0 )
+			return true;
+
+		if ( vsFutexSpin( &m_count, count ) )
+			continue;
+
+		m_waiters.fetch_add(1);
+		vsFutex::Wait( &m_count, count );
+		m_waiters.fetch_sub(1);
+	}
+}
+
+bool
+vsLatch::ArriveAndWait()
+{
+	CountDown();
+	return Wait();
+}
+
+void
+vsLatch::Release()
+{
+	uint32_t count = m_count.fetch_or( LATCH_RELEASED );
+	if ( !(count & LATCH_RELEASED) )
+		vsFutex::WakeAll( &m_count );
+}
+
+bool
+vsLatch::IsReleased() const
+{
+	return (m_count.load() & LATCH_RELEASED) != 0;
+}
+
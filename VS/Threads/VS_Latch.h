@@ -0,0 +1,48 @@
+//
+//  VS_Latch.h
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#ifndef VS_LATCH_H
+#define VS_LATCH_H
+
+#include "VS_Futex.h"
+
+// vsLatch is a single-use countdown.  It starts at some count, threads call
+// CountDown() as they finish their piece of work, and anybody calling Wait()
+// sleeps until the count reaches zero.  Typical use is "kick off N jobs, then
+// wait for all of them to be done".
+
+class vsLatch
+{
+	vsFutexWord		m_count;
+	vsFutexWord		m_waiters;
+
+public:
+
+	vsLatch( unsigned int count );
+	~vsLatch();
+
+	// Decrement the count by 'n'.  It's an error to count down past zero.
+	void CountDown( unsigned int n = 1 );
+
+	// Returns true if the count has reached zero.  Never blocks.
+	bool TryWait() const;
+
+	// Wait until the count has reached zero.  Returns 'false' if the latch
+	// has been released instead, as with vsSemaphore::Wait().
+	bool Wait();
+
+	// CountDown() followed by Wait().
+	bool ArriveAndWait();
+
+	// Release() must be called before destroying the vsLatch!  Wakes all
+	// waiting threads, and causes all future Wait() calls to return 'false'.
+	void Release();
+	bool IsReleased() const;
+};
+
+#endif // VS_LATCH_H
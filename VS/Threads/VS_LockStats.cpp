@@ -0,0 +1,275 @@
+//
+//  VS_LockStats.cpp
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#include "VS_LockStats.h"
+
+#ifdef VS_LOCK_PROFILING
+
+#include "VS_File.h"
+#include <SDL2/SDL.h>
+
+#include "VS_DisableDebugNew.h"
+#include <algorithm>
+#include <vector>
+#include "VS_EnableDebugNew.h"
+
+// The registry of live locks is guarded by a raw SDL spinlock, rather than a
+// vsSpinlock, since a vsSpinlock would itself want to register here.
+static SDL_SpinLock s_registryLock = 0;
+vsLockStats *vsLockStats::s_first = NULL;
+
+namespace
+{
+	const char * TypeName( vsLockStats::Type type )
+	{
+		switch ( type )
+		{
+			case vsLockStats::Type_Mutex: return "mutex";
+			case vsLockStats::Type_Spinlock: return "spinlock";
+			case vsLockStats::Type_Semaphore: return "semaphore";
+		}
+		return "unknown";
+	}
+
+	void AtomicAdd( std::atomic<uint64_t>& counter, uint64_t value )
+	{
+		counter.fetch_add( value, std::memory_order_relaxed );
+	}
+
+	void AtomicMax( std::atomic<uint64_t>& counter, uint64_t value )
+	{
+		uint64_t current = counter.load( std::memory_order_relaxed );
+		while ( value > current && !counter.compare_exchange_weak( current, value, std::memory_order_relaxed ) )
+			;
+	}
+}
+
+vsLockStats::vsLockStats( const char *name, Type type ):
+	m_name( name ? name : "(unnamed)" ),
+	m_type( type ),
+	m_acquisitions(0),
+	m_contended(0),
+	m_totalWait(0),
+	m_maxWait(0),
+	m_totalHold(0),
+	m_maxHold(0),
+	m_holdStart(0),
+	m_holderFile(NULL),
+	m_holderLine(0),
+	m_maxHoldFile(NULL),
+	m_maxHoldLine(0),
+	m_prev(NULL),
+	m_next(NULL)
+{
+	SDL_AtomicLock( &s_registryLock );
+	m_next = s_first;
+	if ( s_first )
+		s_first->m_prev = this;
+	s_first = this;
+	SDL_AtomicUnlock( &s_registryLock );
+}
+
+vsLockStats::~vsLockStats()
+{
+	SDL_AtomicLock( &s_registryLock );
+	if ( m_prev )
+		m_prev->m_next = m_next;
+	else
+		s_first = m_next;
+	if ( m_next )
+		m_next->m_prev = m_prev;
+	SDL_AtomicUnlock( &s_registryLock );
+}
+
+uint64_t
+vsLockStats::Now()
+{
+	return SDL_GetPerformanceCounter();
+}
+
+void
+vsLockStats::Acquired( uint64_t waitStart, bool contended, const char *file, int line )
+{
+	m_holdStart = Now();
+	m_holderFile = file;
+	m_holderLine = line;
+
+	Add( m_acquisitions, 1 );
+	if ( contended )
+	{
+		uint64_t wait = m_holdStart - waitStart;
+		Add( m_contended, 1 );
+		Add( m_totalWait, wait );
+		Max( m_maxWait, wait );
+	}
+}
+
+void
+vsLockStats::Releasing()
+{
+	uint64_t hold = Now() - m_holdStart;
+	Add( m_totalHold, hold );
+	if ( hold > m_maxHold.load( std::memory_order_relaxed ) )
+	{
+		m_maxHold.store( hold, std::memory_order_relaxed );
+		m_maxHoldFile = m_holderFile;
+		m_maxHoldLine = m_holderLine;
+	}
+}
+
+void
+vsLockStats::Waited( uint64_t waitStart, bool contended )
+{
+	AtomicAdd( m_acquisitions, 1 );
+	if ( contended )
+	{
+		uint64_t wait = Now() - waitStart;
+		AtomicAdd( m_contended, 1 );
+		AtomicAdd( m_totalWait, wait );
+		AtomicMax( m_maxWait, wait );
+	}
+}
+
+void
+vsLockStats::Reset()
+{
+	m_acquisitions = 0;
+	m_contended = 0;
+	m_totalWait = 0;
+	m_maxWait = 0;
+	m_totalHold = 0;
+	m_maxHold = 0;
+	m_maxHoldFile = NULL;
+	m_maxHoldLine = 0;
+}
+
+void
+vsLockStats::ResetAll()
+{
+	SDL_AtomicLock( &s_registryLock );
+	for ( vsLockStats *s = s_first; s; s = s->m_next )
+		s->Reset();
+	SDL_AtomicUnlock( &s_registryLock );
+}
+
+void
+vsLockStats::GetSnapshot( Snapshot *snapshot ) const
+{
+	snapshot->name = m_name;
+	snapshot->type = m_type;
+	snapshot->acquisitions = m_acquisitions.load();
+	snapshot->contended = m_contended.load();
+	snapshot->totalWait = m_totalWait.load();
+	snapshot->maxWait = m_maxWait.load();
+	snapshot->totalHold = m_totalHold.load();
+	snapshot->maxHold = m_maxHold.load();
+	snapshot->holderFile = m_holderFile;
+	snapshot->holderLine = m_holderLine;
+	snapshot->maxHoldFile = m_maxHoldFile;
+	snapshot->maxHoldLine = m_maxHoldLine;
+}
+
+size_t
+vsLockStats::GetLockCount()
+{
+	size_t count = 0;
+	SDL_AtomicLock( &s_registryLock );
+	for ( vsLockStats *s = s_first; s; s = s->m_next )
+		count++;
+	SDL_AtomicUnlock( &s_registryLock );
+	return count;
+}
+
+size_t
+vsLockStats::GetSnapshots( Snapshot *buffer, size_t capacity )
+{
+	// Note that we mustn't allocate while holding the registry lock;  the
+	// allocator is itself protected by a vsSpinlock.  So our caller provides
+	// the buffer.
+	size_t count = 0;
+	SDL_AtomicLock( &s_registryLock );
+	for ( vsLockStats *s = s_first; s && count < capacity; s = s->m_next )
+		s->GetSnapshot( &buffer[count++] );
+	SDL_AtomicUnlock( &s_registryLock );
+	return count;
+}
+
+static bool SortByWait( const vsLockStats::Snapshot& a, const vsLockStats::Snapshot& b )
+{
+	return a.totalWait > b.totalWait;
+}
+
+static void TakeSnapshots( std::vector<vsLockStats::Snapshot> *result )
+{
+	// leave a little slack, in case some locks are created while we're busy.
+	result->resize( vsLockStats::GetLockCount() + 16 );
+	result->resize( vsLockStats::GetSnapshots( &(*result)[0], result->size() ) );
+	std::sort( result->begin(), result->end(), SortByWait );
+}
+
+static float ToMilliseconds( uint64_t ticks )
+{
+	return (float)(ticks * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+static vsString CallSite( const char *file, int line )
+{
+	if ( !file )
+		return "-";
+	const char *slash = strrchr( file, '/' );
+	return vsFormatString( "%s:%d", slash ? slash+1 : file, line );
+}
+
+void
+vsLockStats::Report()
+{
+	std::vector<vsLockStats::Snapshot> snapshots;
+	TakeSnapshots( &snapshots );
+
+	vsLog("== Lock contention report (%d locks) ==", (int)snapshots.size());
+	for ( size_t i = 0; i < snapshots.size(); i++ )
+	{
+		const Snapshot& s = snapshots[i];
+		if ( s.acquisitions == 0 )
+			continue;
+		float contendedPercent = 100.f * s.contended / s.acquisitions;
+		vsLog("%s '%s': %d acquired, %d contended (%0.1f%%), wait %0.3fms (max %0.3fms), hold %0.3fms (max %0.3fms at %s), last held at %s",
+				TypeName(s.type), s.name,
+				s.acquisitions, s.contended, contendedPercent,
+				ToMilliseconds(s.totalWait), ToMilliseconds(s.maxWait),
+				ToMilliseconds(s.totalHold), ToMilliseconds(s.maxHold),
+				CallSite(s.maxHoldFile, s.maxHoldLine),
+				CallSite(s.holderFile, s.holderLine) );
+	}
+}
+
+void
+vsLockStats::Dump( const vsString &filename )
+{
+	std::vector<vsLockStats::Snapshot> snapshots;
+	TakeSnapshots( &snapshots );
+
+	vsFile file( filename, vsFile::MODE_WriteDirectly );
+	vsString header("name,type,acquisitions,contended,total_wait_ms,max_wait_ms,total_hold_ms,max_hold_ms,max_hold_site,last_holder_site\n");
+	file.WriteBytes( header.c_str(), header.size() );
+	for ( size_t i = 0; i < snapshots.size(); i++ )
+	{
+		const Snapshot& s = snapshots[i];
+		vsString line = vsFormatString("\"%s\",%s,%d,%d,%f,%f,%f,%f,%s,%s\n",
+				s.name, TypeName(s.type),
+				s.acquisitions, s.contended,
+				ToMilliseconds(s.totalWait), ToMilliseconds(s.maxWait),
+				ToMilliseconds(s.totalHold), ToMilliseconds(s.maxHold),
+				CallSite(s.maxHoldFile, s.maxHoldLine),
+				CallSite(s.holderFile, s.holderLine) );
+		file.WriteBytes( line.c_str(), line.size() );
+	}
+}
+
+#endif // VS_LOCK_PROFILING
+
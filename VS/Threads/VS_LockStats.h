@@ -0,0 +1,131 @@
+//
+//  VS_LockStats.h
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#ifndef VS_LOCKSTATS_H
+#define VS_LOCKSTATS_H
+
+// Lock contention profiling.
+//
+// When VS_LOCK_PROFILING is enabled (via cmake), every vsMutex, vsSpinlock and
+// vsSemaphore carries a vsLockStats record, which counts how often the lock
+// was taken, how often a thread had to wait for it, how long those waits
+// were, and how long the lock was held for.  Lock() calls also record the
+// file and line they were called from, so we can see who is holding a lock,
+// and who held it for the longest time.
+//
+// When VS_LOCK_PROFILING is disabled, none of this exists and the locks
+// behave exactly as they always have.
+//
+// Call vsLockStats::Report() to write a summary to the log, or
+// vsLockStats::Dump() to write a CSV file which can be pulled into a
+// spreadsheet or compared between performance test runs.
+
+#include "VS_DisableDebugNew.h"
+#include <atomic>
+#include "VS_EnableDebugNew.h"
+
+#ifdef VS_LOCK_PROFILING
+
+// Lock() and Wait() pick up their caller's file and line through these
+// default arguments, so that calling code doesn't need to change.
+#define VS_LOCK_CALLSITE_DECL const char *callFile = __builtin_FILE(), int callLine = __builtin_LINE()
+#define VS_LOCK_CALLSITE_DEF const char *callFile, int callLine
+
+class vsLockStats
+{
+public:
+	enum Type
+	{
+		Type_Mutex,
+		Type_Spinlock,
+		Type_Semaphore
+	};
+
+private:
+	const char *m_name;
+	Type m_type;
+
+	// Counters are written while the lock itself is held (or, for
+	// semaphores, with relaxed atomic adds), so they're never contended;
+	// they're atomic only so that Report() can read them safely from another
+	// thread.
+	std::atomic<uint64_t> m_acquisitions;
+	std::atomic<uint64_t> m_contended;
+	std::atomic<uint64_t> m_totalWait;
+	std::atomic<uint64_t> m_maxWait;
+	std::atomic<uint64_t> m_totalHold;
+	std::atomic<uint64_t> m_maxHold;
+
+	uint64_t m_holdStart;
+	const char *m_holderFile;
+	int m_holderLine;
+	const char *m_maxHoldFile;
+	int m_maxHoldLine;
+
+	// intrusive list of all live lock stats.  We can't allocate anything
+	// here;  vsHeap itself is protected by a vsSpinlock!
+	vsLockStats *m_prev;
+	vsLockStats *m_next;
+
+	static vsLockStats *s_first;
+
+	static void Add( std::atomic<uint64_t>& counter, uint64_t value ) { counter.store( counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed ); }
+	static void Max( std::atomic<uint64_t>& counter, uint64_t value ) { if ( value > counter.load(std::memory_order_relaxed) ) counter.store( value, std::memory_order_relaxed ); }
+
+public:
+
+	struct Snapshot
+	{
+		const char *name;
+		Type type;
+		uint64_t acquisitions;
+		uint64_t contended;
+		uint64_t totalWait;	// wait and hold times are in SDL performance counter ticks
+		uint64_t maxWait;
+		uint64_t totalHold;
+		uint64_t maxHold;
+		const char *holderFile;
+		int holderLine;
+		const char *maxHoldFile;
+		int maxHoldLine;
+	};
+
+	vsLockStats( const char *name, Type type );
+	~vsLockStats();
+
+	static uint64_t Now();
+
+	// For mutexes and spinlocks;  call with the lock held.
+	void Acquired( uint64_t waitStart, bool contended, const char *file, int line );
+	void Releasing();
+
+	// For semaphores;  may be called from many threads at once.
+	void Waited( uint64_t waitStart, bool contended );
+
+	void Reset();
+	void GetSnapshot( Snapshot *snapshot ) const;
+
+	// Fills 'buffer' with up to 'capacity' snapshots of live locks, and
+	// returns how many were written.
+	static size_t GetLockCount();
+	static size_t GetSnapshots( Snapshot *buffer, size_t capacity );
+
+	static void ResetAll();
+	static void Report();
+	static void Dump( const vsString &filename );
+};
+
+#else
+
+#define VS_LOCK_CALLSITE_DECL
+#define VS_LOCK_CALLSITE_DEF
+
+#endif // VS_LOCK_PROFILING
+
+#endif // VS_LOCKSTATS_H
+
@@ -8,7 +8,10 @@
 
 #include "VS_Mutex.h"
 
-vsMutex::vsMutex()
+vsMutex::vsMutex( const char *name )
+#ifdef VS_LOCK_PROFILING
+	: m_stats( name, vsLockStats::Type_Mutex )
+#endif
 {
 	m_mutex = SDL_CreateMutex();
 
@@ -20,20 +23,40 @@ vsMutex::~vsMutex()
 }
 
 void
-vsMutex::Lock()
+vsMutex::Lock( VS_LOCK_CALLSITE_DEF )
 {
+#ifdef VS_LOCK_PROFILING
+	// only pay for a timestamp up front if we're actually going to wait.
+	if ( SDL_TryLockMutex(m_mutex) == 0 )
+	{
+		m_stats.Acquired( 0, false, callFile, callLine );
+		return;
+	}
+	uint64_t waitStart = vsLockStats::Now();
 	SDL_LockMutex(m_mutex);
+	m_stats.Acquired( waitStart, true, callFile, callLine );
+#else
+	SDL_LockMutex(m_mutex);
+#endif
 }
 
 void
 vsMutex::Unlock()
 {
+#ifdef VS_LOCK_PROFILING
+	m_stats.Releasing();
+#endif
 	SDL_UnlockMutex(m_mutex);
 }
 
 bool
-vsMutex::TryLock()
+vsMutex::TryLock( VS_LOCK_CALLSITE_DEF )
 {
-	return SDL_TRUE == SDL_TryLockMutex(m_mutex);
+	bool locked = ( 0 == SDL_TryLockMutex(m_mutex) );
+#ifdef VS_LOCK_PROFILING
+	if ( locked )
+		m_stats.Acquired( 0, false, callFile, callLine );
+#endif
+	return locked;
 }
 
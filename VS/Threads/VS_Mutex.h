@@ -13,18 +13,24 @@
 // we're a video game!  Let's use spinlocks instead.
 
 #include "SDL2/SDL.h"
+#include "VS_LockStats.h"
 typedef SDL_mutex* mutex_t;
 
 class vsMutex
 {
     mutex_t   m_mutex;
+#ifdef VS_LOCK_PROFILING
+	vsLockStats m_stats;
+#endif
 
 public:
-    vsMutex();
+	// 'name' is only used for lock profiling, and must be a string literal
+	// (or otherwise outlive the mutex).
+    vsMutex( const char *name = NULL );
     ~vsMutex();
 
-	bool TryLock();
-    void Lock();
+	bool TryLock( VS_LOCK_CALLSITE_DECL );
+    void Lock( VS_LOCK_CALLSITE_DECL );
     void Unlock();
 };
 
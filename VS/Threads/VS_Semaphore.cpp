@@ -8,101 +8,99 @@
 
 #include "VS_Semaphore.h"
 
-#ifdef UNIX
-// unix version of semaphore
-vsSemaphore::vsSemaphore(unsigned int initialValue)
+// The top bit of m_value is our 'released' flag;  the rest is the count.
+// Keeping them in the same word means that Release() always changes the
+// value a sleeping waiter is parked on, so nobody can miss the shutdown.
+#define SEMAPHORE_RELEASED (0x80000000u)
+#define SEMAPHORE_COUNT_MASK (0x7fffffffu)
+
+vsSemaphore::vsSemaphore(unsigned int initialValue, const char *name):
+	m_value( initialValue & SEMAPHORE_COUNT_MASK ),
+	m_waiters( 0 )
+#ifdef VS_LOCK_PROFILING
+	, m_stats( name, vsLockStats::Type_Semaphore )
+#endif
 {
-	pthread_mutex_init( &m_semaphore.mutex, NULL );
-	pthread_mutex_lock( &m_semaphore.mutex );
-    pthread_cond_init( &m_semaphore.cond, NULL );
-	m_value = initialValue;
-	m_released = false;
-	pthread_mutex_unlock( &m_semaphore.mutex );
 }
 
 vsSemaphore::~vsSemaphore()
 {
-	vsAssert(m_released, "Semaphore destroyed without being released?");
-	pthread_mutex_lock(&m_semaphore.mutex);
-	pthread_cond_destroy( &m_semaphore.cond );
-	pthread_mutex_unlock(&m_semaphore.mutex);
-	pthread_mutex_destroy( &m_semaphore.mutex );
+	vsAssert(IsReleased(), "Semaphore destroyed without being released?");
 }
 
 bool
-vsSemaphore::Wait()
-{
-	if ( m_released )
-		return false;
-
-	pthread_mutex_lock(&m_semaphore.mutex);
-	while ( m_value == 0 && !m_released )
-	{
-		pthread_cond_wait( &m_semaphore.cond, &m_semaphore.mutex );
-	}
-	if ( !m_released )
-	{
-		m_value--;
-	}
-
-	pthread_mutex_unlock(&m_semaphore.mutex);
-
-	return !m_released;
-}
-
-void
-vsSemaphore::Post()
-{
-	pthread_mutex_lock(&m_semaphore.mutex);
-	m_value++;
-	pthread_cond_signal( &m_semaphore.cond );
-	pthread_mutex_unlock(&m_semaphore.mutex);
-}
-
-void
-vsSemaphore::Release()
+vsSemaphore::TryWait()
 {
-	if ( !m_released )
+	uint32_t value = m_value.load( std::memory_order_relaxed );
+	while ( value != 0 && !(value & SEMAPHORE_RELEASED) )
 	{
-		m_released = true;
-		pthread_cond_broadcast(&m_semaphore.cond);
+		if ( m_value.compare_exchange_weak( value, value-1, std::memory_order_acquire, std::memory_order_relaxed ) )
+		{
+#ifdef VS_LOCK_PROFILING
+			m_stats.Waited( 0, false );
+#endif
+			return true;
+		}
 	}
-}
-
-#else
-
-vsSemaphore::vsSemaphore(unsigned int initialValue)
-{
-	m_semaphore = CreateSemaphore( NULL, initialValue, 100000, NULL );
-	m_released = false;
-}
-
-vsSemaphore::~vsSemaphore()
-{
-	CloseHandle( m_semaphore );
+	return false;
 }
 
 bool
 vsSemaphore::Wait()
 {
-	if ( m_released )
-		return false;
-	WaitForSingleObject( m_semaphore, INFINITE );
-	return !m_released;
+#ifdef VS_LOCK_PROFILING
+	uint64_t waitStart = 0;
+#endif
+	while ( true )
+	{
+		uint32_t value = m_value.load( std::memory_order_relaxed );
+		if ( value & SEMAPHORE_RELEASED )
+			return false;
+
+		if ( value != 0 )
+		{
+			if ( m_value.compare_exchange_weak( value, value-1, std::memory_order_acquire, std::memory_order_relaxed ) )
+			{
+#ifdef VS_LOCK_PROFILING
+				m_stats.Waited( waitStart, waitStart != 0 );
+#endif
+				return true;
+			}
+			continue;
+		}
+
+#ifdef VS_LOCK_PROFILING
+		if ( waitStart == 0 )
+			waitStart = vsLockStats::Now();
+#endif
+		if ( vsFutexSpin( &m_value, 0 ) )
+			continue;
+
+		m_waiters.fetch_add(1);
+		vsFutex::Wait( &m_value, 0 );
+		m_waiters.fetch_sub(1);
+	}
 }
 
 void
 vsSemaphore::Post()
 {
-	ReleaseSemaphore( m_semaphore, 1, NULL );
+	m_value.fetch_add(1);
+	if ( m_waiters.load() != 0 )
+		vsFutex::WakeOne( &m_value );
 }
 
 void
 vsSemaphore::Release()
 {
-	m_released = true;
-	ReleaseSemaphore( m_semaphore, 1000, NULL );
+	uint32_t value = m_value.fetch_or( SEMAPHORE_RELEASED );
+	if ( !(value & SEMAPHORE_RELEASED) )
+		vsFutex::WakeAll( &m_value );
 }
 
+bool
+vsSemaphore::IsReleased() const
+{
+	return (m_value.load() & SEMAPHORE_RELEASED) != 0;
+}
 
-#endif
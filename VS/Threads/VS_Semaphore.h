@@ -9,29 +9,26 @@
 #ifndef VS_SEMAPHORE_H
 #define VS_SEMAPHORE_H
 
-#ifdef UNIX
-#include "VS_Mutex.h"
-#include <pthread.h>
-struct semaphore_t
-{
-	pthread_mutex_t	mutex;
-	pthread_cond_t	cond;
-};
-#else
-#include <windows.h>
-typedef HANDLE semaphore_t;
-#undef PlaySound  // yay, Windows.
+#include "VS_Futex.h"
+#include "VS_LockStats.h"
 
-#endif
+// vsSemaphore keeps its count and its 'released' flag together in a single
+// futex word, so that Post() and an uncontended Wait() are just atomic
+// operations;  we only enter the kernel when a thread actually needs to sleep,
+// or when there's a sleeping thread which needs to be woken.
 
 class vsSemaphore
 {
-	semaphore_t		m_semaphore;
-	int				m_value;
-	bool			m_released;
+	vsFutexWord		m_value;
+	vsFutexWord		m_waiters;
+#ifdef VS_LOCK_PROFILING
+	vsLockStats		m_stats;
+#endif
 public:
 
-	vsSemaphore(unsigned int initialValue);
+	// 'name' is only used for lock profiling, and must be a string literal
+	// (or otherwise outlive the semaphore).
+	vsSemaphore(unsigned int initialValue, const char *name = NULL);
 	~vsSemaphore();
 
 	// Wait until the semaphore's value is greater than zero,  until the
@@ -41,6 +38,10 @@ public:
 	// system shutdown.
 	bool Wait();
 
+	// As Wait(), but never blocks.  Returns 'true' if we successfully
+	// decremented the semaphore's value.
+	bool TryWait();
+
 	// increment value of semaphore by one.
 	void Post();
 
@@ -51,6 +52,8 @@ public:
 	// semaphore object now or in the future (even if the semaphore's value is
 	// greater than 0).
 	void Release();
+
+	bool IsReleased() const;
 };
 
 
@@ -8,7 +8,10 @@
 
 #include "VS_Spinlock.h"
 
-vsSpinlock::vsSpinlock()
+vsSpinlock::vsSpinlock( const char *name )
+#ifdef VS_LOCK_PROFILING
+	: m_stats( name, vsLockStats::Type_Spinlock )
+#endif
 {
 	m_lock = 0;
 
@@ -19,21 +22,40 @@ vsSpinlock::~vsSpinlock()
 }
 
 void
-vsSpinlock::Lock()
+vsSpinlock::Lock( VS_LOCK_CALLSITE_DEF )
 {
+#ifdef VS_LOCK_PROFILING
+	if ( SDL_TRUE == SDL_AtomicTryLock(&m_lock) )
+	{
+		m_stats.Acquired( 0, false, callFile, callLine );
+		return;
+	}
+	uint64_t waitStart = vsLockStats::Now();
 	SDL_AtomicLock(&m_lock);
+	m_stats.Acquired( waitStart, true, callFile, callLine );
+#else
+	SDL_AtomicLock(&m_lock);
+#endif
 }
 
 void
 vsSpinlock::Unlock()
 {
+#ifdef VS_LOCK_PROFILING
+	m_stats.Releasing();
+#endif
 	SDL_AtomicUnlock(&m_lock);
 }
 
 
 bool
-vsSpinlock::TryLock()
+vsSpinlock::TryLock( VS_LOCK_CALLSITE_DEF )
 {
-	return SDL_TRUE == SDL_AtomicTryLock(&m_lock);
+	bool locked = ( SDL_TRUE == SDL_AtomicTryLock(&m_lock) );
+#ifdef VS_LOCK_PROFILING
+	if ( locked )
+		m_stats.Acquired( 0, false, callFile, callLine );
+#endif
+	return locked;
 }
 
@@ -13,19 +13,25 @@
 // we're a video game!  Let's use spinlocks instead.
 
 #include "SDL2/SDL.h"
+#include "VS_LockStats.h"
 typedef SDL_SpinLock spinlock_t;
 
 class vsSpinlock
 {
     spinlock_t   m_lock;
+#ifdef VS_LOCK_PROFILING
+	vsLockStats m_stats;
+#endif
 
 public:
-    vsSpinlock();
+	// 'name' is only used for lock profiling, and must be a string literal
+	// (or otherwise outlive the spinlock).
+    vsSpinlock( const char *name = NULL );
     ~vsSpinlock();
 
-    void Lock();
+    void Lock( VS_LOCK_CALLSITE_DECL );
     void Unlock();
-    bool TryLock();
+    bool TryLock( VS_LOCK_CALLSITE_DECL );
 };
 
 #endif // VS_SPINLOCK_H
@@ -8,6 +8,10 @@
 
 #include "VS_Task.h"
 
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
 #ifdef UNIX
 void *vsTask::DoStartThread(void* arg)
 #else
@@ -22,22 +26,25 @@ DWORD WINAPI vsTask::DoStartThread( LPVOID arg )
 #endif
 	vsTask *task = (vsTask*)arg;
 
-#if defined(_DEBUG)
-	if ( task->m_name.size() > 16 )
-		task->m_name.resize(16);
+	if ( !task->m_name.empty() )
+	{
+		// pthreads limits names to 16 bytes, including the terminator.
+		if ( task->m_name.size() > 15 )
+			task->m_name.resize(15);
 
 #if defined(__APPLE_CC__)
-	pthread_setname_np( task->m_name.c_str() );
+		pthread_setname_np( task->m_name.c_str() );
 #elif defined(UNIX)
-	pthread_setname_np( pthread_self(), task->m_name.c_str() );
-#endif
-
+		pthread_setname_np( pthread_self(), task->m_name.c_str() );
 #endif
+	}
 
 	task->m_done = false;
 	result = task->Run();
+	// Our owner may delete us as soon as it sees this, so this must be the
+	// last time we touch 'task'.  Owners which need to know that the thread
+	// itself has finished should Join() it.
 	task->m_done = true;
-	task->m_thread = 0L;
 
 #ifdef UNIX
 	return (void*)result;
@@ -48,19 +55,19 @@ DWORD WINAPI vsTask::DoStartThread( LPVOID arg )
 
 vsTask::vsTask( const vsString& name ):
 	m_thread(0),
-#ifdef _DEBUG
 	m_name(name),
-#endif // _DEBUG
+	m_stackSize(0),
 	m_done(false)
 {
 }
 
 vsTask::~vsTask()
 {
-	if ( !m_done && m_thread != 0 )
+	if ( m_thread != 0 )
 	{
 #ifdef UNIX
 		//		pthread_kill( m_thread, SIGKILL );
+		pthread_detach( m_thread );
 #else
 		CloseHandle(m_thread);
 #endif
@@ -68,21 +75,71 @@ vsTask::~vsTask()
 	}
 }
 
+void
+vsTask::Join()
+{
+	if ( m_thread == 0 )
+		return;
+#ifdef UNIX
+	pthread_join( m_thread, NULL );
+#else
+	WaitForSingleObject( m_thread, INFINITE );
+	CloseHandle( m_thread );
+#endif
+	m_thread = 0;
+}
+
 void
 vsTask::Start()
 {
 #ifdef UNIX
-	pthread_create( &m_thread, NULL, &vsTask::DoStartThread, (void*)this );
+	pthread_attr_t attr;
+	pthread_attr_init( &attr );
+	if ( m_stackSize )
+	{
+		int err = pthread_attr_setstacksize( &attr, m_stackSize );
+		if ( err )
+			vsLog("Task '%s': couldn't set stack size to %d bytes (error %d)", m_name.c_str(), (int)m_stackSize, err);
+	}
+#if defined(__linux__)
+	if ( !m_affinity.IsEmpty() )
+	{
+		cpu_set_t cpus;
+		CPU_ZERO( &cpus );
+		for ( int i = 0; i < VS_MAX_CPUS && i < CPU_SETSIZE; i++ )
+		{
+			if ( m_affinity.Contains(i) )
+				CPU_SET( i, &cpus );
+		}
+		pthread_attr_setaffinity_np( &attr, sizeof(cpus), &cpus );
+	}
+#endif
+	int err = pthread_create( &m_thread, &attr, &vsTask::DoStartThread, (void*)this );
+	if ( err )
+		vsErrorLog("Failed to start task '%s': error %d", m_name.c_str(), err);
+	pthread_attr_destroy( &attr );
 
 #else
 	m_thread = CreateThread(
 			NULL,                   // default security attributes
-			0,                      // use default stack size
+			m_stackSize,            // stack size;  0 for the default
 			&vsTask::DoStartThread, // thread function name
 			(void*)this,			// argument to thread function
-			0,                      // use default creation flags
+			CREATE_SUSPENDED,       // so we can set affinity before it runs
 			NULL);					// returns the thread identifier
 
+	if ( !m_affinity.IsEmpty() )
+	{
+		DWORD_PTR mask = 0;
+		for ( int i = 0; i < 64; i++ )
+		{
+			if ( m_affinity.Contains(i) )
+				mask |= ((DWORD_PTR)1) << i;
+		}
+		if ( mask )
+			SetThreadAffinityMask( m_thread, mask );
+	}
+	ResumeThread( m_thread );
 
 #endif
 }
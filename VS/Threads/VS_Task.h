@@ -9,6 +9,8 @@
 #ifndef VS_TASK_H
 #define VS_TASK_H
 
+#include "VS_CpuTopology.h"
+
 #ifdef UNIX
 #include <pthread.h>
 typedef pthread_t thread_t;
@@ -22,9 +24,9 @@ typedef HANDLE thread_t;
 class vsTask
 {
 	thread_t m_thread;
-#ifdef _DEBUG
 	vsString m_name;
-#endif // DEBUG
+	size_t m_stackSize;
+	vsCpuSet m_affinity;
 	bool m_done;
 
 #ifdef UNIX
@@ -40,14 +42,24 @@ protected:
 
 public:
 
-	// name is optional, and will be truncated to 16 characters.  In release
-	// builds, it will be fully ignored.
+	// name is optional, and will be truncated to 16 characters.  Threads are
+	// named in all builds, so they show up in profilers and crash dumps.
 	vsTask( const vsString& name = vsEmptyString );
 	virtual ~vsTask();
 
+	// Call these before Start().  A stack size of 0 means the platform
+	// default.  An empty affinity set means the thread may run anywhere.
+	// (macOS doesn't support affinity, so it's ignored there)
+	void SetStackSize( size_t bytes ) { m_stackSize = bytes; }
+	void SetAffinity( const vsCpuSet& cpus ) { m_affinity = cpus; }
+
 	void Start();
 	bool IsDone() { return m_done; }
 
+	// Blocks until our thread has exited, and releases it.  Call this before
+	// deleting a task whose Run() has been asked to return.
+	void Join();
+
 };
 
 #endif // VS_TASK_H
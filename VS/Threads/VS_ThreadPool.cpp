@@ -0,0 +1,343 @@
+//
+//  VS_ThreadPool.cpp
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#include "VS_ThreadPool.h"
+
+#include "VS_Event.h"
+#include "VS_Semaphore.h"
+#include "VS_Spinlock.h"
+#include "VS_Task.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// vsJob::m_state
+#define JOB_IDLE (0)
+#define JOB_PENDING (1)
+#define JOB_PENDING_WITH_WAITERS (2)
+
+vsJob::vsJob():
+	m_state( JOB_IDLE ),
+	m_next( NULL )
+{
+}
+
+vsJob::~vsJob()
+{
+	vsAssert( IsDone(), "Job destroyed while still queued or running!" );
+}
+
+bool
+vsJob::IsDone() const
+{
+	return m_state.load( std::memory_order_acquire ) == JOB_IDLE;
+}
+
+void
+vsJob::Wait()
+{
+	while ( true )
+	{
+		uint32_t state = m_state.load( std::memory_order_acquire );
+		if ( state == JOB_IDLE )
+			return;
+
+		if ( state == JOB_PENDING )
+		{
+			if ( vsFutexSpin( &m_state, state ) )
+				continue;
+			if ( !m_state.compare_exchange_strong( state, JOB_PENDING_WITH_WAITERS ) )
+				continue;
+		}
+		vsFutex::Wait( &m_state, JOB_PENDING_WITH_WAITERS );
+	}
+}
+
+void
+vsJob::Finished()
+{
+	// Once m_state is idle, a waiter may destroy this job immediately;  the
+	// wake only uses our address, it never touches our memory.
+	if ( m_state.exchange( JOB_IDLE, std::memory_order_release ) == JOB_PENDING_WITH_WAITERS )
+		vsFutex::WakeAll( &m_state );
+}
+
+struct vsThreadPool::Domain
+{
+	vsSpinlock		lock;
+	vsJob *			head;
+	vsJob *			tail;
+
+	vsSemaphore		wake;
+	vsFutexWord		idle;		// how many of this domain's workers are asleep
+	int				workerCount;
+
+	Domain():
+		lock("thread pool queue"),
+		head(NULL),
+		tail(NULL),
+		wake(0, "thread pool wake"),
+		idle(0),
+		workerCount(0)
+	{
+	}
+
+	~Domain()
+	{
+		vsAssert( head == NULL, "Thread pool shut down with jobs still queued!" );
+		if ( !wake.IsReleased() )
+			wake.Release();
+	}
+
+	void Push( vsJob *job )
+	{
+		lock.Lock();
+		job->m_next = NULL;
+		if ( tail )
+			tail->m_next = job;
+		else
+			head = job;
+		tail = job;
+		lock.Unlock();
+	}
+
+	vsJob * Pop()
+	{
+		vsJob *job = NULL;
+		lock.Lock();
+		if ( head )
+		{
+			job = head;
+			head = job->m_next;
+			if ( !head )
+				tail = NULL;
+			job->m_next = NULL;
+		}
+		lock.Unlock();
+		return job;
+	}
+};
+
+class vsThreadPoolWorker : public vsTask
+{
+	vsThreadPool *	m_pool;
+	int				m_domain;
+
+protected:
+	virtual int Run();
+
+public:
+	vsThreadPoolWorker( vsThreadPool *pool, int domain, int index ):
+		vsTask( vsFormatString("vsWorker %d", index) ),
+		m_pool(pool),
+		m_domain(domain)
+	{
+	}
+};
+
+static thread_local bool s_isWorkerThread = false;
+
+int
+vsThreadPoolWorker::Run()
+{
+	s_isWorkerThread = true;
+	vsThreadPool::Domain& domain = m_pool->m_domain[m_domain];
+	while ( true )
+	{
+		// run everything we can find before going back to sleep.
+		while ( vsJob *job = m_pool->Take( m_domain ) )
+		{
+			job->Execute();
+			job->Finished();
+		}
+
+		domain.idle.fetch_add(1);
+		bool awake = domain.wake.Wait();
+		domain.idle.fetch_sub(1);
+		if ( !awake )
+			break;
+	}
+	return 0;
+}
+
+vsThreadPool *vsThreadPool::s_instance = NULL;
+vsThreadPool::Settings vsThreadPool::s_settings;
+
+vsThreadPool *
+vsThreadPool::Instance()
+{
+	if ( !s_instance )
+		s_instance = new vsThreadPool( s_settings );
+	return s_instance;
+}
+
+void
+vsThreadPool::Shutdown()
+{
+	vsDelete( s_instance );
+}
+
+vsThreadPool::vsThreadPool( const Settings& settings ):
+	m_domain(NULL),
+	m_domainCount(0),
+	m_anyQueue(new Domain),
+	m_mainDomain(0),
+	m_worker(NULL),
+	m_workerCount(0),
+	m_nextWake(0)
+{
+	const vsCpuTopology& topology = vsCpuTopology::Instance();
+
+	int mainCpu = vsCpuTopology::GetCurrentCpu();
+	int mainCore = topology.GetCoreForCpu( mainCpu );
+	m_mainDomain = vsMax( 0, topology.GetL3ForCpu( mainCpu ) );
+	m_domainCount = topology.GetL3DomainCount();
+	m_domain = new Domain[m_domainCount];
+
+#if defined(__linux__)
+	if ( settings.pinMainThread && mainCore >= 0 )
+	{
+		const vsCpuSet& cpus = topology.GetCoreCpus( mainCore );
+		cpu_set_t set;
+		CPU_ZERO( &set );
+		for ( int i = 0; i < VS_MAX_CPUS && i < CPU_SETSIZE; i++ )
+			if ( cpus.Contains(i) )
+				CPU_SET( i, &set );
+		pthread_setaffinity_np( pthread_self(), sizeof(set), &set );
+	}
+#endif
+
+	// Hand out physical cores to workers;  the main thread's L3 domain
+	// first (so that it gets workers even if we've been asked for only a
+	// few), then the others.  The main thread's own core is left until last.
+	vsArray<int> cores;
+	for ( int pass = 0; pass < 3; pass++ )
+	{
+		for ( int core = 0; core < topology.GetPhysicalCoreCount(); core++ )
+		{
+			int firstCpu = topology.GetCoreCpus(core).First();
+			bool inMainDomain = ( topology.GetL3ForCpu(firstCpu) == m_mainDomain );
+			bool isMainCore = ( core == mainCore );
+			int wantedPass = isMainCore ? 2 : ( inMainDomain ? 0 : 1 );
+			if ( pass == wantedPass )
+				cores.AddItem( core );
+		}
+	}
+
+	m_workerCount = settings.workerCount;
+	if ( m_workerCount <= 0 )
+		m_workerCount = vsMax( 1, topology.GetPhysicalCoreCount() - 1 );
+
+	m_worker = new vsThreadPoolWorker*[m_workerCount];
+	for ( int i = 0; i < m_workerCount; i++ )
+	{
+		int core = cores[ i % cores.ItemCount() ];
+		const vsCpuSet& coreCpus = topology.GetCoreCpus(core);
+		int domain = vsMax( 0, topology.GetL3ForCpu( coreCpus.First() ) );
+
+		m_worker[i] = new vsThreadPoolWorker( this, domain, i );
+		m_worker[i]->SetStackSize( settings.stackSize );
+		if ( settings.pinning == Pinning_Core )
+			m_worker[i]->SetAffinity( coreCpus );
+		else if ( settings.pinning == Pinning_L3 )
+			m_worker[i]->SetAffinity( topology.GetL3Cpus(domain) );
+		m_domain[domain].workerCount++;
+	}
+	for ( int i = 0; i < m_workerCount; i++ )
+	{
+		m_worker[i]->Start();
+	}
+
+	vsLog("Thread pool: %d workers, %d sharing the main thread's L3 cache", m_workerCount, GetWorkerCount( Affinity_MainThreadL3 ));
+}
+
+vsThreadPool::~vsThreadPool()
+{
+	for ( int i = 0; i < m_domainCount; i++ )
+	{
+		m_domain[i].wake.Release();
+	}
+	for ( int i = 0; i < m_workerCount; i++ )
+	{
+		// join before deleting;  the worker's thread still touches it
+		// after Run() returns.
+		m_worker[i]->Join();
+		vsDelete( m_worker[i] );
+	}
+	vsDeleteArray( m_worker );
+	vsDeleteArray( m_domain );
+	vsDelete( m_anyQueue );
+}
+
+int
+vsThreadPool::GetWorkerCount( Affinity affinity ) const
+{
+	if ( affinity == Affinity_MainThreadL3 && m_domain[m_mainDomain].workerCount > 0 )
+		return m_domain[m_mainDomain].workerCount;
+	return m_workerCount;
+}
+
+bool
+vsThreadPool::IsWorkerThread()
+{
+	return s_isWorkerThread;
+}
+
+void
+vsThreadPool::Submit( vsJob *job, Affinity affinity )
+{
+	vsAssert( job->IsDone(), "Submitted a job which is already queued or running!" );
+	job->m_state.store( JOB_PENDING, std::memory_order_relaxed );
+
+	if ( affinity == Affinity_MainThreadL3 && m_domain[m_mainDomain].workerCount > 0 )
+	{
+		m_domain[m_mainDomain].Push( job );
+		Wake( m_mainDomain );
+	}
+	else
+	{
+		m_anyQueue->Push( job );
+
+		// prefer waking a domain which has a sleeping worker.
+		// (unsigned, so that this is still well-defined once it wraps)
+		uint32_t start = m_nextWake.fetch_add(1);
+		int target = -1;
+		for ( int i = 0; i < m_domainCount; i++ )
+		{
+			int domain = (int)((start + i) % (uint32_t)m_domainCount);
+			if ( m_domain[domain].workerCount > 0 && target == -1 )
+				target = domain;
+			if ( m_domain[domain].workerCount > 0 && m_domain[domain].idle.load() > 0 )
+			{
+				target = domain;
+				break;
+			}
+		}
+		Wake( target );
+	}
+}
+
+void
+vsThreadPool::Wake( int domain )
+{
+	m_domain[domain].wake.Post();
+}
+
+vsJob *
+vsThreadPool::Take( int domain )
+{
+	// jobs which can only run in our domain come first, since nobody else
+	// can take them.
+	vsJob *job = m_domain[domain].Pop();
+	if ( !job )
+		job = m_anyQueue->Pop();
+	return job;
+}
+
@@ -0,0 +1,135 @@
+//
+//  VS_ThreadPool.h
+//  VectorStorm
+//
+//  Created by Trevor Powell on 19/10/26.
+//  Copyright 2026 VectorStorm Pty Ltd. All rights reserved.
+//
+
+#ifndef VS_THREADPOOL_H
+#define VS_THREADPOOL_H
+
+#include "VS_Futex.h"
+#include "VS_CpuTopology.h"
+
+class vsThreadPoolWorker;
+
+// A vsJob is a small piece of work to be run on one of the thread pool's
+// worker threads.  Subclass it, override Execute(), and hand it to
+// vsThreadPool::Submit().  The job object must stay alive until it's done;
+// call Wait() to wait for that.  A job may be submitted again once it's done.
+
+class vsJob
+{
+	vsFutexWord		m_state;
+	vsJob *			m_next;
+
+	void			Finished();
+
+	friend class vsThreadPool;
+	friend class vsThreadPoolWorker;
+
+protected:
+
+	virtual void	Execute() = 0;
+
+public:
+
+	vsJob();
+	virtual ~vsJob();
+
+	bool			IsDone() const;
+	void			Wait();
+};
+
+// vsThreadPool is a persistent set of worker threads, laid out according to
+// the machine's CPU topology (see vsCpuTopology).  By default we start one
+// worker per physical core, minus one for the main thread.
+//
+// Each worker belongs to the L3 cache domain of the core it was assigned to.
+// Jobs may ask to run only within the main thread's L3 domain, so that jobs
+// which work on the same data as the main thread stay cache-local.  Unless
+// workers are pinned, the OS may still migrate them, so this is a hint rather
+// than a guarantee.
+
+class vsThreadPool
+{
+public:
+	enum Affinity
+	{
+		Affinity_Any,			// run on any worker
+		Affinity_MainThreadL3	// run on a worker sharing the main thread's L3 cache
+	};
+
+	enum Pinning
+	{
+		Pinning_None,	// workers may run on any CPU
+		Pinning_L3,		// workers may only run on CPUs in their L3 domain
+		Pinning_Core	// workers are locked to their own physical core
+	};
+
+	struct Settings
+	{
+		int		workerCount;	// 0 means "one per physical core, less one for the main thread"
+		Pinning	pinning;
+		bool	pinMainThread;	// keep the main thread on the core it started on, so "its" L3 domain stays meaningful
+		size_t	stackSize;		// 0 for the platform default
+
+		Settings():
+			workerCount(0),
+			pinning(Pinning_None),
+			pinMainThread(false),
+			stackSize(0)
+		{
+		}
+	};
+
+private:
+	struct Domain;
+
+	static vsThreadPool *	s_instance;
+	static Settings			s_settings;
+
+	Domain *				m_domain;	// one per L3 domain
+	int						m_domainCount;
+	Domain *				m_anyQueue;	// for Affinity_Any jobs, which any domain may take
+	int						m_mainDomain;
+
+	vsThreadPoolWorker **	m_worker;
+	int						m_workerCount;
+
+	vsFutexWord				m_nextWake;
+
+	vsThreadPool( const Settings& settings );
+	~vsThreadPool();
+
+	vsJob *		Take( int domain );
+	void		Wake( int domain );
+
+	friend class vsThreadPoolWorker;
+
+public:
+
+	// Must be called before the pool is first used, to have any effect.
+	static void Configure( const Settings& settings ) { s_settings = settings; }
+
+	// The pool is started on first use (which must be from the main thread,
+	// as that decides which L3 domain is "the main thread's"), and shut
+	// down by vsSystem.
+	static vsThreadPool *	Instance();
+	static void				Shutdown();
+
+	void	Submit( vsJob *job, Affinity affinity = Affinity_Any );
+
+	// How many workers could run a job with this affinity?
+	int		GetWorkerCount( Affinity affinity = Affinity_Any ) const;
+
+	// Is the calling thread one of our workers?  Code which might run inside a
+	// job shouldn't submit more jobs and wait on them;  if every worker did
+	// that at once, nobody would be left to run them.
+	static bool	IsWorkerThread();
+	int		GetMainThreadL3() const { return m_mainDomain; }
+};
+
+#endif // VS_THREADPOOL_H
+
@@ -22,6 +22,9 @@
 
 void vsBacktrace()
 {
+	// make sure everything logged before the crash makes it out to disk.
+	vsLog_FlushOnCrash();
+
 	vsFile f("crash.rpt", vsFile::MODE_WriteDirectly);
 
 	HANDLE process = GetCurrentProcess();
@@ -155,6 +158,9 @@ void vsBacktrace()
 	void *array[20];
 	size_t size;
 
+	// make sure everything logged before the crash makes it out to disk.
+	vsLog_FlushOnCrash();
+
 	// get void*'s for all entries on the stack
 	size = backtrace(array, 20);
 
@@ -173,6 +179,7 @@ void vsInstallBacktraceHandler()
 
 void vsBacktrace()
 {
+	vsLog_FlushOnCrash();
 }
 
 #endif
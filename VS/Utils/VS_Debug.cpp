@@ -55,7 +55,7 @@
 
 static bool bAsserted = false;
 
-vsMutex s_assertMutex;
+vsMutex s_assertMutex("assert");
 
 void vsFailedAssert( const char* conditionStr, const char* msg, const char *file, int line )
 {
@@ -74,7 +74,8 @@ void vsFailedAssert( const char* conditionStr, const char* msg, const char *file
 		vsLog("Failed assertion:  %s", msg);
 		vsLog("Failed condition: (%s)", conditionStr);
 		vsLog("at %s:%d", trimmedFile.c_str(), line);
-		vsLog_End();
+		// we may be on the log's writer thread, so don't wait for it to stop.
+		vsLog_FlushOnCrash();
 
 		{
 #if defined(_DEBUG)
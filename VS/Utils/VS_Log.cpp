@@ -14,23 +14,379 @@
 #include <cstdio>
 #include <cstddef>
 #include "VS_File.h"
+#include "VS_Task.h"
+#include "VS_Event.h"
+#include "VS_Sleep.h"
+
+#include "VS_DisableDebugNew.h"
+#include <atomic>
+#include "VS_EnableDebugNew.h"
+
+#if !TARGET_OS_IPHONE
+#include <SDL2/SDL.h>
+#endif
 
 #ifdef MSVC
 #define vsprintf vsprintf_s
 #endif
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Our queue is a fixed ring of fixed-size records, so the log never uses more
+// than LOG_QUEUE_SLOTS * sizeof(vsLogRecord) bytes (256k) no matter how much
+// is being logged.  Messages longer than one record's worth of text are split
+// across several consecutive records, which are always claimed together so
+// that messages from different threads can't interleave.
+#define LOG_QUEUE_SLOTS (1024)	// must be a power of two
+#define LOG_QUEUE_MASK (LOG_QUEUE_SLOTS-1)
+#define LOG_RECORD_TEXT (240)
+#define LOG_MAX_FRAGMENTS (32)	// messages longer than ~7.5k are truncated
+#define LOG_MAX_CATEGORIES (64)
+
+struct vsLogRecord
+{
+	// Each record's sequence number tells producers and the consumer whose
+	// turn it is to use it.  (This is Dmitry Vyukov's bounded queue)
+	std::atomic<size_t> sequence;
+	uint16_t length;
+	uint8_t fragments;	// number of records in this message, set only on the first one
+	uint8_t error;		// 'true' if this message should go to stderr
+	char text[LOG_RECORD_TEXT];
+};
+
+static vsLogRecord s_record[LOG_QUEUE_SLOTS];
+static std::atomic<size_t> s_enqueuePos(0);
+static std::atomic<size_t> s_dequeuePos(0);
+static std::atomic<bool> s_queueInitialised(false);
+static std::atomic<bool> s_draining(false);	// only one thread may consume at a time
+static std::atomic<uint64_t> s_dropped(0);
+static uint64_t s_droppedReported = 0;
+
+static std::atomic<bool> s_writerRunning(false);
+static std::atomic<bool> s_writerStopping(false);
+static std::atomic<int> s_enqueuing(0);	// producers which may be about to enqueue
+
+struct vsLogCategoryState
+{
+	std::atomic<uint32_t> windowStart;
+	std::atomic<uint32_t> count;
+	std::atomic<uint32_t> suppressed;
+};
+static vsLogCategoryState s_categoryState[LOG_MAX_CATEGORIES];
+static std::atomic<int> s_categoryCount(0);
+
 // static PHYSFS_File* s_log = NULL;
 static vsFile *s_log = NULL;
 
+class vsLogWriter : public vsTask
+{
+protected:
+	virtual int Run();
+public:
+	vsLogWriter(): vsTask("vsLog") {}
+};
+
+// our writer thread's events live for the whole program, and must be released
+// before they're destroyed.
+struct vsLogEvents
+{
+	vsEvent wake;
+	vsEvent exited;
+
+	vsLogEvents(): wake(true) {}
+	~vsLogEvents()
+	{
+		wake.Release();
+		exited.Release();
+	}
+};
+
+static vsLogWriter s_writer;
+static vsLogEvents s_events;
+
+static void WriteToLogFile( const vsString &str )
+{
+	if ( s_log )
+	{
+		s_log->WriteBytes( (const void*)str.c_str(), str.size() );
+	}
+}
+
+static vsString LineEnding( const vsString &str )
+{
+#ifdef _WIN32
+	return str + "\r\n";
+#else
+	return str + "\n";
+#endif
+}
+
+static void InitQueue()
+{
+	if ( !s_queueInitialised.load() )
+	{
+		for ( size_t i = 0; i < LOG_QUEUE_SLOTS; i++ )
+			s_record[i].sequence.store(i, std::memory_order_relaxed);
+		s_queueInitialised.store(true);
+	}
+}
+
+static bool Enqueue( const vsString &str, bool error )
+{
+	size_t length = str.size();
+	size_t fragments = vsMax( (size_t)1, (length + LOG_RECORD_TEXT-1) / LOG_RECORD_TEXT );
+	if ( fragments > LOG_MAX_FRAGMENTS )
+	{
+		fragments = LOG_MAX_FRAGMENTS;
+		length = fragments * LOG_RECORD_TEXT;
+	}
+
+	// Claim 'fragments' consecutive records.  The consumer frees records in
+	// order, so if the last one we want is free, all the others are too.
+	size_t pos = s_enqueuePos.load(std::memory_order_relaxed);
+	while ( true )
+	{
+		size_t last = pos + fragments - 1;
+		size_t sequence = s_record[last & LOG_QUEUE_MASK].sequence.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)sequence - (intptr_t)last;
+		if ( diff == 0 )
+		{
+			if ( s_enqueuePos.compare_exchange_weak( pos, pos + fragments, std::memory_order_relaxed ) )
+				break;
+		}
+		else if ( diff < 0 )
+		{
+			// queue is full.  Drop this message rather than stall the caller.
+			s_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else
+		{
+			pos = s_enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	const char *text = str.c_str();
+	for ( size_t i = 0; i < fragments; i++ )
+	{
+		vsLogRecord &record = s_record[(pos+i) & LOG_QUEUE_MASK];
+		size_t bytes = vsMin( length, (size_t)LOG_RECORD_TEXT );
+		memcpy( record.text, text, bytes );
+		record.length = (uint16_t)bytes;
+		record.fragments = (i == 0) ? (uint8_t)fragments : 0;
+		record.error = error;
+		text += bytes;
+		length -= bytes;
+		record.sequence.store( pos + i + 1, std::memory_order_release );
+	}
+	return true;
+}
+
+// Pull everything currently in the queue, and write it out.  Must only be
+// called by whoever holds 's_draining'.
+static void DrainQueue()
+{
+	vsString out, err, all;
+	size_t pos = s_dequeuePos.load(std::memory_order_relaxed);
+	while ( true )
+	{
+		vsLogRecord &first = s_record[pos & LOG_QUEUE_MASK];
+		if ( first.sequence.load(std::memory_order_acquire) != pos + 1 )
+			break;	// nothing more has been published.
+		size_t fragments = first.fragments;
+		size_t last = pos + fragments - 1;
+		if ( s_record[last & LOG_QUEUE_MASK].sequence.load(std::memory_order_acquire) != last + 1 )
+			break;	// message is still being written;  we'll get it next time.
+
+		vsString &dest = first.error ? err : out;
+		size_t messageLength = 1;
+		for ( size_t i = 0; i < fragments; i++ )
+		{
+			vsLogRecord &record = s_record[(pos+i) & LOG_QUEUE_MASK];
+			dest.append( record.text, record.length );
+			messageLength += record.length;
+			record.sequence.store( pos + i + LOG_QUEUE_SLOTS, std::memory_order_release );
+		}
+		dest.append("\n");
+		pos += fragments;
+
+		// the log file gets everything, in order.
+		all.append( dest, dest.size() - messageLength, vsString::npos );
+	}
+	s_dequeuePos.store(pos, std::memory_order_release);
+
+	uint64_t dropped = s_dropped.load(std::memory_order_relaxed);
+	if ( dropped != s_droppedReported )
+	{
+		vsString warning = vsFormatString("vsLog: dropped %d messages because the log queue was full\n", dropped - s_droppedReported);
+		err += warning;
+		all += warning;
+		s_droppedReported = dropped;
+	}
+
+	if ( !out.empty() )
+	{
+		fputs( out.c_str(), stdout );
+		fflush( stdout );
+	}
+	if ( !err.empty() )
+	{
+		fputs( err.c_str(), stderr );
+	}
+	if ( s_log && !all.empty() )
+	{
+#ifdef _WIN32
+		// convert to Windows-style line endings
+		vsString converted;
+		for ( size_t i = 0; i < all.size(); i++ )
+		{
+			if ( all[i] == '\n' )
+				converted += "\r";
+			converted += all[i];
+		}
+		all = converted;
+#endif
+		WriteToLogFile( all );
+	}
+}
+
+// Crash handlers can't build vsStrings, since the crash may have happened
+// with the heap locked.  So when draining on a crash, we copy each message
+// into this buffer and write it out directly.  (+2 for "\r\n")
+static char s_crashBuffer[LOG_RECORD_TEXT * LOG_MAX_FRAGMENTS + 2];
+
+static void CrashWrite( int fd, const char *text, size_t length )
+{
+	while ( length > 0 )
+	{
+#ifdef _WIN32
+		int written = _write( fd, text, (unsigned int)length );
+#else
+		int written = (int)write( fd, text, length );
+#endif
+		if ( written <= 0 )
+			return;
+		text += written;
+		length -= written;
+	}
+}
+
+static void CrashWriteMessage( bool error, size_t length )
+{
+	s_crashBuffer[length] = '\n';
+	CrashWrite( error ? 2 : 1, s_crashBuffer, length + 1 );
+	if ( s_log )
+	{
+#ifdef _WIN32
+		s_crashBuffer[length++] = '\r';
+		s_crashBuffer[length] = '\n';
+#endif
+		s_log->WriteBytes( s_crashBuffer, length + 1 );
+	}
+}
+
+// As DrainQueue(), but without allocating.  Must only be called by whoever
+// holds 's_draining'.
+static void DrainQueueOnCrash()
+{
+	size_t pos = s_dequeuePos.load(std::memory_order_relaxed);
+	while ( true )
+	{
+		vsLogRecord &first = s_record[pos & LOG_QUEUE_MASK];
+		if ( first.sequence.load(std::memory_order_acquire) != pos + 1 )
+			break;
+		size_t fragments = first.fragments;
+		size_t last = pos + fragments - 1;
+		if ( s_record[last & LOG_QUEUE_MASK].sequence.load(std::memory_order_acquire) != last + 1 )
+			break;
+
+		bool error = first.error != 0;
+		size_t length = 0;
+		for ( size_t i = 0; i < fragments; i++ )
+		{
+			vsLogRecord &record = s_record[(pos+i) & LOG_QUEUE_MASK];
+			memcpy( s_crashBuffer + length, record.text, record.length );
+			length += record.length;
+			record.sequence.store( pos + i + LOG_QUEUE_SLOTS, std::memory_order_release );
+		}
+		pos += fragments;
+		CrashWriteMessage( error, length );
+	}
+	s_dequeuePos.store(pos, std::memory_order_release);
+
+	uint64_t dropped = s_dropped.load(std::memory_order_relaxed);
+	if ( dropped != s_droppedReported )
+	{
+		int length = snprintf( s_crashBuffer, LOG_RECORD_TEXT, "vsLog: dropped %d messages because the log queue was full", (int)(dropped - s_droppedReported) );
+		if ( length > 0 )
+			CrashWriteMessage( true, vsMin( (size_t)length, (size_t)LOG_RECORD_TEXT-1 ) );
+		s_droppedReported = dropped;
+	}
+}
+
+static bool TryDrainQueue()
+{
+	bool expected = false;
+	if ( !s_draining.compare_exchange_strong( expected, true, std::memory_order_acquire ) )
+		return false;
+	DrainQueue();
+	s_draining.store( false, std::memory_order_release );
+	return true;
+}
+
+int
+vsLogWriter::Run()
+{
+	while ( s_events.wake.Wait() )
+	{
+		// if a crash handler has taken over draining the queue, we just
+		// leave it to them.
+		TryDrainQueue();
+		if ( s_writerStopping.load() )
+			break;
+	}
+	s_events.exited.Set();
+	return 0;
+}
+
 void vsLog_Start()
 {
 	s_log = new vsFile("log.txt", vsFile::MODE_WriteDirectly);
 	// s_log = PHYSFS_openWrite( "log.txt" );
+
+	if ( !s_writerRunning.load() )
+	{
+		InitQueue();
+		s_writerStopping.store(false);
+		s_events.exited.Reset();
+		s_writerRunning.store(true);
+		s_writer.Start();
+	}
 }
 
 void vsLog_End()
 {
-	delete s_log;
+	if ( s_writerRunning.load() )
+	{
+		s_writerStopping.store(true);
+		s_events.wake.Set();
+		s_events.exited.Wait();
+		s_writerRunning.store(false);
+
+		// a producer may have seen the writer running just before we stopped
+		// it;  wait for them to finish enqueuing, then write out anything
+		// which sneaked in after the writer's last pass.  Producers arriving
+		// from now on will see it stopped, and write directly.
+		while ( s_enqueuing.load() > 0 )
+			vsSleep(1);
+		TryDrainQueue();
+	}
+
+	vsDelete( s_log );
 	// PHYSFS_close(s_log);
 }
 
@@ -43,44 +399,122 @@ void vsLog_Show()
 	// }
 }
 
-void vsLog_(const vsString &str)
+void vsLog_Flush()
 {
-	fprintf(stdout, "%s\n", str.c_str());
-	if ( s_log )
+	if ( !s_writerRunning.load() )
+		return;
+
+	size_t target = s_enqueuePos.load();
+	while ( s_dequeuePos.load(std::memory_order_acquire) < target && s_writerRunning.load() )
 	{
-#ifdef _WIN32
-		vsString fullLine = str + "\r\n";
-#else
-		vsString fullLine = str + "\n";
-#endif
-		s_log->WriteBytes( (const void*)fullLine.c_str(), fullLine.size() );
+		s_events.wake.Set();
+		vsSleep(1);
 	}
 }
 
+void vsLog_FlushOnCrash()
+{
+	if ( !s_queueInitialised.load() )
+		return;
+
+	// The writer thread may be the one which crashed, or may be stuck.  Give
+	// it a moment to finish whatever it's doing, then take over draining the
+	// queue regardless;  whoever was draining isn't coming back.
+	for ( int i = 0; i < 100; i++ )
+	{
+		bool expected = false;
+		if ( s_draining.compare_exchange_strong( expected, true, std::memory_order_acquire ) )
+			break;
+		vsSleep(1);
+	}
+	s_draining.store( true, std::memory_order_seq_cst );
 
-void vsLog(fmt::CStringRef format, fmt::ArgList args)
+	DrainQueueOnCrash();
+	s_draining.store( false, std::memory_order_release );
+}
+
+uint64_t vsLog_GetDroppedCount()
 {
-	vsString str = fmt::sprintf(format,args);
-	vsLog_(str);
+	return s_dropped.load(std::memory_order_relaxed);
 }
 
-void vsErrorLog_(const vsString &str)
+static void vsLog_( const vsString &str, bool error )
 {
-	fprintf(stderr, "%s\n", str.c_str() );
-	if ( s_log )
+	// Announce ourselves before checking whether the writer is running, so
+	// that vsLog_End() can't miss our message;  it waits for us after it
+	// stops the writer.
+	s_enqueuing.fetch_add(1);
+	if ( s_writerRunning.load() )
 	{
-#ifdef _WIN32
-		vsString fullLine = str + "\r\n";
-#else
-		vsString fullLine = str + "\n";
-#endif
-		s_log->WriteBytes( (const void*)fullLine.c_str(), fullLine.size() );
+		if ( Enqueue( str, error ) )
+			s_events.wake.Set();
+		s_enqueuing.fetch_sub(1);
+		return;
 	}
+	s_enqueuing.fetch_sub(1);
+
+	fprintf(error ? stderr : stdout, "%s\n", str.c_str());
+	WriteToLogFile( LineEnding(str) );
+}
+
+void vsLog(fmt::CStringRef format, fmt::ArgList args)
+{
+	vsString str = fmt::sprintf(format,args);
+	vsLog_(str, false);
 }
 
 void vsErrorLog(fmt::CStringRef format, fmt::ArgList args)
 {
 	vsString str = fmt::sprintf(format,args);
-	vsErrorLog_(str);
+	vsLog_(str, true);
+}
+
+vsLogCategory::vsLogCategory( const char *name, int maxMessagesPerSecond ):
+	m_name(name),
+	m_id( s_categoryCount.fetch_add(1) ),
+	m_maxPerSecond(maxMessagesPerSecond)
+{
+	vsAssert( m_id < LOG_MAX_CATEGORIES, "Too many vsLogCategories;  increase LOG_MAX_CATEGORIES" );
+}
+
+// returns true if this category is allowed to log another message right now.
+static bool RateLimitAllows( const vsLogCategory &category )
+{
+	if ( category.GetMaxPerSecond() <= 0 )
+		return true;
+
+	vsLogCategoryState &state = s_categoryState[ category.GetId() ];
+	uint32_t now = SDL_GetTicks();
+	uint32_t windowStart = state.windowStart.load(std::memory_order_relaxed);
+	if ( now - windowStart >= 1000 )
+	{
+		// new one-second window.  Whoever wins this race resets the count and
+		// reports what was suppressed in the previous window.
+		if ( state.windowStart.compare_exchange_strong( windowStart, now, std::memory_order_relaxed ) )
+		{
+			state.count.store(0, std::memory_order_relaxed);
+			uint32_t suppressed = state.suppressed.exchange(0, std::memory_order_relaxed);
+			if ( suppressed )
+				vsLog_( vsFormatString("[%s] suppressed %d messages", category.GetName(), suppressed), false );
+		}
+	}
+
+	if ( state.count.fetch_add(1, std::memory_order_relaxed) < (uint32_t)category.GetMaxPerSecond() )
+		return true;
+
+	state.suppressed.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+void vsLog(const vsLogCategory& category, fmt::CStringRef format, fmt::ArgList args)
+{
+	// check the rate limit before formatting, so that suppressed messages
+	// cost us almost nothing.
+	if ( !RateLimitAllows( category ) )
+		return;
+
+	vsString str = vsFormatString("[%s] ", category.GetName());
+	str += fmt::sprintf(format,args);
+	vsLog_(str, false);
 }
 
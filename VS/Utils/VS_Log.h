@@ -10,6 +10,8 @@
 #ifndef VS_LOG
 #define VS_LOG
 
+#include "Utils/fmt/printf.h"
+
 // vsLog_Start() creates a file named "log.txt" in our current output directory.
 // All subsequent calls to vsLog() will write out text into that file, in addition
 // to the console.  vsLog_End() closes that file, and stops writing vsLog() messages
@@ -17,11 +19,24 @@
 // use this when an assert is thrown, so that end-users can more easily find the
 // log file so they can e-mail it to us.  (TODO:  Consider whether we want to set
 // up a system which will cause asserts to submit logs to us anonymously, instead?)
+//
+// While the log is started, vsLog() doesn't write anything itself;  it formats
+// its message on the calling thread and pushes it into a fixed-size lock-free
+// queue, and a background writer thread drains that queue out to the console
+// and to "log.txt".  This keeps logging cheap, and safe to call from worker
+// threads.  If the queue is ever full, messages are dropped (and counted)
+// rather than blocking the caller.  Before vsLog_Start() and after vsLog_End(),
+// vsLog() writes directly to the console, as it always has.
+//
+// vsLog_Flush() blocks until everything logged so far has been written out.
+// vsLog_FlushOnCrash() is for use from crash handlers;  it drains the queue
+// from the calling thread, without waiting on the writer thread.
 void vsLog_Start();
 void vsLog_End();
 void vsLog_Show();
-
-#include "Utils/fmt/printf.h"
+void vsLog_Flush();
+void vsLog_FlushOnCrash();
+uint64_t vsLog_GetDroppedCount();
 
 void vsLog(fmt::CStringRef format, fmt::ArgList args);
 FMT_VARIADIC(void, vsLog, fmt::CStringRef)
@@ -29,6 +44,33 @@ FMT_VARIADIC(void, vsLog, fmt::CStringRef)
 void vsErrorLog(fmt::CStringRef format, fmt::ArgList args);
 FMT_VARIADIC(void, vsErrorLog, fmt::CStringRef)
 
+// A vsLogCategory tags log messages with a name, and optionally limits how
+// many messages per second it will let through;  useful for chatty systems
+// which might otherwise flood the log.  Messages beyond the limit are
+// discarded, and a count of how many were suppressed is logged when the
+// next one-second window begins.  Categories are intended to be long-lived
+// (usually static) objects;  'name' must outlive the category.
+//
+//   static vsLogCategory s_netLog("net", 20);
+//   vsLog(s_netLog, "received packet %d", id);
+//
+class vsLogCategory
+{
+	const char *m_name;
+	int m_id;
+	int m_maxPerSecond;
+public:
+	vsLogCategory( const char *name, int maxMessagesPerSecond = 0 );
+
+	const char *GetName() const { return m_name; }
+	int GetId() const { return m_id; }
+	int GetMaxPerSecond() const { return m_maxPerSecond; }
+	void SetMaxPerSecond( int maxMessagesPerSecond ) { m_maxPerSecond = maxMessagesPerSecond; }
+};
+
+void vsLog(const vsLogCategory& category, fmt::CStringRef format, fmt::ArgList args);
+FMT_VARIADIC(void, vsLog, const vsLogCategory&, fmt::CStringRef)
+
 // void vsLog(const char *format, ...);
 // void vsLog(const vsString &str);
 
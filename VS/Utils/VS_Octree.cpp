@@ -12,201 +12,374 @@
 #include "VS/Graphics/VS_Camera.h"
 #include "VS/Graphics/VS_Model.h"
 
-#include <list>
+static const int c_maxLevels = 20;
 
 struct vsOctreeModelInfo
 {
-	vsModel *	m_model;
-	int			m_nodeId;
-	
+	vsModel *				m_model;
+	int						m_nodeId;	// -1 if we're in the tree's 'outside' list
+	vsOctreeModelInfo *		m_prev;
+	vsOctreeModelInfo *		m_next;
+
 	vsOctreeModelInfo() :
 		m_model(NULL),
-		m_nodeId(-1)
+		m_nodeId(-1),
+		m_prev(NULL),
+		m_next(NULL)
 	{
 	}
-	
-	~vsOctreeModelInfo()
+};
+
+struct vsOctreeNode
+{
+	vsBox3D		m_bounds;		// loose bounds;  twice the size of our cell
+	vsVector3D	m_center;		// of our cell
+	int			m_depth;
+	int			m_parentId;
+	int			m_octant;		// which of our parent's octants we are
+	int			m_modelCount;	// models in this node and everything below it
+
+	vsOctreeModelInfo *	m_info;	// models stored directly in this node
+
+	int			m_childCount;
+	int			m_childId[8];		// only the first m_childCount are used
+	vsBox3D		m_childBounds[8];	// m_bounds of those children, packed for batch classification
+
+	vsOctreeNode() :
+		m_depth(0),
+		m_parentId(-1),
+		m_octant(0),
+		m_modelCount(0),
+		m_info(NULL),
+		m_childCount(0)
 	{
 	}
 };
 
-struct vsOctreeNode
+static vsBox3D
+ModelBounds( vsModel *model )
+{
+	return model->GetBoundingBox() + model->GetPosition();
+}
+
+static void
+LinkInfo( vsOctreeModelInfo *info, vsOctreeModelInfo **head )
+{
+	info->m_prev = NULL;
+	info->m_next = *head;
+	if ( *head )
+		(*head)->m_prev = info;
+	*head = info;
+}
+
+static void
+UnlinkInfo( vsOctreeModelInfo *info, vsOctreeModelInfo **head )
 {
-	vsBox3D		m_bounds;
-	int			m_nodeId;
-	int			m_parentNodeId;
-	
-	std::list<vsOctreeModelInfo*>	m_infoList;
-	
-	int			m_childId[8];
-	
-	~vsOctreeNode()
-	{
-		while ( m_infoList.begin() != m_infoList.end() )
+	if ( info->m_prev )
+		info->m_prev->m_next = info->m_next;
+	else
+		*head = info->m_next;
+	if ( info->m_next )
+		info->m_next->m_prev = info->m_prev;
+	info->m_prev = info->m_next = NULL;
+}
+
+vsOctree::vsOctree( const vsBox3D &area, int levels ):
+	m_rootHalfSize( area.Extents() * 0.5f ),
+	m_levels( vsMin( levels, c_maxLevels ) ),
+	m_outside( NULL )
+{
+	vsOctreeNode root;
+	root.m_center = area.Middle();
+	root.m_bounds.Set( root.m_center - m_rootHalfSize * 2.f, root.m_center + m_rootHalfSize * 2.f );
+	m_node.AddItem( root );
+}
+
+vsOctree::~vsOctree()
+{
+	for ( int i = 0; i < m_node.ItemCount(); i++ )
+	{
+		while ( m_node[i].m_info )
 		{
-			vsOctreeModelInfo *info = *m_infoList.begin();
-			
-			m_infoList.remove(info);
-			
-			vsDelete(info);
+			vsOctreeModelInfo *info = m_node[i].m_info;
+			m_node[i].m_info = info->m_next;
+			vsDelete( info );
 		}
 	}
-};
+	while ( m_outside )
+	{
+		vsOctreeModelInfo *info = m_outside;
+		m_outside = info->m_next;
+		vsDelete( info );
+	}
+}
 
-vsOctree::vsOctree( const vsBox3D &area, int levels )
+vsVector3D
+vsOctree::CellHalfSize( int depth ) const
 {
-	int nodeCount = 1;
-	int nodesThisLevel = 1;
-	for ( int i = 0; i < levels; i++ )
+	return m_rootHalfSize / (float)(1 << depth);
+}
+
+int
+vsOctree::AllocateNode( int parentId, int octant )
+{
+	int nodeId;
+	if ( !m_freeNode.IsEmpty() )
+	{
+		nodeId = m_freeNode[ m_freeNode.ItemCount()-1 ];
+		m_freeNode.PopBack();
+	}
+	else
 	{
-		nodesThisLevel *= 8;
-		nodeCount += nodesThisLevel;
+		nodeId = m_node.ItemCount();
+		m_node.AddItem( vsOctreeNode() );
 	}
-	
-	m_nodeCount = nodeCount;
-	m_node = new vsOctreeNode[m_nodeCount];
-	
-	m_nextNodeToInit = 0;
-	
-	InitNode( area, levels, -1 );
+
+	vsOctreeNode &parent = m_node[parentId];
+	vsOctreeNode &node = m_node[nodeId];
+	node.m_depth = parent.m_depth + 1;
+	node.m_parentId = parentId;
+	node.m_octant = octant;
+	node.m_modelCount = 0;
+	node.m_info = NULL;
+	node.m_childCount = 0;
+
+	vsVector3D half = CellHalfSize( node.m_depth );
+	node.m_center = parent.m_center + vsVector3D(
+			(octant & 0x1) ? half.x : -half.x,
+			(octant & 0x2) ? half.y : -half.y,
+			(octant & 0x4) ? half.z : -half.z );
+	node.m_bounds.Set( node.m_center - half * 2.f, node.m_center + half * 2.f );
+
+	vsAssert( parent.m_childCount < 8, "Octree node has too many children" );
+	parent.m_childId[ parent.m_childCount ] = nodeId;
+	parent.m_childBounds[ parent.m_childCount ] = node.m_bounds;
+	parent.m_childCount++;
+
+	return nodeId;
 }
 
-vsOctree::~vsOctree()
+// Finds the depth of the cells which a box belongs in:  the deepest one
+// whose cells are at least as large as the box.  Returns false if the box
+// doesn't fit inside the tree at all.
+bool
+vsOctree::FindCell( const vsBox3D &bounds, int *depth ) const
 {
-	vsDeleteArray( m_node );
+	vsVector3D half = bounds.Extents() * 0.5f;
+	vsVector3D offset = bounds.Middle() - m_node[0].m_center;
+	if ( half.x > m_rootHalfSize.x || half.y > m_rootHalfSize.y || half.z > m_rootHalfSize.z ||
+			vsFabs(offset.x) > m_rootHalfSize.x || vsFabs(offset.y) > m_rootHalfSize.y || vsFabs(offset.z) > m_rootHalfSize.z )
+		return false;
+
+	int d = 0;
+	while ( d < m_levels )
+	{
+		vsVector3D cell = CellHalfSize( d+1 );
+		if ( half.x > cell.x || half.y > cell.y || half.z > cell.z )
+			break;
+		d++;
+	}
+	*depth = d;
+	return true;
+}
+
+// Can a model with these bounds stay in this node?  It can as long as it's
+// inside the node's loose bounds, even if its center has wandered into a
+// neighbouring cell, unless it's become small enough to belong in a child.
+// This is O(1);  it never walks the tree.
+bool
+vsOctree::StaysInNode( const vsBox3D &bounds, int nodeId ) const
+{
+	const vsOctreeNode &node = m_node[nodeId];
+	if ( !node.m_bounds.EncompassesBox( bounds ) )
+		return false;
+	if ( node.m_depth >= m_levels )
+		return true;
+
+	vsVector3D half = bounds.Extents() * 0.5f;
+	vsVector3D child = CellHalfSize( node.m_depth+1 );
+	return ( half.x > child.x || half.y > child.y || half.z > child.z );
 }
 
 void
-vsOctree::InitNode( const vsBox3D &bounds, int levelsToRecurse, int parentId )
-{
-	vsAssert( m_nextNodeToInit < m_nodeCount, "Octree setup error" );
-	vsOctreeNode *node = &m_node[ m_nextNodeToInit ];
-	
-	node->m_bounds = bounds;
-	node->m_nodeId = m_nextNodeToInit;
-	node->m_parentNodeId = parentId;
-	
-	m_nextNodeToInit++;
-	
-	if ( levelsToRecurse == 0 )
-	{
-		for ( int i = 0; i < 8; i++ )
-		{
-			node->m_childId[i] = -1;
-		}
+vsOctree::InsertInfo( vsOctreeModelInfo *info )
+{
+	vsBox3D bounds = ModelBounds( info->m_model );
+	int depth;
+	if ( !FindCell( bounds, &depth ) )
+	{
+		info->m_nodeId = -1;
+		LinkInfo( info, &m_outside );
+		return;
 	}
-	else
+
+	// walk down to the cell containing the box's center, creating any nodes
+	// which don't exist yet.
+	vsVector3D center = bounds.Middle();
+	int nodeId = 0;
+	m_node[0].m_modelCount++;
+	while ( m_node[nodeId].m_depth < depth )
 	{
-		// THIS IS LOGIC IS WRONG FOR MOST CASES!  FIX ME BEFORE COMMITTING BACK TO TRUNK!
-		// (Check the implementation of the mmoQuadTreeStore class for a correct impl)
-		vsBox3D childBounds = bounds * 0.5f;	// each level's nodes are half the size of the parent nodes!
-		
-		float halfWidth = childBounds.Width() * 0.5f;
-		float halfHeight = childBounds.Height() * 0.5f;
-		float halfDepth = childBounds.Depth() * 0.5f;
-		
-		
-		vsVector3D offset[8];
-		
-		for ( int i = 0; i < 8; i++ )
+		const vsOctreeNode &node = m_node[nodeId];
+		int octant = ( center.x >= node.m_center.x ? 0x1 : 0 ) |
+			( center.y >= node.m_center.y ? 0x2 : 0 ) |
+			( center.z >= node.m_center.z ? 0x4 : 0 );
+
+		int childId = -1;
+		for ( int i = 0; i < node.m_childCount; i++ )
 		{
-			if ( i & 0x1 )
-			{
-				offset[i].x += halfWidth;
-			}
-			else
+			if ( m_node[ node.m_childId[i] ].m_octant == octant )
 			{
-				offset[i].x -= halfWidth;
+				childId = node.m_childId[i];
+				break;
 			}
+		}
+		if ( childId < 0 )
+			childId = AllocateNode( nodeId, octant );
 
-			if ( i & 0x2 )
-			{
-				offset[i].y += halfHeight;
-			}
-			else
-			{
-				offset[i].y -= halfHeight;
-			}
+		nodeId = childId;
+		m_node[nodeId].m_modelCount++;
+	}
 
-			if ( i & 0x4 )
-			{
-				offset[i].z += halfDepth;
-			}
-			else
-			{
-				offset[i].z -= halfDepth;
-			}
-		}
+	info->m_nodeId = nodeId;
+	LinkInfo( info, &m_node[nodeId].m_info );
+}
+
+void
+vsOctree::ExtractInfo( vsOctreeModelInfo *info )
+{
+	if ( info->m_nodeId < 0 )
+	{
+		UnlinkInfo( info, &m_outside );
+		return;
+	}
+
+	UnlinkInfo( info, &m_node[info->m_nodeId].m_info );
 
-		for ( int i = 0; i < 8; i++ )
+	// walk back up to the root, recycling any nodes which are now empty.
+	int nodeId = info->m_nodeId;
+	while ( nodeId >= 0 )
+	{
+		vsOctreeNode &node = m_node[nodeId];
+		int parentId = node.m_parentId;
+		node.m_modelCount--;
+		if ( node.m_modelCount == 0 && parentId >= 0 )
 		{
-			node->m_childId[i] = m_nextNodeToInit;
-			InitNode( childBounds + offset[i], levelsToRecurse-1, node->m_nodeId );
+			vsOctreeNode &parent = m_node[parentId];
+			for ( int i = 0; i < parent.m_childCount; i++ )
+			{
+				if ( parent.m_childId[i] == nodeId )
+				{
+					int last = parent.m_childCount - 1;
+					parent.m_childId[i] = parent.m_childId[last];
+					parent.m_childBounds[i] = parent.m_childBounds[last];
+					parent.m_childCount--;
+					break;
+				}
+			}
+			m_freeNode.AddItem( nodeId );
 		}
+		nodeId = parentId;
 	}
+	info->m_nodeId = -1;
 }
 
-
-
 void
 vsOctree::Draw( const vsCamera3D *camera, vsRenderQueue *queue )
 {
-	m_nodesDrawn = 0;
-	DrawNode( 0, camera, queue );
+	m_stats = Stats();
+	m_stats.nodes = m_node.ItemCount() - m_freeNode.ItemCount();
+
+	const vsFrustum &frustum = camera->GetFrustum();
+	DrawList( m_outside, frustum, vsFrustum::Intersect, queue );
+
+	const vsOctreeNode &root = m_node[0];
+	if ( root.m_modelCount == 0 )
+		return;
+
+	vsFrustum::Classification classification;
+	if ( frustum.ClassifyBoxes( &root.m_bounds, 1, &classification ) )
+		DrawNode( 0, frustum, classification, queue );
+	else
+	{
+		m_stats.nodesCulled++;
+		m_stats.modelsCulled += root.m_modelCount;
+	}
 }
 
 void
-vsOctree::DrawNode( int nodeId, const vsCamera3D *camera, vsRenderQueue *queue )
+vsOctree::DrawList( vsOctreeModelInfo *first, const vsFrustum &frustum, vsFrustum::Classification classification, vsRenderQueue *queue )
 {
-	vsAssert( nodeId >= 0 && nodeId < m_nodeCount, "Octree draw error" );
-	vsOctreeNode *node = &m_node[ nodeId ];
-	
-	if ( camera->IsBox3DVisible( node->m_bounds ) )
+	// If this list's node is entirely inside the frustum then so is
+	// everything in it, and we don't need to test anything.
+	if ( classification == vsFrustum::Inside )
 	{
-		// draw all our contents.
-		for( std::list<vsOctreeModelInfo*>::iterator i = node->m_infoList.begin(); i != node->m_infoList.end(); i++ )
+		for ( vsOctreeModelInfo *info = first; info; info = info->m_next )
 		{
-			vsOctreeModelInfo *info = *i;
-			
 			info->m_model->Draw(queue);
+			m_stats.modelsDrawn++;
 		}
-		
-		
-		m_nodesDrawn++;
-		
-		for ( int i = 0; i < 8; i++ )
-		{
-			if ( node->m_childId[i] > 0 )
-			{
-				DrawNode( node->m_childId[i], camera, queue );
-			}
-		}
+		return;
+	}
+	if ( !first )
+		return;
+
+	m_cullBox.Clear();
+	for ( vsOctreeModelInfo *info = first; info; info = info->m_next )
+	{
+		m_cullBox.AddItem( ModelBounds( info->m_model ) );
+	}
+	int count = m_cullBox.ItemCount();
+	m_cullResult.SetArraySize( count );
+	int visible = frustum.ClassifyBoxes( &m_cullBox[0], count, &m_cullResult[0] );
+	m_stats.modelsTested += count;
+	m_stats.modelsCulled += count - visible;
+	m_stats.modelsDrawn += visible;
+
+	int index = 0;
+	for ( vsOctreeModelInfo *info = first; info; info = info->m_next, index++ )
+	{
+		if ( m_cullResult[index] != vsFrustum::Outside )
+			info->m_model->Draw(queue);
 	}
 }
 
 void
-vsOctree::InsertInfoAtNode( vsOctreeModelInfo *info, int nodeId )
+vsOctree::DrawNode( int nodeId, const vsFrustum &frustum, vsFrustum::Classification classification, vsRenderQueue *queue )
 {
-	vsBox3D modelBounds = info->m_model->GetBoundingBox() + info->m_model->GetPosition();
-	vsAssert(nodeId >= 0 && nodeId < m_nodeCount, "Illegal octree node insertion");
-	vsOctreeNode *node = &m_node[nodeId];
-	
-	for ( int i = 0; i < 8; i++ )
+	vsAssert( nodeId >= 0 && nodeId < m_node.ItemCount(), "Octree draw error" );
+	const vsOctreeNode &node = m_node[ nodeId ];
+	m_stats.nodesVisited++;
+
+	DrawList( node.m_info, frustum, classification, queue );
+
+	if ( node.m_childCount == 0 )
+		return;
+
+	// now classify all our children in one batch.
+	vsFrustum::Classification childClassification[8];
+	if ( classification == vsFrustum::Inside )
 	{
-		if ( node->m_childId[i] > 0 )
+		for ( int i = 0; i < node.m_childCount; i++ )
+			childClassification[i] = vsFrustum::Inside;
+	}
+	else
+	{
+		frustum.ClassifyBoxes( node.m_childBounds, node.m_childCount, childClassification );
+	}
+
+	for ( int i = 0; i < node.m_childCount; i++ )
+	{
+		if ( childClassification[i] != vsFrustum::Outside )
 		{
-			vsOctreeNode *childNode = &m_node[ node->m_childId[i] ];
-			
-			if ( childNode->m_bounds.EncompassesBox( modelBounds ) )
-			{
-				InsertInfoAtNode( info, node->m_childId[i] );
-				return;
-			}
+			DrawNode( node.m_childId[i], frustum, childClassification[i], queue );
+		}
+		else
+		{
+			m_stats.nodesCulled++;
+			m_stats.modelsCulled += m_node[ node.m_childId[i] ].m_modelCount;
 		}
 	}
-	
-	info->m_nodeId = nodeId;
-	node->m_infoList.push_back(info);
 }
 
 vsOctreeModelInfo *
@@ -214,38 +387,32 @@ vsOctree::AddModel( vsModel *model )
 {
 	vsOctreeModelInfo *info = new vsOctreeModelInfo;
 	info->m_model = model;
-	
-	InsertInfoAtNode( info, 0 );
-	
+
+	InsertInfo( info );
+
 	return info;
 }
 
 void
 vsOctree::UpdateModel( vsOctreeModelInfo *info )
 {
-	vsAssert( info->m_nodeId >= 0 && info->m_nodeId < m_nodeCount, "Illegal nodeId set on octree info object??" );
-	vsOctreeNode *node = &m_node[info->m_nodeId];
-	vsBox3D modelBounds = info->m_model->GetBoundingBox() + info->m_model->GetPosition();
-	node->m_infoList.remove(info);
+	// Nothing to do unless the model has left its node's loose bounds, or
+	// shrunk enough to belong deeper.  Only then do we walk the tree.
+	vsBox3D bounds = ModelBounds( info->m_model );
+	int depth;
+	bool inPlace = ( info->m_nodeId >= 0 ) ?
+		StaysInNode( bounds, info->m_nodeId ) :
+		!FindCell( bounds, &depth );
+	if ( inPlace )
+		return;
 
-	if ( node->m_bounds.EncompassesBox( modelBounds ) )
-	{
-		InsertInfoAtNode( info, info->m_nodeId );
-	}
-	else
-	{
-		InsertInfoAtNode( info, 0 );
-	}
+	ExtractInfo( info );
+	InsertInfo( info );
 }
 
 void
 vsOctree::RemoveModel( vsOctreeModelInfo *info )
 {
-	vsAssert( info->m_nodeId >= 0 && info->m_nodeId < m_nodeCount, "Illegal nodeId set on octree info object??" );
-	vsOctreeNode *node = &m_node[info->m_nodeId];
-	
-	node->m_infoList.remove(info);
-	
+	ExtractInfo( info );
 	vsDelete(info);
 }
-
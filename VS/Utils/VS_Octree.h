@@ -12,34 +12,85 @@
 
 #include "VS/Graphics/VS_Model.h"
 #include "VS/Math/VS_Box.h"
+#include "VS/Math/VS_Frustum.h"
+#include "VS/Utils/VS_Array.h"
 
 class vsCamera3D;
 struct vsOctreeNode;
 struct vsOctreeModelInfo;
 
+// vsOctree is a loose octree of vsModels, used to frustum cull them.
+//
+// Each node's bounds are twice the size of its cell, so a model can always
+// be stored at the depth matching its size, in the cell containing its
+// center, no matter where it sits relative to cell boundaries.  That means
+// finding a model's node never needs to test boxes, and a model which moves
+// around within its node's loose bounds doesn't need to move at all;
+// UpdateModel() checks that in constant time.  Nodes are created as models
+// arrive and recycled when their subtree empties, in one flat array.  Each
+// node keeps its children's bounds packed together, so that all of a node's
+// children can be classified against the frustum in one batch.
+//
+// Models whose bounds don't fit inside the tree's area are kept in a list
+// of their own, and are tested individually.
+
 class vsOctree
 {
-	vsOctreeNode *	m_node;
-	int				m_nodeCount;
-	
-	int				m_nodesDrawn;
-	
-	int				m_nextNodeToInit;
-	
-	void			InitNode( const vsBox3D &bounds, int levelsToRecurse, int parentId );
-	void			DrawNode( int nodeId, const vsCamera3D *camera, vsRenderQueue *queue );
-	
-	void			InsertInfoAtNode( vsOctreeModelInfo *info, int nodeId );
-	
+public:
+	struct Stats
+	{
+		int nodes;			// nodes currently in the tree
+		int nodesVisited;	// nodes the last Draw() walked into
+		int nodesCulled;	// nodes the last Draw() found outside the frustum
+		int modelsTested;	// models individually tested against the frustum
+		int modelsCulled;	// models not drawn, including those in culled nodes
+		int modelsDrawn;
+
+		Stats():
+			nodes(0),
+			nodesVisited(0),
+			nodesCulled(0),
+			modelsTested(0),
+			modelsCulled(0),
+			modelsDrawn(0)
+		{
+		}
+	};
+
+private:
+	vsArray<vsOctreeNode>	m_node;		// m_node[0] is the root
+	vsArray<int>			m_freeNode;
+	vsVector3D				m_rootHalfSize;
+	int						m_levels;
+
+	vsOctreeModelInfo *		m_outside;	// models which don't fit in the tree
+	Stats					m_stats;
+
+	// scratch space for classifying a node's models in one batch
+	vsArray<vsBox3D>					m_cullBox;
+	vsArray<vsFrustum::Classification>	m_cullResult;
+
+	vsVector3D		CellHalfSize( int depth ) const;
+	int				AllocateNode( int parentId, int octant );
+	bool			FindCell( const vsBox3D &bounds, int *depth ) const;
+	bool			StaysInNode( const vsBox3D &bounds, int nodeId ) const;
+	void			InsertInfo( vsOctreeModelInfo *info );
+	void			ExtractInfo( vsOctreeModelInfo *info );
+
+	void			DrawNode( int nodeId, const vsFrustum &frustum, vsFrustum::Classification classification, vsRenderQueue *queue );
+	void			DrawList( vsOctreeModelInfo *first, const vsFrustum &frustum, vsFrustum::Classification classification, vsRenderQueue *queue );
+
 public:
 					vsOctree( const vsBox3D &area, int levels );
 					~vsOctree();
-	
+
 	vsOctreeModelInfo *	AddModel( vsModel *model );
-	void				UpdateModel( vsOctreeModelInfo *info );
+	void				UpdateModel( vsOctreeModelInfo *info );	// call when the model has moved
 	void				RemoveModel( vsOctreeModelInfo *info );
-	
+
 	void			Draw( const vsCamera3D *camera, vsRenderQueue *queue );
+
+	const Stats &	GetStats() const { return m_stats; }
 };
 
 
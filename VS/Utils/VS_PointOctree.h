@@ -14,7 +14,9 @@
 
 #include "VS/Graphics/VS_Model.h"
 #include "VS/Math/VS_Box.h"
+#include "VS/Threads/VS_ThreadPool.h"
 #include "VS/Utils/VS_Array.h"
+#include "VS/Utils/VS_RadixSort.h"
 
 class vsCamera3D;
 
@@ -23,149 +25,814 @@ struct vsPointOctreeElement
 	vsVector3D position;
 };
 
+template<typename T> class vsPointOctreeBuildJob;
+
+// vsPointOctree is a linear octree of points:  rather than a tree of nodes,
+// it stores its points sorted by their Morton codes (their positions
+// quantised to 21 bits per axis, with the bits interleaved), so that the
+// points inside any octree cell form one contiguous range of the array.
+// Queries walk the implicit tree by binary searching for each child cell's
+// range, down to cells holding no more than 'maxItemsPerNode' points, and
+// never allocate.
+//
+// Build() sorts a whole set of points at once, splitting the work across the
+// thread pool for large sets.  Points may also be added one at a time;  the
+// newest 'maxItemsPerNode' points are kept unsorted, and each time that many
+// arrive they're sorted into a new run, which is merged into the runs
+// before it whenever it grows as large as they are.  So there are never
+// more than a logarithmic number of runs to search, and each run's bounds
+// are kept so that queries can pass over runs far from them;  when points
+// are added in a spatially coherent order, as a mesh's vertices usually
+// are, most runs are.
+//
+// Each point's position is copied when it's added;  points mustn't move
+// while they're in the tree.  Points outside the tree's bounds are kept in
+// a list of their own and tested individually.
+
 template<typename T>
 class vsPointOctree
 {
-	struct Node
+	static const int c_bits = 21;	// per axis
+	static const int c_minPointsPerBuildJob = 16 * 1024;
+	static const int c_maxBuildJobs = 32;
+	static const int c_buildSortShift = 15;	// see SortChunk()
+
+	struct Entry
+	{
+		vsVector3D	position;
+		T *			point;
+	};
+
+	vsVector3D		m_min;
+	float			m_scale;		// quantised units per world unit
+	float			m_quantum;		// world units per quantised unit
+	int				m_maxItemsPerNode;
+
+	vsArray<uint64_t>	m_code;			// sorted runs, largest first
+	vsArray<Entry>		m_entry;		// the points with those codes
+	vsArray<int>		m_runStart;		// index of each run's first entry
+	vsArray<vsBox3D>	m_runBounds;	// bounds of each run's points
+	vsArray<Entry>		m_pending;		// newest points, not yet sorted
+	vsArray<Entry>		m_outside;		// points outside our bounds
+	vsArray<uint64_t>	m_scratchCode;
+	vsArray<Entry>		m_scratch;
+
+	// used while building, along with m_scratch and m_scratchCode
+	vsArray<vsSortItem>	m_sortItem;
+	vsArray<vsSortItem>	m_sortScratch;
+
+	friend class vsPointOctreeBuildJob<T>;
+
+	static uint64_t Spread( uint64_t x )
+	{
+		x &= 0x1fffff;
+		x = (x | x << 32) & 0x1f00000000ffffULL;
+		x = (x | x << 16) & 0x1f0000ff0000ffULL;
+		x = (x | x << 8) & 0x100f00f00f00f00fULL;
+		x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+		x = (x | x << 2) & 0x1249249249249249ULL;
+		return x;
+	}
+
+	bool IsInside( const vsVector3D &p ) const
+	{
+		vsVector3D max = m_min + vsVector3D(1.f, 1.f, 1.f) * ((1 << c_bits) * m_quantum);
+		return ( p.x >= m_min.x && p.y >= m_min.y && p.z >= m_min.z &&
+				p.x < max.x && p.y < max.y && p.z < max.z );
+	}
+
+	uint64_t Quantise( float v, float min ) const
+	{
+		float q = (v - min) * m_scale;
+		return (uint64_t)vsClamp( q, 0.f, (float)((1 << c_bits) - 1) );
+	}
+
+	static uint64_t Interleave( uint64_t x, uint64_t y, uint64_t z )
+	{
+		return Spread( x ) | ( Spread( y ) << 1 ) | ( Spread( z ) << 2 );
+	}
+
+	uint64_t Code( const vsVector3D &p ) const
+	{
+		return Interleave( Quantise(p.x, m_min.x), Quantise(p.y, m_min.y), Quantise(p.z, m_min.z) );
+	}
+
+	Entry MakeEntry( T *point ) const
+	{
+		Entry e;
+		e.position = point->position;
+		e.point = point;
+		return e;
+	}
+
+	static uint64_t Compact( uint64_t x )
+	{
+		x &= 0x1249249249249249ULL;
+		x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3ULL;
+		x = (x ^ (x >> 4)) & 0x100f00f00f00f00fULL;
+		x = (x ^ (x >> 8)) & 0x1f0000ff0000ffULL;
+		x = (x ^ (x >> 16)) & 0x1f00000000ffffULL;
+		x = (x ^ (x >> 32)) & 0x1fffff;
+		return x;
+	}
+
+	// The smallest octree cell holding every entry in [lo,hi), found from
+	// the leading bits that the first and last codes have in common.  Cells
+	// with only one occupied child are skipped over this way, so queries
+	// only ever visit cells where the points actually divide.
+	struct Cell
+	{
+		int			lo;
+		int			hi;
+		int			level;		// 0 is the root, c_bits a single quantum
+		uint64_t	prefix;		// the code's top 3*level bits
+		int			min[3];		// in quanta
+		int			size;
+	};
+
+	void MakeCell( int lo, int hi, Cell *cell ) const
+	{
+		uint64_t first = m_code[lo];
+		uint64_t diff = first ^ m_code[hi-1];
+		int level = c_bits;
+		while ( diff )
+		{
+			diff >>= 3;
+			level--;
+		}
+		cell->lo = lo;
+		cell->hi = hi;
+		cell->level = level;
+		cell->prefix = first >> (3 * (c_bits - level));
+		cell->size = 1 << (c_bits - level);
+		for ( int a = 0; a < 3; a++ )
+			cell->min[a] = (int)Compact( first >> a ) & ~(cell->size - 1);
+	}
+
+	// squared distance from 'p' to a cell, padded by a quantum on each side
+	// so that rounding during quantisation can't hide a point from us.
+	float CellSqDistance( const Cell &cell, const vsVector3D &p ) const
+	{
+		float d = 0.f;
+		const float pos[3] = { p.x, p.y, p.z };
+		const float min[3] = { m_min.x, m_min.y, m_min.z };
+		for ( int a = 0; a < 3; a++ )
+		{
+			float lo = min[a] + (cell.min[a] - 1) * m_quantum;
+			float hi = min[a] + (cell.min[a] + cell.size + 1) * m_quantum;
+			float delta = ( pos[a] < lo ) ? lo - pos[a] : ( pos[a] > hi ) ? pos[a] - hi : 0.f;
+			d += delta * delta;
+		}
+		return d;
+	}
+
+	// does a cell, padded as above, overlap 'box'?
+	bool CellTouches( const Cell &cell, const vsBox3D &box ) const
+	{
+		vsVector3D lo = m_min + vsVector3D( (float)cell.min[0] - 1.f, (float)cell.min[1] - 1.f, (float)cell.min[2] - 1.f ) * m_quantum;
+		vsVector3D hi = lo + vsVector3D(1.f, 1.f, 1.f) * ((cell.size + 2) * m_quantum);
+		return ( lo.x <= box.GetMax().x && lo.y <= box.GetMax().y && lo.z <= box.GetMax().z &&
+				hi.x >= box.GetMin().x && hi.y >= box.GetMin().y && hi.z >= box.GetMin().z );
+	}
+
+	bool IsLeaf( const Cell &cell ) const
+	{
+		return ( cell.hi - cell.lo <= m_maxItemsPerNode || cell.level == c_bits );
+	}
+
+	// first entry in [lo,hi) with a code no less than 'code'.  Written to
+	// compile without branches, since which way each step goes is
+	// unpredictable.
+	int LowerBound( int lo, int hi, uint64_t code ) const
+	{
+		if ( lo >= hi )
+			return lo;
+		const uint64_t *base = &m_code[lo];
+		int count = hi - lo;
+		while ( count > 1 )
+		{
+			int half = count / 2;
+			base = ( base[half] < code ) ? base + half : base;
+			count -= half;
+		}
+		return (int)(base - &m_code[0]) + ( *base < code );
+	}
+
+	// as LowerBound(), for when the answer is probably close to 'lo'.
+	int GallopBound( int lo, int hi, uint64_t code ) const
+	{
+		int step = 1;
+		while ( lo + step < hi && m_code[lo + step] < code )
+		{
+			lo += step;
+			step *= 2;
+		}
+		return LowerBound( lo, vsMin( lo + step, hi ), code );
+	}
+
+	// the range of entries in [cell.lo,cell.hi) lying in child 'c' of 'cell'.
+	void ChildRange( const Cell &cell, int c, int *lo, int *hi ) const
 	{
-		vsBox3D		bounds;
-		vsVector3D	middle;
-		Node*		child[8];
-		vsArray<T*> contents;
-		bool		leaf;
+		int shift = 3 * (c_bits - cell.level - 1);
+		*lo = ( c == 0 ) ? cell.lo : LowerBound( cell.lo, cell.hi, (cell.prefix * 8 + c) << shift );
+		*hi = ( c == 7 ) ? cell.hi : GallopBound( *lo, cell.hi, (cell.prefix * 8 + c + 1) << shift );
+	}
+
+	// the full extent of child 'c' of 'cell', whether or not it's occupied.
+	void ChildBounds( const Cell &cell, int c, Cell *child ) const
+	{
+		child->size = cell.size >> 1;
+		for ( int a = 0; a < 3; a++ )
+			child->min[a] = cell.min[a] + ( (c & (1 << a)) ? child->size : 0 );
+	}
+
+	void FindWithinIn( const Entry *entry, int count, vsArray<T*> *result, const vsVector3D &position, float sqDistance ) const
+	{
+		for ( int i = 0; i < count; i++ )
+		{
+			if ( ( entry[i].position - position ).SqLength() < sqDistance )
+				result->AddItem( entry[i].point );
+		}
+	}
+
+	void FindWithin( const Cell &cell, vsArray<T*> *result, const vsVector3D &position, float sqDistance ) const
+	{
+		if ( CellSqDistance( cell, position ) >= sqDistance )
+			return;
+
+		if ( IsLeaf( cell ) )
+		{
+			FindWithinIn( &m_entry[cell.lo], cell.hi - cell.lo, result, position, sqDistance );
+			return;
+		}
 
-		Node( const vsBox3D &bounds ):
-			bounds(bounds),
-			middle(bounds.Middle()),
-			contents(),
-			leaf(true)
+		// test the children's full cells first;  most of them will miss, and
+		// we needn't search for their entries at all.
+		for ( int c = 0; c < 8; c++ )
 		{
-			for ( int i = 0; i < 8; i++ )
+			Cell child;
+			ChildBounds( cell, c, &child );
+			if ( CellSqDistance( child, position ) >= sqDistance )
+				continue;
+
+			int lo, hi;
+			ChildRange( cell, c, &lo, &hi );
+			if ( lo < hi )
 			{
-				child[i] = NULL;
+				MakeCell( lo, hi, &child );
+				FindWithin( child, result, position, sqDistance );
 			}
 		}
+	}
+
+	// k-nearest search state.  'point' and 'sqDistance' are the caller's
+	// arrays, kept as a max-heap on 'sqDistance' while searching.
+	struct Nearest
+	{
+		vsVector3D	position;
+		int			k;
+		int			count;
+		float		maxSqDistance;
+		T **		point;
+		float *		sqDistance;
 
-		~Node()
+		float Bound() const { return ( count < k ) ? maxSqDistance : sqDistance[0]; }
+
+		void Offer( T *p, float d )
 		{
-			for ( int i = 0; i < 8; i++ )
+			if ( d >= Bound() )
+				return;
+			int i;
+			if ( count < k )
+			{
+				// sift up from the end
+				i = count++;
+				while ( i > 0 && sqDistance[(i-1)/2] < d )
+				{
+					sqDistance[i] = sqDistance[(i-1)/2];
+					point[i] = point[(i-1)/2];
+					i = (i-1)/2;
+				}
+			}
+			else
 			{
-				vsDelete(child[i]);
+				// replace the farthest, and sift down
+				i = 0;
+				while ( true )
+				{
+					int child = i*2 + 1;
+					if ( child >= count )
+						break;
+					if ( child+1 < count && sqDistance[child+1] > sqDistance[child] )
+						child++;
+					if ( sqDistance[child] <= d )
+						break;
+					sqDistance[i] = sqDistance[child];
+					point[i] = point[child];
+					i = child;
+				}
 			}
+			sqDistance[i] = d;
+			point[i] = p;
 		}
 	};
 
-	Node 		m_node;
-	int			m_maxRecursion;
-	int			m_maxItemsPerNode;
+	void FindNearestIn( const Entry *entry, int count, Nearest &n ) const
+	{
+		for ( int i = 0; i < count; i++ )
+			n.Offer( entry[i].point, ( entry[i].position - n.position ).SqLength() );
+	}
 
-	void RecursiveAddPoint( int recursionLevel, T* point, Node* node )
+	void FindNearest( const Cell &cell, Nearest &n ) const
 	{
-		if ( node->leaf )
+		if ( IsLeaf( cell ) )
+		{
+			FindNearestIn( &m_entry[cell.lo], cell.hi - cell.lo, n );
+			return;
+		}
+
+		// visit the children nearest first, so that the later ones are more
+		// likely to be pruned.
+		int order[8];
+		float distance[8];
+		int childCount = 0;
+		for ( int c = 0; c < 8; c++ )
 		{
-			if ( recursionLevel >= m_maxRecursion || node->contents.ItemCount() < m_maxItemsPerNode )
+			Cell child;
+			ChildBounds( cell, c, &child );
+			float d = CellSqDistance( child, n.position );
+			if ( d >= n.Bound() )
+				continue;
+			int j = childCount++;
+			while ( j > 0 && distance[j-1] > d )
 			{
-				node->contents.AddItem( point );
-				return;
+				distance[j] = distance[j-1];
+				order[j] = order[j-1];
+				j--;
 			}
-			else
+			distance[j] = d;
+			order[j] = c;
+		}
+		for ( int i = 0; i < childCount; i++ )
+		{
+			if ( distance[i] >= n.Bound() )
+				break;
+			int lo, hi;
+			ChildRange( cell, order[i], &lo, &hi );
+			if ( lo < hi )
 			{
-				// too many items in this node.  Subdivide!
+				Cell child;
+				MakeCell( lo, hi, &child );
+				if ( CellSqDistance( child, n.position ) < n.Bound() )
+					FindNearest( child, n );
+			}
+		}
+	}
+
+	int RunEnd( int run ) const
+	{
+		return ( run+1 < m_runStart.ItemCount() ) ? m_runStart[run+1] : m_entry.ItemCount();
+	}
+
+	// merge the entries in [a,b) and [b,c), which are each sorted.
+	void Merge( int a, int b, int c )
+	{
+		m_scratchCode.SetArraySize( c - a );
+		m_scratch.SetArraySize( c - a );
+		uint64_t *code = &m_code[0];
+		Entry *entry = &m_entry[0];
+		uint64_t *outCode = &m_scratchCode[0];
+		Entry *out = &m_scratch[0];
+		int i = a, j = b;
+		while ( i < b && j < c )
+		{
+			int from = ( code[j] < code[i] ) ? j++ : i++;
+			*outCode++ = code[from];
+			*out++ = entry[from];
+		}
+		for ( ; i < b; i++ )
+		{
+			*outCode++ = code[i];
+			*out++ = entry[i];
+		}
+		for ( ; j < c; j++ )
+		{
+			*outCode++ = code[j];
+			*out++ = entry[j];
+		}
+		for ( int o = 0; o < c - a; o++ )
+		{
+			code[a + o] = m_scratchCode[o];
+			entry[a + o] = m_scratch[o];
+		}
+	}
 
-				Subdivide( node );
+	void FlushPending()
+	{
+		// append the pending points as a new run, and insertion sort it;
+		// there are never more than m_maxItemsPerNode of these.
+		int start = m_entry.ItemCount();
+		vsBox3D bounds;
+		m_runStart.AddItem( start );
+		for ( int i = 0; i < m_pending.ItemCount(); i++ )
+		{
+			m_code.AddItem( Code( m_pending[i].position ) );
+			m_entry.AddItem( m_pending[i] );
+			bounds.ExpandToInclude( m_pending[i].position );
+		}
+		m_runBounds.AddItem( bounds );
+		m_pending.Clear();
+		for ( int i = start + 1; i < m_entry.ItemCount(); i++ )
+		{
+			uint64_t code = m_code[i];
+			Entry e = m_entry[i];
+			int j = i;
+			while ( j > start && m_code[j-1] > code )
+			{
+				m_code[j] = m_code[j-1];
+				m_entry[j] = m_entry[j-1];
+				j--;
 			}
+			m_code[j] = code;
+			m_entry[j] = e;
+		}
+
+		// keep each run larger than the ones after it.
+		int runs = m_runStart.ItemCount();
+		while ( runs >= 2 && RunEnd(runs-1) - m_runStart[runs-1] >= m_runStart[runs-1] - m_runStart[runs-2] )
+		{
+			Merge( m_runStart[runs-2], m_runStart[runs-1], m_entry.ItemCount() );
+			m_runBounds[runs-2].ExpandToInclude( m_runBounds[runs-1] );
+			m_runStart.PopBack();
+			m_runBounds.PopBack();
+			runs--;
+		}
+	}
+
+	// Computes and sorts the codes for build points [start,end), which
+	// are waiting in m_scratch.  Only each code's top 48 bits are sorted on,
+	// which saves two radix passes;  points rarely share those, and Build()
+	// puts right any which do.
+	void SortChunk( int start, int end )
+	{
+		for ( int i = start; i < end; i++ )
+		{
+			m_scratchCode[i] = Code( m_scratch[i].position );
+			m_sortItem[i].key = m_scratchCode[i] >> c_buildSortShift;
+			m_sortItem[i].index = i;
 		}
+		vsRadixSort( &m_sortItem[start], &m_sortScratch[start], end - start );
+	}
+
+public:
+	vsPointOctree( const vsBox3D &bounds, int maxItemsPerNode ):
+		m_maxItemsPerNode( vsMax(1, maxItemsPerNode) )
+	{
+		// quantise over a cube covering the bounds.
+		vsVector3D extents = bounds.Extents();
+		float size = vsMax( extents.x, vsMax( extents.y, extents.z ) );
+		if ( size <= 0.f )
+			size = 1.f;
+		m_min = bounds.GetMin();
+		m_scale = (1 << c_bits) / size;
+		m_quantum = size / (1 << c_bits);
+	}
+	~vsPointOctree()
+	{
+	}
 
-		vsAssert( !node->leaf, "PointOctree error" );
-		int octant = PickOctant( point->position, node );
+	void Clear()
+	{
+		m_code.Clear();
+		m_entry.Clear();
+		m_runStart.Clear();
+		m_runBounds.Clear();
+		m_pending.Clear();
+		m_outside.Clear();
+	}
 
-		RecursiveAddPoint( recursionLevel + 1, point, node->child[octant] );
+	int GetPointCount() const
+	{
+		return m_entry.ItemCount() + m_pending.ItemCount() + m_outside.ItemCount();
 	}
 
-	void RecursiveFindPointsWithin( Node *node, vsArray<T*> *result, const vsVector3D &position, float distance )
+	void AddPoint( T *point )
 	{
-		if ( node->leaf )
+		if ( !IsInside( point->position ) )
 		{
-			float sqDistance = distance * distance;
-			for (int i = 0; i < node->contents.ItemCount(); ++i)
+			m_outside.AddItem( MakeEntry( point ) );
+			return;
+		}
+		m_pending.AddItem( MakeEntry( point ) );
+		if ( m_pending.ItemCount() >= m_maxItemsPerNode )
+			FlushPending();
+	}
+
+	// Replaces our contents with 'count' points, sorted in one go.
+	// 'threadCount' limits how many threads may share the work, counting
+	// the calling thread;  0 means the calling thread plus every worker
+	// sharing its L3 cache.  Threaded builds must be started from the main
+	// thread.
+	void Build( T **point, int count, int threadCount = 0 );
+
+	// Finds every point closer than 'distance' to 'position', adding them
+	// to 'result'.
+	void FindPointsWithin( vsArray<T*> *result, const vsVector3D &position, float distance ) const
+	{
+		float sqDistance = distance * distance;
+
+		// Every point we could find lies in one of the (at most eight)
+		// cells which the query's bounding box overlaps, at a level where
+		// cells are at least twice the box's size;  using cells that large
+		// means the box usually only overlaps two or three of them.  Visit
+		// each of those in Morton order, and in each run jump straight to
+		// their entries.
+		float reach = distance + m_quantum;
+		int min[3], max[3];
+		const float pos[3] = { position.x, position.y, position.z };
+		const float origin[3] = { m_min.x, m_min.y, m_min.z };
+		int extent = 0;
+		for ( int a = 0; a < 3; a++ )
+		{
+			min[a] = (int)Quantise( pos[a] - reach, origin[a] );
+			max[a] = (int)Quantise( pos[a] + reach, origin[a] );
+			extent = vsMax( extent, max[a] - min[a] );
+		}
+		int sizeBits = 1;
+		while ( (1 << sizeBits) <= extent * 2 && sizeBits < c_bits )
+			sizeBits++;
+
+		Cell cell[8];
+		int cellCount = 0;
+		for ( int c = 0; c < 8; c++ )
+		{
+			Cell &query = cell[cellCount];
+			query.level = c_bits - sizeBits;
+			query.size = 1 << sizeBits;
+			bool duplicate = false;
+			for ( int a = 0; a < 3; a++ )
 			{
-				if ( ( node->contents[i]->position - position ).SqLength() < sqDistance )
-				{
-					result->AddItem( node->contents[i] );
-				}
+				int bound = ( c & (1 << a) ) ? max[a] : min[a];
+				query.min[a] = ( bound >> sizeBits ) << sizeBits;
+				duplicate |= ( (c & (1 << a)) && ( (min[a] >> sizeBits) == (max[a] >> sizeBits) ) );
 			}
+			if ( duplicate || CellSqDistance( query, position ) >= sqDistance )
+				continue;
+			query.prefix = Interleave( query.min[0], query.min[1], query.min[2] ) >> (3 * sizeBits);
+			cellCount++;
 		}
-		else
+		for ( int i = 1; i < cellCount; i++ )
 		{
-			vsAssert( node->contents.ItemCount() == 0, "PointOctree error?" );
+			Cell query = cell[i];
+			int j = i;
+			while ( j > 0 && cell[j-1].prefix > query.prefix )
+			{
+				cell[j] = cell[j-1];
+				j--;
+			}
+			cell[j] = query;
+		}
 
-			for (size_t i = 0; i < 8; ++i)
+		uint64_t cellCodes = 1ULL << (3 * sizeBits);
+		for ( int run = 0; run < m_runStart.ItemCount(); run++ )
+		{
+			if ( m_runBounds[run].SqDistanceFrom( position ) >= sqDistance )
+				continue;
+			int start = m_runStart[run];
+			int end = RunEnd(run);
+			for ( int i = 0; i < cellCount && start < end; i++ )
 			{
-				if ( node->child[i]->bounds.IntersectsSphere(position, distance) )
+				uint64_t lowCode = cell[i].prefix << (3 * sizeBits);
+				if ( m_code[end-1] < lowCode )
+					break;
+				if ( !CellTouches( cell[i], m_runBounds[run] ) )
+					continue;
+				int lo = LowerBound( start, end, lowCode );
+				int hi = GallopBound( lo, end, lowCode + cellCodes );
+				if ( lo < hi )
 				{
-					RecursiveFindPointsWithin( node->child[i], result, position, distance );
+					Cell found;
+					MakeCell( lo, hi, &found );
+					FindWithin( found, result, position, sqDistance );
 				}
+				start = hi;
 			}
 		}
+		if ( !m_pending.IsEmpty() )
+			FindWithinIn( &m_pending[0], m_pending.ItemCount(), result, position, sqDistance );
+		if ( !m_outside.IsEmpty() )
+			FindWithinIn( &m_outside[0], m_outside.ItemCount(), result, position, sqDistance );
 	}
 
-	void Subdivide( Node* node )
+	// Finds the 'k' points nearest to 'position' and closer than
+	// 'maxDistance', writing them into 'result' and their squared distances
+	// into 'sqDistance' (both of which must have room for 'k' items),
+	// nearest first.  Returns how many were found.
+	int FindNearest( const vsVector3D &position, int k, T **result, float *sqDistance, float maxDistance = 1e18f ) const
 	{
-		node->leaf = false;
-		for ( int i = 0; i < 8; i++ )
+		if ( k <= 0 )
+			return 0;
+		Nearest n;
+		n.position = position;
+		n.k = k;
+		n.count = 0;
+		n.maxSqDistance = maxDistance * maxDistance;
+		n.point = result;
+		n.sqDistance = sqDistance;
+
+		if ( !m_pending.IsEmpty() )
+			FindNearestIn( &m_pending[0], m_pending.ItemCount(), n );
+		if ( !m_outside.IsEmpty() )
+			FindNearestIn( &m_outside[0], m_outside.ItemCount(), n );
+
+		// Points next to 'position' in Morton order are usually near it in
+		// space too, so the farthest of the k beside it in the largest run
+		// gives a good bound to prune the search with before it starts.
+		// That bound is inflated slightly since we only accept points
+		// strictly closer than it.
+		if ( !m_runStart.IsEmpty() && RunEnd(0) >= k )
+		{
+			int start = LowerBound( 0, RunEnd(0), Code( position ) );
+			start = vsClamp( start - k/2, 0, RunEnd(0) - k );
+			float farthest = 0.f;
+			for ( int i = start; i < start + k; i++ )
+				farthest = vsMax( farthest, ( m_entry[i].position - position ).SqLength() );
+			n.maxSqDistance = vsMin( n.maxSqDistance, farthest * 1.0001f + 1e-30f );
+		}
+
+		for ( int run = 0; run < m_runStart.ItemCount(); run++ )
 		{
-			vsVector3D corner = node->bounds.Corner(i);
-			vsBox3D box;
-			box.ExpandToInclude(corner);
-			box.ExpandToInclude(node->middle);
-			int octant = PickOctant( corner, node );
-			node->child[octant] = new Node( box );
+			if ( m_runBounds[run].SqDistanceFrom( position ) >= n.Bound() )
+				continue;
+			Cell cell;
+			MakeCell( m_runStart[run], RunEnd(run), &cell );
+			if ( CellSqDistance( cell, position ) < n.Bound() )
+				FindNearest( cell, n );
 		}
 
-		for( int i = 0; i < node->contents.ItemCount(); i++ )
+		// heap sort, to put the nearest first.
+		for ( int end = n.count - 1; end > 0; end-- )
 		{
-			RecursiveAddPoint( 0, node->contents.GetItem(i), node );
+			T *p = result[end];
+			float d = sqDistance[end];
+			result[end] = result[0];
+			sqDistance[end] = sqDistance[0];
+			int i = 0;
+			while ( true )
+			{
+				int child = i*2 + 1;
+				if ( child >= end )
+					break;
+				if ( child+1 < end && sqDistance[child+1] > sqDistance[child] )
+					child++;
+				if ( sqDistance[child] <= d )
+					break;
+				sqDistance[i] = sqDistance[child];
+				result[i] = result[child];
+				i = child;
+			}
+			sqDistance[i] = d;
+			result[i] = p;
 		}
-		node->contents.Clear();
+		return n.count;
 	}
-	
-	int PickOctant( const vsVector3D &position, Node* node )
-	{
-		vsAssert( !node->leaf, "PointOctree error" );
+};
 
-		vsVector3D delta = node->middle - position;
-		int octant = 0;
-		if (delta.x < 0.f)
-			octant |= 0x1;
-		if (delta.y < 0.f)
-			octant |= 0x2;
-		if (delta.z < 0.f)
-			octant |= 0x4;
+// One contiguous run of a Build(), coded and sorted on a thread pool
+// worker.  The caller has usually just made the points, so we keep these
+// within the main thread's L3 cache.
+template<typename T>
+class vsPointOctreeBuildJob : public vsJob
+{
+	vsPointOctree<T> *	m_tree;
+	int					m_start;
+	int					m_end;
 
-		return octant;
+protected:
+	virtual void Execute()
+	{
+		m_tree->SortChunk( m_start, m_end );
 	}
 
 public:
-	vsPointOctree( const vsBox3D &bounds, int maxItemsPerNode ):
-		m_node( bounds ),
-		m_maxRecursion(10),
-		m_maxItemsPerNode( maxItemsPerNode )
+	vsPointOctreeBuildJob():
+		m_tree(NULL),
+		m_start(0),
+		m_end(0)
 	{
 	}
-	~vsPointOctree()
+
+	void Sort( vsPointOctree<T> *tree, int start, int end )
 	{
+		m_tree = tree;
+		m_start = start;
+		m_end = end;
+		vsThreadPool::Instance()->Submit( this, vsThreadPool::Affinity_MainThreadL3 );
 	}
+};
 
-	void AddPoint( T *point )
+template<typename T>
+void
+vsPointOctree<T>::Build( T **point, int count, int threadCount )
+{
+	Clear();
+
+	// Copy out the points to sort, so that later we can gather them into
+	// order from one array rather than chasing pointers.  Points outside
+	// our bounds don't take part in the sort.
+	m_scratch.Reserve( count );
+	m_scratch.Clear();
+	for ( int i = 0; i < count; i++ )
 	{
-		RecursiveAddPoint( 0, point, &m_node );
+		if ( IsInside( point[i]->position ) )
+			m_scratch.AddItem( MakeEntry( point[i] ) );
+		else
+			m_outside.AddItem( MakeEntry( point[i] ) );
 	}
+	count = m_scratch.ItemCount();
+	if ( count == 0 )
+		return;
 
-	void FindPointsWithin( vsArray<T*> *result, const vsVector3D &position, float distance )
+	m_scratchCode.Reserve( count );
+	m_scratchCode.SetArraySize( count );
+	m_sortItem.Reserve( count );
+	m_sortItem.SetArraySize( count );
+	m_sortScratch.Reserve( count );
+	m_sortScratch.SetArraySize( count );
+
+	int runCount = 1;
+	if ( threadCount != 1 && count >= 2 * c_minPointsPerBuildJob )
 	{
-		RecursiveFindPointsWithin( &m_node, result, position, distance );
+		int available = vsThreadPool::Instance()->GetWorkerCount( vsThreadPool::Affinity_MainThreadL3 ) + 1;
+		if ( threadCount <= 0 || threadCount > available )
+			threadCount = available;
+		runCount = vsMin( vsMin( threadCount, c_maxBuildJobs ), count / c_minPointsPerBuildJob );
 	}
-};
 
-#endif /* VS_POINTOCTREE_H */
+	// code and sort contiguous runs in parallel;  the calling thread does
+	// the first one itself.
+	vsPointOctreeBuildJob<T> job[c_maxBuildJobs];
+	int runStart[c_maxBuildJobs + 1];
+	for ( int i = 0; i <= runCount; i++ )
+		runStart[i] = (int)(((int64_t)count * i) / runCount);
+	for ( int i = 1; i < runCount; i++ )
+		job[i-1].Sort( this, runStart[i], runStart[i+1] );
+	SortChunk( runStart[0], runStart[1] );
+	for ( int i = 1; i < runCount; i++ )
+		job[i-1].Wait();
 
+	// then merge the sorted runs pairwise, ping-ponging between our two
+	// sort arrays.
+	vsSortItem *from = &m_sortItem[0];
+	vsSortItem *to = &m_sortScratch[0];
+	while ( runCount > 1 )
+	{
+		int merged = 0;
+		for ( int r = 0; r < runCount; r += 2 )
+		{
+			int a = runStart[r];
+			int b = runStart[ vsMin(r+1, runCount) ];
+			int c = runStart[ vsMin(r+2, runCount) ];
+			int i = a, j = b, o = a;
+			while ( i < b && j < c )
+				to[o++] = ( from[j].key < from[i].key ) ? from[j++] : from[i++];
+			while ( i < b )
+				to[o++] = from[i++];
+			while ( j < c )
+				to[o++] = from[j++];
+			runStart[merged++] = a;
+		}
+		runStart[merged] = count;
+		runCount = merged;
+		vsSortItem *swap = from;
+		from = to;
+		to = swap;
+	}
+
+	// gather the sorted points, finishing the sort on the codes' low bits
+	// among any points which tied on their high ones.
+	vsBox3D bounds;
+	m_code.Reserve( count );
+	m_code.SetArraySize( count );
+	m_entry.Reserve( count );
+	m_entry.SetArraySize( count );
+	for ( int i = 0; i < count; i++ )
+	{
+		const Entry &e = m_scratch[ from[i].index ];
+		uint64_t code = m_scratchCode[ from[i].index ];
+		bounds.ExpandToInclude( e.position );
+		int j = i;
+		while ( j > 0 && m_code[j-1] > code )
+		{
+			m_code[j] = m_code[j-1];
+			m_entry[j] = m_entry[j-1];
+			j--;
+		}
+		m_code[j] = code;
+		m_entry[j] = e;
+	}
+	m_runStart.AddItem( 0 );
+	m_runBounds.AddItem( bounds );
+}
+
+#endif /* VS_POINTOCTREE_H */
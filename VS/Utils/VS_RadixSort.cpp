@@ -0,0 +1,58 @@
+/*
+ *  VS_RadixSort.cpp
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+#include "VS_RadixSort.h"
+
+void vsRadixSort( vsSortItem *items, vsSortItem *scratch, int count )
+{
+	if ( count < 2 )
+		return;
+
+	// build all eight histograms in one pass over the data.
+	int histogram[8][256];
+	memset( histogram, 0, sizeof(histogram) );
+	for ( int i = 0; i < count; i++ )
+	{
+		uint64_t key = items[i].key;
+		for ( int b = 0; b < 8; b++ )
+			histogram[b][ (key >> (b*8)) & 0xff ]++;
+	}
+
+	vsSortItem *from = items;
+	vsSortItem *to = scratch;
+	for ( int b = 0; b < 8; b++ )
+	{
+		int *h = histogram[b];
+
+		// if every key has the same value in this byte, this pass wouldn't
+		// change anything.
+		if ( h[ (from[0].key >> (b*8)) & 0xff ] == count )
+			continue;
+
+		int offset = 0;
+		for ( int i = 0; i < 256; i++ )
+		{
+			int n = h[i];
+			h[i] = offset;
+			offset += n;
+		}
+		for ( int i = 0; i < count; i++ )
+		{
+			int digit = (from[i].key >> (b*8)) & 0xff;
+			to[ h[digit]++ ] = from[i];
+		}
+
+		vsSortItem *swap = from;
+		from = to;
+		to = swap;
+	}
+
+	if ( from != items )
+		memcpy( items, from, sizeof(vsSortItem) * count );
+}
@@ -0,0 +1,26 @@
+/*
+ *  VS_RadixSort.h
+ *  VectorStorm
+ *
+ *  Created by Trevor Powell on 19/10/2026
+ *  Copyright 2026 Trevor Powell.  All rights reserved.
+ *
+ */
+
+#ifndef VS_RADIXSORT_H
+#define VS_RADIXSORT_H
+
+// A sort key, along with the index of the thing it's a key for.
+struct vsSortItem
+{
+	uint64_t	key;
+	uint32_t	index;
+};
+
+// Stable LSD radix sort of 'count' items by key, in ascending order.
+// 'scratch' must have room for 'count' items.  Byte positions in which every
+// key is the same are skipped, so sorting keys which only use a few of their
+// bits is cheap.  The result ends up back in 'items'.
+void vsRadixSort( vsSortItem *items, vsSortItem *scratch, int count );
+
+#endif // VS_RADIXSORT_H
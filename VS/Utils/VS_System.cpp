@@ -21,6 +21,7 @@
 #include "VS_TextureManager.h"
 #include "VS_FileCache.h"
 #include "VS_ShaderCache.h"
+#include "VS_ThreadPool.h"
 
 #include "VS_OpenGL.h"
 #include "Core.h"
@@ -123,6 +124,7 @@ vsSystem::vsSystem(const vsString& companyName, const vsString& title, int argc,
 	m_visible( false ),
 	m_exitGameKeyEnabled( true ),
 	m_exitApplicationKeyEnabled( true ),
+	m_headless( false ),
 	m_minBuffers(minBuffers),
 	m_orientation( Orientation_Normal ),
 	m_title( title ),
@@ -142,6 +144,12 @@ vsSystem::vsSystem(const vsString& companyName, const vsString& title, int argc,
 
 	vsLog("VectorStorm engine version %s",VS_VERSION);
 
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( vsString(argv[i]) == "--headless" )
+			m_headless = true;
+	}
+
 	vsFileCache::Startup();
 	vsShaderCache::Startup();
 	InitPhysFS( argc, argv, companyName, title );
@@ -151,6 +159,11 @@ vsSystem::vsSystem(const vsString& companyName, const vsString& title, int argc,
 
 #if !TARGET_OS_IPHONE
 
+	// Headless runs still want SDL's event loop and timers, just not a real
+	// window;  SDL's dummy video driver gives us exactly that.
+	if ( m_headless )
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+
 	if ( SDL_Init(SDL_INIT_VIDEO) < 0 ){
 		fprintf(stderr, "Couldn't initialise SDL: %s\n", SDL_GetError() );
 		exit(1);
@@ -184,6 +197,7 @@ vsSystem::~vsSystem()
 	vsDelete( m_preferences );
 	vsDelete( m_screen );
 
+	vsThreadPool::Shutdown();
 	delete vsSingletonManager::Instance();
 
 	DeinitPhysFS();
@@ -247,7 +261,7 @@ vsSystem::Init()
 		else
 			wt = vsRenderer::WindowType_Fullscreen;
 	}
-	m_screen = new vsScreen( width, height, 32, wt, vsMax(m_minBuffers, m_preferences->GetBloom() ? 2 : 1), m_preferences->GetVSync(), m_preferences->GetAntialias(), m_preferences->GetHighDPI() );
+	m_screen = new vsScreen( width, height, 32, wt, vsMax(m_minBuffers, m_preferences->GetBloom() ? 2 : 1), m_preferences->GetVSync(), m_preferences->GetAntialias(), m_preferences->GetHighDPI(), m_headless );
 #endif
 	LogSystemDetails();
 
@@ -842,6 +856,7 @@ vsSystem::LogSystemDetails()
 {
 	vsLog("CPU:  %s", CPUDescription().c_str());
 	vsLog("Number of hardware cores:  %d", GetNumberOfCores());
+	vsCpuTopology::Instance().Log();
 }
 
 Resolution *
@@ -70,6 +70,7 @@ class vsSystem
 	bool				m_visible;
 	bool				m_exitGameKeyEnabled;
 	bool				m_exitApplicationKeyEnabled;
+	bool				m_headless;	// '--headless':  no window, no GL;  see vsRenderer_Null
 	int					m_minBuffers; // how many color buffers on our main render target?
 
 	SDL_Cursor *		m_cursor[CursorStyle_MAX];
@@ -126,6 +127,8 @@ public:
 	void	SetCursorStyle(CursorStyle style);
 
 	void	SetWindowCaption(const vsString &caption);
+	bool	IsHeadless() const { return m_headless; }
+
 	bool	AppHasFocus() { return m_focused; }
 	void	SetAppHasFocus( bool focus ) { m_focused = focus; }
 	bool	AppIsVisible() { return m_visible; }
@@ -58,11 +58,13 @@
 #include <VS/Graphics/VS_Camera.h>
 #include <VS/Graphics/VS_Color.h>
 #include <VS/Graphics/VS_DisplayList.h>
+#include <VS/Graphics/VS_DisplayListCapture.h>
 #include <VS/Graphics/VS_DynamicMaterial.h>
 #include <VS/Graphics/VS_Entity.h>
 #include <VS/Graphics/VS_Fog.h>
 #include <VS/Graphics/VS_Fragment.h>
 #include <VS/Graphics/VS_Font.h>
+#include <VS/Graphics/VS_FontLayoutCache.h>
 #include <VS/Graphics/VS_FontRenderer.h>
 #include <VS/Graphics/VS_Light.h>
 #include <VS/Graphics/VS_Lines.h>
@@ -78,8 +80,10 @@
 #include <VS/Graphics/VS_RenderPipelineStageBloom.h>
 #include <VS/Graphics/VS_RenderPipelineStageScenes.h>
 #include <VS/Graphics/VS_RenderQueue.h>
+#include <VS/Graphics/VS_RenderStats.h>
 #include <VS/Graphics/VS_RenderTarget.h>
 #include <VS/Graphics/VS_Renderer.h>
+#include <VS/Graphics/VS_Renderer_Null.h>
 #include <VS/Graphics/VS_Scene.h>
 #include <VS/Graphics/VS_Screen.h>
 #include <VS/Graphics/VS_Shader.h>
@@ -104,12 +108,19 @@
 #include <VS/Math/VS_Span.h>
 #include <VS/Math/VS_Spline.h>
 #include <VS/Math/VS_Transform.h>
+#include <VS/Math/VS_TriangleBVH.h>
 #include <VS/Math/VS_Vector.h>
 
+#include <VS/Threads/VS_Barrier.h>
+#include <VS/Threads/VS_CpuTopology.h>
+#include <VS/Threads/VS_Event.h>
+#include <VS/Threads/VS_Latch.h>
+#include <VS/Threads/VS_LockStats.h>
 #include <VS/Threads/VS_Mutex.h>
 #include <VS/Threads/VS_Semaphore.h>
 #include <VS/Threads/VS_Spinlock.h>
 #include <VS/Threads/VS_Task.h>
+#include <VS/Threads/VS_ThreadPool.h>
 
 #include <VS/Utils/VS_Array.h>
 #include <VS/Utils/VS_ArrayStore.h>
@@ -130,6 +141,7 @@
 #include <VS/Utils/VS_Pool.h>
 #include <VS/Utils/VS_Preferences.h>
 #include <VS/Utils/VS_Primitive.h>
+#include <VS/Utils/VS_RadixSort.h>
 #include <VS/Utils/VS_SingletonManager.h>
 #include <VS/Utils/VS_SingleFloatImage.h>
 #include <VS/Utils/VS_Sleep.h>